@@ -40,6 +40,7 @@ SOFTWARE.
 #include <random>
 #include <algorithm>
 #include <sstream>
+#include <thread>
 
 namespace {
 
@@ -53,19 +54,19 @@ namespace {
     public BlifSolveMethod
   {
     public:
-      ClippingAndAbstract(int maxDepth, bool isOverApprox) :
+      ClippingAndAbstract(int maxDepth, bool isOverApprox, int cacheSize) :
         m_maxDepth(maxDepth),
-        m_isOverApprox(isOverApprox)
+        m_isOverApprox(isOverApprox),
+        m_cacheSize(cacheSize)
     { }
 
       bdd_ptr_set solve(BlifFactors const & blifFactors) const override
       {
         int direction = m_isOverApprox ? dd_constants::Clip_Up : dd_constants::Clip_Down;
         auto funcs = blifFactors.getFactors();
-        bdd_ptr_set funcSet(funcs->cbegin(), funcs->cend());
         auto ddm = blifFactors.getDdManager();
         auto cube = blifFactors.getPiVars();
-        auto result = bdd_clipping_and_exists_multi(ddm, funcSet, cube, m_maxDepth, direction);
+        auto result = bdd_clipping_and_exists_multi(ddm, *funcs, cube, m_maxDepth, direction, m_cacheSize);
         bdd_ptr_set resultSet;
         resultSet.insert(result);
         blif_solve_log_bdd(INFO, "Clipping returned bdd", ddm, result);
@@ -75,8 +76,103 @@ namespace {
     private:
       int m_maxDepth;
       bool m_isOverApprox;
+      int m_cacheSize;
   }; // end class ClippingAndAbstract
 
+  // ***** Class *****
+  // ClippingAndAbstractDeepening
+  // An implementation of BlifSolveMethod
+  // Like ClippingAndAbstract, but raises the clipping depth
+  //   until a round clips nothing, or the node budget or the time limit is exhausted,
+  //   and returns the tightest approximation reached
+  class ClippingAndAbstractDeepening:
+    public BlifSolveMethod
+  {
+    public:
+      ClippingAndAbstractDeepening(int nodeBudget, long timeLimit, bool isOverApprox, int cacheSize) :
+        m_nodeBudget(nodeBudget),
+        m_timeLimit(timeLimit),
+        m_isOverApprox(isOverApprox),
+        m_cacheSize(cacheSize)
+    { }
+
+      bdd_ptr_set solve(BlifFactors const & blifFactors) const override
+      {
+        int direction = m_isOverApprox ? dd_constants::Clip_Up : dd_constants::Clip_Down;
+        auto funcs = blifFactors.getFactors();
+        auto ddm = blifFactors.getDdManager();
+        auto cube = blifFactors.getPiVars();
+        int reachedDepth = 0;
+        auto result = bdd_clipping_and_exists_multi_deepening(
+            ddm, *funcs, cube, direction,
+            1, m_nodeBudget, m_timeLimit, m_cacheSize,
+            &reachedDepth);
+        bdd_ptr_set resultSet;
+        resultSet.insert(result);
+        blif_solve_log(INFO, "Clipping reached depth " << reachedDepth);
+        blif_solve_log_bdd(INFO, "Clipping returned bdd", ddm, result);
+        return resultSet;
+      }
+
+    private:
+      int m_nodeBudget;
+      long m_timeLimit;
+      bool m_isOverApprox;
+      int m_cacheSize;
+  }; // end class ClippingAndAbstractDeepening
+
+  // ***** Class *****
+  // BudgetedAndAbstractMulti
+  // An implementation of BlifSolveMethod
+  // Computes the exact and-abstract while it fits in the node budget
+  //   and the time limit, and clips the rest of the problem
+  //   once either is exceeded
+  class BudgetedAndAbstractMulti:
+    public BlifSolveMethod
+  {
+    public:
+      BudgetedAndAbstractMulti(int nodeBudget, long timeLimit, int clippingDepth, bool isOverApprox, int cacheSize) :
+        m_nodeBudget(nodeBudget),
+        m_timeLimit(timeLimit),
+        m_clippingDepth(clippingDepth),
+        m_isOverApprox(isOverApprox),
+        m_cacheSize(cacheSize)
+    { }
+
+      bdd_ptr_set solve(BlifFactors const & blifFactors) const override
+      {
+        int direction = m_isOverApprox ? dd_constants::Clip_Up : dd_constants::Clip_Down;
+        auto funcs = blifFactors.getFactors();
+        auto ddm = blifFactors.getDdManager();
+        auto cube = blifFactors.getPiVars();
+        bdd_ptr exactPart = NULL;
+        auto result = bdd_and_exists_multi_budgeted(
+            ddm, *funcs, cube, direction,
+            m_nodeBudget, m_timeLimit, m_clippingDepth, m_cacheSize,
+            &exactPart);
+        bdd_ptr_set resultSet;
+        resultSet.insert(result);
+        if (Cudd_ReadOne(ddm) == exactPart)
+        {
+          blif_solve_log(INFO, "Budgeted and-abstract is exact");
+        }
+        else
+        {
+          blif_solve_log_bdd(INFO, "Budgeted and-abstract is exact only in", ddm, exactPart);
+        }
+        blif_solve_log_bdd(INFO, "Budgeted and-abstract returned bdd", ddm, result);
+        bdd_free(ddm, exactPart);
+        return resultSet;
+      }
+
+    private:
+      int m_nodeBudget;
+      long m_timeLimit;
+      int m_clippingDepth;
+      bool m_isOverApprox;
+      int m_cacheSize;
+  }; // end class BudgetedAndAbstractMulti
+
   // ***** Class *****
   // AcyclicViaForAll
   // An implementation for BlifSolveMethod
@@ -111,16 +207,10 @@ namespace {
 
         // initialize the colors for bfs
         const int COLOR_UNVISITED = 1, COLOR_QUEUED = 2, COLOR_VISITED = 3;
-        for_each_list(fg->fl, 
-                      [&](fgnode_list* fl)
-                      { 
-                        fl->n->color = COLOR_UNVISITED; 
-                      });
-        for_each_list(fg->vl,
-                      [&](fgnode_list* vl)
-                      {
-                        vl->n->color = COLOR_UNVISITED;
-                      });
+        for (int i = 0; i < fg->num_funcs; ++i)
+          fg->funcs[i]->color = COLOR_UNVISITED;
+        for (int i = 0; i < fg->num_vars; ++i)
+          fg->vars[i]->color = COLOR_UNVISITED;
 
 
         // add the root node to the var queue
@@ -140,29 +230,29 @@ namespace {
           fgnode* curNode = q.front();
           q.pop();
           curNode->color = COLOR_VISITED;
-          for_each_list(curNode->neigh,
-                       [&](fgedge_list* el)
-                       {
-                         fgnode * nextNode = (curNode->type == VAR_NODE ? el->e->fn : el->e->vn);
-                         if (curNode->parent == nextNode)
-                           return;
-                         else if (nextNode->color != COLOR_UNVISITED)
-                         {
-                           // found a back edge, record it
-                           fgnode * fn = curNode->type == FUNC_NODE ? curNode : nextNode;
-                           fgnode * vn = curNode->type == VAR_NODE ? curNode : nextNode;
-                           for (int fidx = 0; fidx < fn->fs; ++fidx)
-                           for (int vidx = 0; vidx < vn->fs; ++vidx)
-                               backEdges[fn->f[fidx]].insert(vn->f[vidx]);
-                         }
-                         else
-                         {
-                           // no back edge, add to queue
-                           nextNode->parent = curNode;
-                           nextNode->color = COLOR_QUEUED;
-                           q.push(nextNode);
-                         }
-                       });
+          for (int i = 0; i < curNode->num_neigh; ++i)
+          {
+            fgedge * e = curNode->neigh[i];
+            fgnode * nextNode = (curNode->type == VAR_NODE ? e->fn : e->vn);
+            if (curNode->parent == nextNode)
+              continue;
+            else if (nextNode->color != COLOR_UNVISITED)
+            {
+              // found a back edge, record it
+              fgnode * fn = curNode->type == FUNC_NODE ? curNode : nextNode;
+              fgnode * vn = curNode->type == VAR_NODE ? curNode : nextNode;
+              for (int fidx = 0; fidx < fn->fs; ++fidx)
+              for (int vidx = 0; vidx < vn->fs; ++vidx)
+                  backEdges[fn->f[fidx]].insert(vn->f[vidx]);
+            }
+            else
+            {
+              // no back edge, add to queue
+              nextNode->parent = curNode;
+              nextNode->color = COLOR_QUEUED;
+              q.push(nextNode);
+            }
+          }
 
 
         } // end of BFS loop
@@ -362,6 +452,240 @@ namespace {
 
 
 
+
+
+  // ***** Class *****
+  // LoopCutsetConditioning
+  // An implementation for BlifSolveMethod
+  // Computes the exact and-exists on factor graphs with few cycles
+  //   - create the factor graph, with the non-pi vars grouped into a root node
+  //   - find a small set of pi var nodes (a loop cutset) whose removal
+  //       leaves the graph acyclic
+  //   - for each assignment to the variables of the cutset,
+  //       assign them in a snapshot of the graph and pass acyclic messages
+  //       to the root, the snapshots running in parallel, each in a
+  //       manager of its own
+  //   - OR the results of the assignments
+  // Falls back to another method if the cutset has too many variables
+  // *****************
+  class LoopCutsetConditioning:
+    public BlifSolveMethod
+  {
+    public:
+      LoopCutsetConditioning(int maxCutsetSize, int numThreads, BlifSolveMethodCptr fallback):
+        m_maxCutsetSize(std::min(maxCutsetSize, 30)), // one job per assignment, numbered by an int
+        m_numThreads(numThreads),
+        m_fallback(fallback)
+      { }
+
+      bdd_ptr_set solve(BlifFactors const & blifFactors) const override
+      {
+        // create factor graph, with the non-pi vars grouped
+        auto funcs = blifFactors.getFactors();
+        auto ddm = blifFactors.getDdManager();
+        auto fg = factor_graph_new(ddm, &(funcs->front()), funcs->size());
+        auto nonPiVarVec = blifFactors.getNonPiVars();
+        auto nonPiVars = bdd_one(ddm);
+        for (auto npv: (*nonPiVarVec))
+          bdd_and_accumulate(ddm, &nonPiVars, npv);
+        factor_graph_group_vars(fg, nonPiVars);
+        auto rootNode = factor_graph_get_varnode(fg, nonPiVars);
+
+
+        // find the cutset, and the variables to assign
+        Jobs jobs;
+        jobs.nonPiVars = nonPiVars;
+        bool isSmall = rootNode != NULL && findCutset(ddm, fg, rootNode, jobs.cutsetVars);
+        if (!isSmall)
+        {
+          blif_solve_log(INFO, "Loop cutset larger than " << m_maxCutsetSize
+                               << " variables, falling back");
+          factor_graph_delete(fg);
+          bdd_free(ddm, nonPiVars);
+          return m_fallback->solve(blifFactors);
+        }
+        int numJobs = 1 << jobs.cutsetVars.size();
+        blif_solve_log(INFO, "Loop cutset of " << jobs.cutsetVars.size() << " variables, "
+                             << numJobs << " assignments");
+
+
+        // pass acyclic messages for each assignment, and OR the results
+        auto start = now();
+        std::vector<bdd_ptr> results(numJobs, NULL);
+        int status = factor_graph_run_snapshots(fg, numJobs, m_numThreads, &conditionedMessage, &jobs, &results.front());
+        factor_graph_delete(fg);
+        bdd_free(ddm, nonPiVars);
+        if (status != 0)
+        {
+          blif_solve_log(WARNING, "Loop cutset conditioning failed, falling back");
+          return m_fallback->solve(blifFactors);
+        }
+        bdd_ptr result = bdd_zero(ddm);
+        for (auto r: results)
+        {
+          bdd_or_accumulate(ddm, &result, r);
+          bdd_free(ddm, r);
+        }
+        blif_solve_log(INFO, "Passed acyclic messages for " << numJobs
+                             << " assignments in " << duration(start) << " secs");
+        blif_solve_log_bdd(INFO, "Loop cutset conditioning returned bdd", ddm, result);
+
+        bdd_ptr_set resultSet;
+        resultSet.insert(result);
+        return resultSet;
+      }
+
+    private:
+
+      // what each snapshot needs to know
+      struct Jobs
+      {
+        std::vector<int> cutsetVars;   // indices of the variables to assign
+        bdd_ptr nonPiVars;             // the cube of the root node
+      };
+
+      // ***** Function *****
+      // Greedily picks the pi var node of largest degree in what is left
+      //   of the graph after repeatedly removing the nodes of degree
+      //   at most one (which lie on no cycle), till nothing is left
+      // Returns false if the cutset needs more than m_maxCutsetSize variables
+      // ********************
+      bool findCutset(DdManager * ddm, factor_graph * fg, fgnode * rootNode, std::vector<int> & cutsetVars) const
+      {
+        std::map<fgnode *, int> degree;
+        for (int i = 0; i < fg->num_funcs; ++i)
+          degree[fg->funcs[i]] = fg->funcs[i]->num_neigh;
+        for (int i = 0; i < fg->num_vars; ++i)
+          degree[fg->vars[i]] = fg->vars[i]->num_neigh;
+        std::vector<fgnode *> leaves;
+        for (auto const & nd: degree)
+          if (nd.second <= 1)
+            leaves.push_back(nd.first);
+
+        // remove a node, and queue the neighbours left with at most one edge
+        auto remove = [&](fgnode * n) {
+          degree[n] = -1;
+          for (int i = 0; i < n->num_neigh; ++i)
+          {
+            fgnode * next = (n->type == VAR_NODE ? n->neigh[i]->fn : n->neigh[i]->vn);
+            if (degree[next] > 0 && --degree[next] == 1)
+              leaves.push_back(next);
+          }
+        };
+
+        while (true)
+        {
+          while (!leaves.empty())
+          {
+            fgnode * n = leaves.back();
+            leaves.pop_back();
+            if (degree[n] >= 0)
+              remove(n);
+          }
+
+          bool isAcyclic = true;
+          for (auto const & nd: degree)
+            if (nd.second >= 0)
+              isAcyclic = false;
+          if (isAcyclic)
+            return true;
+
+          // the var node with most edges left on cycles
+          fgnode * best = NULL;
+          for (int i = 0; i < fg->num_vars; ++i)
+          {
+            fgnode * v = fg->vars[i];
+            if (v != rootNode && (best == NULL || degree[v] > degree[best]))
+              best = v;
+          }
+          if (best == NULL || degree[best] < 2)
+            return false;
+
+          // add its variables to the cutset
+          bdd_ptr vars = bdd_dup(best->ss[0]);
+          while (!bdd_is_one(ddm, vars))
+          {
+            int index = bdd_get_lowest_index(ddm, vars);
+            bdd_ptr v = bdd_new_var_with_index(ddm, index);
+            bdd_ptr rest = bdd_cube_diff(ddm, vars, v);
+            bdd_free(ddm, v);
+            bdd_free(ddm, vars);
+            vars = rest;
+            cutsetVars.push_back(index);
+          }
+          bdd_free(ddm, vars);
+          if (static_cast<int>(cutsetVars.size()) > m_maxCutsetSize)
+            return false;
+          remove(best);
+        }
+      }
+
+      // ***** Function *****
+      // A job of factor_graph_run_snapshots:
+      //   assigns the cutset variables from the bits of the job,
+      //   passes acyclic messages to the root node,
+      //   and returns the conjunction of its incoming messages,
+      //   or zero if some tree away from the root is unsatisfiable
+      // ********************
+      static bdd_ptr conditionedMessage(factor_graph_snapshot * s, int job, void * data)
+      {
+        Jobs const * jobs = static_cast<Jobs const *>(data);
+        factor_graph * fg = factor_graph_snapshot_write(s);
+        if (fg == NULL)
+          return NULL;
+        DdManager * ddm = fg->m;
+
+        fg->time++;
+        for (size_t i = 0; i < jobs->cutsetVars.size(); ++i)
+        {
+          bdd_ptr v = bdd_new_var_with_index(ddm, jobs->cutsetVars[i]);
+          bdd_ptr literal = ((job >> i) & 1) ? bdd_dup(v) : bdd_not(v);
+          int error = factor_graph_assign_var(fg, literal);
+          bdd_free(ddm, literal);
+          bdd_free(ddm, v);
+          if (error)
+            return NULL;
+        }
+
+        auto rootNode = factor_graph_get_varnode(fg, jobs->nonPiVars);
+        if (factor_graph_acyclic_messages(fg, rootNode) < 0)
+          return NULL;
+
+        // the nodes that got messages on all their edges are the last ones
+        // reached in the trees without the root: each is satisfiable
+        // if the conjunction at that node is
+        bdd_ptr result = bdd_one(ddm);
+        for (int i = 0; i < fg->num_funcs + fg->num_vars && !bdd_is_zero(ddm, result); ++i)
+        {
+          fgnode * n = (i < fg->num_funcs ? fg->funcs[i] : fg->vars[i - fg->num_funcs]);
+          if (n == rootNode || n->num_messages != n->num_neigh)
+            continue;
+          bdd_ptr all = bdd_one(ddm);
+          if (n->type == FUNC_NODE)
+            for (int j = 0; j < n->fs; ++j)
+              bdd_and_accumulate(ddm, &all, n->f[j]);
+          for (int j = 0; j < n->num_neigh; ++j)
+            bdd_and_accumulate(ddm, &all, n->type == FUNC_NODE ? n->neigh[j]->msg_vf : n->neigh[j]->msg_fv);
+          if (bdd_is_zero(ddm, all))
+          {
+            bdd_free(ddm, result);
+            result = bdd_zero(ddm);
+          }
+          bdd_free(ddm, all);
+        }
+        if (rootNode != NULL && !bdd_is_zero(ddm, result))
+          for (int j = 0; j < rootNode->num_neigh; ++j)
+            bdd_and_accumulate(ddm, &result, rootNode->neigh[j]->msg_fv);
+        return result;
+      }
+
+      int m_maxCutsetSize;
+      int m_numThreads;
+      BlifSolveMethodCptr m_fallback;
+  }; // end class LoopCutsetConditioning
+
+
+
   
 
   // ***** Class *****
@@ -404,28 +728,43 @@ namespace {
   //   to conjoin all the factors
   //   and abstract away all primary input variables
   //   in a single pass
+  // With more than one thread, splits the problem
+  //   into about four cofactor jobs per thread
   // *****************
   class ExactAndAbstractMulti
     : public BlifSolveMethod
   {
     public:
-      ExactAndAbstractMulti(int cacheSize):
-        m_cacheSize(cacheSize)
+      ExactAndAbstractMulti(int cacheSize, int numThreads):
+        m_cacheSize(cacheSize),
+        m_numThreads(numThreads)
       { }
 
       bdd_ptr_set solve(BlifFactors const & blif_factors) const override
       {
         auto manager = blif_factors.getDdManager();
         auto factors = blif_factors.getFactors();
-        bdd_ptr_set factor_set(factors->cbegin(), factors->cend());
         auto cube = blif_factors.getPiVars();
         bdd_ptr_set result;
-        result.insert(bdd_and_exists_multi(manager, factor_set, cube, m_cacheSize));
+        if (1 == m_numThreads)
+          result.insert(bdd_and_exists_multi(manager, *factors, cube, m_cacheSize));
+        else
+        {
+          int numThreads = m_numThreads > 0 ? m_numThreads : std::max(1u, std::thread::hardware_concurrency());
+          int numSplitVars = 0;
+          while ((1 << numSplitVars) < 4 * numThreads)
+            ++numSplitVars;
+          blif_solve_log(INFO, "ExactAndAbstractMulti using " << numThreads << " threads and "
+                               << numSplitVars << " split variables");
+          result.insert(bdd_and_exists_multi_parallel(manager, *factors, cube, m_cacheSize,
+                                                      numSplitVars, numThreads));
+        }
         return result;
       }
 
     private:
       int m_cacheSize;
+      int m_numThreads;
   };
 
 
@@ -477,9 +816,9 @@ namespace blif_solve
     return std::make_shared<ExactAndAccumulate>();
   }
 
-  BlifSolveMethodCptr BlifSolveMethod::createExactAndAbstractMulti(int cacheSize)
+  BlifSolveMethodCptr BlifSolveMethod::createExactAndAbstractMulti(int cacheSize, int numThreads)
   {
-    return std::make_shared<ExactAndAbstractMulti>(cacheSize);
+    return std::make_shared<ExactAndAbstractMulti>(cacheSize, numThreads);
   }
 
   BlifSolveMethodCptr BlifSolveMethod::createFactorGraphApprox(
@@ -495,6 +834,14 @@ namespace blif_solve
     return std::make_shared<AcyclicViaForAll>();
   }
 
+  BlifSolveMethodCptr BlifSolveMethod::createLoopCutsetConditioning(
+      int maxCutsetSize,
+      int numThreads,
+      BlifSolveMethodCptr const & fallback)
+  {
+    return std::make_shared<LoopCutsetConditioning>(maxCutsetSize, numThreads, fallback);
+  }
+
   BlifSolveMethodCptr BlifSolveMethod::createTrue()
   {
     return std::make_shared<True>();
@@ -505,9 +852,32 @@ namespace blif_solve
     return std::make_shared<False>();
   }
 
-  BlifSolveMethodCptr BlifSolveMethod::createClippingAndAbstract(int clippingDepth, bool isClippingOverApproximated)
+  BlifSolveMethodCptr BlifSolveMethod::createClippingAndAbstract(int clippingDepth, bool isClippingOverApproximated, int cacheSize)
+  {
+    return std::make_shared<ClippingAndAbstract>(clippingDepth, isClippingOverApproximated, cacheSize);
+  }
+
+  BlifSolveMethodCptr BlifSolveMethod::createClippingAndAbstractDeepening(
+      int clippingNodeBudget,
+      long clippingTimeLimit,
+      bool isClippingOverApproximated,
+      int cacheSize)
+  {
+    return std::make_shared<ClippingAndAbstractDeepening>(
+        clippingNodeBudget, clippingTimeLimit,
+        isClippingOverApproximated, cacheSize);
+  }
+
+  BlifSolveMethodCptr BlifSolveMethod::createBudgetedAndAbstractMulti(
+      int nodeBudget,
+      long timeLimit,
+      int clippingDepth,
+      bool isOverApproximated,
+      int cacheSize)
   {
-    return std::make_shared<ClippingAndAbstract>(clippingDepth, isClippingOverApproximated);
+    return std::make_shared<BudgetedAndAbstractMulti>(
+        nodeBudget, timeLimit, clippingDepth,
+        isOverApproximated, cacheSize);
   }
 
 
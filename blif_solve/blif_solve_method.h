@@ -38,14 +38,26 @@ namespace blif_solve {
       virtual bdd_ptr_set solve(BlifFactors const & blifFactors) const = 0;
 
       static Cptr createExactAndAccumulate();
-      static Cptr createExactAndAbstractMulti(int cacheSize);
+      static Cptr createExactAndAbstractMulti(int cacheSize, int numThreads);
       static Cptr createFactorGraphApprox(int largestSupportSet,
                                           int numConvergence,
                                           std::string const & dotDumpPath);
       static Cptr createAcyclicViaForAll();
+      static Cptr createLoopCutsetConditioning(int maxCutsetSize,
+                                               int numThreads,
+                                               Cptr const & fallback);
       static Cptr createTrue();
       static Cptr createFalse();
-      static Cptr createClippingAndAbstract(int clippingDepth, bool isClippingOverApproximated);
+      static Cptr createClippingAndAbstract(int clippingDepth, bool isClippingOverApproximated, int cacheSize);
+      static Cptr createClippingAndAbstractDeepening(int clippingNodeBudget,
+                                                     long clippingTimeLimit,
+                                                     bool isClippingOverApproximated,
+                                                     int cacheSize);
+      static Cptr createBudgetedAndAbstractMulti(int nodeBudget,
+                                                 long timeLimit,
+                                                 int clippingDepth,
+                                                 bool isOverApproximated,
+                                                 int cacheSize);
 
       virtual ~BlifSolveMethod() {}
 
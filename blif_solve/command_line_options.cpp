@@ -39,8 +39,14 @@ namespace blif_solve {
     largestSupportSet(30),
     numConvergence(1),
     clippingDepth(100),
+    clippingNodeBudget(0),
+    clippingTimeLimit(0),
+    exactNodeBudget(0),
+    exactTimeLimit(0),
+    maxCutsetSize(10),
     numLoVarsToQuantify(0),
     cacheSize(10*1000),
+    numThreads(1),
     dotDumpPath(),
     mustCountSolutions(false),
     blif_file_path()
@@ -121,6 +127,41 @@ namespace blif_solve {
           usage("clipping depth missing after --clipping_depth flag");
         clippingDepth = std::atoi(argv[argi]);
       }
+      else if(arg == "--clipping_node_budget")
+      {
+        ++argi;
+        if (argi >= argc)
+          usage("node budget missing after --clipping_node_budget flag");
+        clippingNodeBudget = std::atoi(argv[argi]);
+      }
+      else if(arg == "--clipping_time_limit")
+      {
+        ++argi;
+        if (argi >= argc)
+          usage("time limit missing after --clipping_time_limit flag");
+        clippingTimeLimit = std::atol(argv[argi]);
+      }
+      else if(arg == "--exact_node_budget")
+      {
+        ++argi;
+        if (argi >= argc)
+          usage("node budget missing after --exact_node_budget flag");
+        exactNodeBudget = std::atoi(argv[argi]);
+      }
+      else if(arg == "--exact_time_limit")
+      {
+        ++argi;
+        if (argi >= argc)
+          usage("time limit missing after --exact_time_limit flag");
+        exactTimeLimit = std::atol(argv[argi]);
+      }
+      else if(arg == "--max_cutset_size")
+      {
+        ++argi;
+        if (argi >= argc)
+          usage("number missing after --max_cutset_size flag");
+        maxCutsetSize = std::atoi(argv[argi]);
+      }
       else if(arg == "--num_lo_vars_to_quantify")
       {
         ++argi;
@@ -135,6 +176,13 @@ namespace blif_solve {
           usage("number missing after --cache_size");
         cacheSize = std::atoi(argv[argi]);
       }
+      else if (arg == "--num_threads")
+      {
+        ++argi;
+        if (argi >= argc)
+          usage("number missing after --num_threads");
+        numThreads = std::atoi(argv[argi]);
+      }
       else if("--must_count_solutions" == arg)
       {
         mustCountSolutions = true;
@@ -170,13 +218,27 @@ namespace blif_solve {
               << "\t\t--verbosity v                : set verbosity level to v;\n"
               << "\t\t                               must be one of QUIET/ERROR/WARNING/INFO/DEBUG\n"
               << "\t\t--clipping_depth d           : set depth for clipping approximation\n"
+              << "\t\t                               (0 to raise the depth until a budget is exhausted)\n"
+              << "\t\t--clipping_node_budget n     : largest clipped result while raising the depth\n"
+              << "\t\t--clipping_time_limit ms     : time limit in milliseconds while raising the depth\n"
+              << "\t\t--exact_node_budget n        : live nodes allowed before BudgetedOverApprox/\n"
+              << "\t\t                               BudgetedUnderApprox start clipping\n"
+              << "\t\t--exact_time_limit ms        : time in milliseconds before they start clipping\n"
+              << "\t\t--max_cutset_size n          : variables LoopCutsetOverApprox/LoopCutsetUnderApprox\n"
+              << "\t\t                               condition on, at most 30 (default 10), before\n"
+              << "\t\t                               falling back to FactorGraphApprox/AcyclicViaForAll\n"
               << "\t\t--cache_size                 : set cache size for custom multi-bdd algorithms\n"
+              << "\t\t--num_threads                : number of threads for ExactAndAbstractMulti,\n"
+              << "\t\t                               the loop cutset methods and counting solutions\n"
+              << "\t\t                               (0 for all hardware threads, default 1)\n"
               << "\t\t--num_lo_vars_to_quantify    : number of lo vars to quantify\n"
               << "\t\t--dot_dump_path ddp          : path to dump dot files (for factor graph visualization\n"
               << "\t\t--must_count_solutions       : whether to count and print the number of solutions\n"
               << "\tAvailable solve methods: ExactAndAccumulate/ExactAndAbstractMulti/FactorGraphApprox/\n"
               << "\t                         FactorGraphExact/AcyclicViaForAll/True/False/\n"
-              << "\t                         ClippingOverApprox/ClippingUnderApprox"
+              << "\t                         ClippingOverApprox/ClippingUnderApprox/\n"
+              << "\t                         BudgetedOverApprox/BudgetedUnderApprox/\n"
+              << "\t                         LoopCutsetOverApprox/LoopCutsetUnderApprox"
               << std::endl;
     exit(error.empty());
   }
@@ -50,11 +50,25 @@ namespace blif_solve {
     // number of convergences to perform
     int numConvergence;
     // maximum depth to use while clipping
+    // (non-positive to raise the depth until a budget is exhausted)
     int clippingDepth;
+    // largest clipped result allowed while raising the depth
+    int clippingNodeBudget;
+    // time limit (in milliseconds) for raising the clipping depth
+    long clippingTimeLimit;
+    // largest number of live nodes for the budgeted and-abstract
+    int exactNodeBudget;
+    // time limit (in milliseconds) for the budgeted and-abstract
+    long exactTimeLimit;
+    // most variables to condition on in LoopCutsetOverApprox/LoopCutsetUnderApprox
+    // before falling back to FactorGraphApprox/AcyclicViaForAll
+    int maxCutsetSize;
     // number of latch output variables to existentially quantify
     int numLoVarsToQuantify;
     // cache size for multi-bdd algorithms
     int cacheSize;
+    // number of threads for multi-bdd algorithms (0 for all hardware threads)
+    int numThreads;
 
     // path to dump dot files (for factor graph visualization)
     std::string dotDumpPath;
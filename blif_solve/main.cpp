@@ -54,9 +54,10 @@ SOFTWARE.
 int                             main                 (int argc, char ** argv);
 blif_solve::BlifSolveMethodCptr createBlifSolveMethod(std::string const & bsmStr,
                                                       blif_solve::CommandLineOptions const & clo);
-long double                     getNumSolutions      (DdManager * ddm,
+std::string                     getNumSolutions      (DdManager * ddm,
                                                       bdd_ptr_set const & bdd,
-                                                      int numVars);
+                                                      int numVars,
+                                                      int numThreads);
 bdd_ptr_set                     divideAndConquer     (blif_solve::BlifFactors::PtrVec const & partitions,
                                                       blif_solve::BlifSolveMethod::Cptr const & method);
 
@@ -121,7 +122,7 @@ int main(int argc, char ** argv)
                            << duration(start) << " sec");
       if(clo->mustCountSolutions)
         blif_solve_log(INFO, "Over approximating method " << clo->overApproximatingMethod
-                             << " finished with " << getNumSolutions(srt->ddm, upperLimit, numNonPiVars)
+                             << " finished with " << getNumSolutions(srt->ddm, upperLimit, numNonPiVars, clo->numThreads)
                              << " solutions.");
     }
 
@@ -139,7 +140,7 @@ int main(int argc, char ** argv)
                            << " in " << duration(start) << " sec");
       if (clo->mustCountSolutions)
         blif_solve_log(INFO, "Under approximating method " << clo->underApproximatingMethod
-                             << " finished with " << getNumSolutions(srt->ddm, lowerLimit, numNonPiVars)
+                             << " finished with " << getNumSolutions(srt->ddm, lowerLimit, numNonPiVars, clo->numThreads)
                              << " solutions.");
     }
 
@@ -190,7 +191,7 @@ blif_solve::BlifSolveMethodCptr createBlifSolveMethod(std::string const & bsmStr
   if ("ExactAndAccumulate" == bsmStr)
     return blif_solve::BlifSolveMethod::createExactAndAccumulate();
   else if ("ExactAndAbstractMulti" == bsmStr)
-    return blif_solve::BlifSolveMethod::createExactAndAbstractMulti(clo.cacheSize);
+    return blif_solve::BlifSolveMethod::createExactAndAbstractMulti(clo.cacheSize, clo.numThreads);
   else if ("FactorGraphApprox" == bsmStr)
     return blif_solve::BlifSolveMethod::createFactorGraphApprox(
         clo.largestSupportSet,
@@ -202,10 +203,33 @@ blif_solve::BlifSolveMethodCptr createBlifSolveMethod(std::string const & bsmStr
     return blif_solve::BlifSolveMethod::createTrue();
   else if ("False" == bsmStr)
     return blif_solve::BlifSolveMethod::createFalse();
+  else if (("ClippingOverApprox" == bsmStr || "ClippingUnderApprox" == bsmStr) && clo.clippingDepth <= 0)
+    return blif_solve::BlifSolveMethod::createClippingAndAbstractDeepening(
+        clo.clippingNodeBudget,
+        clo.clippingTimeLimit,
+        "ClippingOverApprox" == bsmStr,
+        clo.cacheSize);
   else if ("ClippingOverApprox" == bsmStr)
-    return blif_solve::BlifSolveMethod::createClippingAndAbstract(clo.clippingDepth, true);
+    return blif_solve::BlifSolveMethod::createClippingAndAbstract(clo.clippingDepth, true, clo.cacheSize);
   else if ("ClippingUnderApprox" == bsmStr)
-    return blif_solve::BlifSolveMethod::createClippingAndAbstract(clo.clippingDepth, false);
+    return blif_solve::BlifSolveMethod::createClippingAndAbstract(clo.clippingDepth, false, clo.cacheSize);
+  else if ("BudgetedOverApprox" == bsmStr || "BudgetedUnderApprox" == bsmStr)
+    return blif_solve::BlifSolveMethod::createBudgetedAndAbstractMulti(
+        clo.exactNodeBudget,
+        clo.exactTimeLimit,
+        clo.clippingDepth > 0 ? clo.clippingDepth : 100,
+        "BudgetedOverApprox" == bsmStr,
+        clo.cacheSize);
+  else if ("LoopCutsetOverApprox" == bsmStr)
+    return blif_solve::BlifSolveMethod::createLoopCutsetConditioning(
+        clo.maxCutsetSize,
+        clo.numThreads,
+        blif_solve::BlifSolveMethod::createFactorGraphApprox(clo.largestSupportSet, clo.numConvergence, clo.dotDumpPath));
+  else if ("LoopCutsetUnderApprox" == bsmStr)
+    return blif_solve::BlifSolveMethod::createLoopCutsetConditioning(
+        clo.maxCutsetSize,
+        clo.numThreads,
+        blif_solve::BlifSolveMethod::createAcyclicViaForAll());
   else if (bsmStr == "FactorGraphExact")
     throw std::runtime_error("BlifSolveMethod for '" + bsmStr + "' not yet implemented.");
   else
@@ -215,10 +239,14 @@ blif_solve::BlifSolveMethodCptr createBlifSolveMethod(std::string const & bsmStr
 }
 
 
-long double getNumSolutions(DdManager * manager, bdd_ptr_set const & bdds, int numVars)
+// ***** Function *****
+// the exact number of solutions, in decimal
+// (the results of different partitions have disjoint supports,
+// so they are counted separately and multiplied)
+std::string getNumSolutions(DdManager * manager, bdd_ptr_set const & bdds, int numVars, int numThreads)
 {
-  auto numSln = bdd_count_minterm_multi(manager, bdds, numVars, 100*1000);
-  return numSln;
+  auto numSln = bdd_count_minterm_multi_partitioned(manager, bdds, numVars, 100*1000, numThreads);
+  return numSln.toString();
 }
 
 
@@ -0,0 +1,93 @@
+/*
+
+Copyright 2021 Parakram Majumdar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace parakram {
+
+  // ***** ArenaStack *****
+  // ******** class ********
+  // A stack of reusable frames, used by the explicit-stack engines
+  //   that replace deep recursions (see cuddAndAbsMulti.cpp).
+  // Frames are allocated in chunks, and are never moved or freed
+  //   until the stack is destroyed. Hence:
+  //   - a reference to a frame stays valid while frames are pushed above it
+  //   - a popped frame is reused as it is, keeping whatever buffers
+  //     it owns, so a warmed up stack does not touch the heap
+  // push returns the frame as its last user left it,
+  //   so the caller must reinitialize it.
+  // Template arguments:
+  //   TFrame: the frame type, which must be default constructible
+  //   ChunkSize: the number of frames allocated at a time
+  template<typename TFrame, int ChunkSize = 64>
+  class ArenaStack
+  {
+    public:
+
+      ArenaStack(): m_chunks(), m_size(0), m_peakSize(0) { }
+      ArenaStack(ArenaStack const &) = delete;
+      ArenaStack & operator = (ArenaStack const &) = delete;
+
+      TFrame & push()
+      {
+        if (m_size == numFrames())
+          m_chunks.emplace_back(new TFrame[ChunkSize]);
+        ++m_size;
+        if (m_size > m_peakSize)
+          m_peakSize = m_size;
+        return top();
+      }
+
+      void pop() { --m_size; }
+
+      // ***** popTo *****
+      // pop all the frames above the given size
+      void popTo(int size) { if (size < m_size) m_size = size; }
+
+      TFrame & top() { return (*this)[m_size - 1]; }
+      TFrame & operator [] (int i) { return m_chunks[i / ChunkSize][i % ChunkSize]; }
+
+      int size() const { return m_size; }
+      bool empty() const { return 0 == m_size; }
+
+      // ***** profiling *****
+      // peakSize: the largest size since the last resetPeak
+      // numFrames: the number of frames allocated so far
+      int peakSize() const { return m_peakSize; }
+      int numFrames() const { return static_cast<int>(m_chunks.size()) * ChunkSize; }
+      void resetPeak() { m_peakSize = m_size; }
+
+    private:
+
+      std::vector<std::unique_ptr<TFrame[]> > m_chunks;
+      int m_size;
+      int m_peakSize;
+  }; // end class ArenaStack
+
+} // end namespace parakram
@@ -27,6 +27,7 @@ SOFTWARE.
 #include "bdd_factory.h"
 
 #include <stdexcept>
+#include <utility>
 
 namespace dd
 {
@@ -40,17 +41,39 @@ namespace dd
     m_manager(that.m_manager)
   { }
 
+  BddWrapper::BddWrapper(BddWrapper && that) noexcept:
+    m_bdd(that.m_bdd),
+    m_manager(that.m_manager)
+  {
+    that.m_bdd = NULL;
+  }
+
+  BddWrapper::BddWrapper(BddProduct const & product):
+    BddWrapper(product.evaluate())
+  { }
+
   BddWrapper & BddWrapper::operator = (BddWrapper const & that)
   {
-    bdd_free(m_manager, m_bdd);
+    // take the new reference first, in case of self assignment
+    bdd_ptr newBdd = bdd_dup(that.m_bdd);
+    if (NULL != m_bdd)
+      bdd_free(m_manager, m_bdd);
     m_manager = that.m_manager;
-    m_bdd = bdd_dup(that.m_bdd);
+    m_bdd = newBdd;
+    return *this;
+  }
+
+  BddWrapper & BddWrapper::operator = (BddWrapper && that) noexcept
+  {
+    std::swap(m_bdd, that.m_bdd);
+    std::swap(m_manager, that.m_manager);
     return *this;
   }
 
   BddWrapper::~BddWrapper()
   {
-    bdd_free(m_manager, m_bdd);
+    if (NULL != m_bdd)
+      bdd_free(m_manager, m_bdd);
   }
 
   BddWrapper BddWrapper::operator + (BddWrapper const & that) const
@@ -194,6 +217,103 @@ namespace dd
 
 
 
+  // the capacity of the multi-operand computed table
+  //   used to evaluate products
+  int const Product_Cache_Size = 100 * 1000;
+
+  BddProduct::BddProduct(BddWrapper const & f):
+    m_factors(1, f.getCountedBdd()),
+    m_manager(f.getManager())
+  { }
+
+  BddProduct::BddProduct(BddProduct const & that):
+    m_factors(that.m_factors),
+    m_manager(that.m_manager)
+  {
+    for (auto f: m_factors)
+      bdd_dup(f);
+  }
+
+  BddProduct::BddProduct(BddProduct && that) noexcept:
+    m_factors(std::move(that.m_factors)),
+    m_manager(that.m_manager)
+  {
+    that.m_factors.clear();
+  }
+
+  BddProduct & BddProduct::operator = (BddProduct const & that)
+  {
+    if (this != &that)
+    {
+      release();
+      m_factors = that.m_factors;
+      m_manager = that.m_manager;
+      for (auto f: m_factors)
+        bdd_dup(f);
+    }
+    return *this;
+  }
+
+  BddProduct & BddProduct::operator = (BddProduct && that) noexcept
+  {
+    std::swap(m_factors, that.m_factors);
+    std::swap(m_manager, that.m_manager);
+    return *this;
+  }
+
+  BddProduct::~BddProduct()
+  {
+    release();
+  }
+
+  void BddProduct::release()
+  {
+    for (auto f: m_factors)
+      bdd_free(m_manager, f);
+    m_factors.clear();
+  }
+
+  BddProduct & BddProduct::operator *= (BddWrapper const & that)
+  {
+    if (m_manager != that.getManager())
+      throw std::runtime_error("managers must match for bdd operations");
+    m_factors.push_back(that.getCountedBdd());
+    return *this;
+  }
+
+  BddProduct & BddProduct::operator *= (BddProduct const & that)
+  {
+    if (m_manager != that.m_manager)
+      throw std::runtime_error("managers must match for bdd operations");
+    for (auto f: that.m_factors)
+      m_factors.push_back(bdd_dup(f));
+    return *this;
+  }
+
+  BddWrapper BddProduct::evaluate() const
+  {
+    if (1 == m_factors.size())
+      return BddWrapper(bdd_dup(m_factors[0]), m_manager);
+    if (2 == m_factors.size())
+      return BddWrapper(bdd_and(m_manager, m_factors[0], m_factors[1]), m_manager);
+    return BddWrapper(bdd_and_multi(m_manager, m_factors, Product_Cache_Size), m_manager);
+  }
+
+  BddWrapper BddProduct::existentialQuantification(BddWrapper const & variables) const
+  {
+    if (1 == m_factors.size())
+      return BddWrapper(bdd_forsome(m_manager, m_factors[0], variables.getUncountedBdd()), m_manager);
+    if (2 == m_factors.size())
+      return BddWrapper(bdd_and_exists(m_manager, m_factors[0], m_factors[1], variables.getUncountedBdd()), m_manager);
+    return BddWrapper(bdd_and_exists_multi(m_manager, m_factors, variables.getUncountedBdd(), Product_Cache_Size),
+                      m_manager);
+  }
+
+
+
+
+
+
   BddVectorWrapper::BddVectorWrapper(DdManager * manager):
     m_vector(),
     m_manager(manager)
@@ -34,13 +34,24 @@ SOFTWARE.
 namespace dd
 {
 
-
+  class BddProduct;
+
+  // ***** BddWrapper *****
+  // ******** class ********
+  // Owns one reference to a bdd.
+  // A moved-from wrapper holds no bdd,
+  //   and may only be destroyed or assigned to.
+  // The conjunction a * b is evaluated at once. For a chain of
+  //   conjunctions evaluated in one go, build a BddProduct with dd::product.
   class BddWrapper
   {
     public:
       BddWrapper(bdd_ptr elem_bdd, DdManager * manager);
       BddWrapper(BddWrapper const & that);
+      BddWrapper(BddWrapper && that) noexcept;
+      BddWrapper(BddProduct const & product);
       BddWrapper & operator = (BddWrapper const & that);
+      BddWrapper & operator = (BddWrapper && that) noexcept;
 
       ~BddWrapper();
 
@@ -87,6 +98,53 @@ namespace dd
 
 
 
+
+  // ***** BddProduct *****
+  // ******** class ********
+  // An unevaluated conjunction of bdds, holding a reference to each,
+  //   built with dd::product and *=.
+  // Evaluated in one go when converted to a BddWrapper:
+  //   pairwise for two factors, and with bdd_and_multi for more.
+  // existentialQuantification fuses the conjunction with the projection
+  //   (bdd_and_exists, or bdd_and_exists_multi).
+  class BddProduct
+  {
+    public:
+      explicit BddProduct(BddWrapper const & f);
+      BddProduct(BddProduct const & that);
+      BddProduct(BddProduct && that) noexcept;
+      BddProduct & operator = (BddProduct const & that);
+      BddProduct & operator = (BddProduct && that) noexcept;
+      ~BddProduct();
+
+      BddProduct & operator *= (BddWrapper const & that);
+      BddProduct & operator *= (BddProduct const & that);
+
+      BddWrapper evaluate() const;
+      BddWrapper existentialQuantification(BddWrapper const & variables) const;
+
+      int numFactors() const { return static_cast<int>(m_factors.size()); }
+      DdManager * getManager() const { return m_manager; }
+
+    private:
+      void release();
+
+      std::vector<bdd_ptr> m_factors;
+      DdManager * m_manager;
+
+  }; // end class BddProduct
+
+  // the unevaluated conjunction of the given wrappers and products
+  template<typename... Factors>
+  BddProduct product(BddWrapper const & first, Factors const &... rest)
+  {
+    BddProduct result(first);
+    (result *= ... *= rest);
+    return result;
+  }
+
+
+
   class BddVectorWrapper
   {
     public:
@@ -0,0 +1,385 @@
+/*
+
+Copyright 2021 Parakram Majumdar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#pragma once
+
+#include <cuddInt.h>
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+
+namespace parakram {
+
+  // ***** BddOperandSet *****
+  // ******** class ********
+  // A compact set of bdd operands, used by the multi-operand
+  //   cudd algorithms in cuddAndAbsMulti.cpp in place of std::set<DdNode *>.
+  // The operands are sorted by the level of their top variable
+  //   (ties broken by the node address, so that f and !f are adjacent).
+  //   Hence the top variable of the set is the top variable
+  //   of the first operand.
+  // Up to N operands are stored inline, so the narrow sets that make up
+  //   most of the recursion never touch the heap. Larger sets spill.
+  // A commutative hash is accumulated as operands are added,
+  //   so the set can be used as a cache key without rehashing.
+  // Building a set:
+  //   - push the operands in any order
+  //   - call normalize, which sorts and deduplicates the operands,
+  //     drops the constant one, and detects a zero conjunction
+  //     (a constant zero, or a pair f and !f)
+  // Template arguments:
+  //   N: the number of operands stored inline
+  template<int N = 8>
+  class BddOperandSet
+  {
+    public:
+
+      BddOperandSet();
+      BddOperandSet(BddOperandSet const & that);
+      BddOperandSet(BddOperandSet && that);
+      BddOperandSet & operator = (BddOperandSet const & that);
+      BddOperandSet & operator = (BddOperandSet && that);
+      ~BddOperandSet();
+
+      // ***** assign *****
+      // copy the operands of a set with a different inline capacity
+      template<int M>
+      void assign(BddOperandSet<M> const & that);
+
+      // ***** fromRange *****
+      // create a normalized set from a range of bdds
+      template<typename TIter>
+      static BddOperandSet fromRange(DdManager * manager, TIter begin, TIter end);
+
+      // ***** push *****
+      // append an operand, without maintaining the ordering
+      void push(DdNode * f);
+
+      // ***** normalize *****
+      // sort, remove duplicates and ones, and detect zero conjunctions
+      void normalize(DdManager * manager);
+
+      // ***** splitOnTop *****
+      // Computes the normalized 'then' and 'else' cofactors of the set
+      //   with respect to its top variable.
+      // Returns the index of the top variable.
+      // Must be called on a normalized non-empty set.
+      int splitOnTop(DdManager * manager, BddOperandSet & thenSet, BddOperandSet & elseSet) const;
+
+      // ***** topLevel *****
+      // level of the top variable of a normalized non-empty set
+      int topLevel(DdManager * manager) const { return manager->perm[Cudd_Regular(m_data[0])->index]; }
+
+      // ***** contains / erase *****
+      // lookup and removal on a normalized set
+      bool contains(DdManager * manager, DdNode * f) const;
+      bool erase(DdManager * manager, DdNode * f);
+
+      void clear() { m_size = 0; m_hash = 0; m_isZero = false; }
+      int size() const { return m_size; }
+      bool empty() const { return 0 == m_size; }
+      bool isZero() const { return m_isZero; }
+      bool isSpilled() const { return m_data != m_inline; }
+      std::size_t hash() const { return m_hash; }
+
+      DdNode * operator [] (int i) const { return m_data[i]; }
+      DdNode * const * begin() const { return m_data; }
+      DdNode * const * end() const { return m_data + m_size; }
+
+      template<int M>
+      bool operator == (BddOperandSet<M> const & that) const;
+      template<int M>
+      bool operator != (BddOperandSet<M> const & that) const { return !(*this == that); }
+
+      // ***** mix *****
+      // hash contribution of a single operand
+      static std::size_t mix(DdNode const * f)
+      {
+        std::size_t h = reinterpret_cast<std::size_t>(f);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+      }
+
+    private:
+
+      template<int M> friend class BddOperandSet;
+
+      // order on operands: level of top variable, then address
+      static bool precedes(DdManager * manager, DdNode * a, DdNode * b)
+      {
+        int la = manager->perm[Cudd_Regular(a)->index];
+        int lb = manager->perm[Cudd_Regular(b)->index];
+        return la < lb || (la == lb && a < b);
+      }
+
+      void reserve(int capacity);
+
+      DdNode ** m_data;
+      int m_size;
+      int m_capacity;
+      std::size_t m_hash;
+      bool m_isZero;
+      DdNode * m_inline[N];
+  }; // end class BddOperandSet
+
+
+
+
+  template<int N>
+  BddOperandSet<N>::BddOperandSet():
+    m_data(m_inline),
+    m_size(0),
+    m_capacity(N),
+    m_hash(0),
+    m_isZero(false)
+  { }
+
+  template<int N>
+  BddOperandSet<N>::BddOperandSet(BddOperandSet const & that):
+    BddOperandSet()
+  {
+    *this = that;
+  }
+
+  template<int N>
+  BddOperandSet<N>::BddOperandSet(BddOperandSet && that):
+    BddOperandSet()
+  {
+    *this = std::move(that);
+  }
+
+  template<int N>
+  BddOperandSet<N> & BddOperandSet<N>::operator = (BddOperandSet const & that)
+  {
+    if (this != &that)
+      assign(that);
+    return *this;
+  }
+
+  template<int N>
+  template<int M>
+  void BddOperandSet<N>::assign(BddOperandSet<M> const & that)
+  {
+    m_size = 0;
+    reserve(that.m_size);
+    std::copy(that.m_data, that.m_data + that.m_size, m_data);
+    m_size = that.m_size;
+    m_hash = that.m_hash;
+    m_isZero = that.m_isZero;
+  }
+
+  template<int N>
+  BddOperandSet<N> & BddOperandSet<N>::operator = (BddOperandSet && that)
+  {
+    if (this == &that)
+      return *this;
+    if (!that.isSpilled())
+      return *this = static_cast<BddOperandSet const &>(that);
+    if (isSpilled())
+      delete [] m_data;
+    m_data = that.m_data;
+    m_capacity = that.m_capacity;
+    m_size = that.m_size;
+    m_hash = that.m_hash;
+    m_isZero = that.m_isZero;
+    that.m_data = that.m_inline;
+    that.m_capacity = N;
+    that.clear();
+    return *this;
+  }
+
+  template<int N>
+  BddOperandSet<N>::~BddOperandSet()
+  {
+    if (isSpilled())
+      delete [] m_data;
+  }
+
+  template<int N>
+  void BddOperandSet<N>::reserve(int capacity)
+  {
+    if (capacity <= m_capacity)
+      return;
+    int newCapacity = std::max(capacity, 2 * m_capacity);
+    DdNode ** newData = new DdNode *[newCapacity];
+    std::copy(m_data, m_data + m_size, newData);
+    if (isSpilled())
+      delete [] m_data;
+    m_data = newData;
+    m_capacity = newCapacity;
+  }
+
+  template<int N>
+  template<typename TIter>
+  BddOperandSet<N> BddOperandSet<N>::fromRange(DdManager * manager, TIter begin, TIter end)
+  {
+    BddOperandSet<N> result;
+    for (auto it = begin; it != end; ++it)
+      result.push(*it);
+    result.normalize(manager);
+    return result;
+  }
+
+  template<int N>
+  void BddOperandSet<N>::push(DdNode * f)
+  {
+    if (m_size == m_capacity)
+      reserve(m_size + 1);
+    m_data[m_size++] = f;
+  }
+
+  template<int N>
+  void BddOperandSet<N>::normalize(DdManager * manager)
+  {
+    DdNode * const one = DD_ONE(manager);
+    DdNode * const zero = Cudd_Not(one);
+
+    // filter out the constants
+    int numNonConstant = 0;
+    for (int i = 0; i < m_size; ++i)
+    {
+      DdNode * f = m_data[i];
+      if (f == zero)
+      {
+        clear();
+        m_isZero = true;
+        return;
+      }
+      if (f != one)
+        m_data[numNonConstant++] = f;
+    }
+    m_size = numNonConstant;
+
+    // sort, then drop duplicates and detect complementary pairs,
+    // which are adjacent in the sorted order
+    if (m_size > 1)
+      std::sort(m_data, m_data + m_size,
+                [manager](DdNode * a, DdNode * b) { return precedes(manager, a, b); });
+    m_hash = 0;
+    int numUnique = 0;
+    for (int i = 0; i < m_size; ++i)
+    {
+      DdNode * f = m_data[i];
+      if (numUnique > 0)
+      {
+        DdNode * prev = m_data[numUnique - 1];
+        if (prev == f)
+          continue;
+        if (prev == Cudd_Not(f))
+        {
+          clear();
+          m_isZero = true;
+          return;
+        }
+      }
+      m_data[numUnique++] = f;
+      m_hash += mix(f);
+    }
+    m_size = numUnique;
+  }
+
+  template<int N>
+  int BddOperandSet<N>::splitOnTop(DdManager * manager, BddOperandSet & thenSet, BddOperandSet & elseSet) const
+  {
+    thenSet.clear();
+    elseSet.clear();
+    thenSet.reserve(m_size);
+    elseSet.reserve(m_size);
+    DdHalfWord const index = Cudd_Regular(m_data[0])->index;
+    for (int i = 0; i < m_size; ++i)
+    {
+      DdNode * f = m_data[i];
+      DdNode * F = Cudd_Regular(f);
+      if (F->index == index)
+      {
+        thenSet.push(Cudd_NotCond(cuddT(F), Cudd_IsComplement(f)));
+        elseSet.push(Cudd_NotCond(cuddE(F), Cudd_IsComplement(f)));
+      }
+      else
+      {
+        thenSet.push(f);
+        elseSet.push(f);
+      }
+    }
+    thenSet.normalize(manager);
+    elseSet.normalize(manager);
+    return index;
+  }
+
+  template<int N>
+  bool BddOperandSet<N>::contains(DdManager * manager, DdNode * f) const
+  {
+    if (cuddIsConstant(Cudd_Regular(f)))
+      return false;
+    return std::binary_search(m_data, m_data + m_size, f,
+                              [manager](DdNode * a, DdNode * b) { return precedes(manager, a, b); });
+  }
+
+  template<int N>
+  bool BddOperandSet<N>::erase(DdManager * manager, DdNode * f)
+  {
+    if (cuddIsConstant(Cudd_Regular(f)))
+      return false;
+    auto pos = std::lower_bound(m_data, m_data + m_size, f,
+                                [manager](DdNode * a, DdNode * b) { return precedes(manager, a, b); });
+    if (pos == m_data + m_size || *pos != f)
+      return false;
+    std::copy(pos + 1, m_data + m_size, pos);
+    --m_size;
+    m_hash -= mix(f);
+    return true;
+  }
+
+  template<int N>
+  template<int M>
+  bool BddOperandSet<N>::operator == (BddOperandSet<M> const & that) const
+  {
+    return m_hash == that.m_hash
+      && m_size == that.m_size
+      && m_isZero == that.m_isZero
+      && std::equal(m_data, m_data + m_size, that.m_data);
+  }
+
+
+} // end namespace parakram
+
+
+
+namespace std {
+
+  template<int N> struct hash<parakram::BddOperandSet<N> >
+  {
+    std::size_t operator()(parakram::BddOperandSet<N> const & operands) const
+    {
+      return operands.hash();
+    }
+  };
+
+} // end namespace std
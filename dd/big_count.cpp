@@ -0,0 +1,191 @@
+/*
+
+Copyright 2021 Parakram Majumdar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#include "big_count.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace parakram {
+
+  BigCount::BigCount(unsigned long long value):
+    m_limbs()
+  {
+    for (; value > 0; value >>= 32)
+      m_limbs.push_back(static_cast<std::uint32_t>(value));
+  }
+
+  BigCount BigCount::powerOfTwo(int exponent)
+  {
+    BigCount result;
+    result.m_limbs.assign(exponent / 32 + 1, 0);
+    result.m_limbs.back() = std::uint32_t(1) << (exponent % 32);
+    return result;
+  }
+
+  BigCount & BigCount::operator += (BigCount const & that)
+  {
+    if (m_limbs.size() < that.m_limbs.size())
+      m_limbs.resize(that.m_limbs.size(), 0);
+    std::uint64_t carry = 0;
+    for (std::size_t i = 0; i < m_limbs.size() && (carry > 0 || i < that.m_limbs.size()); ++i)
+    {
+      std::uint64_t sum = carry + m_limbs[i] + (i < that.m_limbs.size() ? that.m_limbs[i] : 0);
+      m_limbs[i] = static_cast<std::uint32_t>(sum);
+      carry = sum >> 32;
+    }
+    if (carry > 0)
+      m_limbs.push_back(static_cast<std::uint32_t>(carry));
+    return *this;
+  }
+
+  BigCount & BigCount::operator *= (BigCount const & that)
+  {
+    if (isZero() || that.isZero())
+    {
+      setZero();
+      return *this;
+    }
+    std::vector<std::uint32_t> product(m_limbs.size() + that.m_limbs.size(), 0);
+    for (std::size_t i = 0; i < m_limbs.size(); ++i)
+    {
+      std::uint64_t carry = 0;
+      for (std::size_t j = 0; j < that.m_limbs.size(); ++j)
+      {
+        std::uint64_t cell = std::uint64_t(m_limbs[i]) * that.m_limbs[j] + product[i + j] + carry;
+        product[i + j] = static_cast<std::uint32_t>(cell);
+        carry = cell >> 32;
+      }
+      product[i + that.m_limbs.size()] = static_cast<std::uint32_t>(carry);
+    }
+    m_limbs.swap(product);
+    trim();
+    return *this;
+  }
+
+  BigCount & BigCount::shiftLeft(int numBits)
+  {
+    if (isZero() || numBits <= 0)
+      return *this;
+    int const limbShift = numBits / 32;
+    int const bitShift = numBits % 32;
+    if (bitShift > 0)
+    {
+      std::uint32_t carry = 0;
+      for (auto & limb: m_limbs)
+      {
+        std::uint32_t next = limb >> (32 - bitShift);
+        limb = (limb << bitShift) | carry;
+        carry = next;
+      }
+      if (carry > 0)
+        m_limbs.push_back(carry);
+    }
+    m_limbs.insert(m_limbs.begin(), limbShift, 0);
+    return *this;
+  }
+
+  BigCount & BigCount::shiftRight(int numBits)
+  {
+    if (numBits <= 0)
+      return *this;
+    std::size_t const limbShift = numBits / 32;
+    int const bitShift = numBits % 32;
+    if (limbShift >= m_limbs.size())
+    {
+      setZero();
+      return *this;
+    }
+    m_limbs.erase(m_limbs.begin(), m_limbs.begin() + limbShift);
+    if (bitShift > 0)
+    {
+      for (std::size_t i = 0; i < m_limbs.size(); ++i)
+      {
+        std::uint32_t high = i + 1 < m_limbs.size() ? m_limbs[i + 1] << (32 - bitShift) : 0;
+        m_limbs[i] = (m_limbs[i] >> bitShift) | high;
+      }
+    }
+    trim();
+    return *this;
+  }
+
+  int BigCount::numBits() const
+  {
+    if (isZero())
+      return 0;
+    int bits = 32 * static_cast<int>(m_limbs.size() - 1);
+    for (std::uint32_t top = m_limbs.back(); top > 0; top >>= 1)
+      ++bits;
+    return bits;
+  }
+
+  long double BigCount::toLongDouble() const
+  {
+    // the top three limbs hold more bits than a long double keeps
+    long double result = 0;
+    std::size_t const numTop = std::min<std::size_t>(m_limbs.size(), 3);
+    for (std::size_t i = 0; i < numTop; ++i)
+      result = result * 4294967296.0L + m_limbs[m_limbs.size() - 1 - i];
+    return std::ldexp(result, 32 * static_cast<int>(m_limbs.size() - numTop));
+  }
+
+  std::string BigCount::toString() const
+  {
+    if (isZero())
+      return "0";
+    // peel off nine decimal digits at a time
+    std::vector<std::uint32_t> quotient(m_limbs);
+    std::vector<std::uint32_t> chunks;
+    while (!quotient.empty())
+    {
+      std::uint64_t remainder = 0;
+      for (std::size_t i = quotient.size(); i-- > 0; )
+      {
+        std::uint64_t current = (remainder << 32) | quotient[i];
+        quotient[i] = static_cast<std::uint32_t>(current / 1000000000);
+        remainder = current % 1000000000;
+      }
+      chunks.push_back(static_cast<std::uint32_t>(remainder));
+      while (!quotient.empty() && 0 == quotient.back())
+        quotient.pop_back();
+    }
+    std::string result = std::to_string(chunks.back());
+    for (std::size_t i = chunks.size() - 1; i-- > 0; )
+    {
+      std::string digits = std::to_string(chunks[i]);
+      result.append(9 - digits.size(), '0');
+      result.append(digits);
+    }
+    return result;
+  }
+
+  void BigCount::trim()
+  {
+    while (!m_limbs.empty() && 0 == m_limbs.back())
+      m_limbs.pop_back();
+  }
+
+} // end namespace parakram
@@ -0,0 +1,85 @@
+/*
+
+Copyright 2021 Parakram Majumdar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace parakram {
+
+  // ***** BigCount *****
+  // ******** class ********
+  // An arbitrary-precision unsigned integer,
+  //   for model counts that do not fit in a long double
+  //   (which keeps only 64 significant bits).
+  // Stored as 32-bit limbs, least significant first,
+  //   without leading zero limbs, so zero has no limbs at all.
+  // Only the operations that counting needs are provided:
+  //   addition, multiplication, and shifts by powers of two.
+  class BigCount
+  {
+    public:
+
+      BigCount(): m_limbs() { }
+      explicit BigCount(unsigned long long value);
+
+      // ***** powerOfTwo *****
+      // 2 ^ exponent, for a non-negative exponent
+      static BigCount powerOfTwo(int exponent);
+
+      bool isZero() const { return m_limbs.empty(); }
+      void setZero() { m_limbs.clear(); }
+
+      BigCount & operator += (BigCount const & that);
+      BigCount & operator *= (BigCount const & that);
+      BigCount & shiftLeft(int numBits);
+      BigCount & shiftRight(int numBits);
+
+      bool operator == (BigCount const & that) const { return m_limbs == that.m_limbs; }
+      bool operator != (BigCount const & that) const { return m_limbs != that.m_limbs; }
+
+      // ***** numBits *****
+      // the position of the highest set bit plus one, zero for zero
+      int numBits() const;
+
+      // ***** toLongDouble *****
+      // the nearest long double, or HUGE_VALL if too large
+      long double toLongDouble() const;
+
+      // ***** toString *****
+      // the decimal representation
+      std::string toString() const;
+
+    private:
+
+      void trim();
+
+      std::vector<std::uint32_t> m_limbs;
+  }; // end class BigCount
+
+} // end namespace parakram
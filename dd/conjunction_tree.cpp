@@ -0,0 +1,146 @@
+/*
+
+Copyright 2021 Parakram Majumdar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+
+#include "conjunction_tree.h"
+
+#include <algorithm>
+
+namespace parakram {
+
+  bdd_ptr ConjunctionTree::update(bdd_ptr const * leaves, int size)
+  {
+    refresh(leaves, size);
+    if (NULL == m_nodes[1])
+      m_nodes[1] = bdd_and(m_manager, m_nodes[2], m_nodes[3]);
+    return m_nodes[1];
+  }
+
+
+
+  std::pair<bdd_ptr, bdd_ptr> ConjunctionTree::updateChildren(bdd_ptr const * leaves, int size)
+  {
+    refresh(leaves, size);
+    if (capacity() == 1)
+      return std::make_pair(m_nodes[1], static_cast<bdd_ptr>(NULL));
+    return std::make_pair(m_nodes[2], m_nodes[3]);
+  }
+
+
+
+  void ConjunctionTree::refresh(bdd_ptr const * leaves, int size)
+  {
+    if (size != m_size)
+    {
+      build(leaves, size);
+      return;
+    }
+
+    // replace the leaves that changed, marking their parents
+    int const first = capacity();
+    m_dirty.clear();
+    for (int i = 0; i < size; ++i)
+    {
+      bdd_ptr & leaf = m_nodes[first + i];
+      if (leaf == leaves[i])
+        continue;
+      bdd_free(m_manager, leaf);
+      leaf = bdd_dup(leaves[i]);
+      if (first > 1) // else the leaf is the root
+        markParent(first + i);
+    }
+
+    // conjoin again level by level, going up from a node only if it changed
+    //   (the parents of nodes on one level are all on the level above)
+    std::vector<int> parents;
+    while (!m_dirty.empty())
+    {
+      m_dirty.erase(std::unique(m_dirty.begin(), m_dirty.end()), m_dirty.end());
+      parents.clear();
+      for (int i: m_dirty)
+      {
+        bdd_ptr conjoined = bdd_and(m_manager, m_nodes[2 * i], m_nodes[2 * i + 1]);
+        if (conjoined == m_nodes[i])
+        {
+          bdd_free(m_manager, conjoined);
+          continue;
+        }
+        bdd_free(m_manager, m_nodes[i]);
+        m_nodes[i] = conjoined;
+        parents.push_back(i);
+      }
+      m_dirty.clear();
+      for (int i: parents)
+        markParent(i);
+    }
+  }
+
+
+
+  // the parent of a node that changed is conjoined again,
+  //   except for the root, which is only dropped
+  void ConjunctionTree::markParent(int i)
+  {
+    if (i / 2 > 1)
+      m_dirty.push_back(i / 2);
+    else if (NULL != m_nodes[1])
+    {
+      bdd_free(m_manager, m_nodes[1]);
+      m_nodes[1] = NULL;
+    }
+  }
+
+
+
+  void ConjunctionTree::build(bdd_ptr const * leaves, int size)
+  {
+    clear();
+    int capacity = 1;
+    while (capacity < size)
+      capacity *= 2;
+    m_nodes.resize(2 * capacity);
+    m_nodes[0] = NULL;
+    for (int i = 0; i < capacity; ++i)
+      m_nodes[capacity + i] = i < size ? bdd_dup(leaves[i]) : bdd_one(m_manager);
+    for (int i = capacity - 1; i > 1; --i)
+      m_nodes[i] = bdd_and(m_manager, m_nodes[2 * i], m_nodes[2 * i + 1]);
+    if (capacity > 1)
+      m_nodes[1] = NULL;
+    m_size = size;
+  }
+
+
+
+  void ConjunctionTree::clear()
+  {
+    for (size_t i = 1; i < m_nodes.size(); ++i)
+      if (NULL != m_nodes[i])
+        bdd_free(m_manager, m_nodes[i]);
+    m_nodes.clear();
+    m_size = -1;
+  }
+
+} // end namespace parakram
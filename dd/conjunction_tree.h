@@ -0,0 +1,91 @@
+/*
+
+Copyright 2021 Parakram Majumdar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+
+#pragma once
+
+#include "dd.h"
+
+#include <utility>
+#include <vector>
+
+namespace parakram {
+
+  // ***** ConjunctionTree *****
+  // ******** class ********
+  // A segment tree of partial conjunctions over a list of bdds (the leaves),
+  //   for nodes of a factor graph that conjoin many incoming messages
+  //   each time they fire, when only a few of them changed since.
+  // Each inner node holds the conjunction of its two children,
+  //   so changing k leaves costs O(k log size) conjunctions instead of size,
+  //   and a conjunction that comes out unchanged stops the climb.
+  // The leaves are padded with one up to a power of two.
+  // The root is conjoined only when asked for, so a caller that projects
+  //   the conjunction can fuse the last step with the projection instead.
+  // The tree holds a reference to every bdd it stores.
+  class ConjunctionTree
+  {
+    public:
+
+      explicit ConjunctionTree(DdManager * manager): m_manager(manager), m_size(-1), m_nodes(), m_dirty() { }
+      ConjunctionTree(ConjunctionTree const &) = delete;
+      ConjunctionTree & operator = (ConjunctionTree const &) = delete;
+      ~ConjunctionTree() { clear(); }
+
+      // ***** update *****
+      // makes the leaves equal to the given bdds, which are not consumed,
+      //   redoing the conjunctions above the leaves that changed,
+      //   or all of them if the number of leaves changed
+      // returns the conjunction of all the leaves, owned by the tree,
+      //   and valid until the next update
+      bdd_ptr update(bdd_ptr const * leaves, int size);
+
+      // ***** updateChildren *****
+      // as update, but stops below the root and returns its two children,
+      //   owned by the tree and valid until the next update,
+      //   whose conjunction is that of all the leaves;
+      //   the second is NULL when there is a single leaf
+      std::pair<bdd_ptr, bdd_ptr> updateChildren(bdd_ptr const * leaves, int size);
+
+      int size() const { return m_size < 0 ? 0 : m_size; }
+
+      // drop all the bdds
+      void clear();
+
+    private:
+
+      int capacity() const { return static_cast<int>(m_nodes.size() / 2); }
+      void build(bdd_ptr const * leaves, int size);
+      void refresh(bdd_ptr const * leaves, int size);
+      void markParent(int i);
+
+      DdManager * m_manager;
+      int m_size;
+      std::vector<bdd_ptr> m_nodes; // the root at 1, NULL until asked for; the children of i at 2i and 2i + 1
+      std::vector<int> m_dirty;     // inner nodes to conjoin again, reused between updates
+  }; // end class ConjunctionTree
+
+} // end namespace parakram
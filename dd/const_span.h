@@ -0,0 +1,64 @@
+/*
+
+Copyright 2021 Parakram Majumdar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace parakram {
+
+  // ***** ConstSpan *****
+  // ******** class ********
+  // A read-only view of a contiguous range of elements,
+  //   standing in for std::span, which needs C++20.
+  // The span does not own its elements,
+  //   so they must outlive it.
+  template<typename T>
+  class ConstSpan
+  {
+    public:
+
+      ConstSpan(): m_data(NULL), m_size(0) { }
+      ConstSpan(T const * data, std::size_t size): m_data(data), m_size(size) { }
+      ConstSpan(T const * begin, T const * end): m_data(begin), m_size(end - begin) { }
+      ConstSpan(std::vector<T> const & v): m_data(v.data()), m_size(v.size()) { }
+
+      T const * begin() const { return m_data; }
+      T const * end() const { return m_data + m_size; }
+      T const * cbegin() const { return m_data; }
+      T const * cend() const { return m_data + m_size; }
+      T const & operator [] (std::size_t i) const { return m_data[i]; }
+      std::size_t size() const { return m_size; }
+      bool empty() const { return 0 == m_size; }
+
+    private:
+
+      T const * m_data;
+      std::size_t m_size;
+  }; // end class ConstSpan
+
+} // end namespace parakram
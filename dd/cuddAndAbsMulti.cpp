@@ -26,31 +26,21 @@ SOFTWARE.
 
 #include <stdexcept>
 #include "cuddAndAbsMulti.h"
-#include "lru_cache.h"
+#include "bdd_operand_set.h"
+#include "multi_computed_table.h"
+#include "arena_stack.h"
 #include <util.h>
 #include <cuddInt.h>
 #include <algorithm>
 #include <float.h>
+#include <type_traits>
+#include <vector>
 
-// *********************************************
-// *** std hash definition for unordered_map ***
-// *********************************************
-namespace std {
-  template<> struct hash<std::set<DdNode *> >
-  {
-    typedef set<DdNode *> argument_type;
-    typedef std::size_t result_type;
-    result_type operator()(const argument_type & bddset) const
-    {
-      result_type h = 0;
-      for (const auto bdd: bddset) {
-        result_type bh = (result_type)bdd;
-        h ^= bh + 0x9e3779b9 + (h << 6) + (h >> 2);
-      }
-      return h;
-    }
-  };
-} // end namespace std
+using parakram::BddOperandSet;
+using parakram::MultiComputedTable;
+using parakram::ArenaStack;
+using parakram::BigCount;
+using parakram::ConstSpan;
 
 
 
@@ -66,55 +56,204 @@ namespace std {
 
 
 
-// *** Function *****
-// Recursive and-abstract implementation
-DdNode * cuddBddAndAbstractMultiRecur(
-    DdManager * manager,
-    std::set<DdNode*> const & f,
-    DdNode * cube,
-    parakram::LruCache<std::set<DdNode *>, DdNode*> & cache);
+// ***** MultiBudget *****
+// ******** class ********
+// The limits of a budgeted and-abstract, and its progress.
+// Once either limit is crossed, the budget stays exceeded,
+//   and every sub-problem not yet started is clipped.
+struct MultiBudget
+{
+  unsigned int maxLiveNodes; // zero for no limit
+  unsigned long deadline;    // in util_cpu_time, zero for no limit
+  int clipDepth;
+  int direction;
+  bool exceeded;
+  int numSteps;
+}; // end struct MultiBudget
+
+
+
+// ***** MultiEngine *****
+// ******** class ********
+// The multi-operand kernels:
+//   and, and-abstract, clipping and, clipping and-abstract,
+//   and minterm counting.
+// Each kernel is a state machine over frames on an explicit stack,
+//   in place of a recursion that needs a native stack frame
+//   (with several operand sets) per bdd level.
+// The stack is an arena of frames, one per thread and inline capacity,
+//   that is reused across calls, so a warmed up engine
+//   does not touch the heap for its frames.
+// A call pushes a frame. A return pops it and leaves its value
+//   in m_node (or m_count, or m_exactCount), where the calling frame picks it up
+//   when it resumes. A tail call rewrites the frame in place.
+// The results are identical to those of the recursive formulation.
+// A budgeted and-abstract also returns, in m_mask, the part of the
+//   result that is known to be exact.
+template<int N>
+class MultiEngine
+{
+  public:
 
+    MultiEngine(DdManager * manager, MultiComputedTable & cache);
 
+    DdNode * bddAnd(BddOperandSet<N> const & f);
+    DdNode * bddAndAbstract(BddOperandSet<N> const & f, DdNode * cube);
+    DdNode * budgetedAndAbstract(BddOperandSet<N> const & f, DdNode * cube, MultiBudget & budget, DdNode * & exactPart);
+    DdNode * clippingAnd(BddOperandSet<N> const & f, int distance, int direction);
+    DdNode * clippingAndAbstract(BddOperandSet<N> const & f, DdNode * cube, int distance, int direction);
+    long double countMinterm(BddOperandSet<N> const & f, long double max, int numVars);
+    BigCount const & countMintermExact(BddOperandSet<N> const & f, int numVars);
 
-// ***** Function *****
-// Recursive "and" implementation
-DdNode * cuddBddAndMultiRecur(
-    DdManager * manager,
-    std::set<DdNode *> const & f,
-    parakram::LruCache<std::set<DdNode *>, DdNode *> & cache);
+    // ***** profiling *****
+    // figures of the stack of the calling thread
+    static int peakDepth() { return threadStack().peakSize(); }
+    static int numFrames() { return threadStack().numFrames(); }
+    static void resetPeakDepth() { threadStack().resetPeak(); }
+
+    // ***** numClipped *****
+    // the number of sub-problems approximated so far,
+    //   zero if every result returned is exact
+    int numClipped() const { return m_numClipped; }
+
+  private:
+
+    enum State { Start, AfterThen, AfterElse, AfterOr, AfterClip };
+
+    struct Frame
+    {
+      int op; // a MultiComputedTable::Operation
+      State state;
+      BddOperandSet<N> const * f;
+      BddOperandSet<N> tv;
+      BddOperandSet<N> ev;
+      DdNode * cube;
+      DdNode * nextCube;
+      int distance;
+      int direction;
+      int cacheParam;
+      int index;
+      bool quantify;
+      DdNode * t;
+      DdNode * e;
+      DdNode * tMask;
+      int clippedBefore;
+      long double tCount;
+      BigCount tExactCount;
+    };
+
+    static ArenaStack<Frame> & threadStack();
+
+    void run(int op, BddOperandSet<N> const & f, DdNode * cube, int distance, int direction);
+    void call(int op, BddOperandSet<N> const * f, DdNode * cube, int distance, int direction);
+    void ret(DdNode * r) { m_stack.pop(); m_node = r; m_mask = DD_ONE(m_manager); }
+    void retMasked(DdNode * r, DdNode * mask) { m_stack.pop(); m_node = r; m_mask = mask; }
+    void retCount(long double count) { m_stack.pop(); m_count = count; }
+    void retExactCount() { m_stack.pop(); }
+
+    void stepAnd(Frame & fr);
+    void stepAndAbstract(Frame & fr);
+    void stepClippingAnd(Frame & fr);
+    void stepClippingAndAbstract(Frame & fr);
+    void stepCountMinterm(Frame & fr);
+    void stepExactCountMinterm(Frame & fr);
+
+    // ***** makeNode *****
+    // the node (index, t, e), where t is referenced and e is not
+    // releases t and e if it fails
+    DdNode * makeNode(int index, DdNode * t, DdNode * e);
+
+    // ***** budget *****
+    // the and / and-abstract frames of a budgeted run
+    bool overBudget();
+    void clip(Frame & fr);
+    bool isExact(Frame const & fr) const { return m_numClipped == fr.clippedBefore; }
+    void holdThen(Frame & fr, DdNode * t);
+    void dropThen(Frame & fr);
+    void finishSplit(Frame & fr, DdNode * r, MultiComputedTable::Operation cacheOp, DdNode * cacheCube);
+    template<typename Recur>
+    void delegate(Frame & fr, Recur recur);
+
+    // ***** clipping cache *****
+    // the clipping frames: a result computed without clipping is exact
+    //   at any distance, and is cached as the result of the exact kernel,
+    //   while a clipped one is keyed on the remaining distance and the direction
+    bool lookupClipping(Frame & fr, MultiComputedTable::Operation exactOp, DdNode * & result);
+    void insertClipping(Frame const & fr, MultiComputedTable::Operation exactOp, DdNode * result);
+
+    DdManager * m_manager;
+    MultiComputedTable & m_cache;
+    ArenaStack<Frame> & m_stack;
+    MultiBudget * m_budget;
+    int m_numClipped;
+    DdNode * m_node;
+    DdNode * m_mask;
+    long double m_count;
+    BigCount m_exactCount;
+    BigCount m_fullCount;
+    long double m_max;
+    int m_numVars;
+}; // end class MultiEngine
 
 
 
 // ***** Function *****
-// Recursive "clipping and" implementation
-// for more than two input bdds
-DdNode * cuddBddClippingAndMultiRecur(
-    DdManager * manager,
-    std::set<DdNode *> const & f,
-    int distance,
-    int direction);
+// NULL if the manager must give up (time out or terminate),
+// since checkWhetherToGiveUp returns NULL from its enclosing function
+DdNode * checkGiveUp(DdManager * manager);
 
 
 
 // ***** Function *****
-// Recursive clipping and-abstract implementation
-// for more than two input bdds
-DdNode * cuddBddClippingAndAbstractMultiRecur(
+// Runs the clipping and-abstract recursion to completion,
+// restarting it whenever a reordering interrupts it.
+// Unlike Cudd_bddClippingAndAbstractMulti,
+// does not invoke the timeout handler.
+// If clipped is not NULL, it is set to whether any sub-problem
+// was approximated, that is whether the result may not be exact.
+DdNode * clippingAndAbstractMulti(
     DdManager * manager,
-    std::set<DdNode *> const & f,
+    ConstSpan<DdNode *> f,
     DdNode * cube,
-    int distance,
-    int direction);
+    int maxDepth,
+    int direction,
+    MultiComputedTable & cache,
+    bool * clipped);
 
 
 
 // ***** Function *****
-// Recursive model counting for more than two bdds
-long double cuddBddCountMintermMultiAux(
+// Computes the conjunction (if isConjunction)
+// or the disjunction of two bdds,
+// without invoking the timeout handler.
+DdNode * combineApproximations(
     DdManager * manager,
-    const std::set<DdNode *> & f,
-    long double max,
-    parakram::LruCache<std::set<DdNode *>, long double> & cache);
+    DdNode * f,
+    DdNode * g,
+    bool isConjunction);
+
+
+
+// ***** Function *****
+// Calls func with the template argument N
+// chosen to be the smallest supported inline capacity
+// that can hold numOperands operands.
+// Sets with more than 8 operands use an inline capacity of 8,
+// and spill to the heap.
+template<typename TFunc>
+auto dispatchOnArity(size_t numOperands, TFunc && func)
+  -> decltype(func(std::integral_constant<int, 8>()));
+
+
+
+// ***** Function *****
+// The normalized operand set of a range of bdds,
+// built in a set owned by the calling thread,
+// whose buffer is reused from one call to the next,
+// so that long operand lists are not reallocated on every call.
+// The set is overwritten by the next call on the same thread.
+template<int N>
+BddOperandSet<N> const & scratchOperands(DdManager * manager, ConstSpan<DdNode *> f);
 
 
 
@@ -147,16 +286,24 @@ long double cuddBddCountMintermMultiAux(
 */
 DdNode * Cudd_bddAndAbstractMulti(
     DdManager *manager, 
-    std::set<DdNode*> const & f, 
+    ConstSpan<DdNode *> f, 
     DdNode *cube,
     int cacheSize)
 {
-  DdNode * res;
-  parakram::LruCache<std::set<DdNode *>, DdNode *> cache(cacheSize);
-  do {
-    manager->reordered = 0;
-    res = cuddBddAndAbstractMultiRecur(manager, f, cube, cache);
-  } while(manager->reordered == 1);
+  DdNode * res = dispatchOnArity(f.size(), [&](auto arity) {
+      constexpr int N = decltype(arity)::value;
+      DdNode * r;
+      auto & cache = MultiComputedTable::forManager(manager, cacheSize);
+      do {
+        manager->reordered = 0;
+        // the operand order depends on the variable order,
+        // so the set is rebuilt after a reordering
+        // (the table re-sorts its own keys from a reordering hook)
+        auto const & fSet = scratchOperands<N>(manager, f);
+        r = MultiEngine<N>(manager, cache).bddAndAbstract(fSet, cube);
+      } while(manager->reordered == 1);
+      return r;
+  });
   if (manager->errorCode == CUDD_TIMEOUT_EXPIRED && manager->timeoutHandler) {
     manager->timeoutHandler(manager, manager->tohArg);
   }
@@ -167,6 +314,75 @@ DdNode * Cudd_bddAndAbstractMulti(
 
 
 
+/**
+  @brief Takes the AND of a set of BDDs and simultaneously abstracts
+  the variables in cube, within a budget of live nodes and time.
+
+  @details Computes the exact result as long as the manager holds at
+  most maxLiveNodes live nodes and timeLimit milliseconds have not
+  elapsed. Once either limit is crossed, every sub-problem that has
+  not been started yet is approximated with the clipping and-abstract
+  at depth clipDepth, in the given direction (1 to over-approximate,
+  0 to under-approximate). A non-positive maxLiveNodes or timeLimit
+  means no such limit. Only exact sub-results enter the computed
+  table.
+
+  @return a pointer to the result is successful; NULL otherwise. If
+  exactPart is not NULL, a referenced %BDD is stored in it, over the
+  variables not in cube, that holds where the result is known to be
+  exact: the constant one if no sub-problem had to be approximated.
+
+  @sideeffect None
+
+  @see Cudd_bddAndAbstractMulti Cudd_bddClippingAndAbstractMulti
+
+*/
+DdNode * Cudd_bddAndAbstractMultiBudgeted(
+    DdManager * manager,
+    ConstSpan<DdNode *> f,
+    DdNode * cube,
+    int direction,
+    int maxLiveNodes,
+    long timeLimit,
+    int clipDepth,
+    int cacheSize,
+    DdNode ** exactPart)
+{
+  MultiBudget budget;
+  budget.maxLiveNodes = maxLiveNodes > 0 ? maxLiveNodes : 0;
+  budget.deadline = timeLimit > 0 ? util_cpu_time() + timeLimit : 0;
+  budget.clipDepth = clipDepth;
+  budget.direction = direction;
+  budget.exceeded = false;
+  budget.numSteps = 0;
+
+  DdNode * mask = NULL;
+  DdNode * res = dispatchOnArity(f.size(), [&](auto arity) {
+      constexpr int N = decltype(arity)::value;
+      DdNode * r;
+      auto & cache = MultiComputedTable::forManager(manager, cacheSize);
+      do {
+        manager->reordered = 0;
+        auto const & fSet = scratchOperands<N>(manager, f);
+        r = MultiEngine<N>(manager, cache).budgetedAndAbstract(fSet, cube, budget, mask);
+      } while(manager->reordered == 1);
+      return r;
+  });
+  if (manager->errorCode == CUDD_TIMEOUT_EXPIRED && manager->timeoutHandler) {
+    manager->timeoutHandler(manager, manager->tohArg);
+  }
+  if (NULL != res && NULL != exactPart)
+  {
+    cuddRef(mask);
+    *exactPart = mask;
+  }
+  return (res);
+} // end of Cudd_bddAndAbstractMultiBudgeted
+
+
+
+
+
 /**
   @brief Computes the conjunction of a set f of BDDs.
 
@@ -181,15 +397,20 @@ DdNode * Cudd_bddAndAbstractMulti(
 */
 DdNode * Cudd_bddAndMulti(
     DdManager * dd,
-    std::set<DdNode*> const & f,
+    ConstSpan<DdNode *> f,
     int cacheSize)
 {
-  parakram::LruCache<std::set<DdNode *>, DdNode*> cache(cacheSize);
-  DdNode * res;
-  do {
-    dd->reordered = 0;
-    res = cuddBddAndMultiRecur(dd, f, cache);
-  } while (dd->reordered == 1);
+  DdNode * res = dispatchOnArity(f.size(), [&](auto arity) {
+      constexpr int N = decltype(arity)::value;
+      DdNode * r;
+      auto & cache = MultiComputedTable::forManager(dd, cacheSize);
+      do {
+        dd->reordered = 0;
+        auto const & fSet = scratchOperands<N>(dd, f);
+        r = MultiEngine<N>(dd, cache).bddAnd(fSet);
+      } while (dd->reordered == 1);
+      return r;
+  });
   if (dd->errorCode == CUDD_TIMEOUT_EXPIRED && dd->timeoutHandler)
   {
     dd->timeoutHandler(dd, dd->tohArg);
@@ -215,15 +436,22 @@ DdNode * Cudd_bddAndMulti(
 DdNode *
 Cudd_bddClippingAndMulti(
     DdManager * dd,
-    std::set<DdNode *> const & f,
+    ConstSpan<DdNode *> f,
     int maxDepth,
-    int direction)
+    int direction,
+    int cacheSize)
 {
-  DdNode * res;
-  do {
-    dd->reordered = 0;
-    res = cuddBddClippingAndMultiRecur(dd, f, maxDepth, direction);
-  } while(1 == dd->reordered);
+  DdNode * res = dispatchOnArity(f.size(), [&](auto arity) {
+      constexpr int N = decltype(arity)::value;
+      DdNode * r;
+      auto & cache = MultiComputedTable::forManager(dd, cacheSize);
+      do {
+        dd->reordered = 0;
+        auto const & fSet = scratchOperands<N>(dd, f);
+        r = MultiEngine<N>(dd, cache).clippingAnd(fSet, maxDepth, direction);
+      } while(1 == dd->reordered);
+      return r;
+  });
   if (CUDD_TIMEOUT_EXPIRED == dd->errorCode && dd->timeoutHandler) {
     dd->timeoutHandler(dd, dd->tohArg);
   }
@@ -251,18 +479,14 @@ Cudd_bddClippingAndMulti(
 DdNode *
 Cudd_bddClippingAndAbstractMulti(
     DdManager * dd,
-    std::set<DdNode *> const & f,
+    ConstSpan<DdNode *> f,
     DdNode * cube,
     int maxDepth,
-    int direction)
+    int direction,
+    int cacheSize)
 {
-  DdNode * res;
-
-  do 
-  {
-    dd->reordered = 0;
-    res = cuddBddClippingAndAbstractMultiRecur(dd, f, cube, maxDepth, direction);
-  } while (1 == dd->reordered);
+  auto & cache = MultiComputedTable::forManager(dd, cacheSize);
+  DdNode * res = clippingAndAbstractMulti(dd, f, cube, maxDepth, direction, cache, NULL);
 
 
   if (CUDD_TIMEOUT_EXPIRED == dd->errorCode && dd->timeoutHandler)
@@ -273,6 +497,125 @@ Cudd_bddClippingAndAbstractMulti(
 
 
 
+
+
+/**
+  @brief Approximates the conjunction of a set f of BDDs and
+  simultaneously abstracts the variables in cube, raising the clipping
+  depth until a budget is exhausted.
+
+  @details Runs the clipping and-abstract with depths depthStep,
+  2 * depthStep, 3 * depthStep, ... and returns the tightest
+  approximation reached: the conjunction of the over-approximations
+  (direction 1) or the disjunction of the under-approximations
+  (direction 0) of all the completed rounds. The deepening stops after
+  the first round that did not clip anything, whose result is exact,
+  when the result exceeds maxNodes nodes, or when timeLimit
+  milliseconds have elapsed. A round interrupted by the time limit is
+  discarded. A non-positive maxNodes or timeLimit means no such limit.
+  Sub-results that were not clipped are cached as exact, at any depth,
+  so later rounds only redo the parts that earlier rounds clipped.
+
+  @return a pointer to the resulting %BDD if successful; NULL if not
+  even the first round completed. If reachedDepth is not NULL, the
+  depth of the last completed round is stored in it.
+
+  @sideeffect None
+
+  @see Cudd_bddClippingAndAbstractMulti
+
+*/
+DdNode *
+Cudd_bddClippingAndAbstractMultiDeepening(
+    DdManager * dd,
+    ConstSpan<DdNode *> f,
+    DdNode * cube,
+    int direction,
+    int depthStep,
+    int maxNodes,
+    long timeLimit,
+    int cacheSize,
+    int * reachedDepth)
+{
+  auto & cache = MultiComputedTable::forManager(dd, cacheSize);
+  depthStep = std::max(depthStep, 1);
+  bool const isOverApprox = (0 != direction);
+
+  // the time limit is imposed through cudd's own,
+  // so that a round that runs out of time gives up midway
+  // (an existing time limit of the manager is honoured)
+  unsigned long const oldStartTime = Cudd_ReadStartTime(dd);
+  unsigned long const oldTimeLimit = Cudd_ReadTimeLimit(dd);
+  if (timeLimit > 0)
+  {
+    unsigned long const now = util_cpu_time();
+    unsigned long limit = timeLimit;
+    if (Cudd_TimeLimited(dd))
+    {
+      unsigned long const elapsed = now - oldStartTime;
+      limit = elapsed >= oldTimeLimit ? 0 : std::min(limit, oldTimeLimit - elapsed);
+    }
+    Cudd_SetStartTime(dd, now);
+    Cudd_SetTimeLimit(dd, limit);
+  }
+
+  DdNode * best = NULL;
+  for (int depth = depthStep; ; depth += depthStep)
+  {
+    bool clipped = true;
+    DdNode * r = clippingAndAbstractMulti(dd, f, cube, depth, direction, cache, &clipped);
+    if (NULL == r)
+      break;
+    cuddRef(r);
+    if (NULL != best)
+    {
+      if (maxNodes > 0 && Cudd_DagSize(r) > maxNodes)
+      {
+        Cudd_IterDerefBdd(dd, r);
+        break;
+      }
+      DdNode * combined = combineApproximations(dd, best, r, isOverApprox);
+      if (NULL == combined)
+      {
+        Cudd_IterDerefBdd(dd, r);
+        break;
+      }
+      cuddRef(combined);
+      Cudd_IterDerefBdd(dd, r);
+      Cudd_IterDerefBdd(dd, best);
+      best = combined;
+    }
+    else
+      best = r;
+
+    if (NULL != reachedDepth)
+      *reachedDepth = depth;
+    if (!clipped || (maxNodes > 0 && Cudd_DagSize(best) > maxNodes))
+      break;
+  }
+
+  if (timeLimit > 0)
+  {
+    Cudd_SetStartTime(dd, oldStartTime);
+    Cudd_SetTimeLimit(dd, oldTimeLimit);
+  }
+
+  if (NULL == best)
+  {
+    if (CUDD_TIMEOUT_EXPIRED == dd->errorCode && dd->timeoutHandler)
+      dd->timeoutHandler(dd, dd->tohArg);
+    return NULL;
+  }
+
+  // running out of budget in a later round is not an error
+  if (CUDD_TIMEOUT_EXPIRED == dd->errorCode)
+    Cudd_ClearErrorCode(dd);
+  cuddDeref(best);
+  return best;
+} // end of Cudd_bddClippingAndAbstractMultiDeepening
+
+
+
 /**
   @brief Returns the number of minterms of a set of %ADD or %BDD as a long double.
 
@@ -291,7 +634,7 @@ Cudd_bddClippingAndAbstractMulti(
 long double 
 Cudd_LdblCountMintermMulti(
     DdManager * manager,
-    const std::set<DdNode *> & funcs,
+    ConstSpan<DdNode *> funcs,
     int numVars,
     int multiCacheCapacity)
 {
@@ -299,9 +642,12 @@ Cudd_LdblCountMintermMulti(
   if (HUGE_VALL == max)
     throw new std::runtime_error("OOM while counting minterms");
 
-  parakram::LruCache<std::set<DdNode *>, long double> cache(multiCacheCapacity);
-
-  long double count = cuddBddCountMintermMultiAux(manager, funcs, max, cache);
+  long double count = dispatchOnArity(funcs.size(), [&](auto arity) {
+      constexpr int N = decltype(arity)::value;
+      auto const & fSet = scratchOperands<N>(manager, funcs);
+      auto & cache = MultiComputedTable::forManager(manager, multiCacheCapacity);
+      return MultiEngine<N>(manager, cache).countMinterm(fSet, max, numVars);
+  });
 
   if (count >= powl(2.0L, (long double)(LDBL_MAX_EXP + LDBL_MIN_EXP)))
     throw std::runtime_error("min term count is too large to be scaled back");
@@ -314,455 +660,953 @@ Cudd_LdblCountMintermMulti(
 
 
 
+/**
+  @brief Returns the exact number of minterms of the conjunction of a
+  set of BDDs over numVars variables.
 
+  @details Unlike Cudd_LdblCountMintermMulti, does not lose precision
+  however many variables there are. The counts of the sub-problems are
+  kept in the multi-operand computed table, so repeated counts over
+  overlapping sets of operands share their work.
 
-// *****************************************
-// *** Internal api function definitions ***
-// *****************************************
+  @return the minterm count.
 
+  @sideeffect None
 
+  @see Cudd_LdblCountMintermMulti Cudd_ApaCountMinterm
 
-// *** Function *****
-// Recursive and-abstract implementation
-DdNode * cuddBddAndAbstractMultiRecur(
+*/
+BigCount
+Cudd_BigCountMintermMulti(
     DdManager * manager,
-    std::set<DdNode*> const & fSet2,
-    DdNode * cube,
-    parakram::LruCache<std::set<DdNode *>, DdNode *> & cache)
+    ConstSpan<DdNode *> funcs,
+    int numVars,
+    int multiCacheCapacity)
 {
+  return dispatchOnArity(funcs.size(), [&](auto arity) {
+      constexpr int N = decltype(arity)::value;
+      auto const & fSet = scratchOperands<N>(manager, funcs);
+      auto & cache = MultiComputedTable::forManager(manager, multiCacheCapacity);
+      return MultiEngine<N>(manager, cache).countMintermExact(fSet, numVars);
+  });
+}
 
-  statLine(manager);
-  auto one = DD_ONE(manager);
-  auto zero = Cudd_Not(one);
-  DdNode * r = NULL;
 
-  auto fSet = fSet2;
-  fSet.erase(one);
 
-  // Terminal cases.
-  // if any of the funcs is zero, return zero
-  if (fSet.count(zero) == 1) return zero;
+/**
+  @brief The overloads of the multi-operand functions on sets of BDDs.
 
-  // if any of the funcs is the not of any other func, return zero
-  for (auto f: fSet)
-    if (fSet.count(Cudd_Not(f)) > 0)
-      return zero;
+  @details Forward the operands as a span. Callers that hold their
+  operands in a vector should pass it directly, which saves building
+  the set.
 
-  // if all of the funcs are one, return one
-  if (fSet.empty()) return one;
+  @sideeffect None
 
-  // check cache
-  auto cachedResult = cache.tryGet(fSet);
-  if (cachedResult.isPresent())
-    return cachedResult.get();
+*/
+DdNode * Cudd_bddAndAbstractMulti(
+    DdManager * manager,
+    std::set<DdNode *> const & f,
+    DdNode * cube,
+    int cacheSize)
+{
+  std::vector<DdNode *> operands(f.cbegin(), f.cend());
+  return Cudd_bddAndAbstractMulti(manager, ConstSpan<DdNode *>(operands), cube, cacheSize);
+}
 
-  // if there is only one element, no more need for conjunction
-  if (fSet.size() == 1)
-  {
-    r = cuddBddExistAbstractRecur(manager, *fSet.cbegin(), cube);
-    cache.insert(fSet, r);
-    return r;
-  }
+DdNode * Cudd_bddAndAbstractMultiBudgeted(
+    DdManager * manager,
+    std::set<DdNode *> const & f,
+    DdNode * cube,
+    int direction,
+    int maxLiveNodes,
+    long timeLimit,
+    int clipDepth,
+    int cacheSize,
+    DdNode ** exactPart)
+{
+  std::vector<DdNode *> operands(f.cbegin(), f.cend());
+  return Cudd_bddAndAbstractMultiBudgeted(manager, ConstSpan<DdNode *>(operands), cube, direction,
+                                          maxLiveNodes, timeLimit, clipDepth, cacheSize, exactPart);
+}
 
-  // if cube is empty, return the conjunction
-  if (cube == one)
-  {
-    r = cuddBddAndMultiRecur(manager, fSet, cache);
-    // cache.insert(fSet, r); // should already be in the cache
-    return r;
-  }
+DdNode * Cudd_bddAndMulti(
+    DdManager * dd,
+    std::set<DdNode *> const & f,
+    int cacheSize)
+{
+  std::vector<DdNode *> operands(f.cbegin(), f.cend());
+  return Cudd_bddAndMulti(dd, ConstSpan<DdNode *>(operands), cacheSize);
+}
 
-  // find the top variable of the set of functions
-  int top = manager->perm[Cudd_Regular(*fSet.cbegin())->index];
-  for (auto f: fSet)
-    top = ddMin(top, manager->perm[Cudd_Regular(f)->index]);
+DdNode * Cudd_bddClippingAndMulti(
+    DdManager * dd,
+    std::set<DdNode *> const & f,
+    int maxDepth,
+    int direction,
+    int cacheSize)
+{
+  std::vector<DdNode *> operands(f.cbegin(), f.cend());
+  return Cudd_bddClippingAndMulti(dd, ConstSpan<DdNode *>(operands), maxDepth, direction, cacheSize);
+}
 
-  // find the top variables of the quantified variables
-  int topcube = manager->perm[cube->index];
+DdNode * Cudd_bddClippingAndAbstractMulti(
+    DdManager * dd,
+    std::set<DdNode *> const & f,
+    DdNode * cube,
+    int maxDepth,
+    int direction,
+    int cacheSize)
+{
+  std::vector<DdNode *> operands(f.cbegin(), f.cend());
+  return Cudd_bddClippingAndAbstractMulti(dd, ConstSpan<DdNode *>(operands), cube, maxDepth, direction, cacheSize);
+}
 
-  // skip the quantified variables until there is something to quantify
-  while (topcube < top) {
-    cube = cuddT(cube);
-    if (cube == one) { // if there is nothing to quantify, return the conjunction
-      r = (cuddBddAndMultiRecur(manager, fSet, cache));
-      // cache.insert(fSet, r); // should already be in the cache
-      return r;
-    }
-    topcube = manager->perm[cube->index];
-  }
+DdNode * Cudd_bddClippingAndAbstractMultiDeepening(
+    DdManager * dd,
+    std::set<DdNode *> const & f,
+    DdNode * cube,
+    int direction,
+    int depthStep,
+    int maxNodes,
+    long timeLimit,
+    int cacheSize,
+    int * reachedDepth)
+{
+  std::vector<DdNode *> operands(f.cbegin(), f.cend());
+  return Cudd_bddClippingAndAbstractMultiDeepening(dd, ConstSpan<DdNode *>(operands), cube, direction,
+                                                   depthStep, maxNodes, timeLimit, cacheSize, reachedDepth);
+}
 
-  // collect the 'then's and 'else's
-  std::set<DdNode *> tv, ev;
-  int index = 0;
-  for (auto f: fSet)
-  {
-    auto F = Cudd_Regular(f);
-    auto topf = manager->perm[F->index];
-    if (topf == top) {
-      index = F->index;
-      auto t = cuddT(F);
-      auto e = cuddE(F);
-      if (Cudd_IsComplement(f)) {
-        t = Cudd_Not(t);
-        e = Cudd_Not(e);
-      }
-      tv.insert(t);
-      ev.insert(e);
-    } else {
-      tv.insert(f);
-      ev.insert(f);
-    }
-  }
+long double Cudd_LdblCountMintermMulti(
+    DdManager * manager,
+    std::set<DdNode *> const & funcs,
+    int numVars,
+    int multiCacheCapacity)
+{
+  std::vector<DdNode *> operands(funcs.cbegin(), funcs.cend());
+  return Cudd_LdblCountMintermMulti(manager, ConstSpan<DdNode *>(operands), numVars, multiCacheCapacity);
+}
 
-  // need to quantify the topmost variable
-  if (topcube == top) {
-    auto remainingCube = cuddT(cube);
-    auto t = cuddBddAndAbstractMultiRecur(manager, tv, remainingCube, cache);
-    if (t == NULL) return NULL;
-    // Special case: 1 or anything = 1. Hence, no need to compute
-    // the else branch if t is 1. Likewise t + t * anything = t.
-    // Notice that t == fe implies that fe does not depend on the
-    // variables in the Cube.
-    if (t == one || std::find(ev.cbegin(), ev.cend(), t) != ev.cend()) {
-      cache.insert(fSet, r);
-      return t;
-    }
+BigCount Cudd_BigCountMintermMulti(
+    DdManager * manager,
+    std::set<DdNode *> const & funcs,
+    int numVars,
+    int multiCacheCapacity)
+{
+  std::vector<DdNode *> operands(funcs.cbegin(), funcs.cend());
+  return Cudd_BigCountMintermMulti(manager, ConstSpan<DdNode *>(operands), numVars, multiCacheCapacity);
+}
 
-    cuddRef(t);
-    // Special case: t + !t * anything == t + anything
-    ev.erase(Cudd_Not(t));
-    auto e = cuddBddAndAbstractMultiRecur(manager, ev, remainingCube, cache);
-    if (NULL == e)
-    {
-      Cudd_IterDerefBdd(manager, t);
-      return NULL;
-    }
-    if (t == e)
-    {
-      r = t;
-      cuddDeref(t);
-    } else {
-      cuddRef(e);
-      r = cuddBddAndRecur(manager, Cudd_Not(t), Cudd_Not(e));
-      if (NULL == r) {
-        Cudd_IterDerefBdd(manager, t);
-        Cudd_IterDerefBdd(manager, e);
-        return NULL;
-      }
-      r = Cudd_Not(r);
-      cuddRef(r);
-      Cudd_DelayedDerefBdd(manager, t);
-      Cudd_DelayedDerefBdd(manager, e);
-      cuddDeref(r);
-    }
-  } // end of case where you need to quantify
-  else
-  { // no need to quantify
-    auto t = cuddBddAndAbstractMultiRecur(manager, tv, cube, cache);
-    if (NULL == t) return NULL;
-    cuddRef(t);
-    auto e = cuddBddAndAbstractMultiRecur(manager, ev, cube, cache);
-    if (NULL == e)
-    {
-      Cudd_IterDerefBdd(manager, t);
-      return NULL;
-    }
 
-    if (t == e)
-    {
-      r = t;
-      cuddDeref(t);
-    } else {
-      cuddRef(e);
-      if (Cudd_IsComplement(t)) {
-        r = cuddUniqueInter(manager,
-                            (int) index,
-                            Cudd_Not(t), 
-                            Cudd_Not(e));
-        if (NULL == r) {
-          Cudd_IterDerefBdd(manager, t);
-          Cudd_IterDerefBdd(manager, e);
-          return NULL;
-        }
-        r = Cudd_Not(r);
-      } else {
-        r = cuddUniqueInter(manager, (int)index, t, e);
-        if (r == NULL) {
-          Cudd_IterDerefBdd(manager, t);
-          Cudd_IterDerefBdd(manager, e);
-          return NULL;
-        }
-      }
-      cuddDeref(e);
-      cuddDeref(t);
-    }
-  }
 
-  cache.insert(fSet, r);
-  return r;
-} // end of cuddBddAndAbstractMultiRecur
+/**
+  @brief Reads the profiling figures of the explicit stacks
+  of the multi-operand kernels on the calling thread.
+
+  @details peakDepth is the deepest stack reached since the last
+  call to Cudd_ResetMultiStackPeak, and numFrames the number of
+  frames allocated so far.
 
+  @sideeffect None
 
+*/
+void Cudd_ReadMultiStackStats(int * peakDepth, int * numFrames)
+{
+  *peakDepth = std::max(MultiEngine<2>::peakDepth(),
+                        std::max(MultiEngine<4>::peakDepth(), MultiEngine<8>::peakDepth()));
+  *numFrames = MultiEngine<2>::numFrames() + MultiEngine<4>::numFrames() + MultiEngine<8>::numFrames();
+}
 
 
 
+/**
+  @brief Resets the peak depth reported by Cudd_ReadMultiStackStats.
 
-// ***** Function *****
-// Recursive "and" implementation
-DdNode * cuddBddAndMultiRecur(
-    DdManager * manager,
-    std::set<DdNode *> const & fset,
-    parakram::LruCache<std::set<DdNode *>, DdNode *> & cache)
+  @sideeffect None
+
+*/
+void Cudd_ResetMultiStackPeak()
 {
-  statLine(manager);
-  auto one = DD_ONE(manager);
-  auto zero = Cudd_Not(one);
+  MultiEngine<2>::resetPeakDepth();
+  MultiEngine<4>::resetPeakDepth();
+  MultiEngine<8>::resetPeakDepth();
+}
 
-  // Terminal cases
-  std::set<DdNode *> fSet = fset;
-  fSet.erase(one);
-  if (fSet.empty())
-    return one;
-  if (fSet.size() == 1)
-    return *fSet.cbegin();
-  if (fSet.size() == 2)
-  {
-    auto first = fSet.cbegin();
-    auto second = fSet.cbegin();
-    ++second;
-    if (*first == Cudd_Not(*second))
-      return zero;
-  } 
-  if (fSet.count(zero) > 0)
-    return zero;
-
-  auto optResult = cache.tryGet(fSet);
-  if (optResult.isPresent())
-    return optResult.get();
-
-  auto index = Cudd_Regular(*fSet.cbegin())->index;
-  auto top = manager->perm[index];
-  for (auto f: fSet)
-  {
-    auto F = Cudd_Regular(f);
-    auto ftop = manager->perm[F->index];
-    if (ftop < top)
-    {
-      top = ftop;
-      index = F->index;
-    }
-  }
 
-  std::set<DdNode *> tv, ev;
-  for (auto f: fSet)
-  {
-    auto F = Cudd_Regular(f);
-    if (index == F->index)
-    {
-      tv.insert(Cudd_IsComplement(f) ? Cudd_Not(cuddT(F)) : cuddT(F));
-      ev.insert(Cudd_IsComplement(f) ? Cudd_Not(cuddE(F)) : cuddE(F));
-    } else {
-      tv.insert(f);
-      ev.insert(f);
-    }
-  }
 
-  auto t = cuddBddAndMultiRecur(manager, tv, cache);
-  if (NULL == t) return NULL;
-  cuddRef(t);
 
-  auto e = cuddBddAndMultiRecur(manager, ev, cache);
-  if (NULL == e)
-  {
-    Cudd_IterDerefBdd(manager, t);
-    return NULL;
-  }
-  cuddRef(e);
 
+// *****************************************
+// *** Internal api function definitions ***
+// *****************************************
 
-  DdNode * r;
 
-  if (t == e)
-  {
-    r = t;
-  } else
-  {
-    if (Cudd_IsComplement(t))
-    {
-      r = cuddUniqueInter(manager, (int) index, Cudd_Not(t), Cudd_Not(e));
-      if (NULL == r)
-      {
-        Cudd_IterDerefBdd(manager, t);
-        Cudd_IterDerefBdd(manager, e);
-        return NULL;
-      }
-      r = Cudd_Not(r);
-    } else
-    {
-      r = cuddUniqueInter(manager, (int) index, t, e);
-      if (NULL == r)
-      {
-        Cudd_IterDerefBdd(manager, t);
-        Cudd_IterDerefBdd(manager, e);
-        return NULL;
-      }
-    }
-  }
-  cuddDeref(e);
-  cuddDeref(t);
-  cache.insert(fSet, r);
-  return r;
-} // end cuddBddAndMultiRecur
 
+// ***** Function *****
+// dispatch to the fast paths for small arities
+template<typename TFunc>
+auto dispatchOnArity(size_t numOperands, TFunc && func)
+  -> decltype(func(std::integral_constant<int, 8>()))
+{
+  if (numOperands <= 2)
+    return func(std::integral_constant<int, 2>());
+  else if (numOperands <= 4)
+    return func(std::integral_constant<int, 4>());
+  else
+    return func(std::integral_constant<int, 8>());
+}
 
 
 
-/**
-  @brief Implements the recursive step of Cudd_bddClippingAndMulti
+// ***** Function *****
+// refill the thread's set, keeping its buffer
+template<int N>
+BddOperandSet<N> const & scratchOperands(DdManager * manager, ConstSpan<DdNode *> f)
+{
+  thread_local BddOperandSet<N> scratch;
+  scratch.clear();
+  for (auto g: f)
+    scratch.push(g);
+  scratch.normalize(manager);
+  return scratch;
+}
 
-  @details Takes the conjunction of a set of BDDs.
 
-  @return a pointer to the result is successful; NULL otherwise.
 
-  @sideeffect None
+// ***** Function *****
+// clipping and-abstract, restarted on reordering
+DdNode * clippingAndAbstractMulti(
+    DdManager * manager,
+    ConstSpan<DdNode *> f,
+    DdNode * cube,
+    int maxDepth,
+    int direction,
+    MultiComputedTable & cache,
+    bool * clipped)
+{
+  return dispatchOnArity(f.size(), [&](auto arity) {
+      constexpr int N = decltype(arity)::value;
+      DdNode * r;
+      do 
+      {
+        manager->reordered = 0;
+        auto const & fSet = scratchOperands<N>(manager, f);
+        MultiEngine<N> engine(manager, cache);
+        r = engine.clippingAndAbstract(fSet, cube, maxDepth, direction);
+        if (NULL != clipped)
+          *clipped = engine.numClipped() > 0;
+      } while (1 == manager->reordered);
+      return r;
+  });
+}
 
-  @see cuddBddClippingAnd
 
-*/
-DdNode *
-cuddBddClippingAndMultiRecur(
+
+// ***** Function *****
+// conjunction or disjunction, restarted on reordering
+DdNode * combineApproximations(
     DdManager * manager,
-    std::set<DdNode *> const & f,
-    int distance,
-    int direction)
+    DdNode * f,
+    DdNode * g,
+    bool isConjunction)
 {
-  statLine(manager);
-  auto one = DD_ONE(manager);
-  auto zero = Cudd_Not(one);
+  DdNode * r;
+  do
+  {
+    manager->reordered = 0;
+    r = cuddBddAndRecur(manager, Cudd_NotCond(f, !isConjunction), Cudd_NotCond(g, !isConjunction));
+  } while (1 == manager->reordered);
+  return NULL == r ? NULL : Cudd_NotCond(r, !isConjunction);
+}
+
 
 
-  // Terminal cases
-  if (f.find(zero) != f.end())
-    return zero;
-  for (auto fn: f)
-    if (f.find(Cudd_Not(fn)) != f.end())
-      return zero;
-  std::set<DdNode *> f2;
-  for (auto fn: f)
-    if (fn != one)
-      f2.insert(fn);
-  if (f2.size() == 1)
-    return *f2.begin();
-  else if (f2.size() == 0)
-    return one;
-
-  if (distance == 0) {
-    auto min = *f2.cbegin();
-    for (auto fit = f2.cbegin(); NULL != min && fit != f2.cend(); ++fit)
+// ***** Function *****
+// see checkWhetherToGiveUp
+DdNode * checkGiveUp(DdManager * manager)
+{
+  checkWhetherToGiveUp(manager);
+  return DD_ONE(manager);
+}
+
+
+
+template<int N>
+MultiEngine<N>::MultiEngine(DdManager * manager, MultiComputedTable & cache):
+  m_manager(manager),
+  m_cache(cache),
+  m_stack(threadStack()),
+  m_budget(NULL),
+  m_numClipped(0),
+  m_node(NULL),
+  m_mask(NULL),
+  m_count(0),
+  m_exactCount(),
+  m_fullCount(),
+  m_max(0),
+  m_numVars(0)
+{ }
+
+
+
+template<int N>
+ArenaStack<typename MultiEngine<N>::Frame> & MultiEngine<N>::threadStack()
+{
+  thread_local ArenaStack<Frame> stack;
+  return stack;
+}
+
+
+
+template<int N>
+DdNode * MultiEngine<N>::bddAnd(BddOperandSet<N> const & f)
+{
+  run(MultiComputedTable::And, f, NULL, 0, 0);
+  return m_node;
+}
+
+template<int N>
+DdNode * MultiEngine<N>::bddAndAbstract(BddOperandSet<N> const & f, DdNode * cube)
+{
+  run(MultiComputedTable::AndAbstract, f, cube, 0, 0);
+  return m_node;
+}
+
+template<int N>
+DdNode * MultiEngine<N>::budgetedAndAbstract(
+    BddOperandSet<N> const & f,
+    DdNode * cube,
+    MultiBudget & budget,
+    DdNode * & exactPart)
+{
+  m_budget = &budget;
+  run(MultiComputedTable::AndAbstract, f, cube, 0, 0);
+  m_budget = NULL;
+  exactPart = m_mask;
+  return m_node;
+}
+
+template<int N>
+DdNode * MultiEngine<N>::clippingAnd(BddOperandSet<N> const & f, int distance, int direction)
+{
+  run(MultiComputedTable::ClippingAnd, f, NULL, distance, direction);
+  return m_node;
+}
+
+template<int N>
+DdNode * MultiEngine<N>::clippingAndAbstract(BddOperandSet<N> const & f, DdNode * cube, int distance, int direction)
+{
+  run(MultiComputedTable::ClippingAndAbstract, f, cube, distance, direction);
+  return m_node;
+}
+
+template<int N>
+long double MultiEngine<N>::countMinterm(BddOperandSet<N> const & f, long double max, int numVars)
+{
+  m_max = max;
+  m_numVars = numVars;
+  run(MultiComputedTable::CountMinterm, f, NULL, 0, 0);
+  return m_count;
+}
+
+template<int N>
+BigCount const & MultiEngine<N>::countMintermExact(BddOperandSet<N> const & f, int numVars)
+{
+  m_fullCount = BigCount::powerOfTwo(numVars);
+  m_numVars = numVars;
+  run(MultiComputedTable::ExactCountMinterm, f, NULL, 0, 0);
+  return m_exactCount;
+}
+
+
+
+// ***** Function *****
+// Step the topmost frame until the root frame returns.
+// Frames below the root belong to an enclosing run, if any.
+template<int N>
+void MultiEngine<N>::run(int op, BddOperandSet<N> const & f, DdNode * cube, int distance, int direction)
+{
+  int const base = m_stack.size();
+  call(op, &f, cube, distance, direction);
+  while (m_stack.size() > base)
+  {
+    Frame & fr = m_stack.top();
+    switch (fr.op)
     {
-      if (Cudd_bddLeq(manager, min, *fit))
-        min = min;
-      else if (Cudd_bddLeq(manager, *fit, min))
-        min = *fit;
-      else
-        min = NULL;
+      case MultiComputedTable::And: stepAnd(fr); break;
+      case MultiComputedTable::AndAbstract: stepAndAbstract(fr); break;
+      case MultiComputedTable::ClippingAnd: stepClippingAnd(fr); break;
+      case MultiComputedTable::ClippingAndAbstract: stepClippingAndAbstract(fr); break;
+      case MultiComputedTable::CountMinterm: stepCountMinterm(fr); break;
+      case MultiComputedTable::ExactCountMinterm: stepExactCountMinterm(fr); break;
     }
-    if (NULL != min)
-      return min;
-    return Cudd_NotCond(one, (direction == 0));
   }
+}
 
-  // at this point, none of the functions are constant
-  --distance;
 
-  checkWhetherToGiveUp(manager);
 
-  // here we can skip the use of cuddI,
-  // because the operands are known to be non-constant
-  int minIndex = Cudd_Regular(*f2.cbegin())->index;
-  int minTop = manager->perm[minIndex];
-  for (auto felem: f2)
+template<int N>
+void MultiEngine<N>::call(int op, BddOperandSet<N> const * f, DdNode * cube, int distance, int direction)
+{
+  Frame & fr = m_stack.push();
+  fr.op = op;
+  fr.state = Start;
+  fr.f = f;
+  fr.cube = cube;
+  fr.distance = distance;
+  fr.direction = direction;
+}
+
+
+
+template<int N>
+DdNode * MultiEngine<N>::makeNode(int index, DdNode * t, DdNode * e)
+{
+  if (t == e)
   {
-    int index = Cudd_Regular(felem)->index;
-    int top = manager->perm[index];
-    if (top < minTop)
+    cuddDeref(t);
+    return t;
+  }
+  cuddRef(e);
+  DdNode * r;
+  if (Cudd_IsComplement(t))
+  {
+    r = cuddUniqueInter(m_manager, index, Cudd_Not(t), Cudd_Not(e));
+    if (NULL != r)
+      r = Cudd_Not(r);
+  }
+  else
+    r = cuddUniqueInter(m_manager, index, t, e);
+  if (NULL == r)
+  {
+    Cudd_IterDerefBdd(m_manager, t);
+    Cudd_IterDerefBdd(m_manager, e);
+    return NULL;
+  }
+  cuddDeref(e);
+  cuddDeref(t);
+  return r;
+}
+
+
+
+// ***** Function *****
+// The live nodes are read at every step,
+// the clock only every few steps.
+template<int N>
+bool MultiEngine<N>::overBudget()
+{
+  MultiBudget & budget = *m_budget;
+  if (budget.exceeded)
+    return true;
+  if (budget.maxLiveNodes > 0
+      && m_manager->keys - m_manager->dead > budget.maxLiveNodes)
+    budget.exceeded = true;
+  else if (budget.deadline > 0
+           && 0 == (++budget.numSteps & 0xff)
+           && (unsigned long)util_cpu_time() > budget.deadline)
+    budget.exceeded = true;
+  return budget.exceeded;
+}
+
+
+
+// ***** Function *****
+// Solves the sub-problem of the frame with the clipping kernel instead.
+// Its result is not exact anywhere.
+template<int N>
+void MultiEngine<N>::clip(Frame & fr)
+{
+  ++m_numClipped;
+  fr.state = AfterClip;
+  int const op = MultiComputedTable::And == fr.op
+                   ? MultiComputedTable::ClippingAnd
+                   : MultiComputedTable::ClippingAndAbstract;
+  call(op, fr.f, fr.cube, m_budget->clipDepth, m_budget->direction);
+}
+
+
+
+// ***** Function *****
+// keeps the 'then' result (and its mask) of a split frame
+template<int N>
+void MultiEngine<N>::holdThen(Frame & fr, DdNode * t)
+{
+  cuddRef(t);
+  fr.t = t;
+  if (NULL != m_budget)
+  {
+    fr.tMask = m_mask;
+    cuddRef(fr.tMask);
+  }
+}
+
+
+
+// ***** Function *****
+// releases what holdThen kept
+template<int N>
+void MultiEngine<N>::dropThen(Frame & fr)
+{
+  Cudd_IterDerefBdd(m_manager, fr.t);
+  if (NULL != m_budget)
+    Cudd_IterDerefBdd(m_manager, fr.tMask);
+}
+
+
+
+// ***** Function *****
+// Returns the unreferenced result r of a split frame,
+// whose 'then' mask is still held and whose 'else' mask is in m_mask,
+// referenced when budgeted.
+// The result is exact where both halves are,
+// which is all there is to say about a disjunction.
+// Only exact results are cached.
+template<int N>
+void MultiEngine<N>::finishSplit(Frame & fr, DdNode * r, MultiComputedTable::Operation cacheOp, DdNode * cacheCube)
+{
+  if (NULL == m_budget)
+  {
+    if (NULL != r)
+      m_cache.insert(cacheOp, *fr.f, cacheCube, 0, r);
+    return ret(r);
+  }
+  DdNode * eMask = m_mask;
+  if (NULL == r)
+  {
+    Cudd_IterDerefBdd(m_manager, fr.tMask);
+    Cudd_IterDerefBdd(m_manager, eMask);
+    return ret(NULL);
+  }
+  cuddRef(r);
+  DdNode * mask;
+  if (!fr.quantify)
+  {
+    cuddDeref(eMask);
+    mask = makeNode(fr.index, fr.tMask, eMask);
+  }
+  else
+  {
+    mask = cuddBddAndRecur(m_manager, fr.tMask, eMask);
+    if (NULL != mask)
+      cuddRef(mask);
+    Cudd_IterDerefBdd(m_manager, fr.tMask);
+    Cudd_IterDerefBdd(m_manager, eMask);
+    if (NULL != mask)
+      cuddDeref(mask);
+  }
+  if (NULL == mask)
+  {
+    Cudd_IterDerefBdd(m_manager, r);
+    return ret(NULL);
+  }
+  cuddDeref(r);
+  if (isExact(fr))
+    m_cache.insert(cacheOp, *fr.f, cacheCube, 0, r);
+  return retMasked(r, mask);
+}
+
+
+
+// ***** Function *****
+// Returns the result of one of cudd's own recursions on the sub-problem
+// of the frame. In a budgeted run, the recursion runs under the manager's
+// node and time limits, tightened to those of the budget. If it gives up
+// on them, the budget is exceeded and the sub-problem is clipped instead.
+template<int N>
+template<typename Recur>
+void MultiEngine<N>::delegate(Frame & fr, Recur recur)
+{
+  if (NULL == m_budget)
+    return ret(recur());
+  DdManager * manager = m_manager;
+  MultiBudget & budget = *m_budget;
+  unsigned int const maxLive = Cudd_ReadMaxLive(manager);
+  unsigned long const timeLimit = Cudd_ReadTimeLimit(manager);
+  unsigned long const startTime = Cudd_ReadStartTime(manager);
+  unsigned long const budgetTime = budget.deadline > startTime ? budget.deadline - startTime : 0;
+  bool const limitsNodes = budget.maxLiveNodes > 0 && budget.maxLiveNodes < maxLive;
+  bool const limitsTime = budget.deadline > 0 && budgetTime < timeLimit;
+  if (limitsNodes)
+    Cudd_SetMaxLive(manager, budget.maxLiveNodes);
+  if (limitsTime)
+    Cudd_SetTimeLimit(manager, budgetTime);
+  DdNode * r = recur();
+  if (limitsNodes)
+    Cudd_SetMaxLive(manager, maxLive);
+  if (limitsTime)
+    Cudd_SetTimeLimit(manager, timeLimit);
+  if (NULL == r)
+  {
+    Cudd_ErrorType const error = Cudd_ReadErrorCode(manager);
+    if ((limitsNodes && CUDD_TOO_MANY_NODES == error)
+        || (limitsTime && CUDD_TIMEOUT_EXPIRED == error))
     {
-      minTop = top;
-      minIndex = index;
+      Cudd_ClearErrorCode(manager);
+      budget.exceeded = true;
+      return clip(fr);
     }
   }
+  return ret(r);
+}
+
+
+
+// ***** Function *****
+// A hit on the clipping key is a clipped result, counted as a clip.
+// The clipping key is probed first, since a repeated clipping call
+// mostly finds clipped results.
+template<int N>
+bool MultiEngine<N>::lookupClipping(Frame & fr, MultiComputedTable::Operation exactOp, DdNode * & result)
+{
+  auto const op = static_cast<MultiComputedTable::Operation>(fr.op);
+  fr.cacheParam = MultiComputedTable::clippingParam(fr.distance, fr.direction);
+  if (m_cache.lookup(op, *fr.f, fr.cube, fr.cacheParam, result))
+  {
+    ++m_numClipped;
+    return true;
+  }
+  return m_cache.lookup(exactOp, *fr.f, fr.cube, 0, result);
+}
+
 
-  std::set<DdNode *> ft, fe;
-  for (auto felem: f2)
+
+template<int N>
+void MultiEngine<N>::insertClipping(Frame const & fr, MultiComputedTable::Operation exactOp, DdNode * result)
+{
+  if (isExact(fr))
+    m_cache.insert(exactOp, *fr.f, fr.cube, 0, result);
+  else
+    m_cache.insert(static_cast<MultiComputedTable::Operation>(fr.op), *fr.f, fr.cube, fr.cacheParam, result);
+}
+
+
+
+// *** Function *****
+// and-abstract
+template<int N>
+void MultiEngine<N>::stepAndAbstract(Frame & fr)
+{
+  DdManager * manager = m_manager;
+  auto one = DD_ONE(manager);
+  auto zero = Cudd_Not(one);
+  BddOperandSet<N> const & fSet = *fr.f;
+
+  switch (fr.state)
   {
-    auto Felem = Cudd_Regular(felem);
-    DdNode *th, *el;
-    if (Felem->index == minIndex)
+    case Start:
     {
-      if (Cudd_IsComplement(felem))
+      statLine(manager);
+
+      // Terminal cases.
+      // if any of the funcs is zero,
+      // or if any of the funcs is the not of any other func, return zero
+      if (fSet.isZero()) return ret(zero);
+
+      // if all of the funcs are one, return one
+      if (fSet.empty()) return ret(one);
+
+      // past the budget, the rest is approximated
+      fr.clippedBefore = m_numClipped;
+      if (NULL != m_budget && overBudget())
+        return clip(fr);
+
+      // if there is only one element, no more need for conjunction
+      // (cudd's own computed table caches this)
+      if (fSet.size() == 1)
+        return delegate(fr, [&] { return cuddBddExistAbstractRecur(manager, fSet[0], fr.cube); });
+
+      // with two elements, cudd's own and-abstract applies
+      if (fSet.size() == 2)
+        return delegate(fr, [&] { return cuddBddAndAbstractRecur(manager, fSet[0], fSet[1], fr.cube); });
+
+      // if cube is empty, return the conjunction
+      if (fr.cube == one)
       {
-        th = Cudd_Not(cuddT(Felem));
-        el = Cudd_Not(cuddE(Felem));
-      } 
-      else
+        fr.op = MultiComputedTable::And;
+        return;
+      }
+
+      // find the top variable of the set of functions
+      // (the operands are sorted by level)
+      int top = fSet.topLevel(manager);
+
+      // find the top variables of the quantified variables
+      int topcube = manager->perm[fr.cube->index];
+
+      // skip the quantified variables until there is something to quantify
+      while (topcube < top) {
+        fr.cube = cuddT(fr.cube);
+        if (fr.cube == one) // if there is nothing to quantify, return the conjunction
+        {
+          fr.op = MultiComputedTable::And;
+          return;
+        }
+        topcube = manager->perm[fr.cube->index];
+      }
+
+      // check cache
+      // (the cube is part of the key, after skipping the
+      // quantified variables above the top operand variable)
+      DdNode * r;
+      if (m_cache.lookup(MultiComputedTable::AndAbstract, fSet, fr.cube, 0, r))
+        return ret(r);
+
+      // collect the 'then's and 'else's
+      fr.index = fSet.splitOnTop(manager, fr.tv, fr.ev);
+
+      // need to quantify the topmost variable?
+      fr.quantify = (topcube == top);
+      fr.nextCube = fr.quantify ? cuddT(fr.cube) : fr.cube;
+      fr.state = AfterThen;
+      return call(MultiComputedTable::AndAbstract, &fr.tv, fr.nextCube, 0, 0);
+    }
+
+    case AfterThen:
+    {
+      DdNode * t = m_node;
+      if (NULL == t) return ret(NULL);
+      if (fr.quantify)
       {
-        th = cuddT(Felem);
-        el = cuddE(Felem);
+        // Special case: 1 or anything = 1. Hence, no need to compute
+        // the else branch if t is 1. Likewise t + t * anything = t.
+        // Notice that t == fe implies that fe does not depend on the
+        // variables in the Cube.
+        // (the result is then exact wherever t is)
+        if (t == one || fr.ev.contains(manager, t))
+        {
+          if (isExact(fr))
+            m_cache.insert(MultiComputedTable::AndAbstract, fSet, fr.cube, 0, t);
+          return retMasked(t, m_mask);
+        }
+        // Special case: t + !t * anything == t + anything
+        fr.ev.erase(manager, Cudd_Not(t));
       }
+      holdThen(fr, t);
+      fr.state = AfterElse;
+      return call(MultiComputedTable::AndAbstract, &fr.ev, fr.nextCube, 0, 0);
     }
-    else
+
+    case AfterElse:
     {
-      th = felem;
-      el = felem;
+      DdNode * t = fr.t;
+      DdNode * e = m_node;
+      if (NULL == e)
+      {
+        dropThen(fr);
+        return ret(NULL);
+      }
+      if (NULL != m_budget)
+        cuddRef(m_mask);
+      DdNode * r;
+      if (!fr.quantify)
+        r = makeNode(fr.index, t, e);
+      else if (t == e)
+      {
+        r = t;
+        cuddDeref(t);
+      } else {
+        cuddRef(e);
+        r = cuddBddAndRecur(manager, Cudd_Not(t), Cudd_Not(e));
+        if (NULL == r) {
+          Cudd_IterDerefBdd(manager, t);
+          Cudd_IterDerefBdd(manager, e);
+        } else {
+          r = Cudd_Not(r);
+          cuddRef(r);
+          Cudd_DelayedDerefBdd(manager, t);
+          Cudd_DelayedDerefBdd(manager, e);
+          cuddDeref(r);
+        }
+      }
+      return finishSplit(fr, r, MultiComputedTable::AndAbstract, fr.cube);
     }
-    ft.insert(th);
-    fe.insert(el);
+
+    case AfterClip:
+      return retMasked(m_node, Cudd_Not(DD_ONE(manager)));
+
+    default:
+      return;
   }
+} // end of stepAndAbstract
 
-  auto t = cuddBddClippingAndMultiRecur(manager, ft, distance, direction);
-  if (NULL == t) return NULL;
-  cuddRef(t);
-  auto e = cuddBddClippingAndMultiRecur(manager, fe, distance, direction);
-  if (NULL == e)
+
+
+
+
+
+// ***** Function *****
+// "and"
+template<int N>
+void MultiEngine<N>::stepAnd(Frame & fr)
+{
+  DdManager * manager = m_manager;
+  auto one = DD_ONE(manager);
+  auto zero = Cudd_Not(one);
+  BddOperandSet<N> const & fSet = *fr.f;
+
+  switch (fr.state)
   {
-    Cudd_RecursiveDeref(manager, t);
-    return NULL;
+    case Start:
+    {
+      statLine(manager);
+
+      // Terminal cases
+      if (fSet.isZero())
+        return ret(zero);
+      if (fSet.empty())
+        return ret(one);
+      if (fSet.size() == 1)
+        return ret(fSet[0]);
+
+      // past the budget, the rest is approximated
+      fr.clippedBefore = m_numClipped;
+      if (NULL != m_budget && overBudget())
+        return clip(fr);
+
+      // with two elements, cudd's own conjunction applies
+      if (fSet.size() == 2)
+        return delegate(fr, [&] { return cuddBddAndRecur(manager, fSet[0], fSet[1]); });
+
+      DdNode * cachedResult;
+      if (m_cache.lookup(MultiComputedTable::And, fSet, NULL, 0, cachedResult))
+        return ret(cachedResult);
+
+      fr.index = fSet.splitOnTop(manager, fr.tv, fr.ev);
+      fr.quantify = false;
+      fr.state = AfterThen;
+      return call(MultiComputedTable::And, &fr.tv, NULL, 0, 0);
+    }
+
+    case AfterThen:
+    {
+      DdNode * t = m_node;
+      if (NULL == t) return ret(NULL);
+      holdThen(fr, t);
+      fr.state = AfterElse;
+      return call(MultiComputedTable::And, &fr.ev, NULL, 0, 0);
+    }
+
+    case AfterElse:
+    {
+      DdNode * e = m_node;
+      if (NULL == e)
+      {
+        dropThen(fr);
+        return ret(NULL);
+      }
+      if (NULL != m_budget)
+        cuddRef(m_mask);
+      return finishSplit(fr, makeNode(fr.index, fr.t, e), MultiComputedTable::And, NULL);
+    }
+
+    case AfterClip:
+      return retMasked(m_node, Cudd_Not(DD_ONE(manager)));
+
+    default:
+      return;
   }
-  cuddRef(e);
+} // end stepAnd
 
-  DdNode * result;
-  if (t == e)
-    result = t;
-  else
+
+
+
+/**
+  @brief Implements the step of Cudd_bddClippingAndMulti
+
+  @details Takes the conjunction of a set of BDDs.
+
+  @sideeffect None
+
+  @see cuddBddClippingAnd
+
+*/
+template<int N>
+void MultiEngine<N>::stepClippingAnd(Frame & fr)
+{
+  DdManager * manager = m_manager;
+  auto one = DD_ONE(manager);
+  auto zero = Cudd_Not(one);
+  BddOperandSet<N> const & f2 = *fr.f;
+
+  switch (fr.state)
   {
-    if (Cudd_IsComplement(t))
+    case Start:
     {
-      result = cuddUniqueInter(manager, minIndex, Cudd_Not(t), Cudd_Not(e));
-      if (NULL == result)
-      {
-        Cudd_RecursiveDeref(manager, t);
-        Cudd_RecursiveDeref(manager, e);
-        return NULL;
+      statLine(manager);
+      fr.clippedBefore = m_numClipped;
+
+      // Terminal cases
+      if (f2.isZero())
+        return ret(zero);
+      if (f2.size() == 1)
+        return ret(f2[0]);
+      else if (f2.size() == 0)
+        return ret(one);
+
+      if (fr.distance == 0) {
+        auto min = f2[0];
+        for (auto fit = f2.begin(); NULL != min && fit != f2.end(); ++fit)
+        {
+          if (Cudd_bddLeq(manager, min, *fit))
+            min = min;
+          else if (Cudd_bddLeq(manager, *fit, min))
+            min = *fit;
+          else
+            min = NULL;
+        }
+        if (NULL != min)
+          return ret(min);
+        ++m_numClipped;
+        return ret(Cudd_NotCond(one, (fr.direction == 0)));
       }
-      result = Cudd_Not(result);
+
+      // check cache
+      DdNode * cachedResult;
+      if (lookupClipping(fr, MultiComputedTable::And, cachedResult))
+        return ret(cachedResult);
+
+      // at this point, none of the functions are constant
+      --fr.distance;
+
+      if (NULL == checkGiveUp(manager))
+        return ret(NULL);
+
+      // here we can skip the use of cuddI,
+      // because the operands are known to be non-constant
+      fr.index = f2.splitOnTop(manager, fr.tv, fr.ev);
+      fr.state = AfterThen;
+      return call(MultiComputedTable::ClippingAnd, &fr.tv, NULL, fr.distance, fr.direction);
     }
-    else
+
+    case AfterThen:
     {
-      result = cuddUniqueInter(manager, minIndex, t, e);
-      if (NULL == result)
+      DdNode * t = m_node;
+      if (NULL == t) return ret(NULL);
+      cuddRef(t);
+      fr.t = t;
+      fr.state = AfterElse;
+      return call(MultiComputedTable::ClippingAnd, &fr.ev, NULL, fr.distance, fr.direction);
+    }
+
+    case AfterElse:
+    {
+      DdNode * e = m_node;
+      if (NULL == e)
       {
-        Cudd_RecursiveDeref(manager, t);
-        Cudd_RecursiveDeref(manager, e);
-        return NULL;
+        Cudd_RecursiveDeref(manager, fr.t);
+        return ret(NULL);
       }
+      DdNode * result = makeNode(fr.index, fr.t, e);
+      if (NULL == result) return ret(NULL);
+      insertClipping(fr, MultiComputedTable::And, result);
+      return ret(result);
     }
-  }
-
-  cuddDeref(e);
-  cuddDeref(t);
-  return result;
 
-} // end of cuddBddClippingAndMultiRecur
+    default:
+      return;
+  }
+} // end of stepClippingAnd
 
 
 
@@ -776,284 +1620,273 @@ cuddBddClippingAndMultiRecur(
 
   @details The variables are existentially abstracted.
 
-  @return a pointer to the result is successful; NULL otherwise.
-
   @sideeffect None
 
   @see Cudd_bddClippingAndAbstract
 
 */
-DdNode *
-cuddBddClippingAndAbstractMultiRecur(
-    DdManager * manager,
-    std::set<DdNode *> const & f,
-    DdNode * cube,
-    int distance,
-    int direction)
+template<int N>
+void MultiEngine<N>::stepClippingAndAbstract(Frame & fr)
 {
-
-  statLine(manager);
+  DdManager * manager = m_manager;
   auto const one = DD_ONE(manager);
   auto const zero = Cudd_Not(one);
+  BddOperandSet<N> const & f2 = *fr.f;
 
-  // Terminal cases
-  std::set<DdNode *> f2; // filter out ones
-  for (auto felem: f)
+  switch (fr.state)
   {
-    // if any elem is zero return zero
-    if (zero == felem) return zero;
-    // if any elem is the not of any other lem return zero
-    for (auto felem2: f) if (felem == Cudd_Not(felem2)) return zero;
-    // filter away ones
-    if (one != felem) f2.insert(felem);
-  }
-  // if no elements then return true
-  if (f2.size() == 0) return one;
-  // if nothing more to abstract, just compute and
-  if (cube == one) return cuddBddClippingAndMultiRecur(manager, f2, distance, direction);
-  // if only one element, compute abstraction
-  if (f2.size() == 1) return cuddBddExistAbstractRecur(manager, *f2.cbegin(), cube);
-  // if distance 0 then just return true or false depending on direction
-  if (0 == distance) return Cudd_NotCond(one, (0 == direction));
-
-  // At this point, f2 does not have any constants
-  --distance;
+    case Start:
+    {
+      statLine(manager);
+      fr.clippedBefore = m_numClipped;
+
+      // Terminal cases
+      // if any elem is zero, or the not of any other elem, return zero
+      if (f2.isZero()) return ret(zero);
+      // if no elements then return true
+      if (f2.size() == 0) return ret(one);
+      // if nothing more to abstract, just compute and
+      if (fr.cube == one)
+      {
+        fr.op = MultiComputedTable::ClippingAnd;
+        fr.cube = NULL;
+        return;
+      }
+      // if only one element, compute abstraction
+      if (f2.size() == 1) return ret(cuddBddExistAbstractRecur(manager, f2[0], fr.cube));
+      // if distance 0 then just return true or false depending on direction
+      if (0 == fr.distance)
+      {
+        ++m_numClipped;
+        return ret(Cudd_NotCond(one, (0 == fr.direction)));
+      }
 
-  checkWhetherToGiveUp(manager);
+      // check cache
+      DdNode * cachedResult;
+      if (lookupClipping(fr, MultiComputedTable::AndAbstract, cachedResult))
+        return ret(cachedResult);
 
-  // Here we can skip the use of cuddI, because f2 does not
-  // have any constants
-  
-  // find the topmost variable among all functions
-  int minIndex = Cudd_Regular(*f2.cbegin())->index;
-  int minTop = manager->perm[minIndex];
-  for (auto felem: f2)
-  {
-    int index = Cudd_Regular(felem)->index;
-    int top = manager->perm[index];
-    if (top < minTop)
-    {
-      minIndex = index;
-      minTop = top;
-    }
-  }
-  // find the top variable of the abstraction cube
-  int topCube = manager->perm[cube->index];
-
-  // if none of the funcs have the top cube variable
-  // then we don't need to quantify on this variable
-  if (topCube < minTop)
-    return cuddBddClippingAndAbstractMultiRecur(
-        manager, f2, cuddT(cube), 
-        distance, direction);
-
-  // collect then-s and else-s
-  std::set<DdNode *> ft, fe;
-  for (auto felem: f2)
-  {
-    int index = Cudd_Regular(felem)->index;
-    int top = manager->perm[index];
-    if (top == minTop)
-    {
-      // if top variable needs to be extracted
-      auto ftelem = cuddT(Cudd_Regular(felem));
-      auto feelem = cuddE(Cudd_Regular(felem));
-      if (Cudd_IsComplement(felem))
+      // At this point, f2 does not have any constants
+      --fr.distance;
+
+      if (NULL == checkGiveUp(manager))
+        return ret(NULL);
+
+      // Here we can skip the use of cuddI, because f2 does not
+      // have any constants
+
+      // find the topmost variable among all functions
+      // (the operands are sorted by level)
+      int minTop = f2.topLevel(manager);
+      // find the top variable of the abstraction cube
+      int topCube = manager->perm[fr.cube->index];
+
+      // if none of the funcs have the top cube variable
+      // then we don't need to quantify on this variable
+      if (topCube < minTop)
       {
-        ftelem = Cudd_Not(ftelem);
-        feelem = Cudd_Not(feelem);
+        fr.cube = cuddT(fr.cube);
+        return;
       }
-      ft.insert(ftelem);
-      fe.insert(feelem);
+
+      // collect then-s and else-s
+      fr.index = f2.splitOnTop(manager, fr.tv, fr.ev);
+
+      // compute the 'then' part of the result
+      fr.quantify = (topCube == minTop);
+      fr.nextCube = fr.quantify ? cuddT(fr.cube) : fr.cube;
+      fr.state = AfterThen;
+      return call(MultiComputedTable::ClippingAndAbstract, &fr.tv, fr.nextCube, fr.distance, fr.direction);
     }
-    else
+
+    case AfterThen:
     {
-      // if function is independent of current variable
-      ft.insert(felem);
-      fe.insert(felem);
-    }
-  }
+      DdNode * t = m_node;
+      if (NULL == t) return ret(NULL);
 
-  // compute the 'then' part of the result
-  auto nextCube = (topCube == minTop) ? cuddT(cube) : cube;
-  auto t = cuddBddClippingAndAbstractMultiRecur(manager, ft, nextCube, distance, direction);
-  if (NULL == t) return NULL;
-  
-  // Special case: 
-  //     1 OR anything = 1.
-  // Hence, no need to compute the else branch if t is 1.
-  if (t == one && topCube == minTop)
-    return one;
+      // Special case:
+      //     1 OR anything = 1.
+      // Hence, no need to compute the else branch if t is 1.
+      if (t == one && fr.quantify)
+      {
+        insertClipping(fr, MultiComputedTable::AndAbstract, one);
+        return ret(one);
+      }
 
-  cuddRef(t);
+      cuddRef(t);
+      fr.t = t;
 
-  // compute the 'else' part of the result
-  auto e = cuddBddClippingAndAbstractMultiRecur(manager, fe, nextCube, distance, direction);
-  if (NULL == e)
-  {
-    Cudd_RecursiveDeref(manager, t);
-    return NULL;
-  }
-  cuddRef(e);
-  
-
-  if (topCube == minTop)
-  {
-    // need to abstract
-    // so compute the OR of t and e
-    std::set<DdNode *> teSet;
-    teSet.insert(Cudd_Not(t));
-    teSet.insert(Cudd_Not(e));
-    DdNode * result = cuddBddClippingAndMultiRecur(
-        manager, teSet,
-        distance, (direction == 0));
-    if (NULL == result)
-    {
-      Cudd_RecursiveDeref(manager, t);
-      Cudd_RecursiveDeref(manager, e);
-      return NULL;
+      // compute the 'else' part of the result
+      fr.state = AfterElse;
+      return call(MultiComputedTable::ClippingAndAbstract, &fr.ev, fr.nextCube, fr.distance, fr.direction);
     }
-    result = Cudd_Not(result);
-    cuddRef(result);
-    Cudd_RecursiveDeref(manager, t);
-    Cudd_RecursiveDeref(manager, e);
-    cuddDeref(result);
-    return result;
-  }
-  else if (t == e)
-  {
-    auto result = t;
-    cuddDeref(t);
-    cuddDeref(e);
-    return result;
-  }
-  else
-  {
-    // nothing to abstract, return if-then-else(minIndex, t, e)
-    DdNode * result;
-    if (Cudd_IsComplement(t))
+
+    case AfterElse:
     {
-      result = cuddUniqueInter(manager, minIndex, Cudd_Not(t), Cudd_Not(e));
-      if (NULL == result)
+      DdNode * e = m_node;
+      if (NULL == e)
       {
-        Cudd_RecursiveDeref(manager, t);
-        Cudd_RecursiveDeref(manager, e);
-        return NULL;
+        Cudd_RecursiveDeref(manager, fr.t);
+        return ret(NULL);
       }
-      result = Cudd_Not(result);
+
+      if (!fr.quantify)
+      {
+        // nothing to abstract, return if-then-else(index, t, e)
+        DdNode * result = makeNode(fr.index, fr.t, e);
+        if (NULL == result) return ret(NULL);
+        insertClipping(fr, MultiComputedTable::AndAbstract, result);
+        return ret(result);
+      }
+
+      // need to abstract
+      // so compute the OR of t and e
+      // (the 'then' operands are no longer needed)
+      cuddRef(e);
+      fr.e = e;
+      fr.tv.clear();
+      fr.tv.push(Cudd_Not(fr.t));
+      fr.tv.push(Cudd_Not(e));
+      fr.tv.normalize(manager);
+      fr.state = AfterOr;
+      return call(MultiComputedTable::ClippingAnd, &fr.tv, NULL, fr.distance, (fr.direction == 0));
     }
-    else
+
+    case AfterOr:
     {
-      result = cuddUniqueInter(manager, minIndex, t, e);
+      DdNode * result = m_node;
       if (NULL == result)
       {
-        Cudd_RecursiveDeref(manager, t);
-        Cudd_RecursiveDeref(manager, e);
-        return NULL;
+        Cudd_RecursiveDeref(manager, fr.t);
+        Cudd_RecursiveDeref(manager, fr.e);
+        return ret(NULL);
       }
+      result = Cudd_Not(result);
+      cuddRef(result);
+      Cudd_RecursiveDeref(manager, fr.t);
+      Cudd_RecursiveDeref(manager, fr.e);
+      cuddDeref(result);
+      insertClipping(fr, MultiComputedTable::AndAbstract, result);
+      return ret(result);
     }
-    cuddDeref(t);
-    cuddDeref(e);
-    return result;
+
+    default:
+      return;
   }
-} // end of cuddBddClippingAndAbsMultiRecur
+} // end of stepClippingAndAbstract
 
 
 
-long double cuddBddCountMintermMultiAux(
-    DdManager * manager,
-    const std::set<DdNode *> & f,
-    long double max,
-    parakram::LruCache<std::set<DdNode *>, long double> & cache)
+// ***** Function *****
+// model counting
+template<int N>
+void MultiEngine<N>::stepCountMinterm(Frame & fr)
 {
-  const auto one = DD_ONE(manager);
-  const auto zero = Cudd_Not(one);
-
-  // if any of the funcs is false
-  // then there are zero solutions
-  if (f.count(zero) > 0)
-    return 0;
-
-  // filter away true funcs
-  // as they cannot affect the answer
-  std::set<DdNode *> funcs;
-  for (const auto func: f)
-    if(func != one)
-      funcs.insert(func);
-
-  // no funcs left, so all funcs must have been true
-  if (funcs.empty())
-    return max;
-
-  // check cache
-  auto cacheResult = cache.tryGet(funcs);
-  if (cacheResult.isPresent())
-    return cacheResult.get();
-
-  // find the earliest variable
-  int minIndex = Cudd_Regular(*funcs.cbegin())->index;
-  int minTop = manager->perm[minIndex];
-  for (const auto func: funcs)
+  BddOperandSet<N> const & funcs = *fr.f;
+
+  switch (fr.state)
   {
-    int index = Cudd_Regular(func)->index;
-    int top = manager->perm[index];
-    if (top < minTop)
+    case Start:
     {
-      minTop = top;
-      minIndex = index;
+      // if any of the funcs is false
+      // then there are zero solutions
+      if (funcs.isZero())
+        return retCount(0);
+
+      // true funcs have already been filtered away
+      // as they cannot affect the answer.
+      // no funcs left, so all funcs must have been true
+      if (funcs.empty())
+        return retCount(m_max);
+
+      // check cache
+      // (the count is scaled by the number of variables,
+      // which is therefore part of the key)
+      long double cachedCount;
+      if (m_cache.lookup(MultiComputedTable::CountMinterm, funcs, NULL, m_numVars, cachedCount))
+        return retCount(cachedCount);
+
+      // split on the earliest variable
+      funcs.splitOnTop(m_manager, fr.tv, fr.ev);
+
+      // process the "then" children
+      fr.state = AfterThen;
+      return call(MultiComputedTable::CountMinterm, &fr.tv, NULL, 0, 0);
     }
-  }
 
-
-  // process the "then" children
-  std::set<DdNode *> children;
-  for (const auto func: funcs)
-  {
-    int index = Cudd_Regular(func)->index;
-    if (index == minIndex)
+    case AfterThen:
     {
-      // This is one of the nodes
-      // that is splitting on the earliest variable.
-      // So we need to take the "then" child
-      DdNode * t = cuddT(Cudd_Regular(func));
-      if (Cudd_IsComplement(func))
-        t = Cudd_Not(t);
-      children.insert(t);
-    } else
+      // process the "else" children
+      fr.tCount = m_count;
+      fr.state = AfterElse;
+      return call(MultiComputedTable::CountMinterm, &fr.ev, NULL, 0, 0);
+    }
+
+    case AfterElse:
     {
-      // This node will split later,
-      // so just keep it as it is
-      children.insert(func);
+      // compute result, put into cache, and return
+      const long double fullCount = (fr.tCount * .5) + (m_count * .5);
+      m_cache.insert(MultiComputedTable::CountMinterm, funcs, NULL, m_numVars, fullCount);
+      return retCount(fullCount);
     }
+
+    default:
+      return;
   }
-  const long double tCount = cuddBddCountMintermMultiAux(manager, children, max, cache);
+} // end of stepCountMinterm
 
 
-  // process the "else" children
-  children.clear();
-  for (const auto func: funcs)
+
+// ***** Function *****
+// exact model counting
+// Counts over all the numVars variables, so that a count is always
+// the mean of the counts of its two cofactors, and the halving is exact.
+// The counts are passed in m_exactCount, whose buffer is reused.
+template<int N>
+void MultiEngine<N>::stepExactCountMinterm(Frame & fr)
+{
+  BddOperandSet<N> const & funcs = *fr.f;
+
+  switch (fr.state)
   {
-    int index = Cudd_Regular(func)->index;
-    if (index == minIndex)
-    {
-      // split on this node
-      DdNode * e = cuddE(Cudd_Regular(func));
-      if (Cudd_IsComplement(func))
-        e = Cudd_Not(e);
-      children.insert(e);
-    } else
+    case Start:
     {
-      // do not split on this node yet
-      children.insert(func);
-    }
-  }
-  const long double eCount = cuddBddCountMintermMultiAux(manager, children, max, cache);
+      if (funcs.isZero())
+      {
+        m_exactCount.setZero();
+        return retExactCount();
+      }
+      if (funcs.empty())
+      {
+        m_exactCount = m_fullCount;
+        return retExactCount();
+      }
 
-  // compute result, put into cache, and return
-  const long double fullCount = (tCount * .5) + (eCount * .5);
-  cache.insert(funcs, fullCount);
-  return fullCount;
+      // check cache
+      if (m_cache.lookup(MultiComputedTable::ExactCountMinterm, funcs, NULL, m_numVars, m_exactCount))
+        return retExactCount();
+
+      funcs.splitOnTop(m_manager, fr.tv, fr.ev);
+      fr.state = AfterThen;
+      return call(MultiComputedTable::ExactCountMinterm, &fr.tv, NULL, 0, 0);
+    }
 
+    case AfterThen:
+    {
+      fr.tExactCount = m_exactCount;
+      fr.state = AfterElse;
+      return call(MultiComputedTable::ExactCountMinterm, &fr.ev, NULL, 0, 0);
+    }
 
-} // end of cuddBddCountMintermMultiAux
+    case AfterElse:
+    {
+      m_exactCount += fr.tExactCount;
+      m_exactCount.shiftRight(1);
+      m_cache.insert(MultiComputedTable::ExactCountMinterm, funcs, NULL, m_numVars, m_exactCount);
+      return retExactCount();
+    }
 
+    default:
+      return;
+  }
+} // end of stepExactCountMinterm
@@ -27,20 +27,104 @@ SOFTWARE.
 #include <stdio.h>
 #include <cudd.h>
 #include <set>
+#include "big_count.h"
+#include "const_span.h"
 
 /*---------------------------------------------------------------------------*/
 /* Function prototypes                                                       */
 /*---------------------------------------------------------------------------*/
 
 DdNode * Cudd_bddAndAbstractMulti(DdManager *manager, const std::set<DdNode *> & f, DdNode *cube, int multiCacheCapacity);
+DdNode * Cudd_bddAndAbstractMultiParallel(DdManager *manager,
+                                          const std::set<DdNode *> & f,
+                                          DdNode *cube,
+                                          int multiCacheCapacity,
+                                          int numSplitVars,
+                                          int numThreads);
+DdNode * Cudd_bddAndAbstractMultiBudgeted(DdManager *manager,
+                                          const std::set<DdNode *> & f,
+                                          DdNode *cube,
+                                          int direction,
+                                          int maxLiveNodes,
+                                          long timeLimit,
+                                          int clipDepth,
+                                          int multiCacheCapacity,
+                                          DdNode ** exactPart);
 DdNode * Cudd_bddAndMulti(DdManager *manager, const std::set<DdNode *> & f, int multiCacheCapacity);
 DdNode * Cudd_bddClippingAndMulti(DdManager *manager, 
                                   const std::set<DdNode *> & f, 
                                   int maxDepth, 
-                                  int direction);
+                                  int direction,
+                                  int multiCacheCapacity);
 DdNode * Cudd_bddClippingAndAbstractMulti(DdManager *manager, 
                                           const std::set<DdNode *> & f, 
                                           DdNode *cube, 
                                           int maxDepth, 
-                                          int direction);
+                                          int direction,
+                                          int multiCacheCapacity);
+DdNode * Cudd_bddClippingAndAbstractMultiDeepening(DdManager *manager,
+                                                   const std::set<DdNode *> & f,
+                                                   DdNode *cube,
+                                                   int direction,
+                                                   int depthStep,
+                                                   int maxNodes,
+                                                   long timeLimit,
+                                                   int multiCacheCapacity,
+                                                   int * reachedDepth);
 long double Cudd_LdblCountMintermMulti(DdManager * dd, const std::set<DdNode *> & funcs, int numVars, int multiCacheCapacity);
+parakram::BigCount Cudd_BigCountMintermMulti(DdManager * dd, const std::set<DdNode *> & funcs, int numVars, int multiCacheCapacity);
+parakram::BigCount Cudd_BigCountMintermMultiPartitioned(DdManager * dd,
+                                                        const std::set<DdNode *> & funcs,
+                                                        int numVars,
+                                                        int multiCacheCapacity,
+                                                        int numThreads);
+
+/* Overloads on contiguous ranges of operands,
+   which may be unsorted and hold duplicates */
+DdNode * Cudd_bddAndAbstractMulti(DdManager *manager, parakram::ConstSpan<DdNode *> f, DdNode *cube, int multiCacheCapacity);
+DdNode * Cudd_bddAndAbstractMultiParallel(DdManager *manager,
+                                          parakram::ConstSpan<DdNode *> f,
+                                          DdNode *cube,
+                                          int multiCacheCapacity,
+                                          int numSplitVars,
+                                          int numThreads);
+DdNode * Cudd_bddAndAbstractMultiBudgeted(DdManager *manager,
+                                          parakram::ConstSpan<DdNode *> f,
+                                          DdNode *cube,
+                                          int direction,
+                                          int maxLiveNodes,
+                                          long timeLimit,
+                                          int clipDepth,
+                                          int multiCacheCapacity,
+                                          DdNode ** exactPart);
+DdNode * Cudd_bddAndMulti(DdManager *manager, parakram::ConstSpan<DdNode *> f, int multiCacheCapacity);
+DdNode * Cudd_bddClippingAndMulti(DdManager *manager, 
+                                  parakram::ConstSpan<DdNode *> f, 
+                                  int maxDepth, 
+                                  int direction,
+                                  int multiCacheCapacity);
+DdNode * Cudd_bddClippingAndAbstractMulti(DdManager *manager, 
+                                          parakram::ConstSpan<DdNode *> f, 
+                                          DdNode *cube, 
+                                          int maxDepth, 
+                                          int direction,
+                                          int multiCacheCapacity);
+DdNode * Cudd_bddClippingAndAbstractMultiDeepening(DdManager *manager,
+                                                   parakram::ConstSpan<DdNode *> f,
+                                                   DdNode *cube,
+                                                   int direction,
+                                                   int depthStep,
+                                                   int maxNodes,
+                                                   long timeLimit,
+                                                   int multiCacheCapacity,
+                                                   int * reachedDepth);
+long double Cudd_LdblCountMintermMulti(DdManager * dd, parakram::ConstSpan<DdNode *> funcs, int numVars, int multiCacheCapacity);
+parakram::BigCount Cudd_BigCountMintermMulti(DdManager * dd, parakram::ConstSpan<DdNode *> funcs, int numVars, int multiCacheCapacity);
+parakram::BigCount Cudd_BigCountMintermMultiPartitioned(DdManager * dd,
+                                                        parakram::ConstSpan<DdNode *> funcs,
+                                                        int numVars,
+                                                        int multiCacheCapacity,
+                                                        int numThreads);
+
+void Cudd_ReadMultiStackStats(int * peakDepth, int * numFrames);
+void Cudd_ResetMultiStackPeak();
@@ -0,0 +1,848 @@
+/*
+
+Copyright 2021 Parakram Majumdar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#include "cuddAndAbsMulti.h"
+#include "bdd_partition.h"
+#include "multi_computed_table.h"
+#include <util.h>
+#include <cuddInt.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using parakram::BigCount;
+using parakram::ConstSpan;
+using parakram::MultiComputedTable;
+
+
+
+
+
+
+
+
+
+// **************************************
+// *** Internal function declarations ***
+// **************************************
+
+
+
+// ***** Function *****
+// The variable indices of the top numSplitVars variables
+// in the support of f, sorted by level.
+std::vector<int> chooseSplitVars(
+    DdManager * manager,
+    ConstSpan<DdNode *> f,
+    int numSplitVars);
+
+
+
+// ***** JobQueue *****
+// ******** struct ********
+// The jobs of a worker thread, a contiguous range of cofactors at first.
+// The worker takes jobs from the front, other workers steal from the back.
+struct JobQueue
+{
+  std::mutex mutex;
+  std::deque<int> jobs;
+};
+
+
+
+// ***** Function *****
+// The next job of a worker: the front of its own queue,
+// or else the back of the next queue with a job left.
+// Returns -1 when all the queues are empty.
+int takeJob(
+    std::vector<JobQueue> & queues,
+    int self);
+
+
+
+// ***** Function *****
+// The combination of the results t and e of the two cofactors
+// on the variable with the given index: their OR if the variable
+// is quantified, else their ITE on it.
+// Returns a referenced bdd, or NULL.
+DdNode * combineCofactors(
+    DdManager * manager,
+    int index,
+    bool isQuantified,
+    DdNode * t,
+    DdNode * e);
+
+
+
+// ***** Function *****
+// The body of a worker thread.
+// Creates a manager with the variable order of the source manager,
+// then keeps taking jobs until none are left,
+// leaving the referenced result of each job in its own manager,
+// as a leaf of the combination tree, owned by the worker.
+// The source manager is only read, never modified.
+void runAndAbstractWorker(
+    DdManager * source,
+    std::vector<int> const & order,
+    std::vector<std::vector<DdNode *> > const & jobOperands,
+    DdNode * cube,
+    int cacheSize,
+    int self,
+    std::vector<JobQueue> & queues,
+    std::atomic<bool> & failed,
+    DdManager * & worker,
+    std::vector<DdNode *> & tree,
+    std::vector<int> & owners);
+
+
+
+// ***** Function *****
+// The body of a worker thread, once all the jobs are done:
+// combines the inner nodes of the combination tree owned by the worker,
+// bottom up, in its own manager.
+void runCombineWorker(
+    DdManager * worker,
+    int self,
+    std::vector<int> const & splitVars,
+    std::vector<char> const & isQuantified,
+    std::vector<int> const & owners,
+    std::atomic<bool> & failed,
+    std::vector<DdNode *> & tree);
+
+
+
+// ***** Function *****
+// Probe / fill the shared count tier (see MultiComputedTable::sharedCounts)
+// for a partition of the source manager, sorted by address.
+bool lookupSharedCount(
+    DdManager * source,
+    std::vector<DdNode *> const & partition,
+    int supportSize,
+    BigCount & count);
+void insertSharedCount(
+    DdManager * source,
+    std::vector<DdNode *> const & partition,
+    int supportSize,
+    BigCount const & count);
+
+
+
+// ***** Function *****
+// The shape of a partition of the source manager, sorted by address,
+// from the shared shape tier (see MultiComputedTable::sharedShapes),
+// computing and inserting it on a miss.
+MultiComputedTable::Shape sharedShape(
+    DdManager * source,
+    std::vector<DdNode *> const & partition);
+
+
+
+// ***** Function *****
+// The body of a counting worker thread.
+// Creates a manager with the variable order of the source manager,
+// then keeps pulling partitions until none are left,
+// counting each over its own support,
+// unless another thread or an earlier call already has.
+void runCountWorker(
+    DdManager * source,
+    std::vector<int> const & order,
+    std::vector<std::vector<DdNode *> > const & partitions,
+    std::vector<int> const & supportSizes,
+    int cacheSize,
+    std::atomic<int> & nextJob,
+    std::atomic<bool> & failed,
+    std::vector<BigCount> & counts);
+
+
+
+
+
+
+
+//****************************************
+// *** Public api function definitions ***
+//****************************************
+
+
+
+
+
+/**
+  @brief Takes the AND of a set of BDDs and simultaneously abstracts
+  the variables in cube, using several threads.
+
+  @details Splits on the top numSplitVars variables of the support of f
+  into 2^numSplitVars cofactor jobs, solved by numThreads worker
+  threads, each with a DdManager of its own: the operands are moved in,
+  and the results moved back, with Cudd_bddTransfer. Each worker starts
+  with a contiguous range of the jobs, so that it solves neighbouring
+  cofactors, which share much of their structure, and steals from the
+  other workers once its own range is done. Jobs are not split further
+  at run time, since that would take the source manager, which the
+  workers only read, so numSplitVars should give a few jobs per thread.
+  The results are combined pairwise along a binary tree, taking the OR
+  over the quantified split variables and the ITE over the others: each
+  subtree whose results all sit in one worker is combined by that worker,
+  in parallel with the others, and only the few combinations across
+  workers are left to the source manager. A numThreads of zero uses all
+  the hardware threads.
+
+  @return a pointer to the result is successful; NULL otherwise.
+
+  @sideeffect None
+
+  @see Cudd_bddAndAbstractMulti Cudd_bddTransfer
+
+*/
+DdNode * Cudd_bddAndAbstractMultiParallel(
+    DdManager * manager,
+    ConstSpan<DdNode *> f,
+    DdNode * cube,
+    int cacheSize,
+    int numSplitVars,
+    int numThreads)
+{
+  auto splitVars = chooseSplitVars(manager, f, numSplitVars);
+  if (splitVars.empty())
+    return Cudd_bddAndAbstractMulti(manager, f, cube, cacheSize);
+  int const numVars = static_cast<int>(splitVars.size());
+  int const numJobs = 1 << numVars;
+  if (numThreads <= 0)
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  numThreads = std::min(numThreads, numJobs);
+
+  std::vector<DdNode *> splitProjections;
+  for (auto index: splitVars)
+    splitProjections.push_back(Cudd_bddIthVar(manager, index));
+
+  // the split variables are quantified by the combination,
+  // so they are removed from the cube handed to the jobs
+  DdNode * splitCube = Cudd_bddComputeCube(manager, &splitProjections.front(), NULL, numVars);
+  if (NULL == splitCube)
+    return NULL;
+  Cudd_Ref(splitCube);
+  DdNode * jobCube = Cudd_bddExistAbstract(manager, cube, splitCube);
+  if (NULL == jobCube)
+  {
+    Cudd_RecursiveDeref(manager, splitCube);
+    return NULL;
+  }
+  Cudd_Ref(jobCube);
+  Cudd_RecursiveDeref(manager, splitCube);
+
+  // the cofactors of every job,
+  // where the first split variable is the most significant bit
+  bool failed = false;
+  std::vector<std::vector<DdNode *> > jobOperands(numJobs);
+  std::vector<int> phases(numVars);
+  for (int job = 0; job < numJobs && !failed; ++job)
+  {
+    for (int i = 0; i < numVars; ++i)
+      phases[i] = (job >> (numVars - 1 - i)) & 1;
+    DdNode * literals = Cudd_bddComputeCube(manager, &splitProjections.front(), &phases.front(), numVars);
+    if (NULL == literals)
+    {
+      failed = true;
+      break;
+    }
+    Cudd_Ref(literals);
+    for (auto g: f)
+    {
+      DdNode * cofactor = Cudd_Cofactor(manager, g, literals);
+      if (NULL == cofactor)
+      {
+        failed = true;
+        break;
+      }
+      Cudd_Ref(cofactor);
+      jobOperands[job].push_back(cofactor);
+    }
+    Cudd_RecursiveDeref(manager, literals);
+  }
+
+  // the combination tree: the leaf numJobs + job holds the result of the job,
+  // and the node k, at depth d, combines the results 2k and 2k + 1
+  // of the else and then cofactors on the split variable d;
+  // owners holds the worker whose manager holds each node, or -1
+  std::vector<DdNode *> tree(2 * numJobs, NULL);
+  std::vector<int> owners(2 * numJobs, -1);
+  std::vector<char> isQuantified(numVars);
+  for (int i = 0; i < numVars; ++i)
+    isQuantified[i] = Cudd_bddLeq(manager, cube, splitProjections[i]);
+
+  // solve the jobs in the worker managers
+  // (the workers only read the source manager,
+  // which stays untouched until they are all done),
+  // then combine the subtrees that each worker holds on its own
+  std::vector<DdManager *> workers(numThreads, NULL);
+  if (!failed)
+  {
+    std::vector<int> order(Cudd_ReadSize(manager));
+    for (int level = 0; level < static_cast<int>(order.size()); ++level)
+      order[level] = Cudd_ReadInvPerm(manager, level);
+    std::vector<JobQueue> queues(numThreads);
+    for (int job = 0; job < numJobs; ++job)
+      queues[static_cast<long long>(job) * numThreads / numJobs].jobs.push_back(job);
+    std::atomic<bool> workerFailed(false);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; ++t)
+      threads.emplace_back(runAndAbstractWorker,
+                           manager, std::cref(order), std::cref(jobOperands),
+                           jobCube, cacheSize, t,
+                           std::ref(queues), std::ref(workerFailed),
+                           std::ref(workers[t]),
+                           std::ref(tree), std::ref(owners));
+    for (auto & thread: threads)
+      thread.join();
+    threads.clear();
+
+    // a worker owns the inner nodes whose leaves are all its own
+    for (int k = numJobs - 1; k > 0; --k)
+      if (owners[2 * k] == owners[2 * k + 1])
+        owners[k] = owners[2 * k];
+    for (int t = 0; t < numThreads && !workerFailed; ++t)
+      threads.emplace_back(runCombineWorker,
+                           workers[t], t, std::cref(splitVars), std::cref(isQuantified),
+                           std::cref(owners), std::ref(workerFailed), std::ref(tree));
+    for (auto & thread: threads)
+      thread.join();
+    failed = workerFailed;
+  }
+
+  // move back the roots of the subtrees of the workers
+  std::vector<DdNode *> results(2 * numJobs, NULL);
+  for (int k = 1; k < 2 * numJobs; ++k)
+  {
+    if (NULL == tree[k])
+      continue;
+    DdManager * worker = workers[owners[k]];
+    if (!failed && (1 == k || owners[k / 2] != owners[k]))
+    {
+      results[k] = Cudd_bddTransfer(worker, manager, tree[k]);
+      if (NULL == results[k])
+        failed = true;
+      else
+        Cudd_Ref(results[k]);
+    }
+    Cudd_RecursiveDeref(worker, tree[k]);
+  }
+  for (auto worker: workers)
+  {
+    if (NULL == worker)
+      continue;
+    MultiComputedTable::quit(worker);
+  }
+  for (auto & operands: jobOperands)
+    for (auto g: operands)
+      Cudd_RecursiveDeref(manager, g);
+
+  // combine the rest of the tree, which spans several workers
+  int depth = numVars - 1;
+  for (int k = numJobs - 1; k > 0 && !failed; --k)
+  {
+    if ((1 << depth) > k)
+      --depth;
+    if (-1 != owners[k])
+      continue;
+    DdNode * r = combineCofactors(manager, splitVars[depth], isQuantified[depth],
+                                  results[2 * k + 1], results[2 * k]);
+    if (NULL == r)
+    {
+      failed = true;
+      break;
+    }
+    Cudd_RecursiveDeref(manager, results[2 * k + 1]);
+    Cudd_RecursiveDeref(manager, results[2 * k]);
+    results[2 * k] = results[2 * k + 1] = NULL;
+    results[k] = r;
+  }
+  Cudd_RecursiveDeref(manager, jobCube);
+
+  if (failed)
+  {
+    for (auto r: results)
+      if (NULL != r)
+        Cudd_RecursiveDeref(manager, r);
+    return NULL;
+  }
+  Cudd_Deref(results[1]);
+  return results[1];
+} // end of Cudd_bddAndAbstractMultiParallel
+
+
+
+
+
+/**
+  @brief Returns the exact number of minterms of the conjunction of a
+  set of BDDs over numVars variables, counting the disconnected parts
+  separately.
+
+  @details Partitions f into groups whose supports are disjoint,
+  counts each group over its own support with Cudd_BigCountMintermMulti,
+  and multiplies the counts, along with a factor of two for each of the
+  numVars variables outside every support. With numThreads other than
+  one, the groups are counted by that many worker threads, each with a
+  DdManager of its own (zero for all the hardware threads). The counts
+  of the groups are kept in MultiComputedTable::sharedCounts, and their
+  supports and node counts in MultiComputedTable::sharedShapes, keyed on
+  the nodes of manager, so that repeated groups, across threads and
+  across calls, are only measured and counted once. The groups with the
+  most nodes are counted first.
+
+  @return the minterm count. Throws std::runtime_error if the supports
+  hold more than numVars variables, or a worker fails.
+
+  @sideeffect None
+
+  @see Cudd_BigCountMintermMulti bddPartition
+
+*/
+BigCount Cudd_BigCountMintermMultiPartitioned(
+    DdManager * manager,
+    ConstSpan<DdNode *> f,
+    int numVars,
+    int cacheSize,
+    int numThreads)
+{
+  // the table registers the hooks that purge the shared counts of manager
+  MultiComputedTable::forManager(manager, cacheSize);
+  // duplicates would be counted twice
+  std::vector<DdNode *> unique(f.cbegin(), f.cend());
+  std::sort(unique.begin(), unique.end());
+  unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+  auto partitions = bddPartition(manager, unique);
+  int const numJobs = static_cast<int>(partitions.size());
+  std::vector<MultiComputedTable::Shape> shapes(numJobs);
+  int numFreeVars = numVars;
+  for (int job = 0; job < numJobs; ++job)
+  {
+    std::sort(partitions[job].begin(), partitions[job].end());
+    shapes[job] = sharedShape(manager, partitions[job]);
+    numFreeVars -= static_cast<int>(shapes[job].support.size());
+  }
+  if (numFreeVars < 0)
+    throw std::runtime_error("Cudd_BigCountMintermMultiPartitioned: the functions depend on more than numVars variables");
+
+  // the largest partitions first, so that no worker starts one late
+  std::vector<int> byNodes(numJobs);
+  for (int job = 0; job < numJobs; ++job)
+    byNodes[job] = job;
+  std::stable_sort(byNodes.begin(), byNodes.end(),
+                   [&shapes](int a, int b) { return shapes[a].numNodes > shapes[b].numNodes; });
+  std::vector<std::vector<DdNode *> > sorted(numJobs);
+  std::vector<int> supportSizes(numJobs);
+  for (int job = 0; job < numJobs; ++job)
+  {
+    sorted[job] = std::move(partitions[byNodes[job]]);
+    supportSizes[job] = static_cast<int>(shapes[byNodes[job]].support.size());
+  }
+  partitions.swap(sorted);
+
+  std::vector<BigCount> counts(numJobs);
+  if (numThreads <= 0)
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  numThreads = std::min(numThreads, numJobs);
+  if (numThreads <= 1)
+  {
+    for (int job = 0; job < numJobs; ++job)
+    {
+      if (lookupSharedCount(manager, partitions[job], supportSizes[job], counts[job]))
+        continue;
+      counts[job] = Cudd_BigCountMintermMulti(manager, partitions[job], supportSizes[job], cacheSize);
+      insertSharedCount(manager, partitions[job], supportSizes[job], counts[job]);
+    }
+  }
+  else
+  {
+    std::vector<int> order(Cudd_ReadSize(manager));
+    for (int level = 0; level < static_cast<int>(order.size()); ++level)
+      order[level] = Cudd_ReadInvPerm(manager, level);
+    std::atomic<int> nextJob(0);
+    std::atomic<bool> failed(false);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; ++t)
+      threads.emplace_back(runCountWorker,
+                           manager, std::cref(order), std::cref(partitions),
+                           std::cref(supportSizes), cacheSize,
+                           std::ref(nextJob), std::ref(failed), std::ref(counts));
+    for (auto & thread: threads)
+      thread.join();
+    if (failed)
+      throw std::runtime_error("Cudd_BigCountMintermMultiPartitioned: a counting worker failed");
+  }
+
+  // the product, largest counts last
+  BigCount result = BigCount::powerOfTwo(numFreeVars);
+  std::sort(counts.begin(), counts.end(),
+            [](BigCount const & a, BigCount const & b) { return a.numBits() < b.numBits(); });
+  for (auto const & count: counts)
+    result *= count;
+  return result;
+} // end of Cudd_BigCountMintermMultiPartitioned
+
+
+
+
+
+/**
+  @brief The overloads of the parallel multi-operand functions on sets
+  of BDDs.
+
+  @details Forward the operands as a span.
+
+  @sideeffect None
+
+*/
+DdNode * Cudd_bddAndAbstractMultiParallel(
+    DdManager * manager,
+    std::set<DdNode *> const & f,
+    DdNode * cube,
+    int cacheSize,
+    int numSplitVars,
+    int numThreads)
+{
+  std::vector<DdNode *> operands(f.cbegin(), f.cend());
+  return Cudd_bddAndAbstractMultiParallel(manager, ConstSpan<DdNode *>(operands), cube,
+                                          cacheSize, numSplitVars, numThreads);
+}
+
+BigCount Cudd_BigCountMintermMultiPartitioned(
+    DdManager * manager,
+    std::set<DdNode *> const & f,
+    int numVars,
+    int cacheSize,
+    int numThreads)
+{
+  std::vector<DdNode *> operands(f.cbegin(), f.cend());
+  return Cudd_BigCountMintermMultiPartitioned(manager, ConstSpan<DdNode *>(operands), numVars,
+                                              cacheSize, numThreads);
+}
+
+
+
+
+
+// *****************************************
+// *** Internal api function definitions ***
+// *****************************************
+
+
+
+// ***** Function *****
+// walk the support cube, which is sorted by level
+std::vector<int> chooseSplitVars(
+    DdManager * manager,
+    ConstSpan<DdNode *> f,
+    int numSplitVars)
+{
+  std::vector<int> result;
+  if (numSplitVars <= 0 || f.empty())
+    return result;
+  DdNode * support = Cudd_VectorSupport(manager, const_cast<DdNode **>(f.begin()), static_cast<int>(f.size()));
+  if (NULL == support)
+    return result;
+  Cudd_Ref(support);
+  for (DdNode * s = support;
+       !Cudd_IsConstant(s) && static_cast<int>(result.size()) < numSplitVars;
+       s = Cudd_T(s))
+    result.push_back(Cudd_NodeReadIndex(s));
+  Cudd_RecursiveDeref(manager, support);
+  return result;
+}
+
+
+
+// ***** Function *****
+// the owner steals from itself last
+int takeJob(
+    std::vector<JobQueue> & queues,
+    int self)
+{
+  int const numQueues = static_cast<int>(queues.size());
+  for (int i = 0; i < numQueues; ++i)
+  {
+    JobQueue & queue = queues[(self + i) % numQueues];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty())
+      continue;
+    int job;
+    if (0 == i)
+    {
+      job = queue.jobs.front();
+      queue.jobs.pop_front();
+    }
+    else
+    {
+      job = queue.jobs.back();
+      queue.jobs.pop_back();
+    }
+    return job;
+  }
+  return -1;
+}
+
+
+
+// ***** Function *****
+DdNode * combineCofactors(
+    DdManager * manager,
+    int index,
+    bool isQuantified,
+    DdNode * t,
+    DdNode * e)
+{
+  DdNode * r = isQuantified
+             ? Cudd_bddOr(manager, t, e)
+             : Cudd_bddIte(manager, Cudd_bddIthVar(manager, index), t, e);
+  if (NULL != r)
+    Cudd_Ref(r);
+  return r;
+}
+
+
+
+// ***** Function *****
+// one manager per worker, reused across its jobs
+void runAndAbstractWorker(
+    DdManager * source,
+    std::vector<int> const & order,
+    std::vector<std::vector<DdNode *> > const & jobOperands,
+    DdNode * cube,
+    int cacheSize,
+    int self,
+    std::vector<JobQueue> & queues,
+    std::atomic<bool> & failed,
+    DdManager * & worker,
+    std::vector<DdNode *> & tree,
+    std::vector<int> & owners)
+{
+  try {
+    worker = Cudd_Init(static_cast<unsigned int>(order.size()), 0, CUDD_UNIQUE_SLOTS, CUDD_CACHE_SLOTS, 0);
+    if (NULL == worker
+        || (!order.empty() && !Cudd_ShuffleHeap(worker, const_cast<int *>(&order.front()))))
+    {
+      failed = true;
+      return;
+    }
+    DdNode * workerCube = Cudd_bddTransfer(source, worker, cube);
+    if (NULL == workerCube)
+    {
+      failed = true;
+      return;
+    }
+    Cudd_Ref(workerCube);
+
+    int const numJobs = static_cast<int>(jobOperands.size());
+    for (int job = takeJob(queues, self); job >= 0 && !failed; job = takeJob(queues, self))
+    {
+      std::set<DdNode *> operands;
+      bool transferred = true;
+      for (auto g: jobOperands[job])
+      {
+        DdNode * h = Cudd_bddTransfer(source, worker, g);
+        if (NULL == h)
+        {
+          transferred = false;
+          break;
+        }
+        Cudd_Ref(h);
+        if (!operands.insert(h).second)
+          Cudd_RecursiveDeref(worker, h);
+      }
+      DdNode * r = transferred ? Cudd_bddAndAbstractMulti(worker, operands, workerCube, cacheSize) : NULL;
+      if (NULL != r)
+        Cudd_Ref(r);
+      for (auto h: operands)
+        Cudd_RecursiveDeref(worker, h);
+      if (NULL == r)
+      {
+        failed = true;
+        break;
+      }
+      tree[numJobs + job] = r;
+      owners[numJobs + job] = self;
+    }
+    Cudd_RecursiveDeref(worker, workerCube);
+  }
+  catch (std::exception const &)
+  {
+    failed = true;
+  }
+}
+
+
+
+// ***** Function *****
+// children come before their parents, going down the indices,
+// and the children of a node of the worker are its own too
+void runCombineWorker(
+    DdManager * worker,
+    int self,
+    std::vector<int> const & splitVars,
+    std::vector<char> const & isQuantified,
+    std::vector<int> const & owners,
+    std::atomic<bool> & failed,
+    std::vector<DdNode *> & tree)
+{
+  int const numJobs = static_cast<int>(tree.size() / 2);
+  int depth = static_cast<int>(splitVars.size()) - 1;
+  for (int k = numJobs - 1; k > 0 && !failed; --k)
+  {
+    if ((1 << depth) > k)
+      --depth;
+    if (self != owners[k])
+      continue;
+    DdNode * r = combineCofactors(worker, splitVars[depth], isQuantified[depth],
+                                  tree[2 * k + 1], tree[2 * k]);
+    if (NULL == r)
+    {
+      failed = true;
+      return;
+    }
+    Cudd_RecursiveDeref(worker, tree[2 * k + 1]);
+    Cudd_RecursiveDeref(worker, tree[2 * k]);
+    tree[2 * k] = tree[2 * k + 1] = NULL;
+    tree[k] = r;
+  }
+}
+
+
+
+// ***** Function *****
+// the parameter is the number of variables, as in the MultiComputedTable
+bool lookupSharedCount(
+    DdManager * source,
+    std::vector<DdNode *> const & partition,
+    int supportSize,
+    BigCount & count)
+{
+  parakram::DdCacheProbe probe{source, MultiComputedTable::ExactCountMinterm, supportSize, partition};
+  auto cached = MultiComputedTable::sharedCounts().tryGet(probe);
+  if (!cached.isPresent())
+    return false;
+  count = cached.get();
+  return true;
+}
+
+void insertSharedCount(
+    DdManager * source,
+    std::vector<DdNode *> const & partition,
+    int supportSize,
+    BigCount const & count)
+{
+  parakram::DdCacheKey key{source, MultiComputedTable::ExactCountMinterm, supportSize, partition};
+  MultiComputedTable::sharedCounts().insert(key, count);
+}
+
+
+
+// ***** Function *****
+MultiComputedTable::Shape sharedShape(
+    DdManager * source,
+    std::vector<DdNode *> const & partition)
+{
+  parakram::DdCacheProbe probe{source, MultiComputedTable::OperandShape, 0, partition};
+  auto cached = MultiComputedTable::sharedShapes().tryGet(probe);
+  if (cached.isPresent())
+    return cached.get();
+  DdNode ** nodes = const_cast<DdNode **>(&partition.front());
+  int const n = static_cast<int>(partition.size());
+  int * indices = NULL;
+  int const supportSize = Cudd_VectorSupportIndices(source, nodes, n, &indices);
+  if (supportSize < 0)
+    throw std::runtime_error("Cudd_VectorSupportIndices failed");
+  MultiComputedTable::Shape shape;
+  shape.support.assign(indices, indices + supportSize);
+  FREE(indices);
+  std::sort(shape.support.begin(), shape.support.end());
+  shape.numNodes = Cudd_SharingSize(nodes, n);
+  parakram::DdCacheKey key{source, MultiComputedTable::OperandShape, 0, partition};
+  MultiComputedTable::sharedShapes().insert(key, shape);
+  return shape;
+}
+
+
+
+// ***** Function *****
+// one manager per worker, reused across its partitions
+void runCountWorker(
+    DdManager * source,
+    std::vector<int> const & order,
+    std::vector<std::vector<DdNode *> > const & partitions,
+    std::vector<int> const & supportSizes,
+    int cacheSize,
+    std::atomic<int> & nextJob,
+    std::atomic<bool> & failed,
+    std::vector<BigCount> & counts)
+{
+  DdManager * worker = NULL;
+  try {
+    worker = Cudd_Init(static_cast<unsigned int>(order.size()), 0, CUDD_UNIQUE_SLOTS, CUDD_CACHE_SLOTS, 0);
+    if (NULL == worker
+        || (!order.empty() && !Cudd_ShuffleHeap(worker, const_cast<int *>(&order.front()))))
+      failed = true;
+    int const numJobs = static_cast<int>(partitions.size());
+    for (int job = nextJob++; job < numJobs && !failed; job = nextJob++)
+    {
+      if (lookupSharedCount(source, partitions[job], supportSizes[job], counts[job]))
+        continue;
+      std::set<DdNode *> operands;
+      for (auto g: partitions[job])
+      {
+        DdNode * h = Cudd_bddTransfer(source, worker, g);
+        if (NULL == h)
+        {
+          failed = true;
+          break;
+        }
+        Cudd_Ref(h);
+        if (!operands.insert(h).second)
+          Cudd_RecursiveDeref(worker, h);
+      }
+      if (!failed)
+      {
+        counts[job] = Cudd_BigCountMintermMulti(worker, operands, supportSizes[job], cacheSize);
+        insertSharedCount(source, partitions[job], supportSizes[job], counts[job]);
+      }
+      for (auto h: operands)
+        Cudd_RecursiveDeref(worker, h);
+    }
+  }
+  catch (std::exception const &)
+  {
+    failed = true;
+  }
+  if (NULL != worker)
+  {
+    MultiComputedTable::quit(worker);
+  }
+}
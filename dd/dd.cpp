@@ -27,6 +27,7 @@ SOFTWARE.
 #include "dd.h"
 #include "bnet.h"
 #include "cuddAndAbsMulti.h"
+#include "multi_computed_table.h"
 #include <stdlib.h>
 #include <sstream>
 #include <stdexcept>
@@ -76,6 +77,30 @@ bdd_ptr bdd_cofactor(DdManager * dd, bdd_ptr f, bdd_ptr g)
   return((bdd_ptr)result);
 } /* end of bdd_cofactor */
 
+/**Function********************************************************************
+
+  Synopsis    [Minimizes f against the care set c.]
+
+  Description [Returns a bdd that agrees with f wherever c holds,
+  chosen by Cudd_bddRestrict to be small, and never larger than f.
+  Unlike bdd_cofactor, the result depends only on the variables of f.
+  A failure is generated if the result is NULL.]
+
+  SideEffects []
+
+  SeeAlso     [bdd_cofactor]
+
+******************************************************************************/
+bdd_ptr bdd_minimize(DdManager * dd, bdd_ptr f, bdd_ptr c)
+{
+  DdNode *result;
+
+  result = Cudd_bddRestrict(dd, (DdNode *)f, (DdNode *)c);
+  common_error(result, "bdd_minimize: result = NULL");
+  Cudd_Ref(result);
+  return((bdd_ptr)result);
+} /* end of bdd_minimize */
+
 /**Function********************************************************************
 
   Synopsis    [Finds the variables on which a set of BDDs depends.]
@@ -647,6 +672,80 @@ bdd_ptr  bdd_and_exists_multi(DdManager *dd,
 
 
 
+/**Function*******************************************************************
+ *
+  @brief Takes the AND of multiple BDDs and simultaneously abstracts
+  the variables in cube, using num_threads threads.
+
+  @details Splits on the top num_split_vars variables into
+  2^num_split_vars cofactor jobs, each solved in a DdManager of its own.
+  A num_threads of zero uses all the hardware threads.
+
+  @return a pointer to the result is successful; NULL otherwise.
+
+  @sideeffect None
+
+  @see Cudd_bddAndAbstractMultiParallel
+
+*****************************************************************************/
+bdd_ptr  bdd_and_exists_multi_parallel(DdManager *dd,
+                                       bdd_ptr_set const & funcs,
+                                       bdd_ptr var_cube,
+                                       int cacheSize,
+                                       int num_split_vars,
+                                       int num_threads)
+{
+  DdNode * result = Cudd_bddAndAbstractMultiParallel(dd, funcs, var_cube, cacheSize,
+                                                     num_split_vars, num_threads);
+  common_error(result, "bdd_and_exists_multi_parallel: result = NULL");
+  Cudd_Ref(result);
+  return result;
+}
+
+
+
+
+
+/**Function*******************************************************************
+ *
+  @brief Takes the AND of multiple BDDs and simultaneously abstracts
+  the variables in cube, approximating once a budget is exceeded.
+
+  @details Computes the exact result while the manager holds at most
+  max_live_nodes live nodes and time_limit milliseconds have not
+  elapsed, and clips the remaining sub-problems at depth clip_depth in
+  the given direction after that. A non-positive limit means no limit.
+
+  @return a pointer to the result is successful; NULL otherwise. If
+  exact_part is not NULL, it receives the part of the result that is
+  known to be exact, which the caller must free.
+
+  @sideeffect None
+
+  @see Cudd_bddAndAbstractMultiBudgeted
+
+*****************************************************************************/
+bdd_ptr  bdd_and_exists_multi_budgeted(DdManager *dd,
+                                       bdd_ptr_set const & funcs,
+                                       bdd_ptr var_cube,
+                                       int direction,
+                                       int max_live_nodes,
+                                       long time_limit,
+                                       int clip_depth,
+                                       int cacheSize,
+                                       bdd_ptr * exact_part)
+{
+  DdNode * result = Cudd_bddAndAbstractMultiBudgeted(dd, funcs, var_cube, direction,
+                                                     max_live_nodes, time_limit, clip_depth,
+                                                     cacheSize, exact_part);
+  common_error(result, "bdd_and_exists_multi_budgeted: result = NULL");
+  Cudd_Ref(result);
+  return result;
+}
+
+
+
+
 
 /**Function********************************************************************
 
@@ -665,12 +764,14 @@ bdd_ptr bdd_clipping_and_multi(
     DdManager * dd,
     bdd_ptr_set const & funcs,
     int max_depth,
-    int direction)
+    int direction,
+    int cacheSize)
 {
   DdNode * result = Cudd_bddClippingAndMulti(
       dd, funcs,
       max_depth,
-      direction);
+      direction,
+      cacheSize);
   common_error(result, "bdd_clipping_and__multi: result = NULL");
   Cudd_Ref(result);
   return result;
@@ -699,11 +800,12 @@ bdd_ptr bdd_clipping_and_exists_multi(
     bdd_ptr_set const & funcs, 
     bdd_ptr var_cube,
     int max_depth,
-    int direction)
+    int direction,
+    int cacheSize)
 {
   DdNode * result = Cudd_bddClippingAndAbstractMulti(
       dd, funcs, var_cube,
-      max_depth, direction);
+      max_depth, direction, cacheSize);
   common_error(result, "bdd_clipping_and_exists_multi: result = NULL");
   Cudd_Ref(result);
   return result;
@@ -712,6 +814,48 @@ bdd_ptr bdd_clipping_and_exists_multi(
 
 
 
+
+/**Function********************************************************************
+
+  @brief Approximates the AND of a set of BDDs and simultaneously abstracts the
+  variables in cube, raising the clipping depth by depth_step until a
+  round clips nothing, the result exceeds max_nodes nodes, or time_limit
+  milliseconds have elapsed.
+
+  @details Returns the tightest approximation reached. A non-positive
+  max_nodes or time_limit means no such limit. If reached_depth is not
+  NULL, the depth of the last completed round is stored in it.
+
+  @return a pointer to the result is successful; NULL otherwise.
+
+  @sideeffect None
+
+  @see Cudd_bddClippingAndAbstractMultiDeepening
+
+******************************************************************************/
+bdd_ptr bdd_clipping_and_exists_multi_deepening(
+    DdManager *dd,
+    bdd_ptr_set const & funcs,
+    bdd_ptr var_cube,
+    int direction,
+    int depth_step,
+    int max_nodes,
+    long time_limit,
+    int cacheSize,
+    int * reached_depth)
+{
+  DdNode * result = Cudd_bddClippingAndAbstractMultiDeepening(
+      dd, funcs, var_cube, direction,
+      depth_step, max_nodes, time_limit,
+      cacheSize, reached_depth);
+  common_error(result, "bdd_clipping_and_exists_multi_deepening: result = NULL");
+  Cudd_Ref(result);
+  return result;
+}
+
+
+
+
 /**Function********************************************************************
   @brief Swaps two sets of variables of the same size (x and y) in
   the %BDD f.
@@ -837,3 +981,175 @@ long double bdd_count_minterm_multi(DdManager * dd,
     return Cudd_LdblCountMintermMulti(dd, funcs, numVars, cacheSize);
 }
 
+
+
+/**
+  @brief Returns the exact number of minterms of the conjunction of a
+  set of BDDs over numVars variables.
+
+  @details Counts in arbitrary precision, so there is no limit on the
+  number of variables.
+
+  @see Cudd_BigCountMintermMulti
+*/
+parakram::BigCount bdd_count_minterm_multi_exact(DdManager * dd,
+                                                 const bdd_ptr_set & funcs,
+                                                 int numVars,
+                                                 int cacheSize)
+{
+  return Cudd_BigCountMintermMulti(dd, funcs, numVars, cacheSize);
+}
+
+
+
+/**
+  @brief Returns the exact number of minterms of the conjunction of a
+  set of BDDs over numVars variables, counting each group of
+  functions with disjoint supports separately.
+
+  @details The groups are counted by num_threads threads
+  (zero for all the hardware threads).
+
+  @see Cudd_BigCountMintermMultiPartitioned
+*/
+parakram::BigCount bdd_count_minterm_multi_partitioned(DdManager * dd,
+                                                       const bdd_ptr_set & funcs,
+                                                       int numVars,
+                                                       int cacheSize,
+                                                       int num_threads)
+{
+  return Cudd_BigCountMintermMultiPartitioned(dd, funcs, numVars, cacheSize, num_threads);
+}
+
+
+
+
+/**
+  @brief The multi-operand functions above, on contiguous ranges of
+  functions.
+
+  @details The functions may be in any order and hold duplicates, which
+  are sorted and removed internally in a buffer that is reused across
+  calls, so callers holding a std::vector<bdd_ptr> need not build a
+  bdd_ptr_set first.
+
+  @see Cudd_bddAndMulti Cudd_bddAndAbstractMulti
+*/
+bdd_ptr bdd_and_multi(DdManager * dd, bdd_ptr_span funcs, int cacheSize)
+{
+  DdNode * result = Cudd_bddAndMulti(dd, funcs, cacheSize);
+  common_error(result, "bdd_and_multi: result = NULL");
+  Cudd_Ref(result);
+  return result;
+}
+
+bdd_ptr bdd_and_exists_multi(DdManager * dd, bdd_ptr_span funcs, bdd_ptr var_cube, int cacheSize)
+{
+  DdNode * result = Cudd_bddAndAbstractMulti(dd, funcs, var_cube, cacheSize);
+  common_error(result, "bdd_and_exists_multi: result = NULL");
+  Cudd_Ref(result);
+  return result;
+}
+
+bdd_ptr bdd_and_exists_multi_parallel(DdManager * dd,
+                                      bdd_ptr_span funcs,
+                                      bdd_ptr var_cube,
+                                      int cacheSize,
+                                      int num_split_vars,
+                                      int num_threads)
+{
+  DdNode * result = Cudd_bddAndAbstractMultiParallel(dd, funcs, var_cube, cacheSize,
+                                                     num_split_vars, num_threads);
+  common_error(result, "bdd_and_exists_multi_parallel: result = NULL");
+  Cudd_Ref(result);
+  return result;
+}
+
+bdd_ptr bdd_and_exists_multi_budgeted(DdManager * dd,
+                                      bdd_ptr_span funcs,
+                                      bdd_ptr var_cube,
+                                      int direction,
+                                      int max_live_nodes,
+                                      long time_limit,
+                                      int clip_depth,
+                                      int cacheSize,
+                                      bdd_ptr * exact_part)
+{
+  DdNode * result = Cudd_bddAndAbstractMultiBudgeted(dd, funcs, var_cube, direction,
+                                                     max_live_nodes, time_limit, clip_depth,
+                                                     cacheSize, exact_part);
+  common_error(result, "bdd_and_exists_multi_budgeted: result = NULL");
+  Cudd_Ref(result);
+  return result;
+}
+
+bdd_ptr bdd_clipping_and_multi(DdManager * dd, bdd_ptr_span funcs, int max_depth, int direction, int cacheSize)
+{
+  DdNode * result = Cudd_bddClippingAndMulti(dd, funcs, max_depth, direction, cacheSize);
+  common_error(result, "bdd_clipping_and_multi: result = NULL");
+  Cudd_Ref(result);
+  return result;
+}
+
+bdd_ptr bdd_clipping_and_exists_multi(DdManager * dd,
+                                      bdd_ptr_span funcs,
+                                      bdd_ptr var_cube,
+                                      int max_depth,
+                                      int direction,
+                                      int cacheSize)
+{
+  DdNode * result = Cudd_bddClippingAndAbstractMulti(dd, funcs, var_cube, max_depth, direction, cacheSize);
+  common_error(result, "bdd_clipping_and_exists_multi: result = NULL");
+  Cudd_Ref(result);
+  return result;
+}
+
+bdd_ptr bdd_clipping_and_exists_multi_deepening(DdManager * dd,
+                                                bdd_ptr_span funcs,
+                                                bdd_ptr var_cube,
+                                                int direction,
+                                                int depth_step,
+                                                int max_nodes,
+                                                long time_limit,
+                                                int cacheSize,
+                                                int * reached_depth)
+{
+  DdNode * result = Cudd_bddClippingAndAbstractMultiDeepening(dd, funcs, var_cube, direction,
+                                                              depth_step, max_nodes, time_limit,
+                                                              cacheSize, reached_depth);
+  common_error(result, "bdd_clipping_and_exists_multi_deepening: result = NULL");
+  Cudd_Ref(result);
+  return result;
+}
+
+long double bdd_count_minterm_multi(DdManager * dd, bdd_ptr_span funcs, int numVars, int cacheSize)
+{
+  const int Cudd_Counting_Limit = sizeof(long double) == sizeof(double) ? 1023 : 16383;
+  if (numVars >= Cudd_Counting_Limit)
+  {
+    std::stringstream ss;
+    ss << "Cannot count solutions because number of variables (" << numVars
+      << ") is greater than the allwed limit (" << Cudd_Counting_Limit << ")";
+    throw std::runtime_error(ss.str());
+  }
+  return Cudd_LdblCountMintermMulti(dd, funcs, numVars, cacheSize);
+}
+
+parakram::BigCount bdd_count_minterm_multi_exact(DdManager * dd, bdd_ptr_span funcs, int numVars, int cacheSize)
+{
+  return Cudd_BigCountMintermMulti(dd, funcs, numVars, cacheSize);
+}
+
+parakram::BigCount bdd_count_minterm_multi_partitioned(DdManager * dd,
+                                                       bdd_ptr_span funcs,
+                                                       int numVars,
+                                                       int cacheSize,
+                                                       int num_threads)
+{
+  return Cudd_BigCountMintermMultiPartitioned(dd, funcs, numVars, cacheSize, num_threads);
+}
+
+void bdd_quit(DdManager * dd)
+{
+  parakram::MultiComputedTable::quit(dd);
+}
@@ -29,10 +29,14 @@ SOFTWARE.
 #include <stdio.h>
 #include <cudd.h>
 #include <set>
+#include "big_count.h"
+#include "const_span.h"
+#include <vector>
 
 typedef struct DdNode * add_ptr;
 typedef struct DdNode * bdd_ptr;
 typedef std::set<bdd_ptr> bdd_ptr_set;
+typedef parakram::ConstSpan<bdd_ptr> bdd_ptr_span;
 
 
 namespace dd_constants
@@ -60,6 +64,7 @@ bdd_ptr  bdd_support (DdManager *, bdd_ptr);
 bdd_ptr  bdd_new_var_with_index (DdManager *, int);
 bdd_ptr  bdd_vector_support (DdManager *, bdd_ptr*, int);
 bdd_ptr  bdd_cofactor (DdManager *, bdd_ptr, bdd_ptr);
+bdd_ptr  bdd_minimize (DdManager *, bdd_ptr, bdd_ptr);
 void     bdd_and_accumulate (DdManager *, bdd_ptr *, bdd_ptr);
 int      bdd_get_lowest_index (DdManager *, bdd_ptr);
 void     bdd_free (DdManager *, bdd_ptr);
@@ -73,9 +78,45 @@ bdd_ptr  bdd_xnor(DdManager *dd, bdd_ptr f1, bdd_ptr f2);
 bdd_ptr  bdd_and_multi(DdManager *dd, bdd_ptr_set const & funcs, int cacheSize);
 bdd_ptr  bdd_and_exists_multi(DdManager *dd, bdd_ptr_set const & funcs, bdd_ptr var_cube, 
                               int cacheSize);
-bdd_ptr  bdd_clipping_and_multi(DdManager *dd, bdd_ptr_set const & funcs, int max_depth, int direction);
-bdd_ptr  bdd_clipping_and_exists_multi(DdManager *d, bdd_ptr_set const & funcs, bdd_ptr var_cube, int max_depth, int direction);
+bdd_ptr  bdd_and_exists_multi_parallel(DdManager *dd, bdd_ptr_set const & funcs, bdd_ptr var_cube,
+                                       int cacheSize, int num_split_vars, int num_threads);
+bdd_ptr  bdd_and_exists_multi_budgeted(DdManager *dd, bdd_ptr_set const & funcs, bdd_ptr var_cube,
+                                       int direction, int max_live_nodes, long time_limit, int clip_depth,
+                                       int cacheSize, bdd_ptr * exact_part);
+bdd_ptr  bdd_clipping_and_multi(DdManager *dd, bdd_ptr_set const & funcs, int max_depth, int direction, int cacheSize);
+bdd_ptr  bdd_clipping_and_exists_multi(DdManager *d, bdd_ptr_set const & funcs, bdd_ptr var_cube, int max_depth, int direction,
+                                       int cacheSize);
+bdd_ptr  bdd_clipping_and_exists_multi_deepening(DdManager *d, bdd_ptr_set const & funcs, bdd_ptr var_cube, int direction,
+                                                 int depth_step, int max_nodes, long time_limit, int cacheSize,
+                                                 int * reached_depth);
 bdd_ptr  bdd_substitute_vars(DdManager *d, bdd_ptr f, bdd_ptr* x, bdd_ptr* y, int n);
 bdd_ptr  bdd_assign(DdManager *d, bdd_ptr func, int varIndex, bdd_ptr varValue);
 long double bdd_count_minterm(DdManager * dd, bdd_ptr f, int numVars);
 long double bdd_count_minterm_multi(DdManager * dd, const bdd_ptr_set & fset, int numVars, int cacheSize);
+parakram::BigCount bdd_count_minterm_multi_exact(DdManager * dd, const bdd_ptr_set & fset, int numVars, int cacheSize);
+parakram::BigCount bdd_count_minterm_multi_partitioned(DdManager * dd, const bdd_ptr_set & fset, int numVars,
+                                                       int cacheSize, int num_threads);
+
+// the multi-operand functions on contiguous ranges (e.g. a std::vector<bdd_ptr>),
+// which may be unsorted and hold duplicates, saving the construction of a bdd_ptr_set
+bdd_ptr  bdd_and_multi(DdManager *dd, bdd_ptr_span funcs, int cacheSize);
+bdd_ptr  bdd_and_exists_multi(DdManager *dd, bdd_ptr_span funcs, bdd_ptr var_cube, int cacheSize);
+bdd_ptr  bdd_and_exists_multi_parallel(DdManager *dd, bdd_ptr_span funcs, bdd_ptr var_cube,
+                                       int cacheSize, int num_split_vars, int num_threads);
+bdd_ptr  bdd_and_exists_multi_budgeted(DdManager *dd, bdd_ptr_span funcs, bdd_ptr var_cube,
+                                       int direction, int max_live_nodes, long time_limit, int clip_depth,
+                                       int cacheSize, bdd_ptr * exact_part);
+bdd_ptr  bdd_clipping_and_multi(DdManager *dd, bdd_ptr_span funcs, int max_depth, int direction, int cacheSize);
+bdd_ptr  bdd_clipping_and_exists_multi(DdManager *d, bdd_ptr_span funcs, bdd_ptr var_cube, int max_depth, int direction,
+                                       int cacheSize);
+bdd_ptr  bdd_clipping_and_exists_multi_deepening(DdManager *d, bdd_ptr_span funcs, bdd_ptr var_cube, int direction,
+                                                 int depth_step, int max_nodes, long time_limit, int cacheSize,
+                                                 int * reached_depth);
+long double bdd_count_minterm_multi(DdManager * dd, bdd_ptr_span fset, int numVars, int cacheSize);
+parakram::BigCount bdd_count_minterm_multi_exact(DdManager * dd, bdd_ptr_span fset, int numVars, int cacheSize);
+parakram::BigCount bdd_count_minterm_multi_partitioned(DdManager * dd, bdd_ptr_span fset, int numVars,
+                                                       int cacheSize, int num_threads);
+
+// destroys a manager with Cudd_Quit, after detaching the computed table
+// of the multi-operand functions, for any manager that may have used them
+void     bdd_quit(DdManager * dd);
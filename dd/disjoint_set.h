@@ -24,7 +24,9 @@ SOFTWARE.
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
+#include <vector>
 
 
 namespace parakram {
@@ -101,5 +103,58 @@ namespace parakram {
   }; // end class DisjointSet
 
 
+
+  // ***** joinGroups *****
+  // Joins the groups of elements 0 ... numElements - 1 that share
+  //   an element, returning the resulting classes, each in increasing
+  //   order, and numbered in order of the first group that meets them.
+  // Elements that are in no group are in no class.
+  // If groupClasses is given, it is filled with the class of each group,
+  //   or -1 for an empty group.
+  inline std::vector<std::vector<int> >
+    joinGroups(int numElements,
+               const std::vector<std::vector<int> > & groups,
+               std::vector<int> * groupClasses = NULL)
+  {
+    // the sets point to one another, so they must not be moved
+    std::vector<DisjointSet<int> > sets;
+    sets.reserve(numElements);
+    for (int i = 0; i < numElements; ++i)
+      sets.emplace_back(i, i);
+    std::vector<char> grouped(numElements, 0);
+    for (const auto & group: groups)
+      for (int i: group)
+      {
+        sets[i].computeUnion(sets[group.front()]);
+        grouped[i] = 1;
+      }
+
+    std::vector<int> classOfRoot(numElements, -1);
+    std::vector<std::vector<int> > classes;
+    if (groupClasses)
+      groupClasses->clear();
+    for (const auto & group: groups)
+    {
+      int c = -1;
+      if (!group.empty())
+      {
+        int root = sets[group.front()].find()->id();
+        if (classOfRoot[root] < 0)
+        {
+          classOfRoot[root] = static_cast<int>(classes.size());
+          classes.emplace_back();
+        }
+        c = classOfRoot[root];
+      }
+      if (groupClasses)
+        groupClasses->push_back(c);
+    }
+    for (int i = 0; i < numElements; ++i)
+      if (grouped[i])
+        classes[classOfRoot[sets[i].find()->id()]].push_back(i);
+    return classes;
+  }
+
+
 } // end namespace parakram
 
@@ -28,101 +28,370 @@ SOFTWARE.
 #pragma once
 
 #include "optional.h"
-#include <unordered_map>
-#include <list>
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
 
 namespace parakram {
 
-  template<typename TKey, typename TValue>
+  // ***** LruRangeHash / LruRangeEqual *****
+  // Transparent hash and equality on ranges (anything with begin and end),
+  //   comparing the elements in order.
+  // With these, an LruCache keyed on, say, std::set<DdNode *>
+  //   can be probed with a ConstSpan<DdNode *> or a std::vector<DdNode *>
+  //   holding the same nodes in the same (sorted) order,
+  //   without building a set.
+  struct LruRangeHash
+  {
+    template<typename TRange>
+    std::size_t operator()(TRange const & range) const
+    {
+      std::size_t h = 0;
+      for (auto const & x: range)
+        h ^= std::hash<typename std::decay<decltype(x)>::type>()(x) + 0x9e3779b9 + (h << 6) + (h >> 2);
+      return h;
+    }
+  };
+
+  struct LruRangeEqual
+  {
+    template<typename TRange1, typename TRange2>
+    bool operator()(TRange1 const & a, TRange2 const & b) const
+    {
+      return std::equal(std::begin(a), std::end(a), std::begin(b), std::end(b));
+    }
+  };
+
+
+  // ***** LruCache *****
+  // ******** class ********
+  // A fixed capacity cache that forgets the least recently used entry.
+  // All the state lives in two flat arrays:
+  //   - the entries, each holding its key (stored once), its value,
+  //     its hash, and intrusive links into the recency list
+  //   - an open-addressing index (linear probing, at most half full)
+  //     from hashes to entries, cleaned up by backward shifting on removal,
+  //     so there are no tombstones
+  // Hence a hit costs one probe sequence plus an O(1) relink,
+  //   and once the cache is full, inserts recycle the evicted entry
+  //   instead of allocating.
+  // Lookups are heterogeneous: any probe that THash and TEqual accept
+  //   can be used in place of a key (see LruRangeHash).
+  // Template arguments:
+  //   TKey, TValue: default constructible and move assignable
+  //   THash: hash on keys (and probes)
+  //   TEqual: equality between a key and a key (or a probe)
+  template<typename TKey, typename TValue, typename THash = std::hash<TKey>, typename TEqual = std::equal_to<> >
   class LruCache
   {
     public:
 
-      LruCache(int capacity);
+      struct Stats
+      {
+        unsigned long long hits;
+        unsigned long long misses;
+        unsigned long long insertions;
+        unsigned long long evictions;
+        double hitRate() const { return hits + misses == 0 ? 0.0 : double(hits) / double(hits + misses); }
+      };
+
+      LruCache(int capacity, THash const & hasher = THash(), TEqual const & equal = TEqual());
+
+      // ***** insert *****
+      // Returns false, changing nothing, if the key is already present.
+      // Otherwise inserts the key as the most recently used entry,
+      //   evicting the least recently used one if the cache is full.
+      bool insert(TKey const & key, TValue const & value);
+      bool insert(TKey && key, TValue && value);
 
-      bool insert(const TKey & key, const TValue & value);
-      Optional<TValue> tryGet(const TKey & key);
+      // ***** tryGet / lookup *****
+      // Find the value of a key, and mark it as the most recently used.
+      // lookup returns NULL on a miss, and otherwise a pointer
+      //   that stays valid until the next insert.
+      template<typename TProbe>
+      Optional<TValue> tryGet(TProbe const & probe);
+      template<typename TProbe>
+      TValue * lookup(TProbe const & probe);
+
+      // ***** eraseIf *****
+      // remove the entries for which pred(key, value) holds,
+      //   returning how many were removed
+      template<typename TPred>
+      int eraseIf(TPred pred);
+
+      void clear();
+      int size() const { return static_cast<int>(m_entries.size()) - m_numFree; }
+      int capacity() const { return m_capacity; }
+      Stats const & stats() const { return m_stats; }
+      void resetStats() { m_stats = Stats(); }
 
     private:
-      typedef unsigned long long KeyId;
-      typedef std::list<KeyId>::const_iterator PriorityQueueIterator;
-      typedef std::unordered_map<TKey, KeyId> KeyStore;
-      typedef typename KeyStore::const_iterator KeyStoreIterator;
-      typedef std::unordered_map<KeyId, KeyStoreIterator> KeyStoreMap;
+
+      struct Entry
+      {
+        TKey key;
+        TValue value;
+        std::size_t hash;
+        int prev; // towards the most recently used
+        int next; // towards the least recently used, or the next free entry
+      };
+
+      template<typename TProbe>
+      std::size_t hashOf(TProbe const & probe) const;
+      template<typename TProbe>
+      int find(TProbe const & probe, std::size_t hash) const;
+      template<typename TKeyArg, typename TValueArg>
+      bool emplace(TKeyArg && key, TValueArg && value);
+
+      void link(int e);
+      void unlink(int e);
+      void addToIndex(int e);
+      void removeFromIndex(int e);
+
       int m_capacity;
-      KeyId m_largestKey;
-      KeyStore m_keyStore;
-      KeyStoreMap m_keyStoreMap;
-      std::unordered_map<KeyId, TValue> m_valueMap;
-      std::list<KeyId> m_priorityQueue;
-      std::unordered_map<KeyId, PriorityQueueIterator> m_priorityMap;
-  };
+      THash m_hasher;
+      TEqual m_equal;
+      std::vector<Entry> m_entries;
+      std::vector<int> m_index; // entry positions, -1 for an empty slot
+      std::size_t m_mask;
+      int m_head; // most recently used, -1 if empty
+      int m_tail; // least recently used, -1 if empty
+      int m_free; // list of removed entries, linked through next
+      int m_numFree;
+      Stats m_stats;
+  }; // end class LruCache
 
 
-  template<typename TKey, typename TValue>
-    LruCache<TKey, TValue>::LruCache(int capacity) :
-      m_capacity(capacity),
-      m_largestKey(0),
-      m_keyStore(),
-      m_keyStoreMap(),
-      m_valueMap(),
-      m_priorityQueue(),
-      m_priorityMap()
-  { }
 
 
-  template<typename TKey, typename TValue>
-    bool LruCache<TKey, TValue>::insert(const TKey & key, const TValue & value)
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  LruCache<TKey, TValue, THash, TEqual>::LruCache(int capacity, THash const & hasher, TEqual const & equal) :
+    m_capacity(capacity),
+    m_hasher(hasher),
+    m_equal(equal),
+    m_entries(),
+    m_index(),
+    m_mask(0),
+    m_head(-1),
+    m_tail(-1),
+    m_free(-1),
+    m_numFree(0),
+    m_stats()
+  {
+    std::size_t indexSize = 2;
+    while (capacity > 0 && indexSize < 2 * static_cast<std::size_t>(capacity))
+      indexSize *= 2;
+    m_index.assign(indexSize, -1);
+    m_mask = indexSize - 1;
+    m_entries.reserve(capacity > 0 ? capacity : 0);
+  }
+
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  template<typename TProbe>
+  std::size_t LruCache<TKey, TValue, THash, TEqual>::hashOf(TProbe const & probe) const
+  {
+    // std::hash is the identity on integers and pointers,
+    //   which clusters badly under linear probing, so mix the bits
+    std::size_t h = m_hasher(probe);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  template<typename TProbe>
+  int LruCache<TKey, TValue, THash, TEqual>::find(TProbe const & probe, std::size_t hash) const
+  {
+    for (std::size_t i = hash & m_mask; ; i = (i + 1) & m_mask)
     {
-      // return false if the key already exists
-      if (m_keyStore.find(key) != m_keyStore.end())
-        return false;
-
-      // get the new key id
-      KeyId keyId = ++m_largestKey;
-      m_keyStore[key] = keyId;
-      m_keyStoreMap[keyId] = m_keyStore.find(key);
-      
-      // insert the value
-      m_valueMap[keyId] = value;
-
-      // push to the top of the priority queue
-      m_priorityQueue.push_front(keyId);
-      m_priorityMap[keyId] = m_priorityQueue.begin();
-
-      // forget least recently used element
-      while (m_keyStore.size() > m_capacity && !m_keyStore.empty())
-      {
-        KeyId lruId = m_priorityQueue.back();
-        m_priorityMap.erase(lruId);
-        m_priorityQueue.pop_back();
-        m_valueMap.erase(lruId);
-        auto ksmit = m_keyStoreMap.find(lruId);
-        auto ksit = ksmit->second;
-        m_keyStoreMap.erase(ksmit);
-        m_keyStore.erase(ksit);
-      }
+      int e = m_index[i];
+      if (e < 0)
+        return -1;
+      if (m_entries[e].hash == hash && m_equal(m_entries[e].key, probe))
+        return e;
+    }
+  }
+
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  bool LruCache<TKey, TValue, THash, TEqual>::insert(TKey const & key, TValue const & value)
+  {
+    return emplace(key, value);
+  }
+
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  bool LruCache<TKey, TValue, THash, TEqual>::insert(TKey && key, TValue && value)
+  {
+    return emplace(std::move(key), std::move(value));
+  }
+
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  template<typename TKeyArg, typename TValueArg>
+  bool LruCache<TKey, TValue, THash, TEqual>::emplace(TKeyArg && key, TValueArg && value)
+  {
+    std::size_t hash = hashOf(key);
+
+    // return false if the key already exists
+    if (find(key, hash) >= 0)
+      return false;
+    ++m_stats.insertions;
+
+    // a cache without capacity forgets everything immediately
+    if (m_capacity <= 0)
+    {
+      ++m_stats.evictions;
       return true;
     }
 
-  template<typename TKey, typename TValue>
-    Optional<TValue> LruCache<TKey, TValue>::tryGet(const TKey & key)
+    // pick the entry to fill: a new one, a freed one, or the evicted one
+    int e;
+    if (m_free >= 0)
+    {
+      e = m_free;
+      m_free = m_entries[e].next;
+      --m_numFree;
+    }
+    else if (static_cast<int>(m_entries.size()) < m_capacity)
+    {
+      e = static_cast<int>(m_entries.size());
+      m_entries.emplace_back();
+    }
+    else
+    {
+      e = m_tail;
+      removeFromIndex(e);
+      unlink(e);
+      ++m_stats.evictions;
+    }
+
+    Entry & entry = m_entries[e];
+    entry.key = std::forward<TKeyArg>(key);
+    entry.value = std::forward<TValueArg>(value);
+    entry.hash = hash;
+    addToIndex(e);
+    link(e);
+    return true;
+  }
+
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  template<typename TProbe>
+  TValue * LruCache<TKey, TValue, THash, TEqual>::lookup(TProbe const & probe)
+  {
+    int e = find(probe, hashOf(probe));
+    if (e < 0)
+    {
+      ++m_stats.misses;
+      return NULL;
+    }
+    ++m_stats.hits;
+    if (e != m_head)
+    {
+      unlink(e);
+      link(e);
+    }
+    return &m_entries[e].value;
+  }
+
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  template<typename TProbe>
+  Optional<TValue> LruCache<TKey, TValue, THash, TEqual>::tryGet(TProbe const & probe)
+  {
+    TValue * value = lookup(probe);
+    if (NULL == value)
+      return Optional<TValue>();
+    return *value;
+  }
+
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  template<typename TPred>
+  int LruCache<TKey, TValue, THash, TEqual>::eraseIf(TPred pred)
+  {
+    int numErased = 0;
+    for (int e = m_head, next; e >= 0; e = next)
     {
-      auto keyIdIter = m_keyStore.find(key);
-      KeyId keyId;
-      if (m_keyStore.end() == keyIdIter)
-        return Optional<TValue>();
-      else
-        keyId = keyIdIter->second;
-
-     auto pqiter = m_priorityMap.find(keyId);
-     m_priorityQueue.erase(pqiter->second);
-     m_priorityQueue.push_front(keyId);
-     pqiter->second = m_priorityQueue.begin();
-
-     return m_valueMap[keyId];
+      next = m_entries[e].next;
+      if (!pred(m_entries[e].key, m_entries[e].value))
+        continue;
+      removeFromIndex(e);
+      unlink(e);
+      m_entries[e].next = m_free;
+      m_free = e;
+      ++m_numFree;
+      ++numErased;
     }
+    return numErased;
+  }
 
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  void LruCache<TKey, TValue, THash, TEqual>::clear()
+  {
+    // keep the entries allocated, to be refilled
+    std::fill(m_index.begin(), m_index.end(), -1);
+    for (int e = 0; e < static_cast<int>(m_entries.size()); ++e)
+      m_entries[e].next = e + 1 < static_cast<int>(m_entries.size()) ? e + 1 : -1;
+    m_free = m_entries.empty() ? -1 : 0;
+    m_numFree = static_cast<int>(m_entries.size());
+    m_head = m_tail = -1;
+  }
+
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  void LruCache<TKey, TValue, THash, TEqual>::link(int e)
+  {
+    m_entries[e].prev = -1;
+    m_entries[e].next = m_head;
+    if (m_head >= 0)
+      m_entries[m_head].prev = e;
+    else
+      m_tail = e;
+    m_head = e;
+  }
+
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  void LruCache<TKey, TValue, THash, TEqual>::unlink(int e)
+  {
+    Entry & entry = m_entries[e];
+    if (entry.prev >= 0)
+      m_entries[entry.prev].next = entry.next;
+    else
+      m_head = entry.next;
+    if (entry.next >= 0)
+      m_entries[entry.next].prev = entry.prev;
+    else
+      m_tail = entry.prev;
+  }
 
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  void LruCache<TKey, TValue, THash, TEqual>::addToIndex(int e)
+  {
+    std::size_t i = m_entries[e].hash & m_mask;
+    while (m_index[i] >= 0)
+      i = (i + 1) & m_mask;
+    m_index[i] = e;
+  }
+
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  void LruCache<TKey, TValue, THash, TEqual>::removeFromIndex(int e)
+  {
+    std::size_t i = m_entries[e].hash & m_mask;
+    while (m_index[i] != e)
+      i = (i + 1) & m_mask;
+
+    // shift back the later members of the probe run
+    //   that would become unreachable through the hole at i
+    for (std::size_t j = (i + 1) & m_mask; m_index[j] >= 0; j = (j + 1) & m_mask)
+    {
+      std::size_t home = m_entries[m_index[j]].hash & m_mask;
+      bool reachable = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+      if (!reachable)
+      {
+        m_index[i] = m_index[j];
+        i = j;
+      }
+    }
+    m_index[i] = -1;
+  }
 
 } // end namespace parakram
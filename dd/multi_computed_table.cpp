@@ -0,0 +1,248 @@
+/*
+
+Copyright 2021 Parakram Majumdar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#include "multi_computed_table.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+
+namespace {
+
+  using parakram::MultiComputedTable;
+
+  std::shared_mutex s_registryMutex;
+  std::map<DdManager *, std::unique_ptr<MultiComputedTable> > s_registry;
+
+  MultiComputedTable * findTable(DdManager * manager)
+  {
+    std::shared_lock<std::shared_mutex> lock(s_registryMutex);
+    auto it = s_registry.find(manager);
+    return it == s_registry.end() ? NULL : it->second.get();
+  }
+
+  // ***** Function *****
+  // drop the entries of a manager from a shared tier,
+  //   or only those with a dead operand
+  template<typename TValue>
+  void eraseShared(parakram::DdShardedCache<TValue> & cache, DdManager * manager, bool onlyDead)
+  {
+    cache.eraseIf(
+      [manager, onlyDead](parakram::DdCacheKey const & key, TValue const &) {
+        if (key.manager != manager)
+          return false;
+        if (!onlyDead)
+          return true;
+        for (auto f: key.operands)
+          if (0 == Cudd_Regular(f)->ref)
+            return true;
+        return false;
+      });
+  }
+
+  void eraseSharedEntries(DdManager * manager, bool onlyDead)
+  {
+    eraseShared(MultiComputedTable::sharedCounts(), manager, onlyDead);
+    eraseShared(MultiComputedTable::sharedShapes(), manager, onlyDead);
+  }
+
+  int purgeHook(DdManager * manager, const char *, void *);
+  int resortHook(DdManager * manager, const char *, void *);
+
+  // ***** Function *****
+  // whether the hooks of a table are registered with the manager,
+  //   which tells the manager that made the table
+  //   from a later one at the same address
+  bool hasHooks(DdManager * manager)
+  {
+    return Cudd_IsInHook(manager, purgeHook, CUDD_PRE_GC_HOOK)
+           && Cudd_IsInHook(manager, purgeHook, CUDD_PRE_REORDERING_HOOK)
+           && Cudd_IsInHook(manager, resortHook, CUDD_POST_REORDERING_HOOK);
+  }
+
+  // ***** Hook *****
+  // purge dead entries before garbage collection / reordering
+  int purgeHook(DdManager * manager, const char *, void *)
+  {
+    auto table = findTable(manager);
+    if (table)
+      table->purgeDeadEntries();
+    eraseSharedEntries(manager, true);
+    return 1;
+  }
+
+  // ***** Hook *****
+  // restore the operand order after reordering
+  int resortHook(DdManager * manager, const char *, void *)
+  {
+    auto table = findTable(manager);
+    if (table)
+      table->resortOperands();
+    return 1;
+  }
+
+} // end anonymous namespace
+
+
+
+namespace parakram {
+
+  MultiComputedTable & MultiComputedTable::forManager(DdManager * manager, int minCapacity)
+  {
+    MultiComputedTable * table = findTable(manager);
+    if (NULL == table || !hasHooks(manager))
+    {
+      std::unique_lock<std::shared_mutex> lock(s_registryMutex);
+      auto & entry = s_registry[manager];
+      if (entry && !hasHooks(manager))
+      {
+        // left behind by a manager destroyed without quit
+        entry.reset();
+        eraseSharedEntries(manager, false);
+      }
+      if (!entry)
+      {
+        entry.reset(new MultiComputedTable(manager, minCapacity));
+        if (!Cudd_AddHook(manager, purgeHook, CUDD_PRE_GC_HOOK)
+            || !Cudd_AddHook(manager, purgeHook, CUDD_PRE_REORDERING_HOOK)
+            || !Cudd_AddHook(manager, resortHook, CUDD_POST_REORDERING_HOOK))
+          throw std::runtime_error("Could not register hooks for the multi-operand computed table");
+      }
+      table = entry.get();
+    }
+    if (table->capacity() < minCapacity)
+      table->resize(minCapacity);
+    return *table;
+  }
+
+  void MultiComputedTable::detach(DdManager * manager)
+  {
+    std::unique_lock<std::shared_mutex> lock(s_registryMutex);
+    auto it = s_registry.find(manager);
+    if (it == s_registry.end())
+      return;
+    Cudd_RemoveHook(manager, purgeHook, CUDD_PRE_GC_HOOK);
+    Cudd_RemoveHook(manager, purgeHook, CUDD_PRE_REORDERING_HOOK);
+    Cudd_RemoveHook(manager, resortHook, CUDD_POST_REORDERING_HOOK);
+    s_registry.erase(it);
+    eraseSharedEntries(manager, false);
+  }
+
+  void MultiComputedTable::quit(DdManager * manager)
+  {
+    detach(manager);
+    Cudd_Quit(manager);
+  }
+
+  DdShardedCache<BigCount> & MultiComputedTable::sharedCounts()
+  {
+    static DdShardedCache<BigCount> s_sharedCounts(1 << 14);
+    return s_sharedCounts;
+  }
+
+  DdShardedCache<MultiComputedTable::Shape> & MultiComputedTable::sharedShapes()
+  {
+    static DdShardedCache<Shape> s_sharedShapes(1 << 14);
+    return s_sharedShapes;
+  }
+
+  MultiComputedTable::MultiComputedTable(DdManager * manager, int capacity):
+    m_manager(manager),
+    m_entries(),
+    m_mask(0),
+    m_size(0),
+    m_stats()
+  {
+    resize(capacity);
+  }
+
+  void MultiComputedTable::resize(int capacity)
+  {
+    // round up to a power of two
+    std::size_t numSlots = 1;
+    while (numSlots < static_cast<std::size_t>(std::max(capacity, 1)))
+      numSlots <<= 1;
+    std::vector<Entry> oldEntries(numSlots);
+    oldEntries.swap(m_entries);
+    m_mask = numSlots - 1;
+    m_size = 0;
+    for (auto & entry: oldEntries)
+    {
+      if (0 == entry.op)
+        continue;
+      Entry & slot = m_entries[slotHash(entry.op, entry.operands.hash(), entry.cube, entry.param) & m_mask];
+      if (0 == slot.op)
+        ++m_size;
+      slot = std::move(entry);
+    }
+  }
+
+  bool MultiComputedTable::isDead(Entry const & entry) const
+  {
+    if (NULL != entry.cube && 0 == Cudd_Regular(entry.cube)->ref)
+      return true;
+    if (NULL != entry.node && 0 == Cudd_Regular(entry.node)->ref)
+      return true;
+    for (auto f: entry.operands)
+      if (0 == Cudd_Regular(f)->ref)
+        return true;
+    return false;
+  }
+
+  void MultiComputedTable::purgeDeadEntries()
+  {
+    for (auto & entry: m_entries)
+    {
+      if (0 == entry.op || !isDead(entry))
+        continue;
+      entry.op = 0;
+      entry.operands.clear();
+      --m_size;
+      ++m_stats.purges;
+    }
+  }
+
+  void MultiComputedTable::resortOperands()
+  {
+    for (auto & entry: m_entries)
+      if (0 != entry.op)
+        entry.operands.normalize(m_manager);
+  }
+
+  void MultiComputedTable::clear()
+  {
+    for (auto & entry: m_entries)
+    {
+      entry.op = 0;
+      entry.operands.clear();
+    }
+    m_size = 0;
+  }
+
+} // end namespace parakram
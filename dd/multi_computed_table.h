@@ -0,0 +1,277 @@
+/*
+
+Copyright 2021 Parakram Majumdar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#pragma once
+
+#include "bdd_operand_set.h"
+#include "big_count.h"
+#include "sharded_cache.h"
+#include <vector>
+
+namespace parakram {
+
+  // ***** MultiComputedTable *****
+  // ********** class **********
+  // A computed table for the multi-operand cudd algorithms
+  //   (see cuddAndAbsMulti.cpp), attached to a DdManager.
+  // The table persists across calls, so repeated calls over
+  //   overlapping sets of operands reuse each other's sub-results.
+  // Like the cudd computed table it is lossy:
+  //   an insert overwrites whatever occupied its slot.
+  // Entries are keyed on the operation, the operand set,
+  //   the abstraction cube, and an integer parameter
+  //   (the number of variables for minterm counts, exact or not,
+  //   the remaining distance and direction for clipping).
+  // The table registers hooks with its manager:
+  //   - before garbage collection and reordering,
+  //       entries referring to dead nodes are purged
+  //   - after reordering, the operands of every entry are re-sorted
+  //       by the new variable levels (their hashes do not change)
+  // The table lives until its manager is destroyed with quit
+  //   (or bdd_quit), which detaches it first.
+  // A manager destroyed with a bare Cudd_Quit leaves its table behind,
+  //   but forManager tells a new manager at the same address
+  //   by the missing hooks, and drops the stale table.
+  // The registry of tables is behind a reader-writer lock,
+  //   so threads finding the tables of their own managers do not wait
+  //   on each other. A table needs no lock of its own,
+  //   since only the thread driving its manager uses it.
+  class MultiComputedTable
+  {
+    public:
+
+      enum Operation { And = 1, AndAbstract = 2, CountMinterm = 3, ClippingAnd = 4, ClippingAndAbstract = 5, ExactCountMinterm = 6, OperandShape = 7 };
+
+      // ***** clippingParam *****
+      // the integer parameter of a clipping entry,
+      //   which encodes the remaining distance and the direction
+      static int clippingParam(int distance, int direction) { return 2 * distance + (direction != 0); }
+
+      struct Stats
+      {
+        unsigned long long hits;
+        unsigned long long misses;
+        unsigned long long insertions;
+        unsigned long long evictions;
+        unsigned long long purges;
+        double hitRate() const { return hits + misses == 0 ? 0.0 : double(hits) / double(hits + misses); }
+      };
+
+      // ***** forManager *****
+      // Get the table attached to a manager,
+      //   creating it and registering the hooks on first use.
+      // The table grows to at least minCapacity entries.
+      static MultiComputedTable & forManager(DdManager * manager, int minCapacity = 0);
+
+      // ***** detach *****
+      // Remove the hooks and free the table of a manager, if it has one.
+      static void detach(DdManager * manager);
+
+      // ***** quit *****
+      // Detach the table of a manager, and destroy the manager with Cudd_Quit.
+      static void quit(DdManager * manager);
+
+      // ***** sharedCounts *****
+      // A process-wide, thread safe tier for exact minterm counts,
+      //   keyed on the nodes of the manager that owns the operands,
+      //   so worker threads counting copies of those operands
+      //   in managers of their own can share results.
+      // Entries of a manager with a table are purged by the table's hooks
+      //   when an operand dies, and dropped when the manager is detached.
+      static DdShardedCache<BigCount> & sharedCounts();
+
+      // ***** Shape *****
+      // the structure of a set of operands, which survives a transfer:
+      //   the indices of the variables in their support, sorted,
+      //   and the number of nodes they share
+      struct Shape
+      {
+        std::vector<int> support;
+        int numNodes;
+      };
+
+      // ***** sharedShapes *****
+      // A tier like sharedCounts for the shapes of sets of operands,
+      //   purged in the same way.
+      static DdShardedCache<Shape> & sharedShapes();
+
+      template<int N>
+      bool lookup(Operation op, BddOperandSet<N> const & operands, DdNode * cube, int param, DdNode * & result);
+      template<int N>
+      bool lookup(Operation op, BddOperandSet<N> const & operands, DdNode * cube, int param, long double & result);
+      template<int N>
+      bool lookup(Operation op, BddOperandSet<N> const & operands, DdNode * cube, int param, BigCount & result);
+      template<int N>
+      void insert(Operation op, BddOperandSet<N> const & operands, DdNode * cube, int param, DdNode * result);
+      template<int N>
+      void insert(Operation op, BddOperandSet<N> const & operands, DdNode * cube, int param, long double result);
+      template<int N>
+      void insert(Operation op, BddOperandSet<N> const & operands, DdNode * cube, int param, BigCount const & result);
+
+      // ***** purgeDeadEntries *****
+      // drop all entries that refer to a node with a zero reference count
+      void purgeDeadEntries();
+
+      // ***** resortOperands *****
+      // restore the level order of the operands after a reordering
+      void resortOperands();
+
+      void clear();
+      int capacity() const { return static_cast<int>(m_entries.size()); }
+      int size() const { return m_size; }
+      Stats const & stats() const { return m_stats; }
+      void resetStats() { m_stats = Stats(); }
+
+    private:
+
+      struct Entry
+      {
+        int op; // zero for an empty slot
+        int param;
+        DdNode * cube;
+        BddOperandSet<4> operands;
+        DdNode * node;
+        long double count;
+        BigCount exactCount;
+        Entry(): op(0), param(0), cube(NULL), operands(), node(NULL), count(0), exactCount() { }
+      };
+
+      MultiComputedTable(DdManager * manager, int capacity);
+      MultiComputedTable(MultiComputedTable const &) = delete;
+      MultiComputedTable & operator = (MultiComputedTable const &) = delete;
+
+      void resize(int capacity);
+      bool isDead(Entry const & entry) const;
+      static std::size_t slotHash(int op, std::size_t operandsHash, DdNode * cube, int param);
+
+      template<int N>
+      Entry * find(Operation op, BddOperandSet<N> const & operands, DdNode * cube, int param);
+      template<int N>
+      Entry & slotFor(Operation op, BddOperandSet<N> const & operands, DdNode * cube, int param);
+
+      DdManager * m_manager;
+      std::vector<Entry> m_entries;
+      std::size_t m_mask;
+      int m_size;
+      Stats m_stats;
+  }; // end class MultiComputedTable
+
+
+
+
+  inline std::size_t MultiComputedTable::slotHash(int op, std::size_t operandsHash, DdNode * cube, int param)
+  {
+    std::size_t h = operandsHash;
+    h ^= BddOperandSet<>::mix(cube) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    h ^= static_cast<std::size_t>(op * 31 + param) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    return h;
+  }
+
+  template<int N>
+  MultiComputedTable::Entry * MultiComputedTable::find(Operation op, BddOperandSet<N> const & operands, DdNode * cube, int param)
+  {
+    Entry & entry = m_entries[slotHash(op, operands.hash(), cube, param) & m_mask];
+    if (entry.op == op && entry.cube == cube && entry.param == param && entry.operands == operands)
+    {
+      ++m_stats.hits;
+      return &entry;
+    }
+    ++m_stats.misses;
+    return NULL;
+  }
+
+  template<int N>
+  MultiComputedTable::Entry & MultiComputedTable::slotFor(Operation op, BddOperandSet<N> const & operands, DdNode * cube, int param)
+  {
+    Entry & entry = m_entries[slotHash(op, operands.hash(), cube, param) & m_mask];
+    if (0 == entry.op)
+      ++m_size;
+    else if (!(entry.op == op && entry.cube == cube && entry.param == param && entry.operands == operands))
+      ++m_stats.evictions;
+    ++m_stats.insertions;
+    entry.op = op;
+    entry.cube = cube;
+    entry.param = param;
+    entry.operands.assign(operands);
+    return entry;
+  }
+
+  template<int N>
+  bool MultiComputedTable::lookup(Operation op, BddOperandSet<N> const & operands, DdNode * cube, int param, DdNode * & result)
+  {
+    Entry * entry = find(op, operands, cube, param);
+    if (NULL == entry)
+      return false;
+    result = entry->node;
+    // like the cudd computed table, revive a dead result before handing it out
+    if (0 == Cudd_Regular(result)->ref)
+      cuddReclaim(m_manager, Cudd_Regular(result));
+    return true;
+  }
+
+  template<int N>
+  bool MultiComputedTable::lookup(Operation op, BddOperandSet<N> const & operands, DdNode * cube, int param, long double & result)
+  {
+    Entry * entry = find(op, operands, cube, param);
+    if (NULL == entry)
+      return false;
+    result = entry->count;
+    return true;
+  }
+
+  template<int N>
+  bool MultiComputedTable::lookup(Operation op, BddOperandSet<N> const & operands, DdNode * cube, int param, BigCount & result)
+  {
+    Entry * entry = find(op, operands, cube, param);
+    if (NULL == entry)
+      return false;
+    result = entry->exactCount;
+    return true;
+  }
+
+  template<int N>
+  void MultiComputedTable::insert(Operation op, BddOperandSet<N> const & operands, DdNode * cube, int param, DdNode * result)
+  {
+    slotFor(op, operands, cube, param).node = result;
+  }
+
+  template<int N>
+  void MultiComputedTable::insert(Operation op, BddOperandSet<N> const & operands, DdNode * cube, int param, long double result)
+  {
+    Entry & entry = slotFor(op, operands, cube, param);
+    entry.node = NULL;
+    entry.count = result;
+  }
+
+  template<int N>
+  void MultiComputedTable::insert(Operation op, BddOperandSet<N> const & operands, DdNode * cube, int param, BigCount const & result)
+  {
+    Entry & entry = slotFor(op, operands, cube, param);
+    entry.node = NULL;
+    entry.exactCount = result;
+  }
+
+} // end namespace parakram
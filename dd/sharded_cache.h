@@ -0,0 +1,276 @@
+/*
+
+Copyright 2021 Parakram Majumdar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#pragma once
+
+#include "const_span.h"
+#include "lru_cache.h"
+#include "optional.h"
+#include <cuddInt.h>
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace parakram {
+
+  // ***** ShardedCache *****
+  // ******** class ********
+  // A thread safe LruCache, split into independent shards.
+  // A key goes to the shard picked by its hash, and each shard has
+  //   its own mutex and evicts on its own,
+  //   so there is no global lock and threads working on different keys
+  //   rarely meet. The critical sections are a single LruCache probe.
+  // Values are copied out, since a pointer into a shard
+  //   would not survive a concurrent insert.
+  // Template arguments: as for LruCache
+  template<typename TKey, typename TValue, typename THash = std::hash<TKey>, typename TEqual = std::equal_to<> >
+  class ShardedCache
+  {
+    public:
+
+      typedef typename LruCache<TKey, TValue, THash, TEqual>::Stats Stats;
+
+      // the capacity is split evenly between the shards,
+      //   whose number is rounded up to a power of two
+      ShardedCache(int capacity, int numShards = 16, THash const & hasher = THash(), TEqual const & equal = TEqual());
+      ShardedCache(ShardedCache const &) = delete;
+      ShardedCache & operator = (ShardedCache const &) = delete;
+
+      bool insert(TKey const & key, TValue const & value);
+      bool insert(TKey && key, TValue && value);
+      template<typename TProbe>
+      Optional<TValue> tryGet(TProbe const & probe);
+
+      // ***** eraseIf *****
+      // remove the entries for which pred(key, value) holds,
+      //   one shard at a time
+      template<typename TPred>
+      int eraseIf(TPred pred);
+
+      void clear();
+      int size() const;
+      int numShards() const { return static_cast<int>(m_shards.size()); }
+
+      // ***** stats *****
+      // the sum of the shard counters
+      Stats stats() const;
+      void resetStats();
+
+    private:
+
+      // a shard on its own cache line, so neighbouring locks do not contend
+      struct alignas(64) Shard
+      {
+        mutable std::mutex mutex;
+        LruCache<TKey, TValue, THash, TEqual> cache;
+        Shard(int capacity, THash const & hasher, TEqual const & equal): mutex(), cache(capacity, hasher, equal) { }
+      };
+
+      // ***** ShardLock *****
+      // scoped lock on a shard
+      class ShardLock
+      {
+        public:
+          ShardLock(Shard const & shard): m_lock(shard.mutex) { }
+        private:
+          std::lock_guard<std::mutex> m_lock;
+      };
+
+      template<typename TProbe>
+      Shard & shardFor(TProbe const & probe)
+      {
+        // the high bits, since each shard indexes with the low ones
+        std::size_t h = m_hasher(probe);
+        h *= 0x9e3779b97f4a7c15ULL;
+        return *m_shards[(h >> 32) & m_mask];
+      }
+
+      THash m_hasher;
+      std::vector<std::unique_ptr<Shard> > m_shards;
+      std::size_t m_mask;
+  }; // end class ShardedCache
+
+
+  // ***** DdCacheKey *****
+  // ******** struct ********
+  // A key for results computed from a set of operands in a manager:
+  //   the manager, an operation code, an integer parameter,
+  //   and the operands sorted by address.
+  // The manager is part of the key, so workers on different managers
+  //   can share one cache. Workers that hold copies of a source
+  //   manager's functions can share results structural enough
+  //   to survive the transfer (support sets and sizes, counts)
+  //   by keying them on the source manager's nodes.
+  // DdCacheProbe is the matching heterogeneous probe,
+  //   whose operands are a span instead of a vector.
+  struct DdCacheKey
+  {
+    DdManager const * manager;
+    int op;
+    int param;
+    std::vector<DdNode *> operands;
+  };
+
+  struct DdCacheProbe
+  {
+    DdManager const * manager;
+    int op;
+    int param;
+    ConstSpan<DdNode *> operands;
+  };
+
+  struct DdCacheKeyHash
+  {
+    template<typename TKey>
+    std::size_t operator()(TKey const & key) const
+    {
+      std::size_t h = LruRangeHash()(key.operands);
+      h ^= std::hash<DdManager const *>()(key.manager) + 0x9e3779b9 + (h << 6) + (h >> 2);
+      h ^= static_cast<std::size_t>(key.op * 31 + key.param) + 0x9e3779b9 + (h << 6) + (h >> 2);
+      return h;
+    }
+  };
+
+  struct DdCacheKeyEqual
+  {
+    template<typename TKey1, typename TKey2>
+    bool operator()(TKey1 const & a, TKey2 const & b) const
+    {
+      return a.manager == b.manager && a.op == b.op && a.param == b.param
+        && LruRangeEqual()(a.operands, b.operands);
+    }
+  };
+
+  template<typename TValue>
+  using DdShardedCache = ShardedCache<DdCacheKey, TValue, DdCacheKeyHash, DdCacheKeyEqual>;
+
+
+
+
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  ShardedCache<TKey, TValue, THash, TEqual>::ShardedCache(int capacity, int numShards, THash const & hasher, TEqual const & equal):
+    m_hasher(hasher),
+    m_shards(),
+    m_mask(0)
+  {
+    int n = 1;
+    while (n < numShards)
+      n *= 2;
+    for (int i = 0; i < n; ++i)
+      m_shards.emplace_back(new Shard((capacity + n - 1) / n, hasher, equal));
+    m_mask = n - 1;
+  }
+
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  bool ShardedCache<TKey, TValue, THash, TEqual>::insert(TKey const & key, TValue const & value)
+  {
+    Shard & shard = shardFor(key);
+    ShardLock lock(shard);
+    return shard.cache.insert(key, value);
+  }
+
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  bool ShardedCache<TKey, TValue, THash, TEqual>::insert(TKey && key, TValue && value)
+  {
+    Shard & shard = shardFor(key);
+    ShardLock lock(shard);
+    return shard.cache.insert(std::move(key), std::move(value));
+  }
+
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  template<typename TProbe>
+  Optional<TValue> ShardedCache<TKey, TValue, THash, TEqual>::tryGet(TProbe const & probe)
+  {
+    Shard & shard = shardFor(probe);
+    ShardLock lock(shard);
+    return shard.cache.tryGet(probe);
+  }
+
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  template<typename TPred>
+  int ShardedCache<TKey, TValue, THash, TEqual>::eraseIf(TPred pred)
+  {
+    int numErased = 0;
+    for (auto & shard: m_shards)
+    {
+      ShardLock lock(*shard);
+      numErased += shard->cache.eraseIf(pred);
+    }
+    return numErased;
+  }
+
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  void ShardedCache<TKey, TValue, THash, TEqual>::clear()
+  {
+    for (auto & shard: m_shards)
+    {
+      ShardLock lock(*shard);
+      shard->cache.clear();
+    }
+  }
+
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  int ShardedCache<TKey, TValue, THash, TEqual>::size() const
+  {
+    int result = 0;
+    for (auto const & shard: m_shards)
+    {
+      ShardLock lock(*shard);
+      result += shard->cache.size();
+    }
+    return result;
+  }
+
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  typename ShardedCache<TKey, TValue, THash, TEqual>::Stats ShardedCache<TKey, TValue, THash, TEqual>::stats() const
+  {
+    Stats result = Stats();
+    for (auto const & shard: m_shards)
+    {
+      ShardLock lock(*shard);
+      Stats const & s = shard->cache.stats();
+      result.hits += s.hits;
+      result.misses += s.misses;
+      result.insertions += s.insertions;
+      result.evictions += s.evictions;
+    }
+    return result;
+  }
+
+  template<typename TKey, typename TValue, typename THash, typename TEqual>
+  void ShardedCache<TKey, TValue, THash, TEqual>::resetStats()
+  {
+    for (auto & shard: m_shards)
+    {
+      ShardLock lock(*shard);
+      shard->cache.resetStats();
+    }
+  }
+
+} // end namespace parakram
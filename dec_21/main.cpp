@@ -448,7 +448,7 @@ void Dec21MucCallback::processMuc(const std::vector<std::vector<int> >& muc)
     auto mergedFunc = m_factorGraph->groupFactors(funcNodes);
     m_factorGraph->groupVariables(varNodes);
     blif_solve_log(INFO, "merged " << funcNodes.size() << " func nodes.");
-    m_factorGraph->converge();
+    m_factorGraph->converge(fgpp::FactorGraph::Start::Warm); // keep the messages from before the grouping
     m_factorGraphResult = getFactorGraphResult(m_ddManager, *m_factorGraph, *m_qdimacsToBdd);
     blif_solve_log_bdd(DEBUG, "factor graph result:", m_ddManager, m_factorGraphResult.getUncountedBdd());
     for (auto & cd: clauseDataVec) cd->funcNode = mergedFunc;
@@ -479,11 +479,7 @@ dd::BddWrapper getFactorGraphResult(DdManager* ddm, const fgpp::FactorGraph& fg,
     allVars = allVars.cubeUnion(nextVar);
   }
   auto nonQVars = allVars.cubeDiff(qvars);
-  auto resultVec = fg.getIncomingMessages(nonQVars);
-  dd::BddWrapper result(bdd_one(ddm), ddm);
-  for (const auto & message: resultVec)
-    result = result * message;
-  return result;
+  return fg.getIncomingConjunction(nonQVars);
 }
 
 
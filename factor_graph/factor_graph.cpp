@@ -25,8 +25,16 @@ SOFTWARE.
 
 
 #include <time.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
 #include <queue>
+#include <thread>
 #include "factor_graph.h"
+#include <dd/conjunction_tree.h>
+#include <vector>
 
 
 #define max(x, y) (((x) > (y)) ? (x) : (y))
@@ -34,9 +42,6 @@ SOFTWARE.
 #define IS_VISITED(x) ((x)->color == 1)
 #define SET_UNVISITED(x) ((x)->color = 0)
 #define SET_VISITED(x) ((x)->color = 1)
-#define SKIP_DEAD(list, fg)  if(list->died <= fg->time) { \
-  list = list->next; \
-  continue; }
 #define TIME_INFTY 99999
 
 /* ------------- Debugging ----------------------------*/
@@ -52,17 +57,14 @@ SOFTWARE.
 int factor_graph_add_var(factor_graph *fg, bdd_ptr v);
 int factor_graph_add_func(factor_graph *fg, bdd_ptr f);
 int factor_graph_add_edge(factor_graph * fg, fgnode * f, fgnode * v);
+int factor_graph_add_node(factor_graph *fg, fgnode *n, fgnode **others, int num_others);
 int factor_graph_add_varnode(factor_graph *fg, fgnode* vn);
 int factor_graph_add_funcnode(factor_graph *fg, fgnode* fn);
-void factor_graph_unhide_funcnode(factor_graph *, fgnode *);
-void factor_graph_unhide_varnode(factor_graph *, fgnode *);
-void factor_graph_unhide_edge(factor_graph *, fgedge *);
-void factor_graph_delete_var(factor_graph * fg, bdd_ptr v);
-void factor_graph_delete_varnode(factor_graph * fg, fgnode* v);
-void factor_graph_delete_funcnode(factor_graph * fg, fgnode* f);
+void factor_graph_unhide_node(factor_graph *, fgnode *, int pos);
+void factor_graph_unhide_edge(factor_graph *, fgedge *, int pos, int fpos, int vpos);
+void factor_graph_delete_node(factor_graph * fg, fgnode* n);
 void factor_graph_delete_edge(factor_graph *fg, fgedge * e);
-void factor_graph_hide_funcnode(factor_graph *, fgnode *);
-void factor_graph_hide_varnode(factor_graph *, fgnode *);
+void factor_graph_hide_node(factor_graph *, fgnode *);
 void factor_graph_hide_edge(factor_graph *fg, fgedge *e);
 int factor_graph_is_acyclic(factor_graph *fg, fgnode ** cycle);
 int merge_heur2(factor_graph *fg,fgnode *n1,fgnode *n2,int l);
@@ -70,38 +72,327 @@ int merge_heur1(factor_graph *fg,fgnode *n1,fgnode *n2,int l);
 int merge(factor_graph *fg,fgnode *n1,fgnode *n2,int l);
 int compute_cost(factor_graph *fg,fgnode *n1,fgnode *n2);
 void factor_graph_reset_messages(factor_graph *fg);
+bdd_ptr factor_graph_transfer(DdManager *from, DdManager *to, bdd_ptr f);
+std::vector<int> factor_graph_variable_order(DdManager *m);
+DdManager * factor_graph_worker_manager(const std::vector<int> &order);
 /* ------------- fgnode Datastructure ----------------*/
+fgnode * fgnode_alloc(factor_graph *fg, fgnode_type type);
 fgnode * fgnode_new_func(factor_graph *, bdd_ptr f);
 fgnode * fgnode_new_var(factor_graph * fg, bdd_ptr v);
-void fgnode_delete(DdManager *m, fgnode *n);
+void fgnode_delete(factor_graph *fg, fgnode *n);
 fgnode *fgnode_new_composite_node(factor_graph *fg, fgnode *fn1,fgnode *fn2);
-int var_node_pass_messages(factor_graph *fg, fgnode *n, fgnode_list *queue);
-int func_node_pass_messages(factor_graph *fg, fgnode *n, fgnode_list *queue);
+bdd_ptr and_with_incoming(factor_graph *fg, fgnode *n, bdd_ptr *first, int num_first, bdd_ptr fgedge::*msg);
+int var_node_pass_messages(factor_graph *fg, fgnode *n);
+int func_node_pass_messages(factor_graph *fg, fgnode *n);
 void fgnode_printname(fgnode *n);
 int fgnode_support_size(DdManager *m, fgnode *n);
 int fgnode_intersects_var(factor_graph *fg, fgnode *n, bdd_ptr var);
 
 /* ------------- fgnode_list Datastructure ----------------*/
-fgnode_list * fgnode_list_add_var(factor_graph *fg, fgnode_list * L, bdd_ptr n);
-fgnode_list * fgnode_list_new_var(factor_graph *fg, bdd_ptr n);
 fgnode_list * fgnode_list_delete(fgnode_list * fgnl);
-fgnode_list * fgnode_list_new_func(factor_graph *, bdd_ptr n);
-fgnode_list * fgnode_list_add_func(factor_graph *, fgnode_list * L, bdd_ptr n);
 fgnode_list * fgnode_list_add_node(factor_graph * fg, fgnode_list * L, fgnode * n);
 
 /* ------------- fgedge Datastructure ----------------*/
-void fgedge_delete(DdManager *m, fgedge *e);
-
-/* ------------- fgedge_list Datastructure ----------------*/
-fgedge_list * fgedge_list_new(factor_graph *fg, fgnode *f, fgnode *v);
-fgedge_list * fgedge_list_delete(fgedge_list *el);
-fgedge_list * fgedge_list_add_edge(factor_graph *fg, fgedge_list * L, fgedge * n);
+fgedge * fgedge_new(factor_graph *fg, fgnode *f, fgnode *v);
+void fgedge_delete(factor_graph *fg, fgedge *e);
 
 /* --------------- Miscellaneous ------------------------- */
 int bdd_and_exist_vector(DdManager *m, bdd_ptr *f, bdd_ptr* ss, int size, bdd_ptr V);
 void var_to_eliminate(factor_graph *, fgnode*, bdd_ptr *, int*);
 
 
+/* ------------- Arenas and undo log ----------------*/
+
+// Slots for the nodes or the edges of a factor graph, in chunks that
+// never move, so pointers to them stay valid. Each element knows its
+// slot, in ->index, and freed slots are reused first.
+template<typename T>
+struct fgarena
+{
+  static constexpr int CHUNK_BITS = 8;
+  static constexpr int CHUNK_SIZE = 1 << CHUNK_BITS;
+
+  std::vector<T *> chunks;
+  std::vector<int> free_slots;
+  int num_slots = 0;
+
+  T *at(int index) const
+  {
+    return chunks[index >> CHUNK_BITS] + (index & (CHUNK_SIZE - 1));
+  }
+
+  // whether the slot holds an element
+  bool in_use(int index) const
+  {
+    return at(index)->index == index;
+  }
+
+  // an uninitialized element, but for its index, or NULL if out of memory
+  T *alloc()
+  {
+    int index;
+    if(!free_slots.empty())
+    {
+      index = free_slots.back();
+      free_slots.pop_back();
+    }
+    else
+    {
+      if(num_slots == (int)chunks.size() * CHUNK_SIZE)
+      {
+        T *chunk = (T *)malloc(sizeof(T) * CHUNK_SIZE);
+        if(chunk == NULL)
+          return NULL;
+        chunks.push_back(chunk);
+      }
+      index = num_slots++;
+    }
+    T *x = at(index);
+    x->index = index;
+    return x;
+  }
+
+  void release(T *x)
+  {
+    free_slots.push_back(x->index);
+    x->index = -1;
+  }
+
+  ~fgarena()
+  {
+    for(auto chunk: chunks)
+      free(chunk);
+  }
+};
+
+typedef enum fgundo_kind_enum{FGUNDO_NONE, FGUNDO_ADD_NODE, FGUNDO_ADD_EDGE, FGUNDO_HIDE_NODE, FGUNDO_HIDE_EDGE} fgundo_kind;
+
+// a change that factor_graph_rollback undoes
+struct fgundo
+{
+  fgundo_kind kind;     // FGUNDO_NONE once the element is deleted
+  int time;             // the checkpoint it was made after
+  int index;            // of the node or edge in its arena
+  int pos, fpos, vpos;  // where a hidden element was in the live arrays
+};
+
+// The nodes waiting to fire in factor_graph_converge, first in first out,
+// in a ring buffer that only grows, so pushes and pops do not allocate
+struct fgworklist
+{
+  fgnode **slots = NULL;
+  int capacity = 0;  // zero or a power of two
+  int head = 0;
+  int size = 0;
+
+  // OUTPUT : 0 if successful, -1 if out of memory
+  int push(fgnode *n)
+  {
+    if(size == capacity)
+    {
+      int new_capacity = max(2 * capacity, 64);
+      fgnode **grown = (fgnode **)malloc(sizeof(fgnode *) * new_capacity);
+      if(grown == NULL)
+        return -1;
+      for(int i = 0; i < size; i++)
+        grown[i] = slots[(head + i) & (capacity - 1)];
+      free(slots);
+      slots = grown;
+      capacity = new_capacity;
+      head = 0;
+    }
+    slots[(head + size) & (capacity - 1)] = n;
+    size++;
+    return 0;
+  }
+
+  fgnode *pop()
+  {
+    fgnode *n = slots[head];
+    head = (head + 1) & (capacity - 1);
+    size--;
+    return n;
+  }
+
+  ~fgworklist()
+  {
+    free(slots);
+  }
+};
+
+struct fgstore
+{
+  fgarena<fgnode> nodes;
+  fgarena<fgedge> edges;
+  std::vector<fgundo> undo_log;
+  std::vector<fgnode *> var_nodes;  // the live var node of each variable index, if any
+  fgworklist worklist;
+  std::vector<unsigned long long> queued;  // a bit for each slot of nodes, set while it is in worklist
+};
+
+/** Whether a node is in the worklist of factor_graph_converge
+ */
+inline bool factor_graph_is_queued(factor_graph *fg, fgnode *n)
+{
+  size_t word = n->index >> 6;
+  return word < fg->store->queued.size() && ((fg->store->queued[word] >> (n->index & 63)) & 1);
+}
+
+/** Adds a node to the worklist of factor_graph_converge, if it is not there yet
+ *    (the bitmap grows with the arena, for the nodes made since it was cleared)
+ * OUTPUT : 0 if successful, -1 if out of memory
+ */
+int factor_graph_enqueue(factor_graph *fg, fgnode *n)
+{
+  if(factor_graph_is_queued(fg, n))
+    return 0;
+  assert(n->index < fg->store->nodes.num_slots);
+  size_t word = n->index >> 6;
+  if(word >= fg->store->queued.size())
+    fg->store->queued.resize((fg->store->nodes.num_slots + 63) / 64, 0);
+  fg->store->queued[word] |= 1ULL << (n->index & 63);
+  return fg->store->worklist.push(n);
+}
+
+/** Marks a node, taken from the worklist of factor_graph_converge, as no longer queued
+ */
+void factor_graph_dequeued(factor_graph *fg, fgnode *n)
+{
+  assert((size_t)(n->index >> 6) < fg->store->queued.size());
+  fg->store->queued[n->index >> 6] &= ~(1ULL << (n->index & 63));
+}
+
+/** Puts x at position pos of the array arr of num elements, moving the one there
+ *    to the end, or at the end if pos is negative or not less than num
+ *  Keeps the member pos_of of the moved elements up to date, and grows arr if full
+ * OUTPUT : 0 if successful, -1 if out of memory
+ */
+template<typename T>
+int fgarray_insert(T **&arr, int &num, int &capacity, T *x, int pos, int T::*pos_of)
+{
+  if(num == capacity)
+  {
+    int new_capacity = max(2 * capacity, 4);
+    T **grown = (T **)realloc(arr, sizeof(T *) * new_capacity);
+    if(grown == NULL)
+      return -1;
+    arr = grown;
+    capacity = new_capacity;
+  }
+  if(pos >= 0 && pos < num)
+  {
+    arr[num] = arr[pos];
+    arr[num]->*pos_of = num;
+  }
+  else
+    pos = num;
+  arr[pos] = x;
+  x->*pos_of = pos;
+  num++;
+  return 0;
+}
+
+/** Removes the element at position pos of the array arr of num elements,
+ *    moving the last one into its place
+ */
+template<typename T>
+void fgarray_remove(T **arr, int &num, int pos, int T::*pos_of)
+{
+  num--;
+  if(pos != num)
+  {
+    arr[pos] = arr[num];
+    arr[pos]->*pos_of = pos;
+  }
+}
+
+/** Calls func on the index of each variable of a cube, top first
+ */
+template<typename Func>
+void for_each_cube_index(bdd_ptr cube, Func func)
+{
+  for(DdNode *n = Cudd_Regular(cube); !Cudd_IsConstant(n); n = Cudd_Regular(Cudd_T(n)))
+    func((int)Cudd_NodeReadIndex(n));
+}
+
+/** Makes a node live, at position pos among the nodes of its type (see fgarray_insert)
+ * OUTPUT : 0 if successful, -1 if out of memory
+ */
+int factor_graph_link_node(factor_graph *fg, fgnode *n, int pos)
+{
+  if(n->type == FUNC_NODE)
+    return fgarray_insert(fg->funcs, fg->num_funcs, fg->funcs_capacity, n, pos, &fgnode::pos);
+  if(fgarray_insert(fg->vars, fg->num_vars, fg->vars_capacity, n, pos, &fgnode::pos) == -1)
+    return -1;
+  std::vector<fgnode *> &var_nodes = fg->store->var_nodes;
+  for_each_cube_index(n->ss[0],
+                      [&](int index) {
+                        if(index >= (int)var_nodes.size())
+                          var_nodes.resize(index + 1, NULL);
+                        var_nodes[index] = n;
+                      });
+  return 0;
+}
+
+void factor_graph_unlink_node(factor_graph *fg, fgnode *n)
+{
+  if(n->type == FUNC_NODE)
+    fgarray_remove(fg->funcs, fg->num_funcs, n->pos, &fgnode::pos);
+  else
+  {
+    fgarray_remove(fg->vars, fg->num_vars, n->pos, &fgnode::pos);
+    std::vector<fgnode *> &var_nodes = fg->store->var_nodes;
+    for_each_cube_index(n->ss[0],
+                        [&](int index) {
+                          if(var_nodes[index] == n)
+                            var_nodes[index] = NULL;
+                        });
+  }
+  n->pos = -1;
+}
+
+/** Makes an edge live, at the given positions among the edges of the graph
+ *    and of its two nodes (see fgarray_insert)
+ * OUTPUT : 0 if successful, -1 if out of memory
+ */
+int factor_graph_link_edge(factor_graph *fg, fgedge *e, int pos, int fpos, int vpos)
+{
+  if(fgarray_insert(fg->edges, fg->num_edges, fg->edges_capacity, e, pos, &fgedge::pos) == -1)
+    return -1;
+  if(fgarray_insert(e->fn->neigh, e->fn->num_neigh, e->fn->neigh_capacity, e, fpos, &fgedge::fpos) == -1)
+    return -1;
+  return fgarray_insert(e->vn->neigh, e->vn->num_neigh, e->vn->neigh_capacity, e, vpos, &fgedge::vpos);
+}
+
+void factor_graph_unlink_edge(factor_graph *fg, fgedge *e)
+{
+  fgarray_remove(fg->edges, fg->num_edges, e->pos, &fgedge::pos);
+  fgarray_remove(e->fn->neigh, e->fn->num_neigh, e->fpos, &fgedge::fpos);
+  fgarray_remove(e->vn->neigh, e->vn->num_neigh, e->vpos, &fgedge::vpos);
+  e->pos = -1;
+}
+
+/** Records a change in the undo log
+ * OUTPUT : the position of its entry
+ */
+int factor_graph_log(factor_graph *fg, fgundo_kind kind, int index, int pos, int fpos, int vpos)
+{
+  fg->store->undo_log.push_back({kind, fg->time, index, pos, fpos, vpos});
+  return (int)fg->store->undo_log.size() - 1;
+}
+
+/** Forgets the entries of a deleted node or edge in the undo log
+ */
+void factor_graph_forget(factor_graph *fg, int undo_add, int undo_hide)
+{
+  if(undo_add >= 0)
+    fg->store->undo_log[undo_add].kind = FGUNDO_NONE;
+  if(undo_hide >= 0)
+    fg->store->undo_log[undo_hide].kind = FGUNDO_NONE;
+}
+
+
+
 /* ------------- Function Definitions ----------------*/
 
 /* ------------- Factor Graph Datastructure ----------------*/
@@ -113,110 +404,74 @@ Output: returns 0 if Factor Graph is cyclic
 returns 1 if Factor Fraph is acyclic
 */
 int factor_graph_is_acyclic(factor_graph *fg, fgnode ** cycle){
-  fgnode_list *fl,*vl;
-  fgnode_list *queue;  
-  fgnode *u;
-  fgedge_list *v;
+  fgnode_list *queue;
+  fgnode *u, *w;
+  int i, j;
   *cycle = NULL;
-  fl=fg->fl;
-  vl=fg->vl;
 
 
   // set colors to 0
   // set parents to null
-  do{
-    fl->n->color=0;
-    fl->n->parent = NULL;
-    fl=fl->next;
-  }while(fl!=fg->fl);
+  for(i = 0; i < fg->num_funcs; i++){
+    fg->funcs[i]->color=0;
+    fg->funcs[i]->parent = NULL;
+  }
 
-  do{
-    vl->n->color=0;
-    vl->n->parent = NULL;
-    vl=vl->next;
-  }while(vl!=fg->vl);
+  for(i = 0; i < fg->num_vars; i++){
+    fg->vars[i]->color=0;
+    fg->vars[i]->parent = NULL;
+  }
 
 
 
 
-  while(1) {
-    // skip dead and visited funcs
-    while(fl->n->died <= fg->time || fl->n->color == 1) {
-      //if(fl->n->died <= fg->time)
-      //  fgdm("dead node", fl->n->died);
-      fl = fl->next;
-      if(fl == fg->fl)
-        return 1;
-    }
+  for(i = 0; i < fg->num_funcs; i++) {
+    // skip visited funcs
+    if(fg->funcs[i]->color == 1)
+      continue;
 
     // add one node into the queue
     // and mark it as visited
-    fl->n->color=1;
-    queue= fgnode_list_add_node(fg, NULL, fl->n);
+    fg->funcs[i]->color=1;
+    queue= fgnode_list_add_node(fg, NULL, fg->funcs[i]);
 
 
     // breadth first traversal
     while(queue!=NULL) {
       // u is an element of the queue
-      // v are the edges of u
+      // w are its neighbours
       u=queue->n;
       queue = fgnode_list_delete(queue);
-      v=u->neigh;
-
-      // loop over neighbours v of u
-      if (u->num_neigh > 0) 
-        do {
-          SKIP_DEAD(v, fg);
-          // visit for FUNC_NODE-s
-          if(u->type==FUNC_NODE){
-            // skip if current neighbour is the parent of u
-            if(v->e->vn == u->parent) {
-              v = v->next;
-              continue;
-            }
-
-            // if current neighbour has already been visited,
-            // then we've found a cyle
-            if(v->e->vn->color==1){
-              *cycle = u;
-              return 0;
-            }
-            // else, mark u as parent of current neighbour
-            // and add it to the queue
-            else{
-              v->e->vn->color=1;
-              v->e->vn->parent = u;
-              if(queue == NULL)
-                queue = fgnode_list_add_node(fg, queue, v->e->vn);
-              else
-                fgnode_list_add_node(fg, queue, v->e->vn);
-            }
-          }
-          else{
-            // visit for VAR_NODE-s
-            if(v->e->fn == u->parent) {
-              v = v->next;
-              continue;
-            }
-            if(v->e->fn->color==1){
-              *cycle = u;
-              return 0;
-            }
-            else{
-              v->e->fn->color=1;
-              v->e->fn->parent = u;
-              if(queue == NULL)
-                queue = fgnode_list_add_node(fg, queue, v->e->fn);
-              else
-                fgnode_list_add_node(fg, queue, v->e->fn);
-            }
-          }
-          v=v->next;
-        }while(v!=u->neigh);
+
+      // loop over neighbours w of u
+      for(j = 0; j < u->num_neigh; j++) {
+        w = (u->type == FUNC_NODE ? u->neigh[j]->vn : u->neigh[j]->fn);
+
+        // skip if current neighbour is the parent of u
+        if(w == u->parent)
+          continue;
+
+        // if current neighbour has already been visited,
+        // then we've found a cyle
+        if(w->color==1){
+          *cycle = u;
+          while(queue != NULL)
+            queue = fgnode_list_delete(queue);
+          return 0;
+        }
+
+        // else, mark u as parent of current neighbour
+        // and add it to the queue
+        w->color=1;
+        w->parent = u;
+        if(queue == NULL)
+          queue = fgnode_list_add_node(fg, queue, w);
+        else
+          fgnode_list_add_node(fg, queue, w);
+      }
     }
   }
-  assert(0); //THIS LINE SHOULD BE UNREACHABLE
-  return 0;
+  return 1;
 }
 
 void actually_merge(factor_graph *fg,fgnode *n1,fgnode *n2){
@@ -232,9 +487,15 @@ void actually_merge(factor_graph *fg,fgnode *n1,fgnode *n2){
   else{
     assert(n2->type != VAR_NODE && "Attempted to group func node and var node");
     n=fgnode_new_composite_node(fg, n1,n2);
-    factor_graph_add_funcnode(fg,n);   
-    factor_graph_hide_funcnode(fg,n1);
-    factor_graph_hide_funcnode(fg,n2);
+    // the composite node can only be connected to the neighbours of n1 and n2
+    std::vector<fgnode *> candidates;
+    for(fgnode *m: {n1, n2})
+      for(int i = 0; i < m->num_neigh; i++)
+        if(std::find(candidates.begin(), candidates.end(), m->neigh[i]->vn) == candidates.end())
+          candidates.push_back(m->neigh[i]->vn);
+    factor_graph_add_node(fg, n, candidates.data(), (int)candidates.size());
+    factor_graph_hide_node(fg,n1);
+    factor_graph_hide_node(fg,n2);
     //factor_graph_delete_funcnode(fg,n1);
     //factor_graph_delete_funcnode(fg,n2);
   }
@@ -398,32 +659,28 @@ int merge_heur2(factor_graph *fg,fgnode *n1,fgnode *n2,int l)
 
 bdd_ptr factor_graph_make_acyclic(factor_graph *fg,fgnode *v,int l){
   int is_acyclic=0;
-  fgnode_list *fl,*vl;
   fgnode_list *queue;
   bdd_ptr ans;
   fgnode *u;
   fgnode *n1;
   fgnode *n2;
   fgnode *cycle;
-  fgedge_list *el;
+  fgedge *e;
+  int i;
   int to_break=0;
   queue = NULL;
   while(1){
     while(queue != NULL)
       queue = fgnode_list_delete(queue);
-    fl=fg->fl;
-    vl=fg->vl;
-    do{
-      fl->n->color=0;
-      fl->n->parent=NULL;
-      fl=fl->next;
-    }while(fl!=fg->fl);
-
-    do{
-      vl->n->color=0;
-      vl->n->parent=NULL;
-      vl=vl->next;
-    }while(vl!=fg->vl);
+    for(i = 0; i < fg->num_funcs; i++){
+      fg->funcs[i]->color=0;
+      fg->funcs[i]->parent=NULL;
+    }
+
+    for(i = 0; i < fg->num_vars; i++){
+      fg->vars[i]->color=0;
+      fg->vars[i]->parent=NULL;
+    }
     queue = fgnode_list_add_node(fg, queue, v);
     v->color=1;
     v->parent=NULL;
@@ -434,50 +691,42 @@ bdd_ptr factor_graph_make_acyclic(factor_graph *fg,fgnode *v,int l){
       //fgdm("exploring", u->id);
       queue=fgnode_list_delete(queue);
 
-      el=u->neigh;
-      if(el != NULL)
+      for(i = 0; i < u->num_neigh; i++)
       {
-        do
-        {
-          SKIP_DEAD(el, fg);
-          if(el->e->vn==u->parent || el->e->fn == u->parent)
-          {
-            el = el->next;
-            continue;
+        e = u->neigh[i];
+        if(e->vn==u->parent || e->fn == u->parent)
+          continue;
+        if(u->type == FUNC_NODE){
+          if(e->vn->color==0){
+            e->vn->color=1;
+            e->vn->parent=u;
+            queue = fgnode_list_add_node(fg, queue, e->vn);
+            //fgdm("pushing v", e->vn->id);
+            if(queue != NULL) queue = queue->next;
+          }
+          else{
+            n1=e->vn;
+            n2=e->fn;
+            to_break=1;
+            break;
           }
-          if(u->type == FUNC_NODE){
-            if(el->e->vn->color==0){
-              el->e->vn->color=1;
-              el->e->vn->parent=u;
-              queue = fgnode_list_add_node(fg, queue, el->e->vn);
-              //fgdm("pushing v", el->e->vn->id);
-              if(queue != NULL) queue = queue->next;
-            }
-            else{
-              n1=el->e->vn;
-              n2=el->e->fn;
-              to_break=1;
-              break;
-            }
+        }
+        else{
+          assert(u->type == VAR_NODE);
+          if(e->fn->color==0){
+            e->fn->color=1;
+            e->fn->parent=u;
+            queue = fgnode_list_add_node(fg, queue,e->fn);
+            //fgdm("pushing f", e->fn->id);
+            if(queue != NULL) queue = queue->next;
           }
           else{
-            assert(u->type == VAR_NODE);
-            if(el->e->fn->color==0){
-              el->e->fn->color=1;
-              el->e->fn->parent=u;
-              queue = fgnode_list_add_node(fg, queue,el->e->fn);
-              //fgdm("pushing f", el->e->fn->id);
-              if(queue != NULL) queue = queue->next;
-            }
-            else{
-              n1=el->e->fn;
-              n2=el->e->vn;
-              to_break=1;
-              break;
-            }
+            n1=e->fn;
+            n2=e->vn;
+            to_break=1;
+            break;
           }
-          el = el->next;
-        }while(el!=u->neigh);
+        }
       }
     }
     while(queue != NULL)
@@ -509,11 +758,13 @@ bdd_ptr factor_graph_make_acyclic(factor_graph *fg,fgnode *v,int l){
     }
     //printf(".");
     //fflush(stdout);
+#if FACTOR_GRAPH_DEBUG
     if(factor_graph_verify(fg) < 0)
     {
       fgdm("verification failed", factor_graph_verify(fg));
       exit(0);
     }
+#endif
 
   }
 }
@@ -523,299 +774,116 @@ bdd_ptr factor_graph_make_acyclic(factor_graph *fg,fgnode *v,int l){
 
 
 
-int factor_graph_add_funcnode(factor_graph *fg, fgnode* fn)
+/** Adds a node to a factor graph, with edges to those of the given nodes,
+ *    of the other type, that it is connected to
+ * INPUTS : fg - pointer to factor graph
+ *          n - the node, not yet in any graph
+ *          others - the nodes it may be connected to
+ *          num_others - the size of others
+ * OUTPUT : successful - id of the node
+ *          unsuccessful - (-1), and the node is deleted
+ */
+int factor_graph_add_node(factor_graph *fg, fgnode *n, fgnode **others, int num_others)
 {
-  fgnode_list* newf;
-  int conn;
-  if(fg->fl == NULL)
+  int i, conn;
+  if(factor_graph_link_node(fg, n, -1) == -1)
   {
-    fg->fl = newf = fgnode_list_add_node(fg, fg->fl, fn);
-  }
-  else
-    newf = fgnode_list_add_node(fg, fg->fl, fn);
-
-  if(newf == NULL)
+    fgnode_delete(fg, n);
     return -1;
+  }
+  n->id = (n->type == FUNC_NODE ? ++(fg->max_fid) : ++(fg->max_vid));
+  n->undo_add = factor_graph_log(fg, FGUNDO_ADD_NODE, n->index, -1, -1, -1);
 
-  newf->n->id = ++(fg->max_fid);
-  fg->num_funcs++;
-
-  fgnode_list* viter = fg->vl;
-  do
+  for(i = 0; i < num_others; i++)
   {
-    SKIP_DEAD(viter, fg);
-    conn = factor_graph_is_connected(fg->m, newf->n, viter->n);
-    if(conn == 1)
-    {
-      if(factor_graph_add_edge(fg, newf->n, viter->n) == -1)
-      {
-        factor_graph_delete_funcnode(fg, fn);
-        return -1;
-      }
-    }else if(conn == -1)
+    fgnode *fn = (n->type == FUNC_NODE ? n : others[i]);
+    fgnode *vn = (n->type == FUNC_NODE ? others[i] : n);
+    conn = factor_graph_is_connected(fg->m, fn, vn);
+    if(conn == -1 || (conn == 1 && factor_graph_add_edge(fg, fn, vn) == -1))
     {
-      factor_graph_delete_funcnode(fg, fn);
+      factor_graph_delete_node(fg, n);
       return -1;
     }
-    viter = viter->next;
-  }while(viter != fg->vl);
-
-  return newf->n->id;
-}
-
-void factor_graph_hide_varnode(factor_graph *fg, fgnode *n)
-{
-  fgedge_list *el;
-  fgedge_list *nextel;
-  fgnode_list *vnl;
-
-  if(n->died <= fg->time)
-    return;
-  if(fg->time == n->born)
-  {
-    factor_graph_delete_varnode(fg, n);
-    return;
   }
-
-  el = n->neigh;
-  do {
-    nextel = el->next;
-    factor_graph_hide_edge(fg, el->e);
-    el = nextel;
-  }while(el != n->neigh);
-
-  vnl = fg->vl;
-  do {
-    if(vnl->n == n)
-    {
-      assert(vnl->died == n->died);
-      vnl->died = fg->time;
-      n->died = fg->time;
-      fg->num_vars--;
-      break;
-    }
-    vnl = vnl->next;
-  }while(vnl != fg->vl);
-  assert(n->died == fg->time);
-}
-
-void factor_graph_unhide_edge(factor_graph *fg, fgedge *e)
-{
-  fgedge_list *el;
-  assert(e->born <= fg->time);
-  if(e->died != fg->time)
-    return;
-  factor_graph_unhide_funcnode(fg, e->fn);
-  factor_graph_unhide_varnode(fg, e->vn);
-
-  el = e->fn->neigh;
-  do{
-    if(el->e == e)
-    {
-      assert(el->died == e->died);
-      el->died = TIME_INFTY;
-      e->fn->num_neigh++;
-      break;
-    }
-    el = el->next;
-  }while(el != e->fn->neigh);
-
-  el = e->vn->neigh;
-  do{
-    if(el->e == e)
-    {
-      assert(el->died == e->died);
-      el->died = TIME_INFTY;
-      e->vn->num_neigh++;
-      break;
-    }
-    el = el->next;
-  }while(el != e->vn->neigh);
-
-  el = fg->el;
-  do {
-    if(el->e == e)
-    {
-      assert(el->died == e->died);
-      el->died = TIME_INFTY;
-      fg->num_edges++;
-      break;
-    }
-    el = el->next;
-  }while(el != fg->el);
-
-  e->died = TIME_INFTY;
+  return n->id;
 }
 
-void factor_graph_unhide_varnode(factor_graph *fg, fgnode *n)
+int factor_graph_add_funcnode(factor_graph *fg, fgnode* fn)
 {
-  fgnode_list *vl;
-  assert(n->born <= fg->time);
-  if(n->died != fg->time)
-    return;
-  vl = fg->vl;
-  do {
-    if(vl->n == n)
-    {
-      assert(vl->died == n->died);
-      vl->died = TIME_INFTY;
-      fg->num_vars++;
-      break;
-    }
-    vl = vl->next;
-  }while(vl != fg->vl);
-  n->died = TIME_INFTY;
+  // only the var nodes of the variables of fn can be connected to it,
+  // taken in the order of the var nodes of the graph
+  const std::vector<fgnode *> &var_nodes = fg->store->var_nodes;
+  std::vector<fgnode *> candidates;
+  for(int i = 0; i < fn->fs; i++)
+    for_each_cube_index(fn->ss[i],
+                        [&](int index) {
+                          if(index < (int)var_nodes.size() && var_nodes[index] != NULL)
+                            candidates.push_back(var_nodes[index]);
+                        });
+  std::sort(candidates.begin(), candidates.end(), [](const fgnode *a, const fgnode *b) { return a->pos < b->pos; });
+  candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+  return factor_graph_add_node(fg, fn, candidates.data(), (int)candidates.size());
 }
 
-void factor_graph_unhide_funcnode(factor_graph *fg, fgnode *n)
+int factor_graph_add_varnode(factor_graph *fg, fgnode* vn)
 {
-  fgnode_list *fl;
-  assert(n->born <= fg->time);
-  if(n->died != fg->time)
-    return;
-  fl = fg->fl;
-  do {
-    if(fl->n == n)
-    {
-      assert(fl->died == n->died);
-      fl->died = TIME_INFTY;
-      fg->num_funcs++;
-      break;
-    }
-    fl = fl->next;
-  }while(fl != fg->fl);
-  n->died = TIME_INFTY;
+  return factor_graph_add_node(fg, vn, fg->funcs, fg->num_funcs);
 }
 
-void factor_graph_hide_funcnode(factor_graph *fg, fgnode *n)
+/** Hides a node of a factor graph, and its edges, till the next rollback,
+ *  or deletes it if it was born after the last checkpoint
+ */
+void factor_graph_hide_node(factor_graph *fg, fgnode *n)
 {
-  fgedge_list *el;
-  fgnode_list *fnl;
-  fgedge_list *nextel;
-
-  if(n->died <= fg->time)
+  if(n->pos < 0)
     return;
   if(n->born == fg->time)
   {
-    factor_graph_delete_funcnode(fg, n);
+    factor_graph_delete_node(fg, n);
     return;
   }
 
-  el = n->neigh;
-  do {
-    nextel = el->next;
-    factor_graph_hide_edge(fg, el->e);
-    el = nextel;
-  }while(el != n->neigh);
+  while(n->num_neigh > 0)
+    factor_graph_hide_edge(fg, n->neigh[n->num_neigh - 1]);
 
-  fnl = fg->fl;
-  do {
-    if(fnl->n == n)
-    {
-      assert(fnl->died == n->died);
-      fg->num_funcs--;
-      fnl->died = fg->time;
-      n->died = fg->time;
-      break;
-    }
-    fnl = fnl->next;
-  }while(fnl != fg->fl);
+  n->undo_hide = factor_graph_log(fg, FGUNDO_HIDE_NODE, n->index, n->pos, -1, -1);
+  factor_graph_unlink_node(fg, n);
+  n->died = fg->time;
 }
 
 void factor_graph_hide_edge(factor_graph *fg, fgedge *e)
 {
-  fgedge_list *el;
-  if(e->died <= fg->time)
+  if(e->pos < 0)
     return;
-
   if(e->born == fg->time)
   {
     factor_graph_delete_edge(fg, e);
     return;
   }
 
-  el = fg->el;
-  do
-  {
-    if(el->e == e)
-    {
-      assert(el->died == e->died);
-      el->died = fg->time;
-      break;
-    }
-    el = el->next;
-  }while(el != fg->el);
-
-  assert(e != NULL);
-  assert(e->fn != NULL);
-  el = e->fn->neigh;
-  do
-  {
-    if(el->e == e)
-    {
-      assert(el->died == e->died);
-      el->died = fg->time;
-      break;
-    }
-    el = el->next;
-  }while(el != e->fn->neigh);
-
-  el = e->vn->neigh;
-  do
-  {
-    if(el->e == e)
-    {
-      assert(el->died == e->died);
-      el->died = fg->time;
-      break;
-    }
-    el = el->next;
-  }while(el != e->vn->neigh);
-
+  e->undo_hide = factor_graph_log(fg, FGUNDO_HIDE_EDGE, e->index, e->pos, e->fpos, e->vpos);
+  factor_graph_unlink_edge(fg, e);
   e->died = fg->time;
-  e->vn->num_neigh--;
-  e->fn->num_neigh--;
-  fg->num_edges--;
 }
 
-int factor_graph_add_varnode(factor_graph *fg, fgnode* vn)
+/** Brings back a hidden node, at the position it was hidden from
+ */
+void factor_graph_unhide_node(factor_graph *fg, fgnode *n, int pos)
 {
-  fgnode_list* newv;
-  int conn;
-  if(fg->vl == NULL)
-  {
-    newv = fgnode_list_add_node(fg, fg->vl, vn);
-  }
-  else
-    newv = fgnode_list_add_node(fg, fg->vl, vn);
-
-  if(newv == NULL)
-    return -1;
-
-  newv->n->id = ++(fg->max_vid);
-  fg->num_vars++;
-
-  fgnode_list* fiter = fg->fl;
-  do
-  {
-    SKIP_DEAD(fiter, fg);
-    conn = factor_graph_is_connected(fg->m, fiter->n, newv->n);
-    if(conn == 1)
-    {
-      if(factor_graph_add_edge(fg, fiter->n, newv->n) == -1)
-      {
-        factor_graph_delete_varnode(fg, vn);
-        return -1;
-      }
-    }else if(conn == -1)
-    {
-      factor_graph_delete_varnode(fg, vn);
-      return -1;
-    }
-    fiter = fiter->next;
-  }while(fiter != fg->fl);
+  assert(n->pos < 0);
+  factor_graph_link_node(fg, n, pos);
+  n->died = TIME_INFTY;
+  n->undo_hide = -1;
+}
 
-  return newv->n->id;
+/** Brings back a hidden edge, at the positions it was hidden from
+ */
+void factor_graph_unhide_edge(factor_graph *fg, fgedge *e, int pos, int fpos, int vpos)
+{
+  assert(e->pos < 0 && e->fn->pos >= 0 && e->vn->pos >= 0);
+  factor_graph_link_edge(fg, e, pos, fpos, vpos);
+  e->died = TIME_INFTY;
+  e->undo_hide = -1;
 }
 
 
@@ -830,73 +898,18 @@ int factor_graph_add_varnode(factor_graph *fg, fgnode* vn)
  */
 int factor_graph_add_edge(factor_graph *fg, fgnode * f, fgnode * v)
 {
-  fgedge_list *el;
   fgedge *e;
 
-  el = fgedge_list_new(fg, f, v);
-  if(el==NULL)
-    return -1;
-
-  if(fg->el == NULL)
-    fg->el = el;
-  else
-  {
-    el->next = fg->el;
-    el->prev = fg->el->prev;
-    if(el->prev != NULL)
-      el->prev->next = el;
-    fg->el->prev = el;
-  }
-  el->e->id = ++(fg->max_eid);
-  fg->num_edges++;
-
-  e = el->e;
-  el = (fgedge_list *)malloc(sizeof(fgedge_list));
-  if(el == NULL)
+  e = fgedge_new(fg, f, v);
+  if(e==NULL)
     return -1;
-  el->e = e;
-  if(f->neigh == NULL)
-  {
-    f->neigh = el;
-    el->next = el->prev = el;
-  }
-  else
-  {
-    el->next = f->neigh;
-    el->prev = f->neigh->prev;
-    el->next->prev = el;
-    if(el->prev != NULL)
-      el->prev->next = el;
-  }
-  el->e->id = fg->max_eid;
-  el->born = fg->time;
-  el->died = TIME_INFTY;
-  f->num_neigh++;
 
-  el = (fgedge_list *)malloc(sizeof(fgedge_list));
-  if(el == NULL)
+  if(factor_graph_link_edge(fg, e, -1, -1, -1) == -1)
     return -1;
-  el->e = e;
-  if(v->neigh == NULL)
-  {
-    el->next = el->prev = el;
-    v->neigh = el;
-  }
-  else
-  {
-    el->next = v->neigh;
-    el->prev = v->neigh->prev;
-    el->next->prev = el;
-    if(el->prev != NULL)
-      el->prev->next = el;
-  }
-  el->e->id = fg->max_eid;
-  el->born = fg->time;
-  el->died = TIME_INFTY;
-  v->num_neigh++;
+  e->id = ++(fg->max_eid);
+  e->undo_add = factor_graph_log(fg, FGUNDO_ADD_EDGE, e->index, -1, -1, -1);
 
-
-  return el->e->id;
+  return e->id;
 }
 
 /** Adds a variable node to a factor graph
@@ -906,42 +919,10 @@ int factor_graph_add_edge(factor_graph *fg, fgnode * f, fgnode * v)
  */
 int factor_graph_add_var(factor_graph *fg, bdd_ptr v)
 {
-  fgnode_list* newv;
-  int conn;
-  if(fg->vl == NULL)
-  {
-    newv = fg->vl = fgnode_list_new_var(fg, v);
-  }
-  else
-    newv = fgnode_list_add_var(fg, fg->vl, v);
-
+  fgnode *newv = fgnode_new_var(fg, v);
   if(newv == NULL)
     return -1;
-
-  newv->n->id = ++(fg->max_vid);
-  fg->num_vars++;
-
-  fgnode_list* fiter = fg->fl;
-  if(fiter != NULL) do
-  {
-    SKIP_DEAD(fiter, fg);
-    conn = factor_graph_is_connected(fg->m, fiter->n, newv->n);
-    if(conn == 1)
-    {
-      if(factor_graph_add_edge(fg, fiter->n, newv->n) == -1)
-      {
-        factor_graph_delete_var(fg, v);
-        return -1;
-      }
-    }else if(conn == -1)
-    {
-      factor_graph_delete_var(fg, v);
-      return -1;
-    }
-    fiter = fiter->next;
-  }while(fiter != fg->fl);
-
-  return newv->n->id;
+  return factor_graph_add_varnode(fg, newv);
 }
 
 /** Answers whether a function node's support set intersects with a variable node
@@ -986,247 +967,35 @@ int factor_graph_is_connected(DdManager * m, fgnode* f, fgnode *v)
  */
 int factor_graph_add_func(factor_graph *fg, bdd_ptr f)
 {
-  fgnode_list* newf;
-  int conn;
-  if(fg->fl == NULL)
-  {
-    newf = fg->fl = fgnode_list_new_func(fg, f);
-  }
-  else
-    newf = fgnode_list_add_func(fg, fg->fl, f);
-
+  fgnode *newf = fgnode_new_func(fg, f);
   if(newf == NULL)
     return -1;
-
-  newf->n->id = ++(fg->max_fid);
-  fg->num_funcs++;
-
-  fgnode_list* viter = fg->vl;
-  if(viter != NULL)
-  {
-    do
-    {
-      conn = factor_graph_is_connected(fg->m, newf->n, viter->n);
-      if(conn == 1)
-      {
-        if(factor_graph_add_edge(fg, newf->n, viter->n) == -1)
-        {
-          factor_graph_delete_funcnode(fg, newf->n);
-          return -1;
-        }
-      }
-      viter = viter->next;
-    }while(viter != fg->vl);
-  }
-
-  return newf->n->id;
-}
-
-/** Deletes a variable from a graph, including all its neighboring edges
-*/
-void factor_graph_delete_varnode(factor_graph * fg, fgnode* v)
-{
-  int i;
-  fgnode_list * vl = fg->vl;
-  fgnode * vn;
-
-  //Search for the var node
-  if (vl->n != v)
-    do {
-      vl = vl->next;
-    }while((vl->n != v || vl->n->type == FUNC_NODE) && vl != fg->vl);
-  if(vl->n->type == FUNC_NODE || vl->n != v) // node does not exist
-    return;
-  vn = vl->n;
-
-  //delete all neighboring edges from the graph
-  while(vn->neigh != NULL)
-    factor_graph_delete_edge(fg, vn->neigh->e);
-
-  //delete the variable from the graph
-  if(vl->died > fg->time)
-    fg->num_vars --;
-  //printf("deleting v%d (%d, %d)\n", vl->n->id, vl->n->born, vl->n->died);
-  //fflush(stdout);
-  assert(vl->born == vn->born);
-  assert(vl->n == vn);
-  assert(vl->died == vn->died);
-  fgnode_delete(fg->m, vn);
-  if(fg->vl == vl)
-    fg->vl = fgnode_list_delete(vl);
-  else
-    fgnode_list_delete(vl);
-}
-
-/** Deletes a variable from a graph, including all its neighboring edges
-*/
-void factor_graph_delete_var(factor_graph * fg, bdd_ptr v)
-{
-  int i;
-  fgnode_list * vl = fg->vl;
-  fgnode * vn;
-
-  //Search for the var node
-  do {
-    vl = vl->next;
-  }while((vl->n->f[0] != v || vl->n->type == FUNC_NODE) && vl != fg->vl);
-  if(vl->n->type == FUNC_NODE || vl->n->f[0] != v) // node does not exist
-    return;
-  vn = vl->n;
-
-  //delete all neighboring edges from the graph
-  while(vn->neigh != NULL)
-    factor_graph_delete_edge(fg, vn->neigh->e);
-
-  //delete the variable from the graph
-  fgnode_delete(fg->m, vn);
-  if(fg->vl == vl)
-    fg->vl = fgnode_list_delete(vl);
-  else
-    fgnode_list_delete(vl);
-  fg->num_vars --;
-}
-
-/** Deletes a function from a graph, including all its neighboring edges
-*/
-void factor_graph_delete_func(factor_graph * fg, bdd_ptr f)
-{
-  int i;
-  fgnode_list * fl = fg->fl;
-  fgnode * fn;
-
-  //Search for the func node
-  if(fl->n->f[0] != f)
-    do
-      fl = fl->next;
-    while((fl->n->f[0] != f || fl->n->type == VAR_NODE)  && fl != fg->fl);
-  if(fl->n->type == VAR_NODE || fl->n->f[0] != f) // node does not exist
-    return;
-  fn = fl->n;
-
-  //delete all neighboring edges from the graph
-  while(fn->neigh != NULL)
-    factor_graph_delete_edge(fg, fn->neigh->e);
-
-  //delete the function from the graph
-  fgnode_delete(fg->m, fn);
-  if(fg->fl == fl)
-    fg->fl = fgnode_list_delete(fl);
-  else
-    fgnode_list_delete(fl);
-  fg->num_funcs --;
+  return factor_graph_add_funcnode(fg, newf);
 }
 
-/** Deletes a function from a graph, including all its neighboring edges
+/** Deletes a node from a graph, including all its edges
 */
-void factor_graph_delete_funcnode(factor_graph * fg, fgnode* f)
+void factor_graph_delete_node(factor_graph * fg, fgnode* n)
 {
-  int i;
-  fgnode_list * fl = fg->fl;
-  fgnode * fn;
-
-  //Search for the func node
-  if(fl->n != f)
-    do
-      fl = fl->next;
-    while((fl->n != f || fl->n->type == VAR_NODE)  && fl != fg->fl);
-  if(fl->n->type == VAR_NODE || fl->n != f) // node does not exist
-    return;
-  fn = fl->n;
-
   //delete all neighboring edges from the graph
-  while(fn->num_neigh > 0)
-  {
-    factor_graph_delete_edge(fg, fn->neigh->e);
-
-  }
+  while(n->num_neigh > 0)
+    factor_graph_delete_edge(fg, n->neigh[n->num_neigh - 1]);
 
-  if(fn->died > fg->time)
-    fg->num_funcs --;
-  //delete the function from the graph
-  fgnode_delete(fg->m, fn);
-  if(fg->fl == fl)
-    fg->fl = fgnode_list_delete(fl);
-  else
-    fgnode_list_delete(fl);
+  //delete the node from the graph
+  if(n->pos >= 0)
+    factor_graph_unlink_node(fg, n);
+  factor_graph_forget(fg, n->undo_add, n->undo_hide);
+  fgnode_delete(fg, n);
 }
 
 /** Deletes an edge from a graph. Does not delete the nodes.
 */
 void factor_graph_delete_edge(factor_graph *fg, fgedge * e)
 {
-  fgedge_list * el;
-  fgedge_list * iter;
-  int i;
-
-  //delete edge list from function node
-  el = e->fn->neigh;
-
-  if(el->e == e)
-  {
-    if(el->died > fg->time)
-      e->fn->num_neigh--;
-    e->fn->neigh = fgedge_list_delete(el);
-  }
-  else
-  {
-    do
-    {
-      if(el->e == e)
-      {
-        if(el->died > fg->time)
-          e->fn->num_neigh--;
-        fgedge_list_delete(el);
-        break;
-      }
-      el = el->next;
-    }while(el != e->fn->neigh);
-  }
-
-  //delete edge list from var node
-  el = e->vn->neigh;
-  if(el->e == e)
-  {
-    if(el->died > fg->time)
-      e->vn->num_neigh--;
-    e->vn->neigh = fgedge_list_delete(el);
-  }
-  else
-    do
-    {
-      if(el->e == e)
-      {
-        if(el->died > fg->time)
-          e->vn->num_neigh--;
-        fgedge_list_delete(el);
-        break;
-      }
-      el = el->next;
-    }while(el != e->vn->neigh);
-
-  el = fg->el;
-  if(el->e == e)
-  {
-    if(el->died > fg->time)
-      fg->num_edges--;
-    fg->el = fgedge_list_delete(el);
-  }
-  else
-  {
-    do
-    {
-      if(el->e == e)
-      {
-        if(el->died > fg->time)
-          fg->num_edges--;
-        fgedge_list_delete(el);
-        break;
-      }
-      el = el->next;
-    }while(el != fg->el);
-  }
-  fgedge_delete(fg->m, e);
-
+  if(e->pos >= 0)
+    factor_graph_unlink_edge(fg, e);
+  factor_graph_forget(fg, e->undo_add, e->undo_hide);
+  fgedge_delete(fg, e);
 }
 
 /* ------------- fgnode Datastructure ----------------*/
@@ -1259,108 +1028,102 @@ int fgnode_intersects_var(factor_graph *fg, fgnode *n, bdd_ptr var)
   return 1;
 }
 
+/** A node of the given type, from the arena of the graph,
+ *  without functions, edges or an id yet, or NULL if out of memory
+ */
+fgnode * fgnode_alloc(factor_graph *fg, fgnode_type type)
+{
+  fgnode * fgn = fg->store->nodes.alloc();
+  if(fgn == NULL)
+    return NULL;
+  fgn->id = -1;
+  fgn->f = fgn->ss = NULL;
+  fgn->fs = 0;
+  fgn->parent = NULL;
+  fgn->neigh = NULL;
+  fgn->num_neigh = 0;
+  fgn->neigh_capacity = 0;
+  fgn->num_messages = 0;
+  fgn->color = 0;
+  fgn->type = type;
+  fgn->born = fg->time;
+  fgn->died = TIME_INFTY;
+  fgn->partials = NULL;
+  fgn->num_firings = 0;
+  fgn->fire_time = 0;
+  fgn->pos = -1;
+  fgn->undo_add = fgn->undo_hide = -1;
+  return fgn;
+}
+
 fgnode * fgnode_new_func(factor_graph *fg, bdd_ptr f)
 {
-  fgnode * fgn = (fgnode *)malloc(sizeof(fgnode));
+  fgnode * fgn = fgnode_alloc(fg, FUNC_NODE);
   if(fgn == NULL)
     return NULL;
   fgn->f = (bdd_ptr*)malloc(sizeof(bdd_ptr ));
   fgn->ss = (bdd_ptr*)malloc(sizeof(bdd_ptr ));
   if(fgn->f == NULL || fgn->ss == NULL)
   {
-    if(fgn->f != NULL) free(fgn->f);
-    if(fgn->ss != NULL) free(fgn->ss); 
-    free(fgn);
+    fgnode_delete(fg, fgn);
     return NULL;
   }
   fgn->f[0] = bdd_dup(f);
   fgn->ss[0] = bdd_support(fg->m, f);
-  fgn->id = -1;
-  fgn->neigh = NULL;
-  fgn->num_neigh =  0;
-  fgn->type = FUNC_NODE;
-  fgn->color = 0;
-  fgn->parent = NULL;
   fgn->fs = 1;
-  fgn->born = fg->time;
-  fgn->died = TIME_INFTY;
   return fgn;
 }
 
 fgnode * fgnode_new_var(factor_graph *fg, bdd_ptr v)
 {
-  fgnode * fgn = (fgnode*)malloc(sizeof(fgnode));
+  fgnode * fgn = fgnode_alloc(fg, VAR_NODE);
   if(fgn == NULL)
     return NULL;
-  fgn->id = -1;
-  fgn->neigh = NULL;
-  fgn->num_neigh =  0;
-  fgn->type = VAR_NODE;
   fgn->f = (bdd_ptr *)malloc(sizeof(bdd_ptr));
-  if(fgn->f == NULL)
-  {
-    free(fgn);
-    return NULL;
-  }
-  fgn->f[0] = bdd_dup(v);
   fgn->ss = (bdd_ptr *)malloc(sizeof(bdd_ptr));
-  if(fgn->ss == NULL)
+  if(fgn->f == NULL || fgn->ss == NULL)
   {
-    bdd_free(fg->m, fgn->f[0]);
-    free(fgn->f);
-    free(fgn);
+    fgnode_delete(fg, fgn);
     return NULL;
   }
+  fgn->f[0] = bdd_dup(v);
   fgn->ss[0] = bdd_dup(v);
   fgn->fs = 1;
-  fgn->color = 0;
-  fgn->parent = NULL;
-  fgn->born = fg->time;
-  fgn->died = TIME_INFTY;
   return fgn;
 }
 
-void fgnode_delete(DdManager *m, fgnode *n)
+/** Frees a node, which must have no live edges, back to the arena of the graph
+ */
+void fgnode_delete(factor_graph *fg, fgnode *n)
 {
   int i;
   if(n->f != NULL)
   {
     for(i = 0; i < n->fs; i++)
       if(n->f[i] != NULL)
-        bdd_free(m, n->f[i]);
+        bdd_free(fg->m, n->f[i]);
     free(n->f);
   }
   if(n->ss != NULL)
   {
     for(i = 0; i < n->fs; i++)
       if(n->ss[i] != NULL)
-        bdd_free(m, n->ss[i]);
+        bdd_free(fg->m, n->ss[i]);
     free(n->ss);
   }
 
-  while(n->num_neigh > 0)
-  {
-    n->neigh = fgedge_list_delete(n->neigh);
-    n->num_neigh--;
-  }
-  free(n);
+  free(n->neigh);
+  delete n->partials;
+  fg->store->nodes.release(n);
 }
 
 fgnode *fgnode_new_composite_node(factor_graph *fg, fgnode *fn1,fgnode *fn2)
 {
   int i;
-  fgnode *F=(fgnode *)malloc(sizeof(fgnode));
-  F->born = fg->time;
-  F->died = TIME_INFTY;
-  if(F == NULL)
-    return NULL;
-  F->id = -1;
-  F->neigh = NULL;
-  F->num_neigh = 0;
-  F->type = FUNC_NODE;
-  F->color = 0;
-  F->parent = NULL;
   if(fn1->type==FUNC_NODE && fn2->type==FUNC_NODE){
+    fgnode *F = fgnode_alloc(fg, FUNC_NODE);
+    if(F == NULL)
+      return NULL;
     F->fs=fn1->fs + fn2->fs;
     F->f=(bdd_ptr *)malloc(sizeof(bdd_ptr)*(F->fs));
     for(i=0; i < fn1->fs; i++)
@@ -1372,6 +1135,7 @@ fgnode *fgnode_new_composite_node(factor_graph *fg, fgnode *fn1,fgnode *fn2)
       F->ss[i]=bdd_dup(fn1->ss[i]);
     for(i=0;i<fn2->fs;i++)
       F->ss[i+fn1->fs]=bdd_dup(fn2->ss[i]);
+    return F;
   }
   else
   {
@@ -1381,124 +1145,121 @@ fgnode *fgnode_new_composite_node(factor_graph *fg, fgnode *fn1,fgnode *fn2)
     fflush(stdout);
     return NULL;
   }
+}
 
-  return F;
+
+/** The AND of the given bdds and the incoming messages of a node,
+ *  from its tree of partial conjunctions if it has one, else from scratch
+ */
+bdd_ptr and_with_incoming(factor_graph *fg, fgnode *n, bdd_ptr *first, int num_first, bdd_ptr fgedge::*msg)
+{
+  std::vector<bdd_ptr> leaves(first, first + num_first);
+  for (int i = 0; i < n->num_neigh; i++)
+    leaves.push_back(n->neigh[i]->*msg);
+  if (fg->partial_product_degree <= 0
+      || (int)leaves.size() - num_first < fg->partial_product_degree)
+  {
+    delete n->partials;
+    n->partials = NULL;
+    bdd_ptr result = bdd_one(fg->m);
+    for (auto leaf: leaves)
+      bdd_and_accumulate(fg->m, &result, leaf);
+    return result;
+  }
+  if (NULL == n->partials)
+    n->partials = new parakram::ConjunctionTree(fg->m);
+  return bdd_dup(n->partials->update(&leaves.front(), (int)leaves.size()));
 }
 
 
-int var_node_pass_messages(factor_graph *fg, fgnode *n, fgnode_list *queue)
+
+int var_node_pass_messages(factor_graph *fg, fgnode *n)
 {
   assert(n->type == VAR_NODE);
   // compute the AND of all incoming messages
-  bdd_ptr and_all_incoming = bdd_one(fg->m);
-  for_each_list(n->neigh,
-                [&](fgedge_list * el) {
-                    bdd_and_accumulate(fg->m, &and_all_incoming, el->e->msg_fv);
-                },
-                fg->time);
+  bdd_ptr and_all_incoming = and_with_incoming(fg, n, NULL, 0, &fgedge::msg_fv);
 
   int error = 0;
-  // for each outgoing edge
-  for_each_list(n->neigh,
-                [&](fgedge_list * el) {
-
-                    // exit on memory errors
-                    if (error)
-                        return;
-
-                    // compute the and of
-                    //   the outgoing message
-                    //   and
-                    //   the AND of all incoming messages
-                    bdd_ptr new_outgoing = bdd_and(fg->m, and_all_incoming, el->e->msg_vf);
-                    
-                    // if the message needs updating
-                    if (new_outgoing != el->e->msg_vf)
-                    {
-                        // assign the new message to the outgoing edge
-                        bdd_free(fg->m, el->e->msg_vf);
-                        el->e->msg_vf = new_outgoing;
-
-                        // add the func node to the queue if appropriate
-                        if (IS_UNVISITED(el->e->fn))
-                        {
-                            SET_VISITED(el->e->fn);
-                            if (NULL == fgnode_list_add_node(fg, queue, el->e->fn))
-                              error = 1;
-                        }
-                    }
-                    else
-                        // else throw this new msg away
-                        bdd_free(fg->m, new_outgoing);
-
-                },
-                fg->time);
+  int num_changed = 0;
+  // for each outgoing edge, till a memory error
+  for (int i = 0; i < n->num_neigh && !error; i++)
+  {
+    fgedge * e = n->neigh[i];
+
+    // compute the and of
+    //   the outgoing message
+    //   and
+    //   the AND of all incoming messages
+    bdd_ptr new_outgoing = bdd_and(fg->m, and_all_incoming, e->msg_vf);
+
+    // if the message needs updating
+    if (new_outgoing != e->msg_vf)
+    {
+      // assign the new message to the outgoing edge
+      bdd_free(fg->m, e->msg_vf);
+      e->msg_vf = new_outgoing;
+      ++num_changed;
+
+      // add the func node to the queue if it is not there yet
+      if (factor_graph_enqueue(fg, e->fn) == -1)
+        error = 1;
+    }
+    else
+      // else throw this new msg away
+      bdd_free(fg->m, new_outgoing);
+  }
   bdd_free(fg->m, and_all_incoming);
-  return error * -1;
+  return error ? -1 : num_changed;
 }
 
 
 
-int func_node_pass_messages(factor_graph *fg, fgnode *n, fgnode_list *queue)
+int func_node_pass_messages(factor_graph *fg, fgnode *n)
 {
   assert(FUNC_NODE == n->type);
   
-  // compute the conjunction of all incoming messages
-  bdd_ptr and_all_incoming = bdd_one(fg->m);
-  for_each_list(n->neigh,
-                [&](fgedge_list *el) 
-                {
-                  bdd_and_accumulate(fg->m, &and_all_incoming, el->e->msg_vf);
-                },
-                fg->time);
-
-
-  // conjoin it with all the functions in the func node
-  for (int fi = 0; fi < n->fs; ++fi)
-    bdd_and_accumulate(fg->m, &and_all_incoming, n->f[fi]);
+  // compute the conjunction of all incoming messages,
+  // and of all the functions in the func node
+  bdd_ptr and_all_incoming = and_with_incoming(fg, n, n->f, n->fs, &fgedge::msg_vf);
 
 
   // variable to catch memory errors in loop
   int error = 0;
+  int num_changed = 0;
+
+  // the support set, shared by all the edges
+  bdd_ptr all_vars = bdd_support(fg->m, and_all_incoming);
 
-  // on each edge
-  for_each_list(n->neigh,
-                [&](fgedge_list * el)
-                {
-                  // exit on memory error
-                  if (error)
-                    return;
-
-                  // compute the complement of the support set
-                  bdd_ptr all_vars = bdd_support(fg->m, and_all_incoming);
-                  bdd_ptr ssbar = bdd_cube_diff(fg->m, all_vars, el->e->vn->ss[0]);
-                  bdd_free(fg->m, all_vars);
-
-                  // compute:
-                  //   the and of all incoming messages
-                  //   AND
-                  //   the previous outgoing message
-                  // and project it onto the var node of the outgoing edge
-                  bdd_ptr new_outgoing = bdd_and_exists(fg->m, and_all_incoming, el->e->msg_fv, ssbar);
-                  bdd_free(fg->m, ssbar);
-                  // check if the new_outgoing is better
-                  if (new_outgoing != el->e->msg_fv)
-                  {
-                    bdd_free(fg->m, el->e->msg_fv);
-                    el->e->msg_fv = new_outgoing;
-                    if (IS_UNVISITED(el->e->vn))
-                    {
-                      if (NULL == fgnode_list_add_node(fg, queue, el->e->vn))
-                        error = 1;
-                      SET_VISITED(el->e->vn);
-                    }
-                  } else
-                    bdd_free(fg->m, new_outgoing);
-                },
-                fg->time);
+  // on each edge, till a memory error
+  for (int i = 0; i < n->num_neigh && !error; i++)
+  {
+    fgedge * e = n->neigh[i];
+
+    // compute the complement of the support set
+    bdd_ptr ssbar = bdd_cube_diff(fg->m, all_vars, e->vn->ss[0]);
+
+    // compute:
+    //   the and of all incoming messages
+    //   AND
+    //   the previous outgoing message
+    // and project it onto the var node of the outgoing edge
+    bdd_ptr new_outgoing = bdd_and_exists(fg->m, and_all_incoming, e->msg_fv, ssbar);
+    bdd_free(fg->m, ssbar);
+    // check if the new_outgoing is better
+    if (new_outgoing != e->msg_fv)
+    {
+      bdd_free(fg->m, e->msg_fv);
+      e->msg_fv = new_outgoing;
+      ++num_changed;
+      if (factor_graph_enqueue(fg, e->vn) == -1)
+        error = 1;
+    } else
+      bdd_free(fg->m, new_outgoing);
+  }
 
+  bdd_free(fg->m, all_vars);
   bdd_free(fg->m, and_all_incoming);
-  return error * -1;
+  return error ? -1 : num_changed;
 }
 
 
@@ -1507,57 +1268,38 @@ int func_node_pass_messages(factor_graph *fg, fgnode *n, fgnode_list *queue)
 */
 int var_node_pass_messages_up(factor_graph *fg, fgnode *n, fgnode **parent)
 {
-  fgedge_list *el, *eparent;
+  fgedge *eparent = NULL;
   bdd_ptr F;
+  int i;
   int error = 0;
   assert(n->type == VAR_NODE && "Var_node_pass_messages_up called on a non-var-node\n");
-  el = n->neigh;
   F = bdd_one(fg->m);
-  double init,final;
 
   // Find the parent, the edge where message from function to variable is not passed
   //  init = clock();
-  do {
-    SKIP_DEAD(el,fg);
-    if(el->e->msg_fv == NULL) {
-      assert(el->e->msg_vf == NULL);
-      eparent = el;
-
-      // Check that rest of messages must be passed
-      el = el->next;
-      while(el != n->neigh) {
-        SKIP_DEAD(el,fg);
-        assert(el->e->msg_fv != NULL && "More than one message unpassed in acyclic var node message passing");
-        el = el->next;
-      }
-
-      break;
-
+  for(i = 0; i < n->num_neigh; i++) {
+    if(n->neigh[i]->msg_fv == NULL) {
+      assert(n->neigh[i]->msg_vf == NULL);
+      assert(eparent == NULL && "More than one message unpassed in acyclic var node message passing");
+      eparent = n->neigh[i];
     }
-    el = el->next;
-  } while(el != n->neigh);
+  }
   //	final = clock();
   //	time_find_parent += (double)(final-init) / ((double)CLOCKS_PER_SEC);
 
   assert(eparent != NULL && "Parent not found in acyclic var node message passing");
 
-  el = n->neigh;
-  do {
-    SKIP_DEAD(el,fg);
-    if(el == eparent) {
-      el = el->next;
+  for(i = 0; i < n->num_neigh; i++) {
+    if(n->neigh[i] == eparent)
       continue;
-    }
     //	  init = clock();
-    bdd_and_accumulate(fg->m,&F,el->e->msg_fv);
+    bdd_and_accumulate(fg->m,&F,n->neigh[i]->msg_fv);
     //    final = clock();
     //		time_combine += (double)(final-init) / ((double)CLOCKS_PER_SEC);
+  }
 
-    el = el->next;
-  } while(el != n->neigh);
-
-  eparent->e->msg_vf = bdd_dup(F);
-  eparent->e->fn->num_messages++;
+  eparent->msg_vf = bdd_dup(F);
+  eparent->fn->num_messages++;
 
 
 
@@ -1571,8 +1313,8 @@ int var_node_pass_messages_up(factor_graph *fg, fgnode *n, fgnode **parent)
 
 
 
-  //  assert(IS_UNVISITED(eparent->e->fn) && "Parent already visited");
-  *parent = eparent->e->fn;
+  //  assert(IS_UNVISITED(eparent->fn) && "Parent already visited");
+  *parent = eparent->fn;
   bdd_free(fg->m, F);
 
   return error*(-1);
@@ -1583,15 +1325,14 @@ int var_node_pass_messages_up(factor_graph *fg, fgnode *n, fgnode **parent)
 int func_node_pass_messages_up(factor_graph *fg, fgnode *n, fgnode **parent)
 {
   assert(n->type == FUNC_NODE);
-  fgedge_list *el, *eparent;
+  fgedge *eparent = NULL;
   bdd_ptr F;
-  int i;
+  int i, j;
   int error = 0;
   int exist_error = 0;
   int num_funcs = n->num_neigh + n->fs - 1;
   bdd_ptr * f1 = (bdd_ptr *)malloc(sizeof(bdd_ptr) * num_funcs);
   bdd_ptr *ss1 = (bdd_ptr *)malloc(sizeof(bdd_ptr) * num_funcs);
-  double init,final;
 
   if(f1 == NULL || ss1 == NULL)
   {
@@ -1602,30 +1343,15 @@ int func_node_pass_messages_up(factor_graph *fg, fgnode *n, fgnode **parent)
   }
 
 
-  el = n->neigh;
-  F = bdd_one(fg->m);
-
   // Find the parent, the edge where message from function to variable is not passed
   //  init = clock();
-  do {
-    SKIP_DEAD(el,fg);
-    if(el->e->msg_vf == NULL) {
-      assert(el->e->msg_fv == NULL);
-      eparent = el;
-
-      // Check that rest of messages must be passed
-      el = el->next;
-      while(el != n->neigh) {
-        SKIP_DEAD(el,fg);
-        assert(el->e->msg_vf != NULL && "More than one message unpassed in acyclic var node message passing");
-        el = el->next;
-      }
-
-      break;
-
+  for(j = 0; j < n->num_neigh; j++) {
+    if(n->neigh[j]->msg_vf == NULL) {
+      assert(n->neigh[j]->msg_fv == NULL);
+      assert(eparent == NULL && "More than one message unpassed in acyclic var node message passing");
+      eparent = n->neigh[j];
     }
-    el = el->next;
-  } while(el != n->neigh);
+  }
   //	final = clock();
   //	time_find_parent += (double)(final-init) / ((double)CLOCKS_PER_SEC);
 
@@ -1636,22 +1362,19 @@ int func_node_pass_messages_up(factor_graph *fg, fgnode *n, fgnode **parent)
     f1[i] = bdd_dup(n->f[i]);
     ss1[i] = bdd_dup(n->ss[i]);
   }
-  el = n->neigh;
-  do
+  for(j = 0; j < n->num_neigh; j++)
   {
-    SKIP_DEAD(el, fg);
-    if(el != eparent)
+    if(n->neigh[j] != eparent)
     {
-      f1[i] = bdd_dup(el->e->msg_vf);
-      ss1[i] = bdd_support(fg->m, el->e->msg_vf);
+      f1[i] = bdd_dup(n->neigh[j]->msg_vf);
+      ss1[i] = bdd_support(fg->m, n->neigh[j]->msg_vf);
       i++;
     }
-    el = el->next;
-  }while(el != n->neigh);
+  }
 
   assert(i == num_funcs);
 
-  exist_error = bdd_and_exist_vector(fg->m, f1, ss1, num_funcs, eparent->e->vn->ss[0]);
+  exist_error = bdd_and_exist_vector(fg->m, f1, ss1, num_funcs, eparent->vn->ss[0]);
 
   if(exist_error == -1)
   {
@@ -1681,10 +1404,11 @@ int func_node_pass_messages_up(factor_graph *fg, fgnode *n, fgnode **parent)
     }
     if(ss1[i] != NULL) bdd_free(fg->m, ss1[i]);
   }
-  eparent->e->msg_fv = bdd_dup(F);
-  eparent->e->vn->num_messages++;
-  assert(IS_UNVISITED(eparent->e->vn));
-  *parent = eparent->e->vn;
+  eparent->msg_fv = bdd_dup(F);
+  eparent->vn->num_messages++;
+  // in a tree without the root, the last two nodes may both be queued
+  assert(IS_UNVISITED(eparent->vn) || eparent->vn->num_messages == eparent->vn->num_neigh);
+  *parent = eparent->vn;
   bdd_free(fg->m, F);
   free(f1);
   free(ss1);
@@ -1726,82 +1450,6 @@ int fgnode_support_size(DdManager *m, fgnode *n)
 
 /* ------------- fgnode_list Datastructure ----------------*/
 
-/** creates a new variable node and adds it to the given fgnode_list
- * INPUTS : L - the fgnode_list to be appended
- *          n - bdd_ptr to the node
- * OUTPUT : successful - pointer the node list
- *          unsuccessful - NULL
- */
-fgnode_list * fgnode_list_add_var(factor_graph *fg, fgnode_list * L, bdd_ptr n)
-{
-  fgnode_list * newfgnl = fgnode_list_new_var(fg, n);
-  if(newfgnl == NULL)
-    return NULL;
-  newfgnl->next = L;
-  newfgnl->prev = L->prev;
-  if(L->prev != NULL)
-    L->prev->next = newfgnl;
-  L->prev = newfgnl;
-  return newfgnl;
-}
-
-/** creates a new variable node and uses it to create a new fgnode_list
- * INPUTS : n - bdd_ptr to the node
- * OUTPUT : successful - pointer the new node list
- *          unsuccessful - NULL
- */
-fgnode_list * fgnode_list_new_var(factor_graph *fg, bdd_ptr n)
-{
-  fgnode *var;
-  fgnode_list *fgnl ;
-
-  var = fgnode_new_var(fg, n);
-  if(var == NULL)
-    return NULL;
-
-  fgnl = (fgnode_list *)malloc(sizeof(fgnode_list));
-  if(fgnl == NULL)
-  {
-    fgnode_delete(fg->m, var);
-    return NULL;
-  }
-
-  fgnl->n = var;
-  fgnl->next = fgnl->prev = fgnl;
-  fgnl->born = fg->time;
-  fgnl->died = TIME_INFTY;
-  return fgnl;
-}
-
-/** creates a new function node and uses it to create a new fgnode_list
- * INPUTS : n - bdd_ptr to the node
- * OUTPUT : successful - pointer the new node list
- *          unsuccessful - NULL
- */
-fgnode_list * fgnode_list_new_func(factor_graph *fg, bdd_ptr n)
-{
-  fgnode *func;
-  fgnode_list *fgnl ;
-
-  func = fgnode_new_func(fg, n);
-  if(func == NULL)
-    return NULL;
-
-  fgnl = (fgnode_list *)malloc(sizeof(fgnode_list));
-  if(fgnl == NULL)
-  {
-    fgnode_delete(fg->m, func);
-    return NULL;
-  }
-
-  fgnl->n = func;
-  fgnl->next = fgnl->prev = fgnl;
-  fgnl->born = fg->time;
-  fgnl->died = TIME_INFTY;
-
-  return fgnl;
-}
-
 fgnode_list *fgnode_list_delete(fgnode_list * nl)
 {
   fgnode_list* result = (nl == nl->next ? NULL : nl->next);
@@ -1814,32 +1462,13 @@ fgnode_list *fgnode_list_delete(fgnode_list * nl)
   return result;
 }
 
-/** creates a new function node and adds it to the given fgnode_list
- * INPUTS : L - the fgnode_list to be appended
- *          n - bdd_ptr to the node
- * OUTPUT : successful - pointer the node list
- *          unsuccessful - NULL
- */
-fgnode_list *fgnode_list_add_func(factor_graph *fg, fgnode_list * L, bdd_ptr n)
-{
-  fgnode_list * newfgnl = fgnode_list_new_func(fg, n);
-  if(newfgnl == NULL)
-    return NULL;
-  newfgnl->next = L;
-  newfgnl->prev = L->prev;
-  if(L->prev != NULL)
-    L->prev->next = newfgnl;
-  L->prev = newfgnl;
-  return newfgnl;
-}
-
 /** adds a given fgnode to a fgnode list
  * INPUTS : L - the fgnode_list to be appended
  *          n - pointer to the fgnode
  * OUTPUT : successful - pointer the node list
  *          unsuccessful - NULL
  */
-fgnode_list *fgnode_list_add_node(factor_graph *fg, fgnode_list * L, fgnode * n)
+fgnode_list *fgnode_list_add_node(factor_graph *, fgnode_list * L, fgnode * n)
 {
   fgnode_list * newfgnl = (fgnode_list *)malloc(sizeof(fgnode_list));
   if(newfgnl == NULL)
@@ -1855,115 +1484,61 @@ fgnode_list *fgnode_list_add_node(factor_graph *fg, fgnode_list * L, fgnode * n)
       L->prev->next = newfgnl;
     L->prev = newfgnl;
   }
-  newfgnl->born = fg->time;
-  newfgnl->died = TIME_INFTY;
   return newfgnl;
 }
 
 /* ------------- fgedge Datastructure ----------------*/
-void fgedge_delete(DdManager *m, fgedge *e)
-{
-  if(e->msg_fv != NULL)
-    bdd_free(m, e->msg_fv);
-  if(e->msg_vf != NULL)
-    bdd_free(m, e->msg_vf);
-  free(e);
-}
 
-/* ------------- fgedge_list Datastructure ----------------*/
-fgedge_list * fgedge_list_new(factor_graph *fg, fgnode *f, fgnode *v)
+/** An edge between f and v, from the arena of the graph,
+ *  not yet linked to the graph or its nodes, or NULL if out of memory
+ */
+fgedge * fgedge_new(factor_graph *fg, fgnode *f, fgnode *v)
 {
-  fgedge * e;
-  fgedge_list *el;
-  e = (fgedge *)malloc(sizeof(fgedge));
+  fgedge * e = fg->store->edges.alloc();
   if(e == NULL)
     return NULL;
-
-  el = (fgedge_list *)malloc(sizeof(fgedge_list));
-  if(el == NULL)
-  {
-    free(e);
-    return NULL;
-  }
-
   e->id = -1;
   e->fn = f;
   e->vn = v;
   e->msg_fv = e->msg_vf = NULL;
-  el->next = el;
-  el->prev = el;
-  el->e = e;
   e->born = fg->time;
   e->died = TIME_INFTY;
-  el->born = fg->time;
-  el->died = TIME_INFTY;
-  return el;
-}
-
-fgedge_list * fgedge_list_delete(fgedge_list *el)
-{
-  fgedge_list * result = (el == el->next ? NULL : el->next);
-  if(el->next != NULL)
-    el->next->prev = el->prev;
-  if(el->prev != NULL)
-    el->prev->next = el->next;
-  free(el);
-  return result;
+  e->pos = e->fpos = e->vpos = -1;
+  e->undo_add = e->undo_hide = -1;
+  return e;
 }
 
-fgedge_list *fgedge_list_add_edge(factor_graph *fg, fgedge_list * L, fgedge * e)
+void fgedge_delete(factor_graph *fg, fgedge *e)
 {
-  fgedge_list *newfgnl = (fgedge_list *)malloc(sizeof(fgedge_list));
-  if(newfgnl == NULL)
-    return L;
-  newfgnl->e=e;
-  if(L == NULL){
-    newfgnl->prev=newfgnl;
-    newfgnl->next=newfgnl;
-  }
-  else
-  {
-    newfgnl->next = L;
-    newfgnl->prev = L->prev;
-    if(L->prev != NULL)
-      L->prev->next = newfgnl;
-    L->prev = newfgnl;
-  }
-  newfgnl->born = fg->time;
-  newfgnl->died = TIME_INFTY;
-  return newfgnl;
+  if(e->msg_fv != NULL)
+    bdd_free(fg->m, e->msg_fv);
+  if(e->msg_vf != NULL)
+    bdd_free(fg->m, e->msg_vf);
+  fg->store->edges.release(e);
 }
 
 
 
 /* ------------- External functions ----------------- */
 
+/** The var node holding one of the variables of the cube v, or NULL if none
+ */
 fgnode * factor_graph_get_varnode(factor_graph *fg, bdd_ptr v)
 {
-  fgnode_list *vl = fg->vl;
-  bdd_ptr temp = NULL;
-  do {
-    SKIP_DEAD(vl, fg);
-    temp = bdd_cube_intersection(fg->m, v, vl->n->ss[0]);
-    if(bdd_is_one(fg->m, temp))
-    {
-      bdd_free(fg->m, temp);
-      temp = NULL;
-    }
-    else
-      break;
-    vl = vl->next;
-  }while(vl != fg->vl);
-  if(temp == NULL)
-    return NULL;
-  bdd_free(fg->m, temp);
-  return vl->n;
+  const std::vector<fgnode *> &var_nodes = fg->store->var_nodes;
+  fgnode *result = NULL;
+  for_each_cube_index(v,
+                      [&](int index) {
+                        if(result == NULL && index < (int)var_nodes.size())
+                          result = var_nodes[index];
+                      });
+  return result;
 }
 
-bdd_ptr* factor_graph_incoming_messages(factor_graph * fg, fgnode * V, int *size)
+bdd_ptr* factor_graph_incoming_messages(factor_graph *, fgnode * V, int *size)
 {
   bdd_ptr * result;
-  fgedge_list *el;
+  int i;
 
   if(V->num_neigh == 0)
   {
@@ -1971,70 +1546,54 @@ bdd_ptr* factor_graph_incoming_messages(factor_graph * fg, fgnode * V, int *size
     return NULL;
   }
   result = (bdd_ptr *)malloc(sizeof(bdd_ptr) * V->num_neigh);
-  *size = 0;
-  el = V->neigh;
-  if(el != NULL) do
-  {
-    SKIP_DEAD(el, fg);
-    result[*size] = bdd_dup(el->e->msg_fv);
-    (*size)++;
-    el = el->next;
-  }while(el != V->neigh);
-  assert(*size == V->num_neigh);
+  for(i = 0; i < V->num_neigh; i++)
+    result[i] = bdd_dup(V->neigh[i]->msg_fv);
+  *size = V->num_neigh;
   return result;
 }
 
+/** Replaces the func nodes around the var node of var by their cofactors
+ *    with respect to var, and drops var from its var node, till the next rollback
+ *  Only the neighbours of that var node are looked at,
+ *    so the cost is proportional to the change rather than to the graph
+ *  Each new edge starts from the messages of the edge it replaces,
+ *    cofactored by var, for factor_graph_reconverge to start from
+ * OUTPUT : 0 if successful, 1 if out of memory
+ */
 int factor_graph_assign_var(factor_graph *fg, bdd_ptr var)
 {
-  fgnode_list *vl;
   fgnode * old_v;
   fgnode *newn;
-  fgnode_list *newneigh;
   bdd_ptr temp, unnegated;
-  fgedge_list *el, *nextel;
-  int found, i;
+  int i, j;
 
   unnegated = bdd_support(fg->m, var);
-  vl = fg->vl;
-  found = 0;
-  do {
-    SKIP_DEAD(vl, fg);
-    temp = bdd_cube_intersection(fg->m, unnegated, vl->n->ss[0]);
-    if(!bdd_is_one(fg->m, temp))
-    {
-      bdd_free(fg->m, temp);
-      found = 1;
-      break;
-    }
-    bdd_free(fg->m, temp);
-    vl = vl->next;
-  }while(vl != fg->vl);
+  old_v = factor_graph_get_varnode(fg, unnegated);
   //fgdm("here1", 0);
-  if(!found)
+  if(old_v == NULL)
+  {
+    bdd_free(fg->m, unnegated);
     return 0; //no errors
-  old_v = vl->n;
+  }
 
-  el = old_v->neigh;
-  newneigh = NULL;
-  do {
-    SKIP_DEAD(el, fg);
-    newn = (fgnode *)malloc(sizeof(fgnode));
+  // the cofactors of the neighbours of old_v, each with the var nodes
+  // it may be connected to, which are the other neighbours of its func,
+  // and the edges to them
+  std::vector<fgedge *> old_v_edges(old_v->neigh, old_v->neigh + old_v->num_neigh);
+  std::vector<fgnode *> new_funcs;
+  std::vector<std::vector<fgnode *> > candidates;
+  std::vector<std::vector<fgedge *> > old_edges;
+  for(fgedge *old_v_edge: old_v_edges)
+  {
+    fgnode *old_f = old_v_edge->fn;
+    newn = fgnode_alloc(fg, FUNC_NODE);
     if(newn == NULL) return 1; //error
-    newn->type = FUNC_NODE;
-    newn->born = fg->time;
-    newn->died = TIME_INFTY;
-    newn->parent = NULL;
-    newn->id = -1;
-    newn->neigh = NULL;
-    newn->num_neigh = 0;
-    SET_UNVISITED(newn);
-    newn->f  = (bdd_ptr *)malloc(sizeof(bdd_ptr) * (int)(el->e->fn->fs));
-    newn->ss = (bdd_ptr *)malloc(sizeof(bdd_ptr) * (int)(el->e->fn->fs));
+    newn->f  = (bdd_ptr *)malloc(sizeof(bdd_ptr) * (int)(old_f->fs));
+    newn->ss = (bdd_ptr *)malloc(sizeof(bdd_ptr) * (int)(old_f->fs));
     if(newn->f == NULL || newn->ss == NULL) return 1;
-    newn->fs = 0;
-    for(i = 0; i < el->e->fn->fs; i++)
+    for(i = 0; i < old_f->fs; i++)
     {
-      temp = bdd_cofactor(fg->m, el->e->fn->f[i], var);
+      temp = bdd_cofactor(fg->m, old_f->f[i], var);
       if(bdd_is_one(fg->m, temp))
       {
         bdd_free(fg->m, temp);
@@ -2045,127 +1604,146 @@ int factor_graph_assign_var(factor_graph *fg, bdd_ptr var)
       newn->fs++;
     }
     if(newn->fs == 0)
-      fgnode_delete(fg->m, newn);
-    else
     {
-      newneigh = fgnode_list_add_node(fg, newneigh, newn);
-      if(newneigh == NULL)
-        return 1;
+      fgnode_delete(fg, newn);
+      continue;
     }
-    nextel = el->next;
-    factor_graph_hide_funcnode(fg, el->e->fn);
-    el = nextel;
-  }while(el != old_v->neigh && old_v->neigh != NULL);
+    new_funcs.push_back(newn);
+    candidates.emplace_back();
+    old_edges.emplace_back();
+    for(j = 0; j < old_f->num_neigh; j++)
+      if(old_f->neigh[j]->vn != old_v)
+      {
+        candidates.back().push_back(old_f->neigh[j]->vn);
+        old_edges.back().push_back(old_f->neigh[j]);
+      }
+    old_edges.back().push_back(old_v_edge);
+  }
+  for(fgedge *old_v_edge: old_v_edges)
+    factor_graph_hide_node(fg, old_v_edge->fn);
   temp = bdd_cube_diff(fg->m, old_v->ss[0], unnegated);
   bdd_free(fg->m, unnegated);
 
-  factor_graph_hide_varnode(fg, old_v);
+  factor_graph_hide_node(fg, old_v);
 
   if(!bdd_is_one(fg->m, temp))
   {
     newn = fgnode_new_var(fg, temp);
-    if(newn == NULL)
+    if(newn == NULL || factor_graph_add_node(fg, newn, NULL, 0) == -1)
       return 1;
-    factor_graph_add_varnode(fg, newn);
+    for(auto &c: candidates)
+      c.push_back(newn);
   }
 
   bdd_free(fg->m, temp);
 
-  while(newneigh != NULL)
+  for(i = 0; i < (int)new_funcs.size(); i++)
   {
-    factor_graph_add_funcnode(fg, newneigh->n);
-    //if(newneigh->n->id == 295)
-    //  fgdm("i was right!", 0);
-    newneigh = fgnode_list_delete(newneigh);
+    if(factor_graph_add_node(fg, new_funcs[i], candidates[i].data(), (int)candidates[i].size()) == -1)
+      return 1;
+
+    // the old edge of each candidate is at its position in the candidates,
+    // the one to old_v, if any, last
+    fgnode *n = new_funcs[i];
+    for(j = 0; j < n->num_neigh; j++)
+    {
+      fgedge *e = n->neigh[j];
+      auto c = std::find(candidates[i].begin(), candidates[i].end(), e->vn);
+      fgedge *old_e = old_edges[i][c - candidates[i].begin()];
+      if(old_e->msg_fv != NULL)
+        e->msg_fv = bdd_cofactor(fg->m, old_e->msg_fv, var);
+      if(old_e->msg_vf != NULL)
+        e->msg_vf = bdd_cofactor(fg->m, old_e->msg_vf, var);
+    }
   }
+#if FACTOR_GRAPH_DEBUG
   if(factor_graph_verify(fg) < 0)
   {
     fgdm("verification failed", factor_graph_verify(fg));
     exit(0);
   }
+#endif
   return 0;
 }
 
+/** Undoes every change since the last checkpoint, newest first,
+ *    and goes back to the checkpoint before it
+ */
 void factor_graph_rollback(factor_graph *fg)
 {
-  fgnode_list *nl, *nnl;
-  fgedge_list *el, *nel;
-  int i;
+  std::vector<fgundo> &undo_log = fg->store->undo_log;
 
-  //add back deleted function nodes
-  nl = fg->fl;
-  do {
-    if(nl->born < fg->time && nl->died == fg->time)
-      factor_graph_unhide_funcnode(fg, nl->n);
-    nl = nl->next;
-  }while(nl != fg->fl);
-
-  //fgdm("added back deleted function nodes", factor_graph_verify(fg));
-
-  //add back deleted variable nodes
-  nl = fg->vl;
-  do {
-    if(nl->born < fg->time && nl->died == fg->time)
-      factor_graph_unhide_varnode(fg, nl->n);
-    nl = nl->next;
-  }while(nl != fg->vl);
-  //fgdm("added back deleted variable nodes", factor_graph_verify(fg));
-
-  //add back deleted edges
-  el = fg->el;
-  do {
-    if(el->born < fg->time && el->died == fg->time)
-      factor_graph_unhide_edge(fg, el->e);
-    el = el->next;
-  }while(el != fg->el);
-  //fgdm("added back deleted edges", factor_graph_verify(fg));
-
-  //remove added edges
-  el = fg->el;
-  do
-  {
-    nel = (el->next == el ? NULL : el->next);
-    if(el->born == fg->time)
+  while(!undo_log.empty() && undo_log.back().time >= fg->time)
+  {
+    fgundo u = undo_log.back();
+    undo_log.pop_back();
+    switch(u.kind)
     {
-      //fgdm("removing edge ", el->e->id);
-      factor_graph_delete_edge(fg, el->e);
-      //fgdm("removed edge ", 0);
+      case FGUNDO_ADD_NODE:
+      {
+        fgnode *n = fg->store->nodes.at(u.index);
+        n->undo_add = -1;
+        factor_graph_delete_node(fg, n);
+        break;
+      }
+      case FGUNDO_ADD_EDGE:
+      {
+        fgedge *e = fg->store->edges.at(u.index);
+        e->undo_add = -1;
+        factor_graph_delete_edge(fg, e);
+        break;
+      }
+      case FGUNDO_HIDE_NODE:
+        factor_graph_unhide_node(fg, fg->store->nodes.at(u.index), u.pos);
+        break;
+      case FGUNDO_HIDE_EDGE:
+        factor_graph_unhide_edge(fg, fg->store->edges.at(u.index), u.pos, u.fpos, u.vpos);
+        break;
+      case FGUNDO_NONE:
+        break;
     }
-    el = nel;
-  }while(el != fg->el && el != NULL);
-  //fgdm("removed added edges", factor_graph_verify(fg));
-
-  //remove added functions
-  nl = fg->fl;
-  do
-  {
-    nnl = nl->next;
-    assert(nl->died == nl->n->died);
-    if(nl->born == fg->time)
-      factor_graph_delete_funcnode(fg, nl->n);
-    nl = nnl;
-  }while(nl != fg->fl);
-  //fgdm("removed added func nodes", factor_graph_verify(fg));
-
-  //remove added variables
-  nl = fg->vl;
-  do
-  {
-    nnl = nl->next;
-    if(nl->born == fg->time)
-      factor_graph_delete_varnode(fg, nl->n);
-    nl = nnl;
-  }while(nl != fg->vl);
-  //fgdm("removed added var nodes", factor_graph_verify(fg));
+  }
 
   fg->time--;
 
+#if FACTOR_GRAPH_DEBUG
   if(factor_graph_verify(fg) < 0)
   {
     fgdm("verification failed", factor_graph_verify(fg));
     exit(0);
   }
+#endif
+}
 
+/** An empty factor graph in the manager m, or NULL if out of memory
+ */
+factor_graph * factor_graph_alloc(DdManager *m)
+{
+  factor_graph * fg = (factor_graph *)malloc(sizeof(factor_graph));
+  if(fg == NULL)
+    return NULL;
+  fg->m = m;
+  fg->funcs = fg->vars = NULL;
+  fg->edges = NULL;
+  fg->num_funcs = 0;
+  fg->num_vars = 0;
+  fg->num_edges = 0;
+  fg->funcs_capacity = fg->vars_capacity = fg->edges_capacity = 0;
+  fg->max_fid = -1;
+  fg->max_vid = -1;
+  fg->max_eid = -1;
+  fg->partial_product_degree = FACTOR_GRAPH_PARTIAL_PRODUCT_DEGREE;
+  fg->round_callback = NULL;
+  fg->round_callback_data = NULL;
+  fg->time_nodes = 0;
+  fg->time = 1;
+  fg->store = new (std::nothrow) fgstore;
+  if(fg->store == NULL)
+  {
+    free(fg);
+    return NULL;
+  }
+  return fg;
 }
 
 /**
@@ -2177,7 +1755,7 @@ void factor_graph_rollback(factor_graph *fg)
  */
 factor_graph * factor_graph_new(DdManager *m,bdd_ptr *f, int size)
 {
-  factor_graph * fg = (factor_graph *)malloc(sizeof(factor_graph));
+  factor_graph * fg = factor_graph_alloc(m);
   int i;
   bdd_ptr supp;
   bdd_ptr v;
@@ -2185,21 +1763,6 @@ factor_graph * factor_graph_new(DdManager *m,bdd_ptr *f, int size)
 
   if(fg == NULL)
     return NULL;
-  fg->m = m;
-  fg->num_funcs = 0;
-  fg->num_vars = 0;
-  fg->num_edges = 0;
-  fg->max_fid = -1;
-  fg->max_vid = -1;
-  //dummy nodes to mark the beginning of the lists
-  fg->time = -1;
-  fg->vl = fgnode_list_new_var( fg, bdd_one( fg->m ) );
-  fg->fl = fgnode_list_new_func( fg, bdd_one( fg->m ) );
-  fg->el = NULL;
-  factor_graph_add_edge(fg, fg->fl->n, fg->vl->n);
-  fg->el->died = fg->vl->died = fg->fl->died = -1;
-  fg->vl->n->died = fg->fl->n->died = -1;  
-  fg->time = 1;
 
   supp = bdd_vector_support(m, f, size);
   while(!bdd_is_one(m, supp))
@@ -2232,103 +1795,231 @@ factor_graph * factor_graph_new(DdManager *m,bdd_ptr *f, int size)
 */
 void factor_graph_delete(factor_graph *fg)
 {
-  while(fg->vl != NULL)
-    factor_graph_delete_varnode(fg, fg->vl->n);
-  while(fg->fl != NULL)
-    factor_graph_delete_funcnode(fg, fg->fl->n);
+  int i;
+  fgstore *store = fg->store;
+  for(i = 0; i < store->edges.num_slots; i++)
+    if(store->edges.in_use(i))
+      fgedge_delete(fg, store->edges.at(i));
+  for(i = 0; i < store->nodes.num_slots; i++)
+    if(store->nodes.in_use(i))
+      fgnode_delete(fg, store->nodes.at(i));
+  delete store;
+  free(fg->funcs);
+  free(fg->vars);
+  free(fg->edges);
   free(fg);
 }
 
-/** Function to set all messages in the factor graph to true
-*/
-void factor_graph_reset_messages(factor_graph *fg)
+/** A copy of the live part of a factor graph in the manager m, which
+ *    may be the manager of fg, with the same nodes, edges, ids, positions
+ *    and messages, and an empty undo log, so it cannot be rolled back
+ *    past the checkpoint it was copied at
+ *  Only reads fg and its manager, so several threads may copy one graph
+ *    at once, each into its own manager, while nothing changes fg
+ * OUTPUT : the copy, or NULL if out of memory
+ */
+factor_graph * factor_graph_copy(factor_graph *fg, DdManager *m)
 {
-  //set all messages to true
-  fgedge_list *el;
-  el = fg->el;
-  if(el != NULL) do {
-    SKIP_DEAD(el, fg);
-    if(el->e->msg_fv != NULL)
+  int i, j, t;
+  int error = 0;
+  factor_graph *copy = factor_graph_alloc(m);
+  if(copy == NULL)
+    return NULL;
+  copy->max_fid = fg->max_fid;
+  copy->max_vid = fg->max_vid;
+  copy->max_eid = fg->max_eid;
+  copy->time = fg->time;
+  copy->partial_product_degree = fg->partial_product_degree;
+
+  auto transfer = [&](bdd_ptr f) -> bdd_ptr {
+    bdd_ptr g = factor_graph_transfer(fg->m, m, f);
+    if(g == NULL)
+      error = 1;
+    return g;
+  };
+
+  // the nodes, the var nodes first, each at its position
+  std::vector<fgnode *> node_copies(fg->store->nodes.num_slots, NULL);
+  for(t = 0; t < 2 && !error; t++)
+  {
+    fgnode **nodes = (t == 0 ? fg->vars : fg->funcs);
+    int num_nodes = (t == 0 ? fg->num_vars : fg->num_funcs);
+    for(i = 0; i < num_nodes && !error; i++)
     {
-      bdd_free(fg->m, el->e->msg_fv);
-      //el->e->msg_fv = NULL;
+      fgnode *n = nodes[i];
+      fgnode *c = fgnode_alloc(copy, n->type);
+      if(c == NULL)
+      {
+        error = 1;
+        break;
+      }
+      c->id = n->id;
+      c->born = n->born;
+      c->f = (bdd_ptr *)malloc(sizeof(bdd_ptr) * n->fs);
+      c->ss = (bdd_ptr *)malloc(sizeof(bdd_ptr) * n->fs);
+      if(c->f == NULL || c->ss == NULL)
+      {
+        error = 1;
+        break;
+      }
+      for(j = 0; j < n->fs && !error; j++)
+      {
+        c->f[j] = transfer(n->f[j]);
+        c->ss[j] = transfer(n->ss[j]);
+        c->fs++;
+      }
+      if(error || factor_graph_link_node(copy, c, -1) == -1)
+        error = 1;
+      node_copies[n->index] = c;
     }
-    el->e->msg_fv = bdd_one(fg->m);
+  }
 
-    if(el->e->msg_vf != NULL)
+  // the edges, in the order of the edges of the graph,
+  // then in the order of the edges of each node
+  std::vector<fgedge *> edge_copies(fg->store->edges.num_slots, NULL);
+  for(i = 0; i < fg->num_edges && !error; i++)
+  {
+    fgedge *e = fg->edges[i];
+    fgedge *c = fgedge_new(copy, node_copies[e->fn->index], node_copies[e->vn->index]);
+    if(c == NULL)
     {
-      bdd_free(fg->m, el->e->msg_vf);
-      //el->e->msg_vf = NULL;
+      error = 1;
+      break;
+    }
+    c->id = e->id;
+    c->born = e->born;
+    if(e->msg_fv != NULL)
+      c->msg_fv = transfer(e->msg_fv);
+    if(e->msg_vf != NULL)
+      c->msg_vf = transfer(e->msg_vf);
+    if(fgarray_insert(copy->edges, copy->num_edges, copy->edges_capacity, c, -1, &fgedge::pos) == -1)
+      error = 1;
+    edge_copies[e->index] = c;
+  }
+  for(t = 0; t < 2 && !error; t++)
+  {
+    fgnode **nodes = (t == 0 ? fg->vars : fg->funcs);
+    int num_nodes = (t == 0 ? fg->num_vars : fg->num_funcs);
+    for(i = 0; i < num_nodes && !error; i++)
+    {
+      fgnode *c = node_copies[nodes[i]->index];
+      int fgedge::*pos_of = (c->type == FUNC_NODE ? &fgedge::fpos : &fgedge::vpos);
+      for(j = 0; j < nodes[i]->num_neigh && !error; j++)
+        if(fgarray_insert(c->neigh, c->num_neigh, c->neigh_capacity,
+                          edge_copies[nodes[i]->neigh[j]->index], -1, pos_of) == -1)
+          error = 1;
     }
-    el->e->msg_vf = bdd_one(fg->m);
+  }
+
+  // whatever was made is in the arenas of the copy
+  if(error)
+  {
+    factor_graph_delete(copy);
+    return NULL;
+  }
+  return copy;
+}
 
-    el = el->next;
-  } while(el != fg->el);
+/** Function to set all messages in the factor graph to true
+*/
+void factor_graph_reset_messages(factor_graph *fg)
+{
+  //set all messages to true
+  int i;
+  for(i = 0; i < fg->num_edges; i++)
+  {
+    fgedge *e = fg->edges[i];
+    if(e->msg_fv != NULL)
+      bdd_free(fg->m, e->msg_fv);
+    e->msg_fv = bdd_one(fg->m);
 
+    if(e->msg_vf != NULL)
+      bdd_free(fg->m, e->msg_vf);
+    e->msg_vf = bdd_one(fg->m);
+  }
 }
 
 /** Function to reset messages to NULL and num_messages to 0
 */
 void factor_graph_reset_messages_num(factor_graph *fg)
 {
-  //set number of messages received from neighbours to be 0
-  fgnode_list *viter;
-  fgnode_list *fiter;
-  fgedge_list *el;
+  int i;
 
   //set all messages to NULL
-  el = fg->el;
-  if(el != NULL) do {
-    SKIP_DEAD(el, fg);
-    if(el->e->msg_fv != NULL)
-    {
-      bdd_free(fg->m, el->e->msg_fv);
-    }
-    el->e->msg_fv = NULL;
+  for(i = 0; i < fg->num_edges; i++)
+  {
+    fgedge *e = fg->edges[i];
+    if(e->msg_fv != NULL)
+      bdd_free(fg->m, e->msg_fv);
+    e->msg_fv = NULL;
 
-    if(el->e->msg_vf != NULL)
-    {
-      bdd_free(fg->m, el->e->msg_vf);
-    }
-    el->e->msg_vf = NULL;
+    if(e->msg_vf != NULL)
+      bdd_free(fg->m, e->msg_vf);
+    e->msg_vf = NULL;
+  }
 
-    el = el->next;
-  } while(el != fg->el);
+  //set number of messages received from neighbours to be 0
+  for(i = 0; i < fg->num_vars; i++)
+    fg->vars[i]->num_messages = 0;
+  for(i = 0; i < fg->num_funcs; i++)
+    fg->funcs[i]->num_messages = 0;
+}
 
-  viter = fg->vl;
-  do
-  {
-    SKIP_DEAD(viter, fg);
-    viter->n->num_messages = 0;
-    viter = viter->next;
-  }while(viter != fg->vl);
 
-  fiter = fg->fl;
-  do
-  {
-    SKIP_DEAD(fiter, fg);
-    fiter->n->num_messages = 0;
-    fiter = fiter->next;
-  }while(fiter != fg->fl);
+/** f, moved from the manager from to the manager to, which may be the same
+ * OUTPUT : a new reference, or NULL if out of memory
+ */
+bdd_ptr factor_graph_transfer(DdManager *from, DdManager *to, bdd_ptr f)
+{
+  if(from == to)
+    return bdd_dup(f);
+  bdd_ptr g = Cudd_bddTransfer(from, to, f);
+  if(g != NULL)
+    Cudd_Ref(g);
+  return g;
+}
 
-  return;
+/** The variable of each level of the manager m, top first
+ */
+std::vector<int> factor_graph_variable_order(DdManager *m)
+{
+  std::vector<int> order(Cudd_ReadSize(m));
+  for(int i = 0; i < (int)order.size(); i++)
+    order[i] = Cudd_ReadInvPerm(m, i);
+  return order;
 }
 
+/** A new manager for a worker thread, with the variables in the given order
+ * OUTPUT : the manager, or NULL if out of memory
+ */
+DdManager * factor_graph_worker_manager(const std::vector<int> &order)
+{
+  DdManager *worker = Cudd_Init((unsigned int)order.size(), 0, CUDD_UNIQUE_SLOTS, CUDD_CACHE_SLOTS, 0);
+  if(worker != NULL
+     && !order.empty() && !Cudd_ShuffleHeap(worker, const_cast<int *>(&order.front())))
+  {
+    bdd_quit(worker);
+    worker = NULL;
+  }
+  return worker;
+}
 
+/** Passes messages once towards root, on an acyclic graph
+ *  In a tree without root, which a forest may have, the messages go
+ *    towards the last node reached, which gets them on all its edges
+ */
 int factor_graph_acyclic_messages(factor_graph *fg, fgnode* root)
 {
   int i,j,var;
   fgnode_list *queue = NULL, *bfs = NULL;
-  fgnode_list *itr;
   fgnode *n, *nn, *parent;
-  fgedge_list *el;
   int error = 0;
   double init,final;
 
   if(!root)
     return 1;
 
-  if(fg->el == NULL)
+  if(fg->num_edges == 0)
     return 1;
 
   assert(root->type == VAR_NODE && "Root is not a variable node in factor_graph_acyclic_messages");
@@ -2337,29 +2028,25 @@ int factor_graph_acyclic_messages(factor_graph *fg, fgnode* root)
 
   queue = NULL;
 
-  itr = fg->fl;
-  do
+  for(i = 0; i < fg->num_funcs; i++)
   {
-    SKIP_DEAD(itr, fg);
-    SET_UNVISITED(itr->n);
-    if(itr->n->num_neigh == 1) {
-      queue = fgnode_list_add_node(fg, queue, itr->n);
-      SET_VISITED(itr->n);
+    n = fg->funcs[i];
+    SET_UNVISITED(n);
+    if(n->num_neigh == 1) {
+      queue = fgnode_list_add_node(fg, queue, n);
+      SET_VISITED(n);
     }
-    itr = itr->next;
-  }while(itr != fg->fl);
+  }
 
-  itr = fg->vl;
-  do
+  for(i = 0; i < fg->num_vars; i++)
   {
-    SKIP_DEAD(itr, fg);
-    SET_UNVISITED(itr->n);
-    if(itr->n->num_neigh == 1 && itr->n != root) {
-      queue = fgnode_list_add_node(fg, queue, itr->n);
-      SET_VISITED(itr->n);
+    n = fg->vars[i];
+    SET_UNVISITED(n);
+    if(n->num_neigh == 1 && n != root) {
+      queue = fgnode_list_add_node(fg, queue, n);
+      SET_VISITED(n);
     }
-    itr = itr->next;
-  }while(itr != fg->vl);
+  }
 
   // There has to be a leaf
   if(queue == NULL)
@@ -2415,83 +2102,489 @@ int factor_graph_acyclic_messages(factor_graph *fg, fgnode* root)
 }
 
 
+// One tree of an acyclic factor graph, breadth first from its root,
+// with the messages along its edges, in the manager m, which is
+// the manager of the graph or the one of a worker thread
+struct fgtree
+{
+  DdManager *m = NULL;
+  std::vector<fgnode *> nodes;               // nodes[0] is the root
+  std::vector<int> parent;                   // the position of the parent of each node, -1 for the root
+  std::vector<std::vector<int> > children;   // the positions of the children of each node
+  std::vector<fgedge *> up;                  // the edge of each node to its parent, NULL for the root
+  std::vector<std::vector<bdd_ptr> > f;      // the functions of each func node, in m
+  std::vector<bdd_ptr> vars;                 // the variables of each var node, in m
+  std::vector<bdd_ptr> up_msg, down_msg;     // along up, towards the root and away from it, in m
+};
+
+/** Finds the trees of an acyclic factor graph, with at least one edge each
+ * OUTPUT : 0 if successful, -1 if the graph has a cycle
+ */
+int factor_graph_find_trees(factor_graph *fg, std::vector<fgtree> &trees)
+{
+  std::vector<char> seen(fg->store->nodes.num_slots, 0);
+  for(int i = 0; i < fg->num_vars + fg->num_funcs; i++)
+  {
+    fgnode *root = (i < fg->num_vars ? fg->vars[i] : fg->funcs[i - fg->num_vars]);
+    if(seen[root->index] || root->num_neigh == 0)
+      continue;
+    trees.emplace_back();
+    fgtree &t = trees.back();
+    t.nodes.push_back(root);
+    t.parent.push_back(-1);
+    t.up.push_back(NULL);
+    seen[root->index] = 1;
+    for(int j = 0; j < (int)t.nodes.size(); j++)
+    {
+      fgnode *n = t.nodes[j];
+      for(int k = 0; k < n->num_neigh; k++)
+      {
+        fgedge *e = n->neigh[k];
+        if(e == t.up[j])
+          continue;
+        fgnode *next = (n->type == VAR_NODE ? e->fn : e->vn);
+        if(seen[next->index])
+          return -1;
+        seen[next->index] = 1;
+        t.nodes.push_back(next);
+        t.parent.push_back(j);
+        t.up.push_back(e);
+      }
+    }
+    t.children.resize(t.nodes.size());
+    for(int j = 1; j < (int)t.nodes.size(); j++)
+      t.children[t.parent[j]].push_back(j);
+  }
+  return 0;
+}
 
-/** Passes messages in a factor graph till convergence
-*/
-int factor_graph_converge(factor_graph *fg)
+/** Fires node j of a tree: towards its parent, from its children, if !down,
+ *    else towards its children, from its parent and its other children
+ *  Conjunctions of the prefixes and the suffixes of its incoming messages
+ *    give each outgoing one without conjoining the others again
+ */
+void fgtree_fire(fgtree &t, int j, bool down)
 {
-  int i,j;
-  fgnode_list *queue;
-  fgnode_type curtype;
-  fgnode_list *itr;
-  fgnode * n;
-  int iter;
-  int error = 0;
+  DdManager *m = t.m;
+  int i;
+  std::vector<bdd_ptr> in;
+  std::vector<int> from;
+  if(down && t.parent[j] >= 0)
+  {
+    in.push_back(t.down_msg[j]);
+    from.push_back(t.parent[j]);
+  }
+  for(int c: t.children[j])
+  {
+    in.push_back(t.up_msg[c]);
+    from.push_back(c);
+  }
+  int k = (int)in.size();
+
+  // pre[i] conjoins the functions of the node and in[0 .. i-1],
+  // suf[i] conjoins in[i .. k-1]
+  std::vector<bdd_ptr> pre(k + 1), suf(k + 2);
+  pre[0] = bdd_one(m);
+  if(t.nodes[j]->type == FUNC_NODE)
+    for(bdd_ptr g: t.f[j])
+      bdd_and_accumulate(m, &pre[0], g);
+  for(i = 0; i < k; i++)
+    pre[i + 1] = bdd_and(m, pre[i], in[i]);
+  suf[k] = bdd_one(m);
+  suf[k + 1] = bdd_one(m);
+  for(i = k - 1; i >= 0; i--)
+    suf[i] = bdd_and(m, in[i], suf[i + 1]);
+
+  // the variables of the neighbours, which a func node projects onto one of
+  bdd_ptr all_vars = NULL;
+  if(t.nodes[j]->type == FUNC_NODE)
+  {
+    all_vars = bdd_one(m);
+    for(int n: from)
+      bdd_and_accumulate(m, &all_vars, t.vars[n]);
+    if(!down)
+      bdd_and_accumulate(m, &all_vars, t.vars[t.parent[j]]);
+  }
+
+  // the conjunction of all but in[skip], to the neighbour to
+  auto out = [&](int skip, int to) -> bdd_ptr {
+    if(all_vars == NULL)
+      return bdd_and(m, pre[skip], suf[skip + 1]);
+    bdd_ptr others = bdd_cube_diff(m, all_vars, t.vars[to]);
+    bdd_ptr msg = bdd_and_exists(m, pre[skip], suf[skip + 1], others);
+    bdd_free(m, others);
+    return msg;
+  };
+  if(!down)
+    t.up_msg[j] = out(k, t.parent[j]);
+  else
+    for(i = 0; i < k; i++)
+      if(from[i] != t.parent[j])
+        t.down_msg[from[i]] = out(i, from[i]);
+
+  if(all_vars != NULL)
+    bdd_free(m, all_vars);
+  for(bdd_ptr g: pre)
+    bdd_free(m, g);
+  for(bdd_ptr g: suf)
+    bdd_free(m, g);
+}
 
-  if(fg->el == NULL)
-    return 1;
+/** Computes the messages along every edge of a tree, in the manager m,
+ *    moving the functions and variables of its nodes there first
+ *  Only reads the graph and its manager, so the trees of a forest may be
+ *    done at once on several threads, each with a manager of its own
+ * OUTPUT : 0 if successful, -1 if out of memory
+ */
+int fgtree_pass_messages(factor_graph *fg, fgtree &t, DdManager *m)
+{
+  int j;
+  int n = (int)t.nodes.size();
+  t.m = m;
+  t.f.assign(n, std::vector<bdd_ptr>());
+  t.vars.assign(n, NULL);
+  t.up_msg.assign(n, NULL);
+  t.down_msg.assign(n, NULL);
+  for(j = 0; j < n; j++)
+  {
+    fgnode *node = t.nodes[j];
+    if(node->type == VAR_NODE)
+    {
+      if((t.vars[j] = factor_graph_transfer(fg->m, m, node->ss[0])) == NULL)
+        return -1;
+      continue;
+    }
+    for(int i = 0; i < node->fs; i++)
+    {
+      bdd_ptr g = factor_graph_transfer(fg->m, m, node->f[i]);
+      if(g == NULL)
+        return -1;
+      t.f[j].push_back(g);
+    }
+  }
 
-  factor_graph_reset_messages(fg);
+  // collect, from the leaves to the root, then distribute, back to the leaves
+  for(j = n - 1; j > 0; j--)
+    fgtree_fire(t, j, false);
+  for(j = 0; j < n; j++)
+    fgtree_fire(t, j, true);
+  return 0;
+}
 
-  queue = NULL;
-  itr = fg->fl;
-  do
-  {
-    SKIP_DEAD(itr, fg);
-    SET_VISITED(itr->n);
-    queue = fgnode_list_add_node(fg, queue, itr->n);
-    itr = itr->next;
-  }while(itr != fg->fl);
+/** Frees the bdds of a tree, in its manager
+ */
+void fgtree_free(fgtree &t)
+{
+  for(auto &fs: t.f)
+    for(bdd_ptr g: fs)
+      bdd_free(t.m, g);
+  for(auto *v: {&t.vars, &t.up_msg, &t.down_msg})
+    for(bdd_ptr g: *v)
+      if(g != NULL)
+        bdd_free(t.m, g);
+  t.f.clear();
+  t.vars.clear();
+  t.up_msg.clear();
+  t.down_msg.clear();
+}
+
+/** Passes messages on an acyclic factor graph in two sweeps over each tree,
+ *    towards a root and back, so every var node gets its incoming messages,
+ *    exact for its tree, at once rather than with a run of
+ *    factor_graph_acyclic_messages for each
+ *  The trees of a forest are done on num_threads threads (as many as the
+ *    hardware has if not positive), each with a manager of its own,
+ *    with the variable order of the manager of fg, and their messages
+ *    are moved back on the calling thread; with one thread or one tree,
+ *    everything happens in the manager of fg
+ * OUTPUT : 1 if successful, -1 if the graph has a cycle or out of memory
+ */
+int factor_graph_acyclic_all_messages(factor_graph *fg, int num_threads)
+{
+  int i, j;
+  std::vector<fgtree> trees;
+  if(factor_graph_find_trees(fg, trees) == -1)
+    return -1;
+
+  int num_trees = (int)trees.size();
+  if(num_threads <= 0)
+    num_threads = max((int)std::thread::hardware_concurrency(), 1);
+  if(num_threads > num_trees)
+    num_threads = num_trees;
 
-  itr = fg->vl;
-  do
+  bool ok = true;
+  std::vector<DdManager *> workers;
+  if(num_threads <= 1)
   {
-    SET_UNVISITED(itr->n);
-    itr = itr->next;
-  }while(itr != fg->vl);
-  if(queue == NULL)
+    for(i = 0; i < num_trees && ok; i++)
+      ok = (fgtree_pass_messages(fg, trees[i], fg->m) == 0);
+  }
+  else
   {
-    fgdm("queue is null!", fg->num_funcs);
+    // the workers only read fg and its manager till they are all done
+    std::vector<int> order = factor_graph_variable_order(fg->m);
+    std::atomic<int> next_tree(0);
+    std::atomic<bool> failed(false);
+    workers.assign(num_threads, NULL);
+    std::vector<std::thread> threads;
+    for(i = 0; i < num_threads; i++)
+      threads.emplace_back([&, i]() {
+                             workers[i] = factor_graph_worker_manager(order);
+                             if(workers[i] == NULL)
+                               failed = true;
+                             for(int t = next_tree++; t < num_trees && !failed; t = next_tree++)
+                               if(fgtree_pass_messages(fg, trees[t], workers[i]) == -1)
+                                 failed = true;
+                           });
+    for(auto &thread: threads)
+      thread.join();
+    ok = !failed;
+  }
+
+  // move the messages to the edges, and free the trees
+  for(auto &t: trees)
+  {
+    for(j = 1; j < (int)t.up_msg.size() && ok; j++)
+    {
+      bdd_ptr up = factor_graph_transfer(t.m, fg->m, t.up_msg[j]);
+      bdd_ptr down = factor_graph_transfer(t.m, fg->m, t.down_msg[j]);
+      if(up == NULL || down == NULL)
+      {
+        if(up != NULL) bdd_free(fg->m, up);
+        if(down != NULL) bdd_free(fg->m, down);
+        ok = false;
+        break;
+      }
+      fgedge *e = t.up[j];
+      bdd_ptr *to_parent = (t.nodes[j]->type == VAR_NODE ? &e->msg_vf : &e->msg_fv);
+      bdd_ptr *to_child = (t.nodes[j]->type == VAR_NODE ? &e->msg_fv : &e->msg_vf);
+      if(*to_parent != NULL) bdd_free(fg->m, *to_parent);
+      if(*to_child != NULL) bdd_free(fg->m, *to_child);
+      *to_parent = up;
+      *to_child = down;
+    }
+    for(fgnode *n: t.nodes)
+      n->num_messages = n->num_neigh;
+    if(t.m != NULL)
+      fgtree_free(t);
+  }
+  for(auto worker: workers)
+    if(worker != NULL)
+      bdd_quit(worker);
+
+  if(!ok)
+  {
+    fgdm("error", 1);
     return -1;
   }
-  curtype = FUNC_NODE;
+  return 1;
+}
+
+
+
+/* ------------- Telemetry ----------------*/
+
+// the start of a round, to measure it from
+struct factor_graph_round_clock
+{
+  double wall_start;
+  double cpu_start;
+  double cache_hits;
+  double cache_look_ups;
+};
+
+double factor_graph_wall_seconds()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void factor_graph_start_round(factor_graph *fg, factor_graph_round_clock *round_clock, factor_graph_round_stats *stats, int round)
+{
+  memset(stats, 0, sizeof(factor_graph_round_stats));
+  stats->round = round;
+  round_clock->wall_start = factor_graph_wall_seconds();
+  round_clock->cpu_start = (double)clock() / CLOCKS_PER_SEC;
+  round_clock->cache_hits = Cudd_ReadCacheHits(fg->m);
+  round_clock->cache_look_ups = Cudd_ReadCacheLookUps(fg->m);
+}
+
+// fill in the rest of the stats, and tell the callback
+void factor_graph_finish_round(factor_graph *fg, const factor_graph_round_clock *round_clock, factor_graph_round_stats *stats)
+{
+  double cache_look_ups = Cudd_ReadCacheLookUps(fg->m) - round_clock->cache_look_ups;
+  stats->wall_time = factor_graph_wall_seconds() - round_clock->wall_start;
+  stats->cpu_time = (double)clock() / CLOCKS_PER_SEC - round_clock->cpu_start;
+  stats->cache_hit_rate = cache_look_ups > 0 ? (Cudd_ReadCacheHits(fg->m) - round_clock->cache_hits) / cache_look_ups : 0;
+  stats->num_live_nodes = Cudd_ReadNodeCount(fg->m);
+  for(int i = 0; i < fg->num_edges; i++)
+  {
+    int size_fv = bdd_size(fg->edges[i]->msg_fv);
+    int size_vf = bdd_size(fg->edges[i]->msg_vf);
+    stats->total_message_size += size_fv + size_vf;
+    stats->max_message_size = max(stats->max_message_size, max(size_fv, size_vf));
+  }
+  fg->round_callback(fg, stats, fg->round_callback_data);
+}
+
+/** Tells callback about every round of the next calls to factor_graph_converge,
+ *    or nobody if it is NULL, passing it data
+ *  If time_nodes is non-zero, also counts and times the firings of each node,
+ *    in its num_firings and fire_time
+ */
+void factor_graph_set_round_callback(factor_graph *fg, factor_graph_round_callback callback, void *data, int time_nodes)
+{
+  fg->round_callback = callback;
+  fg->round_callback_data = data;
+  fg->time_nodes = time_nodes;
+}
+
+/** A factor_graph_round_callback writing each round to the FILE * in file,
+ *    as a line of JSON
+ */
+void factor_graph_write_round_json(factor_graph *, const factor_graph_round_stats *stats, void *file)
+{
+  fprintf((FILE *)file,
+          "{\"event\": \"round\", \"round\": %d, \"firings\": %ld, \"messages_changed\": %ld, "
+          "\"total_message_size\": %ld, \"max_message_size\": %d, \"live_nodes\": %ld, "
+          "\"cache_hit_rate\": %g, \"wall_time\": %g, \"cpu_time\": %g}\n",
+          stats->round, stats->num_firings, stats->num_messages_changed,
+          stats->total_message_size, stats->max_message_size, stats->num_live_nodes,
+          stats->cache_hit_rate, stats->wall_time, stats->cpu_time);
+  fflush((FILE *)file);
+}
+
+/** Writes the nodes that fired in the last factor_graph_converge,
+ *    slowest first, as a line of JSON each, if the nodes were timed
+ */
+void factor_graph_write_node_times_json(factor_graph *fg, FILE *file)
+{
+  std::vector<fgnode *> fired;
+  for (int i = 0; i < fg->num_funcs; ++i)
+    if (fg->funcs[i]->num_firings > 0)
+      fired.push_back(fg->funcs[i]);
+  for (int i = 0; i < fg->num_vars; ++i)
+    if (fg->vars[i]->num_firings > 0)
+      fired.push_back(fg->vars[i]);
+  std::stable_sort(fired.begin(), fired.end(),
+                   [](const fgnode * a, const fgnode * b) { return a->fire_time > b->fire_time; });
+  for (auto n: fired)
+  {
+    int size = 0;
+    bdd_ptr support = bdd_one(fg->m);
+    for (int i = 0; i < n->fs; ++i)
+    {
+      size += bdd_size(n->f[i]);
+      bdd_and_accumulate(fg->m, &support, n->ss[i]);
+    }
+    fprintf(file, "{\"event\": \"node\", \"type\": \"%s\", \"id\": %d, \"size\": %d, \"variables\": [",
+            n->type == FUNC_NODE ? "factor" : "variable", n->id, size);
+    for (bool first = true; !bdd_is_one(fg->m, support); first = false)
+    {
+      int index = bdd_get_lowest_index(fg->m, support);
+      bdd_ptr v = bdd_new_var_with_index(fg->m, index);
+      bdd_ptr rest = bdd_cube_diff(fg->m, support, v);
+      bdd_free(fg->m, v);
+      bdd_free(fg->m, support);
+      support = rest;
+      fprintf(file, first ? "%d" : ", %d", index);
+    }
+    bdd_free(fg->m, support);
+    fprintf(file, "], \"firings\": %ld, \"wall_time\": %g}\n", n->num_firings, n->fire_time);
+  }
+  fflush(file);
+}
+
+
+
+/** Empties the worklist of factor_graph_converge,
+ *    and clears the firings of the nodes
+ */
+void factor_graph_clear_worklist(factor_graph *fg)
+{
+  int i;
+  fg->store->worklist.head = fg->store->worklist.size = 0;
+  fg->store->queued.assign((fg->store->nodes.num_slots + 63) / 64, 0);
+  for(i = 0; i < fg->num_funcs; i++)
+  {
+    fg->funcs[i]->num_firings = 0;
+    fg->funcs[i]->fire_time = 0;
+  }
+  for(i = 0; i < fg->num_vars; i++)
+  {
+    fg->vars[i]->num_firings = 0;
+    fg->vars[i]->fire_time = 0;
+  }
+}
+
+/** Fires the nodes in the worklist, and the ones they queue, till it is empty
+ * OUTPUT : the number of rounds if successful, -1 if out of memory
+ */
+int factor_graph_fire_queued(factor_graph *fg)
+{
+  fgworklist &queue = fg->store->worklist;
+  fgnode_type curtype;
+  fgnode * n;
+  int iter;
+  int error = 0;
+  int num_changed;
+  factor_graph_round_clock round_clock;
+  factor_graph_round_stats round_stats;
+
+  curtype = queue.slots[queue.head]->type;
   iter = 1;
-  while(queue != NULL && !error)
+  factor_graph_start_round(fg, &round_clock, &round_stats, iter);
+  while(queue.size > 0 && !error)
   {
     //printf(".");
     //fflush(stdout);n
-    n = queue->n;
+    n = queue.pop();
     //fgdm("exploring node ", n->id);
 
     if(n->type != curtype)
     {
       curtype = n->type;
+      if (fg->round_callback)
+        factor_graph_finish_round(fg, &round_clock, &round_stats);
       iter++;
+      factor_graph_start_round(fg, &round_clock, &round_stats, iter);
       //fgdm("iteration :", iter);
     }
 
+    double fire_start = fg->time_nodes ? factor_graph_wall_seconds() : 0;
     if(n->type == VAR_NODE)
     {
-      error = var_node_pass_messages(fg, n, queue);
+      num_changed = var_node_pass_messages(fg, n);
       //if(error)
       //  fgdm("error in var_node_pass_messagse", 0);
     }
     else {
       assert(n->type == FUNC_NODE);
       //fgdm("entering cpm", 0);
-      error = func_node_pass_messages(fg, n, queue);
+      num_changed = func_node_pass_messages(fg, n);
       //if(error)
       //  fgdm("error in func_node_pass_messages", 0);
       //fgdm("leaving cpm", 0);
     }
-    queue = fgnode_list_delete(queue);
-    SET_UNVISITED(n);
+    if (num_changed < 0)
+      error = 1;
+    else
+    {
+      ++round_stats.num_firings;
+      round_stats.num_messages_changed += num_changed;
+    }
+    if (fg->time_nodes)
+    {
+      ++n->num_firings;
+      n->fire_time += factor_graph_wall_seconds() - fire_start;
+    }
+    factor_graph_dequeued(fg, n);
   }
+  if (fg->round_callback && !error)
+    factor_graph_finish_round(fg, &round_clock, &round_stats);
   //printf("\n");
   if(error)
   {
-    while(queue != NULL)
-      queue = fgnode_list_delete(queue);
+    queue.head = queue.size = 0;
     fgdm("error", error);
     return -1;
   }
@@ -2499,10 +2592,299 @@ int factor_graph_converge(factor_graph *fg)
   return iter;
 }
 
+/** Passes messages in a factor graph till convergence
+*/
+int factor_graph_converge(factor_graph *fg)
+{
+  int i;
+  int error = 0;
+
+  if(fg->num_edges == 0)
+    return 1;
+
+  factor_graph_reset_messages(fg);
+
+  factor_graph_clear_worklist(fg);
+  for(i = 0; i < fg->num_funcs; i++)
+    if(factor_graph_enqueue(fg, fg->funcs[i]) == -1)
+      error = 1;
+  if(fg->store->worklist.size == 0 || error)
+  {
+    fgdm("queue is null!", fg->num_funcs);
+    return -1;
+  }
+
+  return factor_graph_fire_queued(fg);
+}
+
+/** Passes messages in a factor graph till convergence, starting from the
+ *    messages it already has, which factor_graph_assign_var keeps,
+ *    so only the nodes born since the last checkpoint fire at first
+ *  Falls back to factor_graph_converge if some edge has no messages yet
+ * OUTPUT : the number of rounds, zero if nothing changed, -1 if out of memory
+ */
+int factor_graph_reconverge(factor_graph *fg)
+{
+  int i;
+  int error = 0;
+
+  if(fg->num_edges == 0)
+    return 1;
+  for(i = 0; i < fg->num_edges; i++)
+    if(fg->edges[i]->msg_fv == NULL || fg->edges[i]->msg_vf == NULL)
+      return factor_graph_converge(fg);
+
+  factor_graph_clear_worklist(fg);
+  for(i = 0; i < fg->num_funcs; i++)
+    if(fg->funcs[i]->born == fg->time && factor_graph_enqueue(fg, fg->funcs[i]) == -1)
+      error = 1;
+  for(i = 0; i < fg->num_vars; i++)
+    if(fg->vars[i]->born == fg->time && factor_graph_enqueue(fg, fg->vars[i]) == -1)
+      error = 1;
+  if(error)
+  {
+    fgdm("error", error);
+    return -1;
+  }
+  if(fg->store->worklist.size == 0)
+    return 0;
+
+  return factor_graph_fire_queued(fg);
+}
+
+
+
+/* ------------- Snapshots ----------------*/
+
+// A copy-on-write view of a factor graph, in a manager of its own:
+// it reads the graph it was taken of till its first change, when it
+// copies it, with its messages, into its manager (see factor_graph_copy)
+struct factor_graph_snapshot
+{
+  factor_graph *parent;
+  DdManager *m;
+  factor_graph *copy;   // NULL till the first change
+};
+
+/** A snapshot of fg in the manager m, which must have the variables of
+ *    the manager of fg, and may be it
+ *  Nothing is copied yet, and fg must not change while the snapshot lives
+ * OUTPUT : the snapshot, or NULL if out of memory
+ */
+factor_graph_snapshot * factor_graph_snapshot_new(factor_graph *fg, DdManager *m)
+{
+  factor_graph_snapshot *s = (factor_graph_snapshot *)malloc(sizeof(factor_graph_snapshot));
+  if(s == NULL)
+    return NULL;
+  s->parent = fg;
+  s->m = m;
+  s->copy = NULL;
+  return s;
+}
+
+/** The graph of a snapshot, copied from its parent if not yet,
+ *    to be changed without changing the parent
+ * OUTPUT : the graph, or NULL if out of memory
+ */
+factor_graph * factor_graph_snapshot_write(factor_graph_snapshot *s)
+{
+  if(s->copy == NULL)
+    s->copy = factor_graph_copy(s->parent, s->m);
+  return s->copy;
+}
+
+/** Assigns the variables of a cube of literals, from the manager of the
+ *    parent, in the graph of a snapshot, after a new checkpoint,
+ *    and passes messages again, starting from the ones it had
+ * OUTPUT : 0 if successful, -1 if out of memory
+ */
+int factor_graph_snapshot_assign(factor_graph_snapshot *s, bdd_ptr assignment)
+{
+  factor_graph *fg = factor_graph_snapshot_write(s);
+  int error = 0;
+  if(fg == NULL)
+    return -1;
+
+  bdd_ptr cube = factor_graph_transfer(s->parent->m, s->m, assignment);
+  if(cube == NULL)
+    return -1;
+
+  fg->time++;
+  bdd_ptr supp = bdd_support(s->m, cube);
+  for_each_cube_index(supp,
+                      [&](int index) {
+                        if(error)
+                          return;
+                        bdd_ptr v = bdd_new_var_with_index(s->m, index);
+                        bdd_ptr positive = bdd_and(s->m, cube, v);
+                        bdd_ptr literal = (bdd_is_zero(s->m, positive) ? bdd_not(v) : bdd_dup(v));
+                        if(factor_graph_assign_var(fg, literal) != 0)
+                          error = 1;
+                        bdd_free(s->m, literal);
+                        bdd_free(s->m, positive);
+                        bdd_free(s->m, v);
+                      });
+  bdd_free(s->m, supp);
+  bdd_free(s->m, cube);
+
+  if(error || factor_graph_reconverge(fg) < 0)
+    return -1;
+  return 0;
+}
+
+/** The AND of the incoming messages of the var nodes holding variables
+ *    of the cube vars, in the manager of the snapshot, read from its parent
+ *    if it has not changed yet
+ *  The variables of vars that were assigned have no var node, and add nothing
+ * OUTPUT : the message, or NULL if out of memory
+ */
+bdd_ptr factor_graph_snapshot_message(factor_graph_snapshot *s, bdd_ptr vars)
+{
+  factor_graph *fg = (s->copy != NULL ? s->copy : s->parent);
+  const std::vector<fgnode *> &var_nodes = fg->store->var_nodes;
+  std::vector<fgnode *> nodes;
+  for_each_cube_index(vars,
+                      [&](int index) {
+                        if(index < (int)var_nodes.size() && var_nodes[index] != NULL)
+                          nodes.push_back(var_nodes[index]);
+                      });
+  std::sort(nodes.begin(), nodes.end(), [](const fgnode *a, const fgnode *b) { return a->pos < b->pos; });
+  nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+
+  bdd_ptr result = bdd_one(s->m);
+  for(fgnode *n: nodes)
+    for(int i = 0; i < n->num_neigh; i++)
+    {
+      bdd_ptr msg = n->neigh[i]->msg_fv;
+      if(msg == NULL)
+        continue;
+      bdd_ptr g = factor_graph_transfer(fg->m, s->m, msg);
+      if(g == NULL)
+      {
+        bdd_free(s->m, result);
+        return NULL;
+      }
+      bdd_and_accumulate(s->m, &result, g);
+      bdd_free(s->m, g);
+    }
+  return result;
+}
+
+/** Deletes a snapshot, and its graph if it was copied, but not its parent
+ */
+void factor_graph_snapshot_delete(factor_graph_snapshot *s)
+{
+  if(s->copy != NULL)
+    factor_graph_delete(s->copy);
+  free(s);
+}
+
+/** One thread of factor_graph_run_snapshots, with a manager of its own,
+ *    running jobs on snapshots of fg till there are none left
+ */
+void factor_graph_snapshot_worker(factor_graph *fg,
+                                  const std::vector<int> &order,
+                                  int num_jobs,
+                                  factor_graph_snapshot_job job,
+                                  void *data,
+                                  std::atomic<int> &next_job,
+                                  std::atomic<bool> &failed,
+                                  DdManager *&worker,
+                                  std::vector<bdd_ptr> &worker_results,
+                                  std::vector<DdManager *> &result_managers)
+{
+  worker = factor_graph_worker_manager(order);
+  if(worker == NULL)
+    failed = true;
+  for(int j = next_job++; j < num_jobs && !failed; j = next_job++)
+  {
+    factor_graph_snapshot *s = factor_graph_snapshot_new(fg, worker);
+    if(s == NULL)
+    {
+      failed = true;
+      break;
+    }
+    worker_results[j] = job(s, j, data);
+    result_managers[j] = worker;
+    if(worker_results[j] == NULL)
+      failed = true;
+    factor_graph_snapshot_delete(s);
+  }
+}
+
+/** Runs num_jobs jobs, each on a snapshot of fg of its own, on num_threads
+ *    threads (as many as the hardware has if not positive), each thread
+ *    with a manager of its own, with the variable order of the manager of fg
+ *  The snapshots only read fg till they change, so the jobs start from its
+ *    messages, and fg and its manager must not change till all are done
+ *  The result of each job, in the manager of its snapshot, is moved
+ *    to results[job], in the manager of fg
+ * OUTPUT : 0 if successful, -1 if out of memory, with all results NULL
+ */
+int factor_graph_run_snapshots(factor_graph *fg,
+                               int num_jobs,
+                               int num_threads,
+                               factor_graph_snapshot_job job,
+                               void *data,
+                               bdd_ptr *results)
+{
+  int i;
+  if(num_threads <= 0)
+    num_threads = max((int)std::thread::hardware_concurrency(), 1);
+  if(num_threads > num_jobs)
+    num_threads = num_jobs;
+
+  std::vector<int> order = factor_graph_variable_order(fg->m);
+  std::atomic<int> next_job(0);
+  std::atomic<bool> failed(false);
+  std::vector<DdManager *> workers(num_threads, NULL);
+  std::vector<bdd_ptr> worker_results(num_jobs, NULL);
+  std::vector<DdManager *> result_managers(num_jobs, NULL);
+  std::vector<std::thread> threads;
+  for(i = 0; i < num_threads; i++)
+    threads.emplace_back(factor_graph_snapshot_worker,
+                         fg, std::cref(order), num_jobs, job, data,
+                         std::ref(next_job), std::ref(failed),
+                         std::ref(workers[i]),
+                         std::ref(worker_results), std::ref(result_managers));
+  for(auto &thread: threads)
+    thread.join();
+
+  // move the results back
+  bool ok = !failed;
+  for(i = 0; i < num_jobs; i++)
+  {
+    results[i] = NULL;
+    if(worker_results[i] == NULL)
+      continue;
+    if(ok)
+    {
+      results[i] = factor_graph_transfer(result_managers[i], fg->m, worker_results[i]);
+      if(results[i] == NULL)
+        ok = false;
+    }
+    bdd_free(result_managers[i], worker_results[i]);
+  }
+  for(auto worker: workers)
+    if(worker != NULL)
+      bdd_quit(worker);
+
+  if(!ok)
+  {
+    for(i = 0; i < num_jobs; i++)
+      if(results[i] != NULL)
+      {
+        bdd_free(fg->m, results[i]);
+        results[i] = NULL;
+      }
+    return -1;
+  }
+  return 0;
+}
+
 void factor_graph_print(factor_graph *fg, const char * dotfile, const char * fgfile)
 {
-  fgnode_list *fiter, *viter;
-  fgedge_list *eiter;
+  fgnode *n;
   FILE *fgv;
   FILE *gv;
   if(strcmp(dotfile, "stdout"))
@@ -2514,48 +2896,40 @@ void factor_graph_print(factor_graph *fg, const char * dotfile, const char * fgf
   else
     fgv = stdout;
 
-  int i;
+  int i, j;
   //printf("* * * * * * *\n* Printing factor graph:\n");
-  fiter = fg->fl;
-  if(fiter == NULL || fg->vl == NULL)
+  if(fg->num_funcs == 0 || fg->num_vars == 0)
   {
     fprintf(fgv, "* factor graph has no functions/variables!!\n* * * * * * *\n");
     return;
   }
   fprintf(gv, "graph {\n");
   fprintf(fgv, "* Adjacency list:\n");
-  do {
-    fprintf(fgv, "* f%d : ", fiter->n->id);
-    eiter = fiter->n->neigh;
-    if(eiter != NULL) do {
-      SKIP_DEAD(eiter, fg);
-      fprintf(gv, "f%d -- v%d;\n", fiter->n->id, eiter->e->vn->id);
-      fprintf(fgv, "v%d ", eiter->e->vn->id);
-      eiter = eiter->next;
-    }while(eiter != fiter->n->neigh);
+  for(i = 0; i < fg->num_funcs; i++) {
+    n = fg->funcs[i];
+    fprintf(fgv, "* f%d : ", n->id);
+    for(j = 0; j < n->num_neigh; j++) {
+      fprintf(gv, "f%d -- v%d;\n", n->id, n->neigh[j]->vn->id);
+      fprintf(fgv, "v%d ", n->neigh[j]->vn->id);
+    }
     fprintf(fgv, "\n");
-    fiter = fiter->next;
-  }while(fiter != fg->fl);
+  }
 
   fprintf(fgv, "* Functions:\n");
-  do {
-    fprintf(fgv, "* f%d:\n",fiter->n->id);
-    //if(fiter->n->type == FUNC_NODE)
-    //  bdd_print_minterms(fg->m, fiter->n->f[0]);
-    SKIP_DEAD(fiter, fg);
-    fprintf(gv, "f%d [label=\"f%d(%d)\", shape=box];\n", fiter->n->id, fiter->n->id, fgnode_support_size(fg->m, fiter->n));
-    fiter = fiter->next;
-  }while(fiter != fg->fl);
-
-  viter = fg->vl;
+  for(i = 0; i < fg->num_funcs; i++) {
+    n = fg->funcs[i];
+    fprintf(fgv, "* f%d:\n", n->id);
+    //bdd_print_minterms(fg->m, n->f[0]);
+    fprintf(gv, "f%d [label=\"f%d(%d)\", shape=box];\n", n->id, n->id, fgnode_support_size(fg->m, n));
+  }
+
   fprintf(fgv, "* Variables:\n");
-  do {
-    SKIP_DEAD(viter, fg);
-    fprintf(fgv, "* v%d:\n",viter->n->id);
-    //bdd_print_minterms(fg->m, viter->n->f[0]);
-    fprintf(gv, "v%d [label=\"v%d(%d)\"];\n", viter->n->id, viter->n->id, fgnode_support_size(fg->m, viter->n));
-    viter = viter->next;
-  }while(viter != fg->vl);
+  for(i = 0; i < fg->num_vars; i++) {
+    n = fg->vars[i];
+    fprintf(fgv, "* v%d:\n", n->id);
+    //bdd_print_minterms(fg->m, n->f[0]);
+    fprintf(gv, "v%d [label=\"v%d(%d)\"];\n", n->id, n->id, fgnode_support_size(fg->m, n));
+  }
 
   fprintf(fgv, "* * * * * * *\n");
   fflush(stdout);
@@ -2564,13 +2938,6 @@ void factor_graph_print(factor_graph *fg, const char * dotfile, const char * fgf
     fclose(gv);
   if(fgv != stdout)
     fclose(fgv);
-
-  viter = fg->vl;
-  /*do{
-    fgdm("nei : ", viter->n->num_neigh);
-    viter = viter->next;
-    }while(viter != fg->vl);
-    */ 
 }
 
 
@@ -2583,214 +2950,110 @@ void factor_graph_print(factor_graph *fg, const char * dotfile, const char * fgf
  */
 int factor_graph_group_vars(factor_graph *fg, bdd_ptr vars)
 {
-  int count = 0;
-  fgnode_list *vl = fg->vl;
-  fgnode_list *nvl;
-  bdd_ptr intscn, unn;
-
-  do {
-    SKIP_DEAD(vl, fg);
-    intscn = bdd_cube_intersection(fg->m, vars, vl->n->f[0]);
-    if(intscn == NULL)
-      return -1;
-    if(intscn != bdd_one(fg->m))
-      count++;
-    bdd_free(fg->m, intscn);
-    vl = vl->next;
-  }while(vl != fg->vl);
+  const std::vector<fgnode *> &var_nodes = fg->store->var_nodes;
+  std::vector<fgnode *> grouped, candidates;
+  bdd_ptr unn;
+  int i;
 
-  if(count == 0 || count == 1)
+  // the var nodes holding the variables, found through the var node of each
+  for_each_cube_index(vars,
+                      [&](int index) {
+                        if(index < (int)var_nodes.size() && var_nodes[index] != NULL)
+                          grouped.push_back(var_nodes[index]);
+                      });
+  auto by_index = [](const fgnode *a, const fgnode *b) { return a->index < b->index; };
+  std::sort(grouped.begin(), grouped.end(), by_index);
+  grouped.erase(std::unique(grouped.begin(), grouped.end()), grouped.end());
+
+  if(grouped.size() < 2)
     return 0;
 
+  // the new var node is connected to the neighbours of the grouped ones, and no others
   unn = bdd_one(fg->m);
-  do {
-    SKIP_DEAD(vl, fg);
-    intscn = bdd_cube_intersection(fg->m, vars, vl->n->f[0]);
-    if(intscn == NULL)
-      return -1;
-    nvl = (vl->next == vl? NULL : vl->next);
-    if(intscn != bdd_one(fg->m))
-    {
-      bdd_and_accumulate(fg->m, &unn, vl->n->f[0]);
-      //factor_graph_delete_var(fg, vl->n->f[0]);
-      //assert(0); //fgtest3 debug : this function should not be called
-      factor_graph_hide_varnode(fg, vl->n);
-    }
-    bdd_free(fg->m, intscn);
-    vl = nvl;
-  }while(vl != fg->vl || nvl==NULL);
-  if(factor_graph_add_var(fg, unn) == -1)
-    return -1;
+  for(fgnode *vn: grouped)
+  {
+    bdd_and_accumulate(fg->m, &unn, vn->f[0]);
+    for(i = 0; i < vn->num_neigh; i++)
+      candidates.push_back(vn->neigh[i]->fn);
+  }
+  std::sort(candidates.begin(), candidates.end(), by_index);
+  candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+  for(fgnode *vn: grouped)
+    factor_graph_hide_node(fg, vn);
+
+  fgnode *newv = fgnode_new_var(fg, unn);
   bdd_free(fg->m, unn);
+  if(newv == NULL || factor_graph_add_node(fg, newv, candidates.data(), (int)candidates.size()) == -1)
+    return -1;
   return 0;
 }
 
 
-int factor_graph_verify(factor_graph *fg)//performing 7 tests
-{
-  fgnode_list *fl;
-  fgnode_list *vl;
-  fgedge_list *el;
-  fgedge_list *fl1;
-  fgedge_list *vl1;
-  int count = 0, temp;
-  int is_correct = 1;
-  int max_fid,max_vid,max_eid;
-  max_fid = max_vid = max_eid = -1;
-  fl=fg->fl;
-  vl=fg->vl;
-  //checking the number of function nodes
-  if(fl != NULL) do{
-    //printf("func id %d, born %d, died %d\n", fl->n->id, fl->n->born, fl->n->died);
-    //printf("       list born %d, died %d\n", fl->born, fl->died);
-    SKIP_DEAD(fl, fg);
-    if(fl->n->type != FUNC_NODE)
+/** Checks that the live arrays of the graph and of its nodes agree
+ * OUTPUT : 1 if they do, a negative number naming the failed check if not
+ */
+int factor_graph_verify(factor_graph *fg)
+{
+  int i, j;
+  long func_neigh = 0, var_neigh = 0;
+
+  //checking the function nodes
+  for(i = 0; i < fg->num_funcs; i++)
+  {
+    fgnode *n = fg->funcs[i];
+    if(n->type != FUNC_NODE)
     {
       fgdm("non func node in func list", 0);
       return -1;
     }
-    if(fl->n->id > max_fid){
-      max_fid=fl->n->id;
-    }
-    count++;
-    if(fl->next->prev != fl)
+    if(n->pos != i || !fg->store->nodes.in_use(n->index) || fg->store->nodes.at(n->index) != n)
     {
-      fgdm("inconsistent func list", 0);
+      fgdm("inconsistent func list", i);
       return -2;
     }
-    fflush(stdout);
-    fl = fl->next;
-  }while(fl != fg->fl);
-  if(count != fg->num_funcs){
-    fgdm("incorrect number of functions", count);
-    fgdm("correct number is ", fg->num_funcs);
-    return -3;
-  }
-  //if(max_fid != fg->max_fid){
-  //  return -4;
-  //}
-  //  fgdm("num_funcs ok", 0);
-  count = 0;//reset count for the check of the variable nodes
-  //checking the number of variable nodes
-  if(vl != NULL) do {
-    SKIP_DEAD(vl, fg);
-    if(vl->n->type != VAR_NODE)
+    for(j = 0; j < n->num_neigh; j++)
+      if(n->neigh[j]->fn != n || n->neigh[j]->fpos != j || n->neigh[j]->pos < 0)
+        return -11;
+    func_neigh += n->num_neigh;
+  }
+
+  //checking the variable nodes
+  for(i = 0; i < fg->num_vars; i++)
+  {
+    fgnode *n = fg->vars[i];
+    if(n->type != VAR_NODE)
       return -5;
-    if(vl->n->id > max_vid){
-      max_vid = vl->n->id;
-    }
-    count++;
-    if(vl->next->prev != vl)
+    if(n->pos != i || !fg->store->nodes.in_use(n->index) || fg->store->nodes.at(n->index) != n)
       return -6;
-    vl = vl->next;
-  }while(vl != fg->vl);
-  if(count != fg->num_vars){
-    fgdm("count is ", count);
-    fgdm("num_vars is ", fg->num_vars);
-    is_correct=-7;
-    return is_correct;
-  }
-  //if(max_vid != fg->max_vid){
-  //  is_correct = -8;
-  //  return is_correct;
-  //}
-  //  fgdm("num_vars ok", 1);
-  count = 0;  //reset count for the check of number of edges
-  //checking the total no. of edges
-  el = fg->el;
-  if(el != NULL) do{
-    SKIP_DEAD(el, fg);
-    if(el->e->id > max_eid){
-      max_eid = el->e->id;
-    }
-    if(el->e->fn->type != FUNC_NODE || el->e->vn->type != VAR_NODE)
+    for(j = 0; j < n->num_neigh; j++)
+      if(n->neigh[j]->vn != n || n->neigh[j]->vpos != j || n->neigh[j]->pos < 0)
+        return -12;
+    var_neigh += n->num_neigh;
+  }
+
+  //checking the edges
+  for(i = 0; i < fg->num_edges; i++)
+  {
+    fgedge *e = fg->edges[i];
+    if(e->fn->type != FUNC_NODE || e->vn->type != VAR_NODE)
     {
-      fgdm("el->e->fn->type", el->e->fn->type);
-      fgdm("el->e->vn->type", el->e->vn->type);
-      fgdm("el->e->id", el->e->id);
+      fgdm("e->fn->type", e->fn->type);
+      fgdm("e->vn->type", e->vn->type);
+      fgdm("e->id", e->id);
       return -9;
     }
-    count++;
-    if(el->next->prev != el)
+    if(e->pos != i || e->fn->pos < 0 || e->vn->pos < 0)
       return -10;
+  }
 
-    fl1 = el->e->fn->neigh;
-    temp = 0;
-    if(fl1 != NULL) do{
-      SKIP_DEAD(fl1, fg);
-      if(el->e == fl1->e){
-        temp = 1;
-        break;
-      }
-      fl1 = fl1->next;
-    }while(fl1 != el->e->fn->neigh);
-    if(temp != 1)
-      return -11;
-    temp = 0;
-    vl1 = el->e->vn->neigh;
-    if(vl1 != NULL) do{
-      SKIP_DEAD(vl1, fg);
-      if(el->e == vl1->e){
-        temp = 1;
-        break;
-      }
-      vl1 = vl1->next;
-    }while(vl1 != el->e->vn->neigh);
-    if(temp != 1)
-      return -12;
-
-
-    el = el->next;
-  }while(el != fg->el);
-  if(count != fg->num_edges){
-    is_correct = -13;
-    return is_correct;
-  }
-  //if(max_eid != fg->max_eid){
-  //  is_correct = -14;
-  //  return is_correct;
-  //}
-  //  fgdm("num_edges ok", 2);
-  //checking the no. of neighbours of each function node
-  do{
-    SKIP_DEAD(fl, fg);
-    fl1 = fl->n->neigh;
-    count = 0;
-    if(fl1 != NULL) do{
-      SKIP_DEAD(fl1, fg);
-      count++;
-      if(fl1->next->prev != fl1)
-        return -15;
-      fl1 = fl1->next;
-    }while(fl1 != fl->n->neigh);
-    if(count != fl->n->num_neigh){
-      is_correct = -16;
-      return is_correct;
-    }
-    fl = fl->next;
-  }while(fl != fg->fl);
-
-  count = 0;//reset count for the check of no. of neighbours of a variable node
-  //checking no. of neighbours of a variable node
-  do{
-    SKIP_DEAD(vl, fg);
-    vl1 = vl->n->neigh;
-    count = 0;
-    if(vl1 != NULL) do{
-      SKIP_DEAD(vl1, fg);
-      count++;
-      if(vl1->next->prev != vl1)
-        return -17;
-      vl1 = vl1->next;
-    }while(vl1 != vl->n->neigh);
-    if(count != vl->n->num_neigh){
-      is_correct = -18;
-      return is_correct;
-    }
-    vl = vl->next;
-  }while(vl != fg->vl);
+  //checking the no. of neighbours of the nodes
+  if(func_neigh != fg->num_edges)
+    return -16;
+  if(var_neigh != fg->num_edges)
+    return -18;
 
-  return is_correct;
+  return 1;
 }
 
 int factor_graph_test(DdManager *m)
@@ -2804,18 +3067,12 @@ void var_to_eliminate(factor_graph *fg, fgnode *n, bdd_ptr *ans, int *score)
 {
   int i;
   int count;
-  fgedge_list *e;
   bdd_ptr supp_set;
   bdd_ptr var, temp;
   if(n->type == FUNC_NODE)
   {
-    //e = n->neigh;
-    //do
-    //{
-    //  SKIP_DEAD(e, fg);
-    //  var_to_eliminate(fg, e->e->vn, ans, score);
-    //  e = e->next;
-    //}while(e != n->neigh);
+    //for(i = 0; i < n->num_neigh; i++)
+    //  var_to_eliminate(fg, n->neigh[i]->vn, ans, score);
     return;
   }
   assert(n->type == VAR_NODE);
@@ -2828,14 +3085,9 @@ void var_to_eliminate(factor_graph *fg, fgnode *n, bdd_ptr *ans, int *score)
     bdd_free(fg->m, supp_set);
     supp_set = temp;
     count = 0;
-    e = n->neigh;
-    do
-    {
-      SKIP_DEAD(e, fg);
-      if(fgnode_intersects_var(fg, e->e->fn, var))
+    for(i = 0; i < n->num_neigh; i++)
+      if(fgnode_intersects_var(fg, n->neigh[i]->fn, var))
         count++;
-      e = e->next;
-    }while(e != n->neigh);
     if(count > *score)
     {
       *score = count;
@@ -2953,19 +3205,13 @@ bdd_ptr *vector_to_bdd(DdManager *m, int **cnf, int *clssz, int cnfsz, int *ress
 bool factor_graph_is_single_connected_component(factor_graph *fg)
 {
   int const COLOR_UNVISITED = 0, COLOR_VISITED = 1;
-  if (fg->fl == NULL || fg->vl == NULL)
-    return false;
-  fgnode * topNode = NULL;
-  auto mark_unvisited = [&](fgnode_list *fl)
-                        {
-                          fl->n->color = COLOR_UNVISITED;
-                          topNode = fl->n;
-                        };
-  for_each_list(fg->fl, mark_unvisited);
-  for_each_list(fg->vl, mark_unvisited);
-
-  if (NULL == topNode)
+  if (fg->num_funcs == 0 || fg->num_vars == 0)
     return false;
+  for (int i = 0; i < fg->num_funcs; ++i)
+    fg->funcs[i]->color = COLOR_UNVISITED;
+  for (int i = 0; i < fg->num_vars; ++i)
+    fg->vars[i]->color = COLOR_UNVISITED;
+  fgnode * topNode = fg->vars[fg->num_vars - 1];
 
   std::queue<fgnode*> q;
   q.push(topNode);
@@ -2975,27 +3221,25 @@ bool factor_graph_is_single_connected_component(factor_graph *fg)
   {
     auto curNode = q.front();
     q.pop();
-    for_each_list(curNode->neigh,
-                  [&](fgedge_list * el)
-                  {
-                    fgnode * nextNode = (curNode->type == FUNC_NODE ? el->e->vn : el->e->fn);
-                    if (nextNode->color == COLOR_UNVISITED)
-                    {
-                      nextNode->color = COLOR_VISITED;
-                      q.push(nextNode);
-                    }
-                  });
-  }
-
-  bool isConnected = true;
-  auto find_unvisited = [&](fgnode_list *nl)
-                        {
-                          if(nl->n->color == COLOR_UNVISITED)
-                            isConnected = false;
-                        };
-  for_each_list(fg->fl, find_unvisited);
-  for_each_list(fg->vl, find_unvisited);
-  return isConnected;
+    for (int i = 0; i < curNode->num_neigh; ++i)
+    {
+      fgedge * e = curNode->neigh[i];
+      fgnode * nextNode = (curNode->type == FUNC_NODE ? e->vn : e->fn);
+      if (nextNode->color == COLOR_UNVISITED)
+      {
+        nextNode->color = COLOR_VISITED;
+        q.push(nextNode);
+      }
+    }
+  }
+
+  for (int i = 0; i < fg->num_funcs; ++i)
+    if (fg->funcs[i]->color == COLOR_UNVISITED)
+      return false;
+  for (int i = 0; i < fg->num_vars; ++i)
+    if (fg->vars[i]->color == COLOR_UNVISITED)
+      return false;
+  return true;
 }
 
 
@@ -30,38 +30,66 @@ SOFTWARE.
 #include <util.h>
 #include <dd/dd.h>
 
+// if non-zero, factor_graph_assign_var, factor_graph_rollback and
+// factor_graph_make_acyclic verify the whole graph after every change,
+// which costs time proportional to the graph rather than to the change
+#ifndef FACTOR_GRAPH_DEBUG
 #define FACTOR_GRAPH_DEBUG 1
+#endif
 
 typedef enum fgnode_type_enum{VAR_NODE, FUNC_NODE} fgnode_type;
 
+namespace parakram { class ConjunctionTree; }
+
+// nodes with at least this many edges keep a tree of the partial
+// conjunctions of their incoming messages (see dd/conjunction_tree.h),
+// zero disables the trees
+#define FACTOR_GRAPH_PARTIAL_PRODUCT_DEGREE 16
+
 struct fgnode;
 struct fgnode_list;
 struct fgedge;
-struct fgedge_list;
+struct fgstore;
 struct factor_graph;
-
+struct factor_graph_snapshot;
+
+// Nodes and edges live in arenas of the factor graph (see fgstore in
+// factor_graph.cpp), addressed by their index. The graph and each node
+// keep dense arrays of the live nodes and edges, so walks never see
+// the hidden ones. A node or edge is hidden, rather than deleted,
+// when it is removed after the checkpoint (fg->time) it was born at,
+// and is recorded in an undo log, so factor_graph_rollback only
+// touches what changed since the last checkpoint.
 struct fgnode
 {
   int id;
   bdd_ptr *f, *ss;
   struct fgnode *parent;
-  struct fgedge_list *neigh;
+  struct fgedge **neigh;   // the live edges of the node, num_neigh of them
   int num_neigh;
+  int neigh_capacity;
   int num_messages;
   int fs;
   int color;
   fgnode_type type;
   int born;
   int died;
+  parakram::ConjunctionTree *partials;
+  // if the factor graph times its nodes, the firings of this node
+  // in the last factor_graph_converge, and their wall time in seconds
+  long num_firings;
+  double fire_time;
+  int index;               // in the node arena of the graph
+  int pos;                 // among the live func or var nodes of the graph, -1 if hidden
+  int undo_add, undo_hide; // entries of the node in the undo log, -1 if none
 };
 
+// a queue of nodes, for walking the graph
 struct fgnode_list
 {
   struct fgnode_list *next;
   struct fgnode_list *prev;
   fgnode * n;
-  int born;
-  int died;
 };
 
 struct fgedge
@@ -73,32 +101,57 @@ struct fgedge
   int id;
   int born;
   int died;
+  int index;               // in the edge arena of the graph
+  int pos;                 // among the live edges of the graph, -1 if hidden
+  int fpos, vpos;          // among the live edges of fn and of vn
+  int undo_add, undo_hide; // entries of the edge in the undo log, -1 if none
 };
 
-struct fgedge_list
+// what one round of factor_graph_converge did, a round being
+// the firings of func nodes, or of var nodes, one after the other
+struct factor_graph_round_stats
 {
-  struct fgedge_list *next;
-  struct fgedge_list *prev;
-  fgedge *e;
-  int born;
-  int died;
+  int round;
+  long num_firings;
+  long num_messages_changed;
+  long total_message_size;   // bdd nodes, counted for each message on its own
+  int max_message_size;
+  long num_live_nodes;
+  double cache_hit_rate;     // of the CUDD computed table, during the round
+  double wall_time;          // in seconds
+  double cpu_time;           // in seconds
 };
 
+// told about each round by factor_graph_converge
+typedef void (*factor_graph_round_callback)(factor_graph *fg, const factor_graph_round_stats *stats, void *data);
+
 struct factor_graph
 {
-  fgnode_list *fl;
-  fgnode_list *vl;
-  fgedge_list *el;
+  fgnode **funcs;          // the live func nodes, num_funcs of them
+  fgnode **vars;           // the live var nodes, num_vars of them
+  fgedge **edges;          // the live edges, num_edges of them
   int num_funcs, num_vars, num_edges;
+  int funcs_capacity, vars_capacity, edges_capacity;
   int max_fid, max_vid, max_eid;
   DdManager *m;
   int time;
+  int partial_product_degree;
+  factor_graph_round_callback round_callback;
+  void *round_callback_data;
+  int time_nodes;
+  struct fgstore *store;   // the arenas of the nodes and edges, and the undo log
 };
 
 factor_graph * factor_graph_new(DdManager *m,bdd_ptr *f, int size);
 void factor_graph_delete(factor_graph *fg);
+factor_graph * factor_graph_copy(factor_graph *fg, DdManager *m);
 int factor_graph_converge(factor_graph *fg);
+int factor_graph_reconverge(factor_graph *fg);
+void factor_graph_set_round_callback(factor_graph *fg, factor_graph_round_callback callback, void *data, int time_nodes);
+void factor_graph_write_round_json(factor_graph *fg, const factor_graph_round_stats *stats, void *file);
+void factor_graph_write_node_times_json(factor_graph *fg, FILE *file);
 int factor_graph_acyclic_messages(factor_graph *fg, fgnode* root);
+int factor_graph_acyclic_all_messages(factor_graph *fg, int num_threads);
 int factor_graph_group_vars(factor_graph *fg, bdd_ptr vars);
 int factor_graph_verify(factor_graph *fg);
 int factor_graph_test(DdManager *dd);
@@ -113,19 +166,21 @@ int factor_graph_is_connected(DdManager * m, fgnode* f, fgnode *v);
 fgnode * factor_graph_get_varnode(factor_graph *fg, bdd_ptr v);
 bool factor_graph_is_single_connected_component(factor_graph *fg);
 
+// Copy-on-write snapshots of a converged factor graph, for exploring
+// assignments on several threads at once, each in a manager of its own
+// (see factor_graph_run_snapshots in factor_graph.cpp)
+factor_graph_snapshot * factor_graph_snapshot_new(factor_graph *fg, DdManager *m);
+factor_graph * factor_graph_snapshot_write(factor_graph_snapshot *s);
+int factor_graph_snapshot_assign(factor_graph_snapshot *s, bdd_ptr assignment);
+bdd_ptr factor_graph_snapshot_message(factor_graph_snapshot *s, bdd_ptr vars);
+void factor_graph_snapshot_delete(factor_graph_snapshot *s);
+
+// a job of factor_graph_run_snapshots: its result, in the manager of
+// the snapshot, or NULL if out of memory
+typedef bdd_ptr (*factor_graph_snapshot_job)(factor_graph_snapshot *s, int job, void *data);
+int factor_graph_run_snapshots(factor_graph *fg, int num_jobs, int num_threads, factor_graph_snapshot_job job, void *data, bdd_ptr *results);
+
 #define fgdm(m, i) printf("%s: %s %d\n", __FUNCTION__, m, i); fflush(stdout)
 //#define fgdm(i) 0
 
-template<typename FgList, typename Func>
-void for_each_list(FgList* const fl, Func func, int const time = -1)
-{
-  if (NULL == fl)
-    return;
-  auto fli = fl;
-  do {
-    if (fli->died > time)
-      func(fli);
-    fli = fli->next;
-  } while(fli != fl);
-}
 
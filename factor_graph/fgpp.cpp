@@ -24,9 +24,21 @@ SOFTWARE.
 
 #include "fgpp.h"
 
+#include <dd/conjunction_tree.h>
+#include <dd/disjoint_set.h>
+
 #include <stdexcept>
 #include <map>
+#include <queue>
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <ostream>
+#include <set>
+#include <sstream>
 
 namespace {
 
@@ -46,9 +58,32 @@ namespace {
   struct FGNode {
     FGEdgePtrSet edges;
     dd::BddWrapper nodeBdd;
+    long long residual; // for Schedule::Residual
+    std::unique_ptr<parakram::ConjunctionTree> partials; // for nodes of high degree
+    long long numFirings; // when nodes are timed
+    double wallTime;
+    bool keepsPartials(int partialProductDegree) const
+    {
+      return partialProductDegree > 0 && static_cast<int>(edges.size()) >= partialProductDegree;
+    }
     virtual ~FGNode() {}
-    FGNode(const dd::BddWrapper & v_nodeBdd) : edges(), nodeBdd(v_nodeBdd) {}
-    virtual void passMessages(FGNodePtrSet & updatedNodes) = 0;
+    FGNode(const dd::BddWrapper & v_nodeBdd) : edges(), nodeBdd(v_nodeBdd), residual(0), partials(), numFirings(0), wallTime(0) {}
+    // if trackResiduals, also add to the residual of each updated node
+    // nodes with at least partialProductDegree edges keep their partials
+    // returns the number of messages that changed
+    virtual int passMessages(FGNodePtrSet & updatedNodes, bool trackResiduals = false, int partialProductDegree = 0) = 0;
+    // the conjunction of first and the given incoming message of each edge
+    dd::BddWrapper conjoinIncoming(const dd::BddWrapper & first,
+                                   dd::BddWrapper FGEdge::* message,
+                                   int partialProductDegree);
+    // the same, left as the product of the two children of the root
+    //   of the tree of partial conjunctions, for nodes that keep one
+    dd::BddProduct conjoinIncomingBelowRoot(const dd::BddWrapper & first,
+                                            dd::BddWrapper FGEdge::* message);
+    // the leaves of that tree, in the order of the edges,
+    //   which changes only when grouping
+    std::vector<bdd_ptr> partialLeaves(const dd::BddWrapper & first,
+                                       dd::BddWrapper FGEdge::* message) const;
   };
 
   struct FGEdge {
@@ -56,6 +91,12 @@ namespace {
     FGFactorNodeWeakPtr factorNode;
     dd::BddWrapper variableToFactorMessage;
     dd::BddWrapper factorToVariableMessage;
+    // the variables projected away by each message:
+    //   those of the factor's support outside the variable node, and vice versa
+    dd::BddWrapper factorQuantified;
+    dd::BddWrapper variableQuantified;
+    // recompute them, after grouping changed either node
+    void updateQuantified();
     FGVariableNodePtr getVariableNode()
     {
       FGVariableNodePtr result = variableNode.lock();
@@ -73,12 +114,12 @@ namespace {
 
   struct FGVariableNode : public FGNode {
     FGVariableNode(const dd::BddWrapper & v_nodeBdd): FGNode(v_nodeBdd) {}
-    virtual void passMessages(FGNodePtrSet & updatedNodes) override;
+    virtual int passMessages(FGNodePtrSet & updatedNodes, bool trackResiduals = false, int partialProductDegree = 0) override;
   };
 
   struct FGFactorNode : public FGNode {
     FGFactorNode(const dd::BddWrapper & v_nodeBdd): FGNode(v_nodeBdd), supportBdd(v_nodeBdd.support()) {}
-    virtual void passMessages(FGNodePtrSet & updatedNodes) override;
+    virtual int passMessages(FGNodePtrSet & updatedNodes, bool trackResiduals = false, int partialProductDegree = 0) override;
     dd::BddWrapper supportBdd;
   };
 
@@ -89,6 +130,23 @@ namespace {
   }
 
 
+  // the messages without duplicates or ones, in order of first occurrence,
+  //   or just zero if any of them is zero
+  std::vector<dd::BddWrapper> distinctMessages(const std::vector<dd::BddWrapper> & messages)
+  {
+    std::vector<dd::BddWrapper> result;
+    std::set<bdd_ptr> seen;
+    for (const auto & message: messages)
+    {
+      if (message.isZero())
+        return std::vector<dd::BddWrapper>(1, message);
+      if (!message.isOne() && seen.insert(message.getUncountedBdd()).second)
+        result.push_back(message);
+    }
+    return result;
+  }
+
+
   class FactorGraphImpl: public fgpp::FactorGraph
   {
     public:
@@ -99,15 +157,41 @@ namespace {
 
       BddWrapper groupFactors(const std::vector<BddWrapper> & factors) override;
       void groupVariables(const BddWrapper & variableCube) override;
+      std::vector<BddWrapper> groupFactors(const std::vector<std::vector<BddWrapper> > & factorGroups) override;
+      void groupVariables(const std::vector<BddWrapper> & variableCubes) override;
       std::vector<BddWrapper> getIncomingMessages(const BddWrapper & variableCube) const override;
-      int converge() override;
+      using fgpp::FactorGraph::converge;
+      int converge(Schedule schedule, Start start) override;
+      ConvergenceStats getConvergenceStats() const override { return m_stats; }
+      void setPartialProductDegree(int degree) override { m_partialProductDegree = degree; }
 
       static void test(DdManager *);
 
+      // for the nodes, which fire outside the graph
+      using fgpp::FactorGraph::residualOf;
+
     private:
+      void convergeFlooding(FGNodePtrSet pendingSet);
+      void convergeResidual(const FGNodePtrSet & pendingSet);
+
+      // fire a node, counting it and the messages it changed,
+      //   and timing it if nodes are timed
+      void fire(const FGNodePtr & node, FGNodePtrSet & updatedNodes, bool trackResiduals);
+
+      // tell the observer about the round since before and clock
+      void reportRound(int round, const ConvergenceStats & before, const RoundClock & clock) const;
+      RoundClock startRound() const { return RoundClock({(*m_factorNodes.cbegin())->nodeBdd.getManager()}); }
+
+      // replace the nodes by a single one, doing nothing for fewer than two
+      BddWrapper mergeFactorNodes(const std::vector<FGNodePtr> & old_fnodes);
+      void mergeVariableNodes(const std::vector<FGNodePtr> & old_vnodes);
+
       FGEdgePtrSet m_edges;
       FGNodePtrSet m_factorNodes;
       FGNodePtrSet m_variableNodes;
+      FGNodePtrSet m_pendingNodes; // nodes to fire first on a warm start
+      ConvergenceStats m_stats;
+      int m_partialProductDegree = DefaultPartialProductDegree;
 
   };
 
@@ -118,28 +202,96 @@ namespace {
     variableNode(v_variableNode),
     factorNode(v_factorNode),
     variableToFactorMessage(v_variableNode->nodeBdd.one()),
-    factorToVariableMessage(v_variableNode->nodeBdd.one())
+    factorToVariableMessage(v_variableNode->nodeBdd.one()),
+    factorQuantified(v_factorNode->supportBdd.cubeDiff(v_variableNode->nodeBdd)),
+    variableQuantified(v_variableNode->nodeBdd.cubeDiff(v_factorNode->supportBdd))
   { }
 
 
 
+  void FGEdge::updateQuantified()
+  {
+    const auto & vnode = getVariableNode()->nodeBdd;
+    const auto & fsupport = getFactorNode()->supportBdd;
+    factorQuantified = fsupport.cubeDiff(vnode);
+    variableQuantified = vnode.cubeDiff(fsupport);
+  }
+
+
+
+
+
+
+  dd::BddWrapper FGNode::conjoinIncoming(const dd::BddWrapper & first,
+                                         dd::BddWrapper FGEdge::* message,
+                                         int partialProductDegree)
+  {
+    using namespace dd;
+    // a single conjunction of all of them
+    if (!keepsPartials(partialProductDegree))
+    {
+      partials.reset();
+      BddProduct product(first);
+      for (const auto & edge: edges)
+        product *= (*edge).*message;
+      return product.evaluate();
+    }
+
+    // or the root of the tree, after replacing the leaves that changed
+    std::vector<bdd_ptr> leaves = partialLeaves(first, message);
+    if (!partials)
+      partials.reset(new parakram::ConjunctionTree(first.getManager()));
+    bdd_ptr conjoined = partials->update(&leaves.front(), static_cast<int>(leaves.size()));
+    return BddWrapper(bdd_dup(conjoined), first.getManager());
+  }
 
 
 
-  void FGVariableNode::passMessages(FGNodePtrSet & updatedNodes)
+  dd::BddProduct FGNode::conjoinIncomingBelowRoot(const dd::BddWrapper & first,
+                                                  dd::BddWrapper FGEdge::* message)
   {
     using namespace dd;
-    // compute message
-    BddWrapper message =  nodeBdd.one();
+    std::vector<bdd_ptr> leaves = partialLeaves(first, message);
+    if (!partials)
+      partials.reset(new parakram::ConjunctionTree(first.getManager()));
+    auto children = partials->updateChildren(&leaves.front(), static_cast<int>(leaves.size()));
+    BddProduct result(BddWrapper(bdd_dup(children.first), first.getManager()));
+    if (NULL != children.second)
+      result *= BddWrapper(bdd_dup(children.second), first.getManager());
+    return result;
+  }
+
+
+
+  std::vector<bdd_ptr> FGNode::partialLeaves(const dd::BddWrapper & first,
+                                             dd::BddWrapper FGEdge::* message) const
+  {
+    std::vector<bdd_ptr> leaves;
+    leaves.reserve(edges.size() + 1);
+    leaves.push_back(first.getUncountedBdd());
     for (const auto & edge: edges)
-      message = message * edge->factorToVariableMessage;
+      leaves.push_back(((*edge).*message).getUncountedBdd());
+    return leaves;
+  }
+
+
+
+
+
+
+  int FGVariableNode::passMessages(FGNodePtrSet & updatedNodes, bool trackResiduals, int partialProductDegree)
+  {
+    using namespace dd;
+    // compute message, the conjunction of all incoming messages
+    BddWrapper message = conjoinIncoming(nodeBdd.one(), &FGEdge::factorToVariableMessage, partialProductDegree);
 
     // update message for each edge
+    int numChanged = 0;
     for (const auto & edge: edges)
     {
       // project the message
       FGFactorNodePtr factorNode = edge->getFactorNode();
-      BddWrapper factorMessage = project(message, factorNode->supportBdd);
+      BddWrapper factorMessage = message.existentialQuantification(edge->variableQuantified);
 
       
       // if message is already updated, skip
@@ -147,37 +299,55 @@ namespace {
         continue;
 
       // update the message
+      if (trackResiduals)
+        factorNode->residual += FactorGraphImpl::residualOf(edge->variableToFactorMessage, factorMessage);
       edge->variableToFactorMessage = factorMessage;
       updatedNodes.insert(factorNode);
+      ++numChanged;
     }
-
+    return numChanged;
   }
 
 
 
-  void FGFactorNode::passMessages(FGNodePtrSet & updatedNodes)
+  int FGFactorNode::passMessages(FGNodePtrSet & updatedNodes, bool trackResiduals, int partialProductDegree)
   {
     using namespace dd;
-    // compute conjoined message
-    BddWrapper conjoined = nodeBdd;
-    for (const auto & edge: edges)
-      conjoined = conjoined * edge->variableToFactorMessage;
+    // the factor itself and all incoming messages:
+    //   left as a product, so that each projection below is fused
+    //   with the conjunction, which is never built,
+    //   or, with a tree of partial conjunctions, with the conjunction
+    //   of the two children of its root, which is not built either
+    BddProduct conjoined(nodeBdd);
+    if (keepsPartials(partialProductDegree))
+      conjoined = conjoinIncomingBelowRoot(nodeBdd, &FGEdge::variableToFactorMessage);
+    else
+    {
+      partials.reset();
+      for (const auto & edge: edges)
+        conjoined *= edge->variableToFactorMessage;
+    }
 
     // update message for each edge
+    int numChanged = 0;
     for (const auto & edge: edges)
     {
       // project the message
       FGVariableNodePtr variableNode = edge->getVariableNode();
-      BddWrapper variableMessage = project(conjoined, variableNode->nodeBdd);
+      BddWrapper variableMessage = conjoined.existentialQuantification(edge->factorQuantified);
 
       // if message is already updated, skip
       if (edge->factorToVariableMessage == variableMessage)
         continue;
 
       // update the message
+      if (trackResiduals)
+        variableNode->residual += FactorGraphImpl::residualOf(edge->factorToVariableMessage, variableMessage);
       edge->factorToVariableMessage = variableMessage;
       updatedNodes.insert(variableNode);
+      ++numChanged;
     }
+    return numChanged;
   }
 
 
@@ -216,42 +386,158 @@ namespace {
         fnode->edges.insert(edge);
       }
     }
+    m_pendingNodes = m_factorNodes;
   }
 
 
 
-  int FactorGraphImpl::converge()
+  int FactorGraphImpl::converge(Schedule schedule, Start start)
   {
-    // reset all messages
+    m_stats = ConvergenceStats();
     if (m_factorNodes.empty()) return 0;
-    auto one = (*m_factorNodes.cbegin())->nodeBdd.one();
-    for (const auto & edge: m_edges)
+    if (start == Start::Cold)
     {
-      edge->variableToFactorMessage = one;
-      edge->factorToVariableMessage = one;
+      // reset all messages
+      auto one = (*m_factorNodes.cbegin())->nodeBdd.one();
+      for (const auto & edge: m_edges)
+      {
+        edge->variableToFactorMessage = one;
+        edge->factorToVariableMessage = one;
+      }
+      m_pendingNodes = m_factorNodes;
     }
+    for (auto * nodes: {&m_factorNodes, &m_variableNodes})
+      for (const auto & node: *nodes)
+      {
+        node->numFirings = 0;
+        node->wallTime = 0;
+      }
 
-    // set up factor nodes for message passing
-    FGNodePtrSet pendingSet(m_factorNodes.cbegin(), m_factorNodes.cend());
-    
+    // every other node already sends what its incoming messages imply
+    FGNodePtrSet pendingSet;
+    pendingSet.swap(m_pendingNodes);
+    if (schedule == Schedule::Residual)
+      convergeResidual(pendingSet);
+    else
+      convergeFlooding(std::move(pendingSet));
+
+    if (m_observer)
+    {
+      std::vector<NodeTime> nodeTimes;
+      for (auto * nodes: {&m_factorNodes, &m_variableNodes})
+        for (const auto & node: *nodes)
+          if (node->numFirings > 0)
+            nodeTimes.push_back(NodeTime{nodes == &m_factorNodes, node->nodeBdd, node->numFirings, node->wallTime});
+      reportConverged(m_stats, std::move(nodeTimes));
+    }
+    return m_stats.numIterations;
+  }
+
+
+
+  void FactorGraphImpl::convergeFlooding(FGNodePtrSet pendingSet)
+  {
     // pass messages and collect nodes for next iteration
-    int numIterations = 0;
     while(!pendingSet.empty())
     {
-      ++numIterations;
+      ++m_stats.numIterations;
+      ConvergenceStats before = m_stats;
+      RoundClock clock = startRound();
       FGNodePtrSet updatedNodes;
       for (const auto & node: pendingSet)
-        node->passMessages(updatedNodes);
+        fire(node, updatedNodes, false);
+      if (m_observer)
+        reportRound(m_stats.numIterations, before, clock);
 
       pendingSet.swap(updatedNodes);
     }
+  }
+
+
 
-    return numIterations;
+  void FactorGraphImpl::convergeResidual(const FGNodePtrSet & pendingSet)
+  {
+    // every pending node starts with the size of its own bdd as residual,
+    //   the information it has not sent yet
+    // entries of the queue whose residual is out of date are skipped
+    typedef std::pair<long long, FGNodePtr> Entry;
+    std::priority_queue<Entry> queue;
+    for (const auto & vnode: m_variableNodes)
+      vnode->residual = 0;
+    for (const auto & fnode: m_factorNodes)
+      fnode->residual = 0;
+    for (const auto & node: pendingSet)
+    {
+      node->residual = bdd_size(node->nodeBdd.getUncountedBdd());
+      queue.push(Entry(node->residual, node));
+    }
+
+    // fire the node with the largest residual,
+    //   until no node has pending messages,
+    //   in rounds of as many firings as there are nodes
+    long long const roundLength = m_factorNodes.size() + m_variableNodes.size();
+    int round = 0;
+    ConvergenceStats before = m_stats;
+    RoundClock clock = startRound();
+    while(!queue.empty())
+    {
+      Entry top = queue.top();
+      queue.pop();
+      if (top.second->residual != top.first)
+        continue;
+      top.second->residual = 0;
+      FGNodePtrSet updatedNodes;
+      fire(top.second, updatedNodes, true);
+      for (const auto & node: updatedNodes)
+        queue.push(Entry(node->residual, node));
+      if (m_observer && m_stats.numFirings - before.numFirings == roundLength)
+      {
+        reportRound(++round, before, clock);
+        before = m_stats;
+        clock = startRound();
+      }
+    }
+    if (m_observer && m_stats.numFirings > before.numFirings)
+      reportRound(++round, before, clock);
+    m_stats.numIterations = static_cast<int>(m_stats.numFirings);
   }
 
 
 
 
+  void FactorGraphImpl::fire(const FGNodePtr & node, FGNodePtrSet & updatedNodes, bool trackResiduals)
+  {
+    ++m_stats.numFirings;
+    if (!m_timeNodes)
+    {
+      m_stats.numMessagesChanged += node->passMessages(updatedNodes, trackResiduals, m_partialProductDegree);
+      return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    m_stats.numMessagesChanged += node->passMessages(updatedNodes, trackResiduals, m_partialProductDegree);
+    node->wallTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ++node->numFirings;
+  }
+
+
+
+  void FactorGraphImpl::reportRound(int round, const ConvergenceStats & before, const RoundClock & clock) const
+  {
+    RoundStats stats;
+    clock.finish(stats);
+    stats.round = round;
+    stats.numFirings = m_stats.numFirings - before.numFirings;
+    stats.numMessagesChanged = m_stats.numMessagesChanged - before.numMessagesChanged;
+    for (const auto & edge: m_edges)
+    {
+      measureMessage(edge->variableToFactorMessage, stats);
+      measureMessage(edge->factorToVariableMessage, stats);
+    }
+    m_observer->onRound(stats);
+  }
+
+
+
   std::vector<dd::BddWrapper> FactorGraphImpl::getIncomingMessages(const BddWrapper & variableCube) const
   {
     std::vector<BddWrapper> result;
@@ -272,37 +558,99 @@ namespace {
 
   dd::BddWrapper FactorGraphImpl::groupFactors(const std::vector<BddWrapper>& factors)
   {
-    if (factors.empty())
-      throw std::invalid_argument("FactorGraph::groupFactors must be called with at least one factor.");
-    std::set<BddWrapper> factorSet(factors.cbegin(), factors.cend());
-    FGFactorNodePtr new_fnode = std::make_shared<FGFactorNode>(factors.cbegin()->one());
-    FGNodePtrSet neighbors;
-    for (auto fit = m_factorNodes.begin(); fit != m_factorNodes.end();)
-    {
-      FGNodePtr old_fnode = *fit;
-      if (factorSet.count(old_fnode->nodeBdd) == 0)
+    return groupFactors(std::vector<std::vector<BddWrapper> >(1, factors)).front();
+  }
+
+
+
+
+
+  std::vector<dd::BddWrapper> FactorGraphImpl::groupFactors(const std::vector<std::vector<BddWrapper> > & factorGroups)
+  {
+    for (const auto & factors: factorGroups)
+      if (factors.empty())
+        throw std::invalid_argument("FactorGraph::groupFactors must be called with at least one factor.");
+
+    // index the factor nodes by their factor, which several nodes may share
+    std::vector<FGNodePtr> nodes(m_factorNodes.cbegin(), m_factorNodes.cend());
+    std::map<bdd_ptr, std::vector<int> > nodesOfFactor;
+    for (int n = 0; n < static_cast<int>(nodes.size()); ++n)
+      nodesOfFactor[nodes[n]->nodeBdd.getUncountedBdd()].push_back(n);
+    std::vector<std::vector<int> > groups;
+    for (const auto & factors: factorGroups)
+    {
+      groups.emplace_back();
+      for (const auto & factor: factors)
       {
-        ++fit;
-        continue;
+        auto nit = nodesOfFactor.find(factor.getUncountedBdd());
+        if (nit != nodesOfFactor.end())
+          groups.back().insert(groups.back().end(), nit->second.cbegin(), nit->second.cend());
       }
+    }
+
+    std::vector<int> groupClasses;
+    std::vector<BddWrapper> classFactors;
+    for (const auto & nodeClass: parakram::joinGroups(static_cast<int>(nodes.size()), groups, &groupClasses))
+    {
+      std::vector<FGNodePtr> classNodes;
+      for (int n: nodeClass)
+        classNodes.push_back(nodes[n]);
+      classFactors.push_back(mergeFactorNodes(classNodes));
+    }
+    std::vector<BddWrapper> result;
+    for (size_t g = 0; g < factorGroups.size(); ++g)
+    {
+      if (groupClasses[g] < 0)
+        result.push_back(factorGroups[g].front().one());
+      else
+        result.push_back(classFactors[groupClasses[g]]);
+    }
+    return result;
+  }
+
+
+
 
+
+  dd::BddWrapper FactorGraphImpl::mergeFactorNodes(const std::vector<FGNodePtr> & old_fnodes)
+  {
+    if (old_fnodes.size() < 2)
+      return old_fnodes.front()->nodeBdd;
+    FGFactorNodePtr new_fnode = std::make_shared<FGFactorNode>(old_fnodes.front()->nodeBdd.one());
+    // the edge of the new node to each neighbour, starting at the
+    //   conjunction of the messages of the edges it replaces
+    std::map<FGNodePtr, FGEdgePtr> neighbors;
+    for (const auto & old_fnode: old_fnodes)
+    {
       new_fnode->nodeBdd = new_fnode->nodeBdd * old_fnode->nodeBdd;
       for (const auto & old_edge: old_fnode->edges)
       {
         const auto & old_vnode = old_edge->getVariableNode();
         m_edges.erase(old_edge);
         old_vnode->edges.erase(old_edge);
-        if (neighbors.count(old_vnode))
-          continue;
-        neighbors.insert(old_vnode);
-        FGEdgePtr new_edge = std::make_shared<FGEdge>(old_vnode, new_fnode);
-        m_edges.insert(new_edge);
-        old_vnode->edges.insert(new_edge);
-        new_fnode->edges.insert(new_edge);
+        auto nit = neighbors.find(old_vnode);
+        if (nit == neighbors.end())
+        {
+          FGEdgePtr new_edge = std::make_shared<FGEdge>(old_vnode, new_fnode);
+          m_edges.insert(new_edge);
+          old_vnode->edges.insert(new_edge);
+          new_fnode->edges.insert(new_edge);
+          nit = neighbors.insert(std::make_pair(old_vnode, new_edge)).first;
+        }
+        auto & new_edge = nit->second;
+        new_edge->variableToFactorMessage = new_edge->variableToFactorMessage * old_edge->variableToFactorMessage;
+        new_edge->factorToVariableMessage = new_edge->factorToVariableMessage * old_edge->factorToVariableMessage;
       }
-      fit = m_factorNodes.erase(fit);
+      m_pendingNodes.erase(old_fnode);
+      m_factorNodes.erase(old_fnode);
     }
+    new_fnode->supportBdd = new_fnode->nodeBdd.support();
+    for (const auto & edge: new_fnode->edges)
+      edge->updateQuantified();
     m_factorNodes.insert(new_fnode);
+    m_pendingNodes.insert(new_fnode);
+    for (const auto & neighbor: neighbors)
+      m_pendingNodes.insert(neighbor.first);
     return new_fnode->nodeBdd;
   }
 
@@ -312,36 +660,93 @@ namespace {
 
   void FactorGraphImpl::groupVariables(const BddWrapper & variableCube)
   {
-    if (m_variableNodes.empty())
-      return;
-    FGVariableNodePtr new_vnode = std::make_shared<FGVariableNode>((*m_variableNodes.cbegin())->nodeBdd.one());
-    FGNodePtrSet neighbors;
-    for (auto vit = m_variableNodes.begin(); vit != m_variableNodes.end();)
+    groupVariables(std::vector<BddWrapper>(1, variableCube));
+  }
+
+
+
+
+
+  void FactorGraphImpl::groupVariables(const std::vector<BddWrapper> & variableCubes)
+  {
+    // index the variable nodes by the variables they hold
+    std::vector<FGNodePtr> nodes(m_variableNodes.cbegin(), m_variableNodes.cend());
+    std::map<int, int> nodeOfVariable;
+    for (int n = 0; n < static_cast<int>(nodes.size()); ++n)
     {
-      FGNodePtr old_vnode = *vit;
-      if (old_vnode->nodeBdd.cubeIntersection(variableCube).isOne())
+      BddWrapper cube = nodes[n]->nodeBdd;
+      while (!cube.isOne())
       {
-        ++vit;
-        continue;
+        auto v = cube.varWithLowestIndex();
+        nodeOfVariable[v.getIndex()] = n;
+        cube = cube.cubeDiff(v);
       }
+    }
+    std::vector<std::vector<int> > groups;
+    for (BddWrapper cube: variableCubes)
+    {
+      groups.emplace_back();
+      while (!cube.isOne())
+      {
+        auto v = cube.varWithLowestIndex();
+        auto nit = nodeOfVariable.find(v.getIndex());
+        if (nit != nodeOfVariable.end())
+          groups.back().push_back(nit->second);
+        cube = cube.cubeDiff(v);
+      }
+    }
+
+    for (const auto & nodeClass: parakram::joinGroups(static_cast<int>(nodes.size()), groups))
+    {
+      std::vector<FGNodePtr> classNodes;
+      for (int n: nodeClass)
+        classNodes.push_back(nodes[n]);
+      mergeVariableNodes(classNodes);
+    }
+  }
+
+
+
 
+
+  void FactorGraphImpl::mergeVariableNodes(const std::vector<FGNodePtr> & old_vnodes)
+  {
+    if (old_vnodes.size() < 2)
+      return;
+    FGVariableNodePtr new_vnode = std::make_shared<FGVariableNode>(old_vnodes.front()->nodeBdd.one());
+    // the edge of the new node to each neighbour, starting at the
+    //   conjunction of the messages of the edges it replaces
+    std::map<FGNodePtr, FGEdgePtr> neighbors;
+    for (const auto & old_vnode: old_vnodes)
+    {
       new_vnode->nodeBdd = new_vnode->nodeBdd.cubeUnion(old_vnode->nodeBdd);
       for (const auto & old_edge: old_vnode->edges)
       {
         const auto & old_fnode = old_edge->getFactorNode();
         m_edges.erase(old_edge);
         old_fnode->edges.erase(old_edge);
-        if (neighbors.count(old_fnode))
-          continue;
-        neighbors.insert(old_fnode);
-        FGEdgePtr new_edge = std::make_shared<FGEdge>(new_vnode, old_fnode);
-        m_edges.insert(new_edge);
-        old_fnode->edges.insert(new_edge);
-        new_vnode->edges.insert(new_edge);
+        auto nit = neighbors.find(old_fnode);
+        if (nit == neighbors.end())
+        {
+          FGEdgePtr new_edge = std::make_shared<FGEdge>(new_vnode, old_fnode);
+          m_edges.insert(new_edge);
+          old_fnode->edges.insert(new_edge);
+          new_vnode->edges.insert(new_edge);
+          nit = neighbors.insert(std::make_pair(old_fnode, new_edge)).first;
+        }
+        auto & new_edge = nit->second;
+        new_edge->variableToFactorMessage = new_edge->variableToFactorMessage * old_edge->variableToFactorMessage;
+        new_edge->factorToVariableMessage = new_edge->factorToVariableMessage * old_edge->factorToVariableMessage;
       }
-      vit = m_variableNodes.erase(vit);
+      m_pendingNodes.erase(old_vnode);
+      m_variableNodes.erase(old_vnode);
     }
+    for (const auto & edge: new_vnode->edges)
+      edge->updateQuantified();
     m_variableNodes.insert(new_vnode);
+    m_pendingNodes.insert(new_vnode);
+    for (const auto & neighbor: neighbors)
+      m_pendingNodes.insert(neighbor.first);
   }
 
 } // end anonymous namespace
@@ -367,6 +772,147 @@ namespace fgpp
   }
 
 
+  std::vector<dd::BddWrapper> FactorGraph::getDistinctIncomingMessages(const BddWrapper & variableCube) const
+  {
+    auto distinct = distinctMessages(getIncomingMessages(variableCube));
+    if (distinct.size() < 2)
+      return distinct;
+
+    // the care set of each message is the conjunction of the minimized
+    //   messages before it and of the original ones after it,
+    //   so the conjunction of all of them never changes
+    DdManager * manager = distinct.front().getManager();
+    std::vector<BddWrapper> suffixes(distinct.size(), distinct.front().one());
+    for (size_t i = distinct.size() - 1; i > 0; --i)
+      suffixes[i - 1] = suffixes[i] * distinct[i];
+    std::vector<BddWrapper> result;
+    std::set<bdd_ptr> kept;
+    BddWrapper prefix = distinct.front().one();
+    for (size_t i = 0; i < distinct.size(); ++i)
+    {
+      BddWrapper care = prefix * suffixes[i];
+      if (care.isZero())
+        return std::vector<BddWrapper>(1, care);
+      BddWrapper minimized(bdd_minimize(manager, distinct[i].getUncountedBdd(), care.getUncountedBdd()), manager);
+      if (minimized.isZero())
+        return std::vector<BddWrapper>(1, minimized);
+      if (minimized.isOne() || !kept.insert(minimized.getUncountedBdd()).second)
+        continue;
+      prefix = prefix * minimized;
+      result.push_back(minimized);
+    }
+    return result;
+  }
+
+
+  dd::BddWrapper FactorGraph::getIncomingConjunction(const BddWrapper & variableCube) const
+  {
+    auto distinct = distinctMessages(getIncomingMessages(variableCube));
+    if (distinct.empty())
+      return variableCube.one();
+    dd::BddProduct conjunction(distinct.front());
+    for (size_t i = 1; i < distinct.size(); ++i)
+      conjunction *= distinct[i];
+    return conjunction.evaluate();
+  }
+
+
+  FactorGraph::RoundClock::RoundClock(const std::vector<DdManager *> & managers):
+    m_managers(managers),
+    m_wallStart(std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count()),
+    m_cpuStart(static_cast<double>(std::clock()) / CLOCKS_PER_SEC),
+    m_cacheHits(0),
+    m_cacheLookUps(0)
+  {
+    for (auto manager: m_managers)
+    {
+      m_cacheHits += Cudd_ReadCacheHits(manager);
+      m_cacheLookUps += Cudd_ReadCacheLookUps(manager);
+    }
+  }
+
+
+  void FactorGraph::RoundClock::finish(RoundStats & stats) const
+  {
+    stats.wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count() - m_wallStart;
+    stats.cpuTime = static_cast<double>(std::clock()) / CLOCKS_PER_SEC - m_cpuStart;
+    double cacheHits = 0, cacheLookUps = 0;
+    stats.numLiveNodes = 0;
+    for (auto manager: m_managers)
+    {
+      cacheHits += Cudd_ReadCacheHits(manager);
+      cacheLookUps += Cudd_ReadCacheLookUps(manager);
+      stats.numLiveNodes += Cudd_ReadNodeCount(manager);
+    }
+    stats.cacheHitRate = cacheLookUps > m_cacheLookUps ? (cacheHits - m_cacheHits) / (cacheLookUps - m_cacheLookUps) : 0;
+  }
+
+
+  void FactorGraph::measureMessage(const BddWrapper & message, RoundStats & stats)
+  {
+    int size = bdd_size(message.getUncountedBdd());
+    stats.totalMessageSize += size;
+    stats.maxMessageSize = std::max(stats.maxMessageSize, size);
+  }
+
+
+  long long FactorGraph::residualOf(const BddWrapper & oldMessage, const BddWrapper & newMessage)
+  {
+    return std::abs(bdd_size(oldMessage.getUncountedBdd()) - bdd_size(newMessage.getUncountedBdd())) + 1;
+  }
+
+
+  void FactorGraph::reportConverged(const ConvergenceStats & stats, std::vector<NodeTime> nodeTimes) const
+  {
+    std::stable_sort(nodeTimes.begin(), nodeTimes.end(),
+                     [](const NodeTime & a, const NodeTime & b) { return a.wallTime > b.wallTime; });
+    m_observer->onConverged(stats, nodeTimes);
+  }
+
+
+  void FactorGraph::JsonLinesWriter::onRound(const RoundStats & stats)
+  {
+    m_out << "{\"event\": \"round\""
+          << ", \"round\": " << stats.round
+          << ", \"firings\": " << stats.numFirings
+          << ", \"messages_changed\": " << stats.numMessagesChanged
+          << ", \"total_message_size\": " << stats.totalMessageSize
+          << ", \"max_message_size\": " << stats.maxMessageSize
+          << ", \"live_nodes\": " << stats.numLiveNodes
+          << ", \"cache_hit_rate\": " << stats.cacheHitRate
+          << ", \"wall_time\": " << stats.wallTime
+          << ", \"cpu_time\": " << stats.cpuTime
+          << "}" << std::endl;
+  }
+
+
+  void FactorGraph::JsonLinesWriter::onConverged(const ConvergenceStats & stats, const std::vector<NodeTime> & nodeTimes)
+  {
+    for (const auto & nodeTime: nodeTimes)
+    {
+      m_out << "{\"event\": \"node\""
+            << ", \"type\": \"" << (nodeTime.isFactor ? "factor" : "variable") << "\""
+            << ", \"size\": " << bdd_size(nodeTime.node.getUncountedBdd())
+            << ", \"variables\": [";
+      BddWrapper support = nodeTime.node.support();
+      for (bool first = true; !support.isOne(); first = false)
+      {
+        auto v = support.varWithLowestIndex();
+        m_out << (first ? "" : ", ") << v.getIndex();
+        support = support.cubeDiff(v);
+      }
+      m_out << "], \"firings\": " << nodeTime.numFirings
+            << ", \"wall_time\": " << nodeTime.wallTime
+            << "}\n";
+    }
+    m_out << "{\"event\": \"converged\""
+          << ", \"iterations\": " << stats.numIterations
+          << ", \"firings\": " << stats.numFirings
+          << ", \"messages_changed\": " << stats.numMessagesChanged
+          << "}" << std::endl;
+  }
+
+
   void FactorGraph::testFactorGraphImpl(DdManager * manager)
   {
     FactorGraphImpl::test(manager);
@@ -502,6 +1048,28 @@ namespace {
       assert(-FAndProjected + messagesAnd == V[0].one()); // assert(FAndProjected => messagesAnd)
     }
 
+    // the fused messages of the factors should be the projections
+    //   of the conjunction of the factor and its incoming messages,
+    //   also after grouping changed the supports and the variable nodes
+    auto checkFused = [](const FactorGraphImpl & fg) {
+      for (const auto & fnode: fg.m_factorNodes)
+      {
+        BddWrapper conjoined = fnode->nodeBdd;
+        for (const auto & edge: fnode->edges)
+          conjoined = conjoined * edge->variableToFactorMessage;
+        for (const auto & edge: fnode->edges)
+          assert(edge->factorToVariableMessage == project(conjoined, edge->getVariableNode()->nodeBdd));
+      }
+    };
+    checkFused(fg1);
+    {
+      FactorGraphImpl fg(F);
+      fg.groupFactors({F[4], F[5]});
+      fg.groupVariables(V[5] * V[6] * V[10]);
+      fg.converge();
+      checkFused(fg);
+    }
+
     // convergence on acyclic graph should give exact answers
     {
       FactorGraphImpl fg2(F);
@@ -682,7 +1250,178 @@ namespace {
       }
     }
 
+    // a warm start after grouping should reach the fixpoint of a cold start,
+    //   with fewer firings
+    {
+      BddWrapper allVars = V[0].one();
+      for (const auto & variable: V)
+        allVars = allVars * variable;
+      auto allMessages = [&](const FactorGraphImpl & fg) {
+        auto messages = fg.getIncomingMessages(allVars);
+        return std::multiset<BddWrapper>(messages.cbegin(), messages.cend());
+      };
+      FactorGraphImpl warm(F), cold(F);
+      assert(warm.converge(Start::Warm) == cold.converge(Start::Cold));
+      assert(allMessages(warm) == allMessages(cold));
+      auto regroup = [&](const std::function<void(FactorGraphImpl &)> & group, Schedule schedule) {
+        group(warm);
+        group(cold);
+        warm.converge(schedule, Start::Warm);
+        cold.converge(schedule, Start::Cold);
+        assert(allMessages(warm) == allMessages(cold));
+        assert(warm.getConvergenceStats().numFirings <= cold.getConvergenceStats().numFirings);
+        assert(warm.m_pendingNodes.empty());
+      };
+      regroup([&](FactorGraphImpl & fg) { fg.groupFactors({F[0], F[1], F[2]}); }, Schedule::Flooding);
+      regroup([&](FactorGraphImpl & fg) { fg.groupVariables(V[0] * V[1] * V[2]); }, Schedule::Flooding);
+      regroup([&](FactorGraphImpl & fg) { fg.groupFactors({F[5], F[6], F[7]}); }, Schedule::Residual);
+      regroup([&](FactorGraphImpl & fg) { fg.groupVariables(V[6] * V[9] * V[11]); }, Schedule::Residual);
+      regroup([&](FactorGraphImpl & fg) { fg.groupFactors({F[0] * F[1] * F[2], F[3]}); }, Schedule::Flooding);
+    }
+
+    // trees of partial conjunctions at every node give the same fixpoint,
+    //   including after grouping, and on a warm start
+    {
+      BddWrapper allVars = V[0].one();
+      for (const auto & variable: V)
+        allVars = allVars * variable;
+      auto allMessages = [&](const FactorGraphImpl & fg) {
+        auto messages = fg.getIncomingMessages(allVars);
+        return std::multiset<BddWrapper>(messages.cbegin(), messages.cend());
+      };
+      FactorGraphImpl trees(F), plain(F);
+      trees.setPartialProductDegree(1);
+      plain.setPartialProductDegree(0);
+      trees.converge();
+      plain.converge();
+      assert(allMessages(trees) == allMessages(plain));
+      for (const auto & fnode: trees.m_factorNodes)
+        assert(fnode->partials && fnode->partials->size() == static_cast<int>(fnode->edges.size()) + 1);
+      for (auto * g: {&trees, &plain})
+      {
+        g->groupFactors({F[5], F[6], F[7]});
+        g->groupVariables(V[6] * V[9] * V[11]);
+      }
+      trees.converge(Start::Warm);
+      plain.converge(Start::Cold);
+      assert(allMessages(trees) == allMessages(plain));
+      trees.converge(Schedule::Residual);
+      assert(allMessages(trees) == allMessages(plain));
+    }
+
+    // the distinct messages should keep the conjunction of all the messages,
+    //   without duplicates or ones, and so should the conjunction itself
+    {
+      BddWrapper allVars = V[0].one();
+      for (const auto & variable: V)
+        allVars = allVars * variable;
+      for (const auto & cube: std::vector<BddWrapper>{allVars, V[1], V[5] * V[6] * V[9]})
+      {
+        BddWrapper messagesAnd = V[0].one();
+        for (const auto & m: fg1.getIncomingMessages(cube))
+          messagesAnd = messagesAnd * m;
+        auto distinct = fg1.getDistinctIncomingMessages(cube);
+        assert(distinct.size() <= fg1.getIncomingMessages(cube).size());
+        assert(std::set<BddWrapper>(distinct.cbegin(), distinct.cend()).size() == distinct.size());
+        BddWrapper distinctAnd = V[0].one();
+        for (const auto & m: distinct)
+        {
+          assert(!m.isOne());
+          distinctAnd = distinctAnd * m;
+        }
+        assert(distinctAnd == messagesAnd);
+        assert(fg1.getIncomingConjunction(cube) == messagesAnd);
+      }
+      FactorGraphImpl contradiction({V[0] * V[1], -V[0] + -V[1], V[1] + V[2]});
+      contradiction.converge();
+      auto distinct = contradiction.getDistinctIncomingMessages(V[1]);
+      assert(distinct.size() == 1 && distinct.front().isZero());
+      assert(contradiction.getIncomingConjunction(V[0] * V[1] * V[2]).isZero());
+    }
+
+    // grouping in bulk should give the graph of grouping one at a time,
+    //   joining the cubes and the lists of factors that overlap
+    {
+      BddWrapper allVars = V[0].one();
+      for (const auto & variable: V)
+        allVars = allVars * variable;
+      auto allMessages = [&](const FactorGraphImpl & fg) {
+        auto messages = fg.getIncomingMessages(allVars);
+        return std::multiset<BddWrapper>(messages.cbegin(), messages.cend());
+      };
+      auto nodeBdds = [](const FGNodePtrSet & nodes) {
+        std::multiset<BddWrapper> result;
+        for (const auto & node: nodes)
+          result.insert(node->nodeBdd);
+        return result;
+      };
+      FactorGraphImpl bulk(F), sequential(F);
+      bulk.converge();
+      sequential.converge();
+      auto merged = bulk.groupFactors({{F[5], F[6]}, {F[3]}, {F[6], F[7]}, {V[0].one()}});
+      assert(merged.size() == 4);
+      assert(merged[0] == F[5] * F[6] * F[7] && merged[2] == merged[0]);
+      assert(merged[1] == F[3]);
+      assert(merged[3].isOne());
+      bulk.groupVariables({V[0] * V[1], V[6] * V[9], V[1] * V[2], V[4]});
+      sequential.groupFactors({F[5], F[6]});
+      sequential.groupFactors({F[5] * F[6], F[7]});
+      sequential.groupVariables(V[0] * V[1]);
+      sequential.groupVariables(V[6] * V[9]);
+      sequential.groupVariables(V[1] * V[2]);
+      assert(nodeBdds(bulk.m_factorNodes) == nodeBdds(sequential.m_factorNodes));
+      assert(nodeBdds(bulk.m_variableNodes) == nodeBdds(sequential.m_variableNodes));
+      assert(bulk.m_edges.size() == sequential.m_edges.size());
+      bulk.converge(Start::Warm);
+      sequential.converge(Start::Cold);
+      assert(allMessages(bulk) == allMessages(sequential));
+    }
+
+    // the rounds reported to an observer should add up to the convergence stats,
+    //   one round per iteration when flooding
+    {
+      struct Recorder: public ConvergenceObserver {
+        std::vector<RoundStats> rounds;
+        std::vector<NodeTime> nodeTimes;
+        void onRound(const RoundStats & stats) override { rounds.push_back(stats); }
+        void onConverged(const ConvergenceStats &, const std::vector<NodeTime> & times) override { nodeTimes = times; }
+      };
+      for (auto schedule: {Schedule::Flooding, Schedule::Residual})
+      {
+        FactorGraphImpl fg(F);
+        auto recorder = std::make_shared<Recorder>();
+        fg.setConvergenceObserver(recorder, true);
+        fg.converge(schedule);
+        auto stats = fg.getConvergenceStats();
+        if (schedule == Schedule::Flooding)
+          assert(static_cast<int>(recorder->rounds.size()) == stats.numIterations);
+        long long numFirings = 0, numMessagesChanged = 0, numNodeFirings = 0;
+        for (const auto & round: recorder->rounds)
+        {
+          assert(round.totalMessageSize >= round.maxMessageSize);
+          numFirings += round.numFirings;
+          numMessagesChanged += round.numMessagesChanged;
+        }
+        assert(numFirings == stats.numFirings);
+        assert(numMessagesChanged == stats.numMessagesChanged);
+        assert(!recorder->nodeTimes.empty());
+        for (size_t i = 0; i < recorder->nodeTimes.size(); ++i)
+        {
+          assert(i == 0 || recorder->nodeTimes[i - 1].wallTime >= recorder->nodeTimes[i].wallTime);
+          numNodeFirings += recorder->nodeTimes[i].numFirings;
+        }
+        assert(numNodeFirings == stats.numFirings);
+      }
 
+      std::ostringstream out;
+      FactorGraphImpl fg(F);
+      fg.setConvergenceObserver(std::make_shared<JsonLinesWriter>(out), true);
+      fg.converge();
+      auto json = out.str();
+      assert(json.find("{\"event\": \"round\"") == 0);
+      assert(json.find("\"event\": \"node\"") != std::string::npos);
+      assert(json.find("\"event\": \"converged\"") != std::string::npos);
+    }
   }
 
 
@@ -25,7 +25,9 @@ SOFTWARE.
 #pragma once
 
 #include <dd/bdd_factory.h>
+#include <iosfwd>
 #include <memory>
+#include <vector>
 
 
 namespace fgpp
@@ -37,17 +39,177 @@ namespace fgpp
       typedef std::shared_ptr<FactorGraph> Ptr;
       typedef dd::BddWrapper BddWrapper;
 
+      // the order in which converge fires nodes
+      enum class Schedule {
+        // every node whose incoming messages changed fires once per iteration
+        Flooding,
+        // the node with the largest residual fires first, where the residual
+        //   of a node adds up, over its incoming messages that changed since
+        //   it last fired, the change in bdd size plus one
+        Residual
+      };
+
+      // the messages converge starts from
+      enum class Start {
+        // every message is reset to one, and every factor fires first
+        Cold,
+        // the messages of the last converge are kept, and an edge made by
+        //   groupFactors or groupVariables starts at the conjunction of
+        //   the messages of the edges it replaces, which are still sound
+        // only the nodes whose edges changed since then fire first,
+        //   so the fixpoint is reached without redoing the rest of the graph
+        Warm
+      };
+
+      // counters of the last call to converge
+      struct ConvergenceStats {
+        int numIterations = 0;    // as returned by converge
+        long long numFirings = 0; // nodes fired, each one a conjunction plus a projection per edge
+        long long numMessagesChanged = 0;
+      };
+
+      // what one round of converge did, a round being an iteration of
+      //   the flooding schedule, as many firings of the residual schedule
+      //   as the graph has nodes, or a superstep of convergeParallel
+      // sizes and manager counters are read at the end of the round,
+      //   from the worker managers for convergeParallel
+      struct RoundStats {
+        int round = 0;
+        long long numFirings = 0;
+        long long numMessagesChanged = 0;
+        long long totalMessageSize = 0; // bdd nodes, counted for each message on its own
+        int maxMessageSize = 0;
+        long numLiveNodes = 0;
+        double cacheHitRate = 0;        // of the CUDD computed table, during the round
+        double wallTime = 0;            // in seconds
+        double cpuTime = 0;             // in seconds, of the whole process
+      };
+
+      // the firings of one node over a whole converge
+      struct NodeTime {
+        bool isFactor;
+        BddWrapper node;                // the factor, or the cube of its variables
+        long long numFirings;
+        double wallTime;
+      };
+
+      // told about each round of converge, and about the nodes
+      //   once it is done: the ones that fired, slowest first,
+      //   when nodes are timed, and none otherwise
+      class ConvergenceObserver {
+        public:
+          virtual void onRound(const RoundStats & stats) = 0;
+          virtual void onConverged(const ConvergenceStats &, const std::vector<NodeTime> &) {}
+          virtual ~ConvergenceObserver() {}
+      };
+
+      // writes each round, each timed node and the totals as a JSON
+      //   object on a line of its own, told apart by its "event" field
+      class JsonLinesWriter: public ConvergenceObserver {
+        public:
+          JsonLinesWriter(std::ostream & out): m_out(out) {}
+          void onRound(const RoundStats & stats) override;
+          void onConverged(const ConvergenceStats & stats, const std::vector<NodeTime> & nodeTimes) override;
+        private:
+          std::ostream & m_out;
+      };
+
       virtual void groupVariables(const BddWrapper & variableCube) = 0;
       virtual BddWrapper groupFactors(const std::vector<BddWrapper> & factors) = 0;
+
+      // group every cube, or every list of factors, in a single pass,
+      //   as if by one call per cube or list, so that cubes (or lists)
+      //   that meet a common node end up grouped together
+      // a cube meeting only one variable node leaves it as it is
+      // groupFactors returns the merged factor of each list,
+      //   or one for a list that matches no factor
+      virtual void groupVariables(const std::vector<BddWrapper> & variableCubes) = 0;
+      virtual std::vector<BddWrapper> groupFactors(const std::vector<std::vector<BddWrapper> > & factorGroups) = 0;
+
       virtual std::vector<BddWrapper> getIncomingMessages(const BddWrapper & variableCube) const = 0;
-      virtual int converge() = 0;
+
+      // the incoming messages without duplicates or ones, in order of
+      //   first occurrence, each minimized (bdd_minimize) against the
+      //   conjunction of the others, and dropped if that makes it one,
+      //   so that their conjunction is unchanged
+      // just zero if any of them is zero
+      std::vector<BddWrapper> getDistinctIncomingMessages(const BddWrapper & variableCube) const;
+
+      // the conjunction of the distinct incoming messages,
+      //   in a single multi-operand conjunction
+      BddWrapper getIncomingConjunction(const BddWrapper & variableCube) const;
+
+      // pass messages until nothing changes,
+      //   returning the number of flooding iterations,
+      //   or the number of firings for the residual schedule
+      virtual int converge(Schedule schedule, Start start) = 0;
+      int converge(Schedule schedule) { return converge(schedule, Start::Cold); }
+      int converge(Start start) { return converge(Schedule::Flooding, start); }
+      int converge() { return converge(Schedule::Flooding, Start::Cold); }
+      virtual ConvergenceStats getConvergenceStats() const = 0;
+
+      // reach the same fixpoint as converge, on numThreads worker threads
+      //   (zero for all the hardware threads), each with a DdManager of its own,
+      //   returning the number of supersteps: in each one every worker converges
+      //   its part of the graph, and then the messages on the cut are exchanged
+      // the default ignores numThreads and converges sequentially
+      virtual int convergeParallel(int /* numThreads */) { return converge(); }
+
+      // a node with at least this many edges keeps a tree of partial
+      //   conjunctions of its incoming messages, so that firing it conjoins
+      //   again only above the messages that changed since it last fired
+      // zero disables the trees
+      virtual void setPartialProductDegree(int degree) = 0;
+      static constexpr int DefaultPartialProductDegree = 16;
 
       // static Ptr createLegacyFactorGraph(const std::vector<BddWrapper> & factors);
       static Ptr createFactorGraph(const std::vector<BddWrapper> & factors);
 
+      // same interface, stored as compressed sparse rows:
+      //   integer node and edge ids, and contiguous message arrays,
+      //   with nodes and messages visited in a reproducible order
+      static Ptr createCsrFactorGraph(const std::vector<BddWrapper> & factors);
+
+      // report each converge to the observer, or to nobody if it is null,
+      //   and if timeNodes, also time every firing of every node
+      // the messages are measured after each round, which costs
+      //   a traversal of all of them
+      void setConvergenceObserver(const std::shared_ptr<ConvergenceObserver> & observer, bool timeNodes = false)
+      {
+        m_observer = observer;
+        m_timeNodes = timeNodes;
+      }
+
       virtual ~FactorGraph() {}
 
       static void testFactorGraphImpl(DdManager * manager);
+      static void testCsrFactorGraphImpl(DdManager * manager);
+
+    protected:
+
+      std::shared_ptr<ConvergenceObserver> m_observer;
+      bool m_timeNodes = false;
+
+      // for the implementations: the time and the manager counters
+      //   of a round, from construction to finish
+      class RoundClock {
+        public:
+          RoundClock(const std::vector<DdManager *> & managers);
+          // fill in the times, the live nodes and the cache hit rate
+          void finish(RoundStats & stats) const;
+        private:
+          std::vector<DdManager *> m_managers;
+          double m_wallStart, m_cpuStart, m_cacheHits, m_cacheLookUps;
+      };
+
+      // add the size of a message to stats
+      static void measureMessage(const BddWrapper & message, RoundStats & stats);
+
+      // the contribution of a changed message to the residual of its receiver
+      static long long residualOf(const BddWrapper & oldMessage, const BddWrapper & newMessage);
+
+      // tell the observer the totals and the nodes, slowest first
+      void reportConverged(const ConvergenceStats & stats, std::vector<NodeTime> nodeTimes) const;
 
   };
 
@@ -0,0 +1,1610 @@
+/*
+
+Copyright 2021 Parakram Majumdar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+#include "fgpp.h"
+
+#include <dd/conjunction_tree.h>
+#include <dd/disjoint_set.h>
+#include <dd/multi_computed_table.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+
+  // ***** CsrFactorGraph *****
+  // ******** class ********
+  // A factor graph with integer ids instead of node objects.
+  // Edges are numbered factor-major: the edges of factor f are
+  //   [m_factorOffsets[f], m_factorOffsets[f + 1]), each pointing to
+  //   a variable in m_edgeVariables, in increasing order of variable id.
+  // The edges of variable v are listed in m_variableEdges, from
+  //   m_variableOffsets[v] to m_variableOffsets[v + 1].
+  // Messages live in two arrays indexed by edge id.
+  // Grouping rebuilds the arrays (compaction), keeping the messages
+  //   of edges that survive, and starting each new edge at the conjunction
+  //   of the messages of the edges it replaces, for a warm start.
+  // convergeParallel splits the factors into partitions, each converged
+  //   as a CsrFactorGraph of its own in a worker manager, where
+  //   a variable shared with other partitions gets an extra boundary factor
+  //   holding the conjunction of the messages it receives from them.
+  class CsrFactorGraph: public fgpp::FactorGraph
+  {
+    public:
+
+      typedef dd::BddWrapper BddWrapper;
+
+      CsrFactorGraph(const std::vector<BddWrapper> & factors);
+
+      BddWrapper groupFactors(const std::vector<BddWrapper> & factors) override;
+      void groupVariables(const BddWrapper & variableCube) override;
+      std::vector<BddWrapper> groupFactors(const std::vector<std::vector<BddWrapper> > & factorGroups) override;
+      void groupVariables(const std::vector<BddWrapper> & variableCubes) override;
+      std::vector<BddWrapper> getIncomingMessages(const BddWrapper & variableCube) const override;
+      using fgpp::FactorGraph::converge;
+      int converge(Schedule schedule, Start start) override;
+      ConvergenceStats getConvergenceStats() const override { return m_stats; }
+      int convergeParallel(int numThreads) override;
+      void setPartialProductDegree(int degree) override;
+
+      static void test(DdManager *);
+
+    private:
+
+      struct Partition;
+
+      // a graph with the given structure, where the edges of factor f
+      //   go to edgeVariables[factorOffsets[f]] ... in increasing order
+      CsrFactorGraph(std::vector<BddWrapper> && factors,
+                     std::vector<BddWrapper> && variables,
+                     std::vector<int> && factorOffsets,
+                     std::vector<int> && edgeVariables);
+
+      int numFactors() const { return static_cast<int>(m_factors.size()); }
+      int numVariables() const { return static_cast<int>(m_variables.size()); }
+      int numEdges() const { return static_cast<int>(m_edgeVariables.size()); }
+
+      // fire a node, adding the ids of the nodes whose
+      //   incoming messages changed to updatedNodes,
+      //   and, if residuals is given, adding to their residuals
+      // factor f has node id f, variable v has node id numFactors() + v
+      // returns the number of messages that changed
+      int passFactorMessages(int f, std::vector<int> & updatedNodes, std::vector<long long> * residuals = NULL);
+      int passVariableMessages(int v, std::vector<int> & updatedNodes, std::vector<long long> * residuals = NULL);
+      int passMessages(int node, std::vector<int> & updatedNodes, std::vector<long long> * residuals = NULL);
+
+      // passMessages, counting the firing and the messages it changed,
+      //   and timing it if nodes are timed
+      void fire(int node, std::vector<int> & updatedNodes, std::vector<long long> * residuals = NULL);
+
+      // tell the observer about the round since before and clock
+      void reportRound(int round, const ConvergenceStats & before, const RoundClock & clock) const;
+      RoundClock startRound() const { return RoundClock({m_factors.front().getManager()}); }
+      void reportConverged() const;
+
+      // the conjunction of first and the numMessages messages given by
+      //   message(i), kept in partials if there are enough of them
+      template<typename TMessage>
+      BddWrapper conjoin(std::unique_ptr<parakram::ConjunctionTree> & partials,
+                         const BddWrapper & first,
+                         int numMessages,
+                         TMessage const & message);
+      // the same, with enough messages to keep partials, left as
+      //   the product of the two children of the root of the tree
+      template<typename TMessage>
+      dd::BddProduct conjoinBelowRoot(std::unique_ptr<parakram::ConjunctionTree> & partials,
+                                      const BddWrapper & first,
+                                      int numMessages,
+                                      TMessage const & message);
+
+      // flooding from the given nodes, without resetting any message
+      void flood(std::vector<int> pending);
+      void convergeResidual(const std::vector<int> & pending);
+
+      // the ids of the nodes to fire first on a warm start, clearing them
+      std::vector<int> takePendingNodes();
+
+      // the partition of each factor: connected components as in bddPartition,
+      //   cut into chunks in breadth-first order, balanced by number of edges
+      std::vector<int> partitionFactors(int numPartitions) const;
+
+      // replace the factor-major arrays, carrying over the messages
+      //   of edge edgeOrigins[e], or starting at one if that is -1,
+      //   and rebuild the variable side
+      void compact(std::vector<int> && factorOffsets,
+                   std::vector<int> && edgeVariables,
+                   std::vector<int> const & edgeOrigins);
+      void linkVariables();
+      void quantifyEdges(int f);
+
+      std::vector<BddWrapper> m_factors;
+      std::vector<BddWrapper> m_factorSupports;
+      std::vector<BddWrapper> m_variables;
+
+      std::vector<int> m_factorOffsets;
+      std::vector<int> m_edgeVariables;
+      std::vector<int> m_edgeFactors;
+      std::vector<int> m_variableOffsets;
+      std::vector<int> m_variableEdges;
+
+      std::vector<BddWrapper> m_variableToFactorMessages;
+      std::vector<BddWrapper> m_factorToVariableMessages;
+
+      // the variables projected away by the messages on each edge:
+      //   those of the factor's support outside the variable, and vice versa
+      std::vector<BddWrapper> m_factorQuantified;
+      std::vector<BddWrapper> m_variableQuantified;
+
+      // the nodes whose edges changed since the last converge
+      std::vector<char> m_pendingFactors;
+      std::vector<char> m_pendingVariables;
+
+      // the partial conjunctions of the nodes of high degree,
+      //   dropped when grouping renumbers the edges
+      int m_partialProductDegree = DefaultPartialProductDegree;
+      std::vector<std::unique_ptr<parakram::ConjunctionTree> > m_factorPartials;
+      std::vector<std::unique_ptr<parakram::ConjunctionTree> > m_variablePartials;
+
+      ConvergenceStats m_stats;
+
+      // the firings and the time of each node id, when nodes are timed
+      std::vector<long long> m_nodeFirings;
+      std::vector<double> m_nodeWallTimes;
+  };
+
+
+
+
+  CsrFactorGraph::CsrFactorGraph(const std::vector<BddWrapper> & factors)
+  {
+    if (factors.empty())
+      return;
+
+    std::map<bdd_ptr, int> variableIds;
+    std::vector<int> factorOffsets(1, 0);
+    std::vector<int> edgeVariables;
+    for (const auto & factor: factors)
+    {
+      m_factors.push_back(factor);
+      m_factorSupports.push_back(factor.support());
+      // the variables of the factor, in increasing order of index
+      std::vector<int> neighbours;
+      BddWrapper fsup = m_factorSupports.back();
+      while(!fsup.isOne())
+      {
+        auto v = fsup.varWithLowestIndex();
+        fsup = fsup.cubeDiff(v);
+        auto vit = variableIds.find(v.getUncountedBdd());
+        if (vit == variableIds.end())
+        {
+          vit = variableIds.insert(std::make_pair(v.getUncountedBdd(), numVariables())).first;
+          m_variables.push_back(v);
+        }
+        neighbours.push_back(vit->second);
+      }
+      std::sort(neighbours.begin(), neighbours.end());
+      edgeVariables.insert(edgeVariables.end(), neighbours.cbegin(), neighbours.cend());
+      factorOffsets.push_back(static_cast<int>(edgeVariables.size()));
+    }
+    compact(std::move(factorOffsets), std::move(edgeVariables), std::vector<int>(edgeVariables.size(), -1));
+    m_pendingFactors.assign(numFactors(), 1);
+    m_pendingVariables.assign(numVariables(), 0);
+  }
+
+
+
+
+  CsrFactorGraph::CsrFactorGraph(std::vector<BddWrapper> && factors,
+                                 std::vector<BddWrapper> && variables,
+                                 std::vector<int> && factorOffsets,
+                                 std::vector<int> && edgeVariables):
+    m_factors(std::move(factors)),
+    m_variables(std::move(variables))
+  {
+    for (const auto & factor: m_factors)
+      m_factorSupports.push_back(factor.support());
+    std::vector<int> edgeOrigins(edgeVariables.size(), -1);
+    compact(std::move(factorOffsets), std::move(edgeVariables), edgeOrigins);
+    m_pendingFactors.assign(numFactors(), 1);
+    m_pendingVariables.assign(numVariables(), 0);
+  }
+
+
+
+
+  void CsrFactorGraph::compact(std::vector<int> && factorOffsets,
+                               std::vector<int> && edgeVariables,
+                               std::vector<int> const & edgeOrigins)
+  {
+    assert(factorOffsets.size() == m_factors.size() + 1);
+    assert(edgeOrigins.size() == edgeVariables.size());
+    BddWrapper one = m_factors.front().one();
+    std::vector<BddWrapper> variableToFactorMessages, factorToVariableMessages;
+    variableToFactorMessages.reserve(edgeOrigins.size());
+    factorToVariableMessages.reserve(edgeOrigins.size());
+    for (int origin: edgeOrigins)
+    {
+      variableToFactorMessages.push_back(origin < 0 ? one : m_variableToFactorMessages[origin]);
+      factorToVariableMessages.push_back(origin < 0 ? one : m_factorToVariableMessages[origin]);
+    }
+    m_variableToFactorMessages.swap(variableToFactorMessages);
+    m_factorToVariableMessages.swap(factorToVariableMessages);
+    m_factorOffsets.swap(factorOffsets);
+    m_edgeVariables.swap(edgeVariables);
+    linkVariables();
+    m_factorQuantified.assign(numEdges(), one);
+    m_variableQuantified.assign(numEdges(), one);
+    for (int f = 0; f < numFactors(); ++f)
+      quantifyEdges(f);
+    m_factorPartials.clear();
+    m_factorPartials.resize(numFactors());
+    m_variablePartials.clear();
+    m_variablePartials.resize(numVariables());
+  }
+
+
+
+
+  void CsrFactorGraph::linkVariables()
+  {
+    m_edgeFactors.assign(numEdges(), 0);
+    for (int f = 0; f < numFactors(); ++f)
+      std::fill(m_edgeFactors.begin() + m_factorOffsets[f], m_edgeFactors.begin() + m_factorOffsets[f + 1], f);
+
+    // counting sort of the edges by variable,
+    //   stable so that each variable sees its factors in increasing order
+    m_variableOffsets.assign(numVariables() + 1, 0);
+    for (int v: m_edgeVariables)
+      ++m_variableOffsets[v + 1];
+    for (int v = 0; v < numVariables(); ++v)
+      m_variableOffsets[v + 1] += m_variableOffsets[v];
+    m_variableEdges.resize(numEdges());
+    std::vector<int> next(m_variableOffsets.cbegin(), m_variableOffsets.cend() - 1);
+    for (int e = 0; e < numEdges(); ++e)
+      m_variableEdges[next[m_edgeVariables[e]]++] = e;
+  }
+
+
+
+
+  void CsrFactorGraph::setPartialProductDegree(int degree)
+  {
+    m_partialProductDegree = degree;
+    for (auto & partials: m_factorPartials)
+      partials.reset();
+    for (auto & partials: m_variablePartials)
+      partials.reset();
+  }
+
+
+
+
+  template<typename TMessage>
+  dd::BddWrapper CsrFactorGraph::conjoin(std::unique_ptr<parakram::ConjunctionTree> & partials,
+                                         const BddWrapper & first,
+                                         int numMessages,
+                                         TMessage const & message)
+  {
+    // below the partial product degree, first and the messages
+    //   of the node's edge range, conjoined in one product
+    if (m_partialProductDegree <= 0 || numMessages < m_partialProductDegree)
+    {
+      dd::BddProduct product(first);
+      for (int i = 0; i < numMessages; ++i)
+        product *= message(i);
+      return product.evaluate();
+    }
+
+    // at or above it, the root of the node's tree, with first at leaf 0
+    //   and message(i) at leaf i + 1: only the conjunctions above the leaves
+    //   whose message is a different BDD than at the last firing are rebuilt
+    std::vector<bdd_ptr> leaves(numMessages + 1);
+    leaves[0] = first.getUncountedBdd();
+    for (int i = 0; i < numMessages; ++i)
+      leaves[i + 1] = message(i).getUncountedBdd();
+    if (!partials)
+      partials.reset(new parakram::ConjunctionTree(first.getManager()));
+    bdd_ptr conjoined = partials->update(&leaves.front(), numMessages + 1);
+    return BddWrapper(bdd_dup(conjoined), first.getManager());
+  }
+
+
+
+
+  template<typename TMessage>
+  dd::BddProduct CsrFactorGraph::conjoinBelowRoot(std::unique_ptr<parakram::ConjunctionTree> & partials,
+                                                  const BddWrapper & first,
+                                                  int numMessages,
+                                                  TMessage const & message)
+  {
+    std::vector<bdd_ptr> leaves(numMessages + 1);
+    leaves[0] = first.getUncountedBdd();
+    for (int i = 0; i < numMessages; ++i)
+      leaves[i + 1] = message(i).getUncountedBdd();
+    if (!partials)
+      partials.reset(new parakram::ConjunctionTree(first.getManager()));
+    auto children = partials->updateChildren(&leaves.front(), numMessages + 1);
+    dd::BddProduct result(BddWrapper(bdd_dup(children.first), first.getManager()));
+    if (NULL != children.second)
+      result *= BddWrapper(bdd_dup(children.second), first.getManager());
+    return result;
+  }
+
+
+
+
+  void CsrFactorGraph::quantifyEdges(int f)
+  {
+    for (int e = m_factorOffsets[f]; e < m_factorOffsets[f + 1]; ++e)
+    {
+      const auto & variable = m_variables[m_edgeVariables[e]];
+      m_factorQuantified[e] = m_factorSupports[f].cubeDiff(variable);
+      m_variableQuantified[e] = variable.cubeDiff(m_factorSupports[f]);
+    }
+  }
+
+
+
+
+  int CsrFactorGraph::passFactorMessages(int f, std::vector<int> & updatedNodes, std::vector<long long> * residuals)
+  {
+    // m_factors[f] and the messages on edges firstEdge.. of f, as a BddProduct
+    //   that each existentialQuantification in the edge loop evaluates
+    //   as one and-exists; at or above the partial product degree its
+    //   operands are the two children of the root of m_factorPartials[f]
+    int const firstEdge = m_factorOffsets[f];
+    int const degree = m_factorOffsets[f + 1] - firstEdge;
+    dd::BddProduct conjoined(m_factors[f]);
+    if (m_partialProductDegree > 0 && degree >= m_partialProductDegree)
+      conjoined = conjoinBelowRoot(m_factorPartials[f], m_factors[f], degree,
+                                   [&](int i) -> BddWrapper const & { return m_variableToFactorMessages[firstEdge + i]; });
+    else
+      for (int e = firstEdge; e < m_factorOffsets[f + 1]; ++e)
+        conjoined *= m_variableToFactorMessages[e];
+
+    // update message for each edge
+    int numChanged = 0;
+    for (int e = m_factorOffsets[f]; e < m_factorOffsets[f + 1]; ++e)
+    {
+      int v = m_edgeVariables[e];
+      BddWrapper variableMessage = conjoined.existentialQuantification(m_factorQuantified[e]);
+      if (m_factorToVariableMessages[e] == variableMessage)
+        continue;
+      if (residuals)
+        (*residuals)[numFactors() + v] += residualOf(m_factorToVariableMessages[e], variableMessage);
+      m_factorToVariableMessages[e] = std::move(variableMessage);
+      updatedNodes.push_back(numFactors() + v);
+      ++numChanged;
+    }
+    return numChanged;
+  }
+
+
+
+
+  int CsrFactorGraph::passVariableMessages(int v, std::vector<int> & updatedNodes, std::vector<long long> * residuals)
+  {
+    // compute message, the conjunction of all incoming messages
+    int const firstEdge = m_variableOffsets[v];
+    BddWrapper message = conjoin(m_variablePartials[v], m_variables[v].one(), m_variableOffsets[v + 1] - firstEdge,
+                                 [&](int i) -> BddWrapper const & { return m_factorToVariableMessages[m_variableEdges[firstEdge + i]]; });
+
+    // update message for each edge
+    int numChanged = 0;
+    for (int i = m_variableOffsets[v]; i < m_variableOffsets[v + 1]; ++i)
+    {
+      int e = m_variableEdges[i];
+      int f = m_edgeFactors[e];
+      BddWrapper factorMessage = message.existentialQuantification(m_variableQuantified[e]);
+      if (m_variableToFactorMessages[e] == factorMessage)
+        continue;
+      if (residuals)
+        (*residuals)[f] += residualOf(m_variableToFactorMessages[e], factorMessage);
+      m_variableToFactorMessages[e] = std::move(factorMessage);
+      updatedNodes.push_back(f);
+      ++numChanged;
+    }
+    return numChanged;
+  }
+
+
+
+
+  int CsrFactorGraph::passMessages(int node, std::vector<int> & updatedNodes, std::vector<long long> * residuals)
+  {
+    if (node < numFactors())
+      return passFactorMessages(node, updatedNodes, residuals);
+    else
+      return passVariableMessages(node - numFactors(), updatedNodes, residuals);
+  }
+
+
+
+
+  void CsrFactorGraph::fire(int node, std::vector<int> & updatedNodes, std::vector<long long> * residuals)
+  {
+    ++m_stats.numFirings;
+    if (!m_timeNodes)
+    {
+      m_stats.numMessagesChanged += passMessages(node, updatedNodes, residuals);
+      return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    m_stats.numMessagesChanged += passMessages(node, updatedNodes, residuals);
+    m_nodeWallTimes[node] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ++m_nodeFirings[node];
+  }
+
+
+
+
+  void CsrFactorGraph::reportRound(int round, const ConvergenceStats & before, const RoundClock & clock) const
+  {
+    RoundStats stats;
+    clock.finish(stats);
+    stats.round = round;
+    stats.numFirings = m_stats.numFirings - before.numFirings;
+    stats.numMessagesChanged = m_stats.numMessagesChanged - before.numMessagesChanged;
+    for (int e = 0; e < numEdges(); ++e)
+    {
+      measureMessage(m_variableToFactorMessages[e], stats);
+      measureMessage(m_factorToVariableMessages[e], stats);
+    }
+    m_observer->onRound(stats);
+  }
+
+
+
+
+  void CsrFactorGraph::reportConverged() const
+  {
+    std::vector<NodeTime> nodeTimes;
+    for (int node = 0; node < static_cast<int>(m_nodeFirings.size()); ++node)
+      if (m_nodeFirings[node] > 0)
+        nodeTimes.push_back(NodeTime{node < numFactors(),
+                                     node < numFactors() ? m_factors[node] : m_variables[node - numFactors()],
+                                     m_nodeFirings[node],
+                                     m_nodeWallTimes[node]});
+    FactorGraph::reportConverged(m_stats, std::move(nodeTimes));
+  }
+
+
+
+
+  int CsrFactorGraph::converge(Schedule schedule, Start start)
+  {
+    m_stats = ConvergenceStats();
+    if (m_factors.empty()) return 0;
+    if (start == Start::Cold)
+    {
+      // reset all messages
+      BddWrapper one = m_factors.front().one();
+      std::fill(m_variableToFactorMessages.begin(), m_variableToFactorMessages.end(), one);
+      std::fill(m_factorToVariableMessages.begin(), m_factorToVariableMessages.end(), one);
+      m_pendingFactors.assign(numFactors(), 1);
+      m_pendingVariables.assign(numVariables(), 0);
+    }
+    m_nodeFirings.assign(m_timeNodes ? numFactors() + numVariables() : 0, 0);
+    m_nodeWallTimes.assign(m_nodeFirings.size(), 0);
+
+    // every other node already sends what its incoming messages imply
+    if (schedule == Schedule::Residual)
+      convergeResidual(takePendingNodes());
+    else
+      flood(takePendingNodes());
+    if (m_observer)
+      reportConverged();
+    return m_stats.numIterations;
+  }
+
+
+
+
+  std::vector<int> CsrFactorGraph::takePendingNodes()
+  {
+    std::vector<int> pending;
+    for (int f = 0; f < numFactors(); ++f)
+      if (m_pendingFactors[f])
+        pending.push_back(f);
+    for (int v = 0; v < numVariables(); ++v)
+      if (m_pendingVariables[v])
+        pending.push_back(numFactors() + v);
+    m_pendingFactors.assign(numFactors(), 0);
+    m_pendingVariables.assign(numVariables(), 0);
+    return pending;
+  }
+
+
+
+
+  void CsrFactorGraph::flood(std::vector<int> pending)
+  {
+    // pass messages and collect nodes for next iteration,
+    //   firing them in increasing order of node id
+    std::vector<int> updatedNodes;
+    while(!pending.empty())
+    {
+      ++m_stats.numIterations;
+      ConvergenceStats before = m_stats;
+      RoundClock clock = startRound();
+      updatedNodes.clear();
+      for (int node: pending)
+        fire(node, updatedNodes);
+      if (m_observer)
+        reportRound(m_stats.numIterations, before, clock);
+      std::sort(updatedNodes.begin(), updatedNodes.end());
+      updatedNodes.erase(std::unique(updatedNodes.begin(), updatedNodes.end()), updatedNodes.end());
+      pending.swap(updatedNodes);
+    }
+  }
+
+
+
+
+  void CsrFactorGraph::convergeResidual(const std::vector<int> & pending)
+  {
+    // every pending node starts with the size of its own bdd as residual,
+    //   the information it has not sent yet
+    // entries of the queue whose residual is out of date are skipped,
+    //   and ties go to the lower node id
+    typedef std::pair<long long, int> Entry;
+    auto lower = [](const Entry & a, const Entry & b) {
+      return a.first < b.first || (a.first == b.first && a.second > b.second);
+    };
+    std::priority_queue<Entry, std::vector<Entry>, decltype(lower)> queue(lower);
+    std::vector<long long> residuals(numFactors() + numVariables(), 0);
+    for (int node: pending)
+    {
+      BddWrapper const & nodeBdd = node < numFactors() ? m_factors[node] : m_variables[node - numFactors()];
+      residuals[node] = bdd_size(nodeBdd.getUncountedBdd());
+      queue.push(Entry(residuals[node], node));
+    }
+
+    // fire the node with the largest residual,
+    //   until no node has pending messages,
+    //   in rounds of as many firings as there are nodes
+    long long const roundLength = numFactors() + numVariables();
+    int round = 0;
+    ConvergenceStats before = m_stats;
+    RoundClock clock = startRound();
+    std::vector<int> updatedNodes;
+    while(!queue.empty())
+    {
+      Entry top = queue.top();
+      queue.pop();
+      if (residuals[top.second] != top.first)
+        continue;
+      residuals[top.second] = 0;
+      updatedNodes.clear();
+      fire(top.second, updatedNodes, &residuals);
+      for (int node: updatedNodes)
+        queue.push(Entry(residuals[node], node));
+      if (m_observer && m_stats.numFirings - before.numFirings == roundLength)
+      {
+        reportRound(++round, before, clock);
+        before = m_stats;
+        clock = startRound();
+      }
+    }
+    if (m_observer && m_stats.numFirings > before.numFirings)
+      reportRound(++round, before, clock);
+    m_stats.numIterations = static_cast<int>(m_stats.numFirings);
+  }
+
+
+
+
+  std::vector<dd::BddWrapper> CsrFactorGraph::getIncomingMessages(const BddWrapper & variableCube) const
+  {
+    std::vector<BddWrapper> result;
+    for (int v = 0; v < numVariables(); ++v)
+    {
+      if (m_variables[v].cubeIntersection(variableCube).isOne())
+        continue;
+      for (int i = m_variableOffsets[v]; i < m_variableOffsets[v + 1]; ++i)
+        result.push_back(m_factorToVariableMessages[m_variableEdges[i]]);
+    }
+    return result;
+  }
+
+
+
+
+  dd::BddWrapper CsrFactorGraph::groupFactors(const std::vector<BddWrapper>& factors)
+  {
+    return groupFactors(std::vector<std::vector<BddWrapper> >(1, factors)).front();
+  }
+
+
+
+
+  std::vector<dd::BddWrapper> CsrFactorGraph::groupFactors(const std::vector<std::vector<BddWrapper> > & factorGroups)
+  {
+    for (const auto & factors: factorGroups)
+      if (factors.empty())
+        throw std::invalid_argument("FactorGraph::groupFactors must be called with at least one factor.");
+
+    // index the factors, which may repeat
+    std::map<bdd_ptr, std::vector<int> > idsOfFactor;
+    for (int f = 0; f < numFactors(); ++f)
+      idsOfFactor[m_factors[f].getUncountedBdd()].push_back(f);
+    std::vector<std::vector<int> > groups;
+    for (const auto & factors: factorGroups)
+    {
+      groups.emplace_back();
+      for (const auto & factor: factors)
+      {
+        auto fit = idsOfFactor.find(factor.getUncountedBdd());
+        if (fit != idsOfFactor.end())
+          groups.back().insert(groups.back().end(), fit->second.cbegin(), fit->second.cend());
+      }
+    }
+    std::vector<int> groupClasses;
+    auto classes = parakram::joinGroups(numFactors(), groups, &groupClasses);
+
+    // the factor of each class, and the classes of two or more factors to merge
+    std::vector<BddWrapper> classFactors;
+    std::vector<int> classOfFactor(numFactors(), -1);
+    for (const auto & factorClass: classes)
+    {
+      dd::BddProduct merged(m_factors[factorClass.front()]);
+      for (size_t i = 1; i < factorClass.size(); ++i)
+      {
+        merged *= m_factors[factorClass[i]];
+        classOfFactor[factorClass[i]] = static_cast<int>(classFactors.size());
+      }
+      if (factorClass.size() > 1)
+        classOfFactor[factorClass.front()] = static_cast<int>(classFactors.size());
+      classFactors.push_back(merged.evaluate());
+    }
+    std::vector<BddWrapper> result;
+    for (size_t g = 0; g < factorGroups.size(); ++g)
+      result.push_back(groupClasses[g] < 0 ? factorGroups[g].front().one() : classFactors[groupClasses[g]]);
+
+    // the factors left alone keep their order,
+    //   and the merged ones follow in order of their class,
+    //   each with an edge to every variable of the factors it replaces
+    std::vector<int> factorOffsets(1, 0), edgeVariables, edgeOrigins;
+    std::vector<BddWrapper> newFactors, newSupports;
+    std::vector<char> newPendingFactors;
+    for (int f = 0; f < numFactors(); ++f)
+    {
+      if (classOfFactor[f] >= 0)
+        continue;
+      newFactors.push_back(m_factors[f]);
+      newSupports.push_back(m_factorSupports[f]);
+      newPendingFactors.push_back(m_pendingFactors[f]);
+      for (int e = m_factorOffsets[f]; e < m_factorOffsets[f + 1]; ++e)
+      {
+        edgeVariables.push_back(m_edgeVariables[e]);
+        edgeOrigins.push_back(e);
+      }
+      factorOffsets.push_back(static_cast<int>(edgeVariables.size()));
+    }
+    if (newFactors.size() == m_factors.size())
+      return result; // nothing to group
+
+    // the new edges, and the messages of the replaced edges they start from
+    std::vector<int> mergedEdges;
+    std::vector<dd::BddProduct> mergedVariableToFactor, mergedFactorToVariable;
+    for (size_t c = 0; c < classes.size(); ++c)
+    {
+      if (classes[c].size() < 2)
+        continue;
+      std::map<int, std::pair<dd::BddProduct, dd::BddProduct> > mergedMessages;
+      for (int f: classes[c])
+        for (int e = m_factorOffsets[f]; e < m_factorOffsets[f + 1]; ++e)
+        {
+          auto mit = mergedMessages.find(m_edgeVariables[e]);
+          if (mit == mergedMessages.end())
+            mergedMessages.insert(std::make_pair(m_edgeVariables[e],
+                                                 std::make_pair(dd::BddProduct(m_variableToFactorMessages[e]),
+                                                                dd::BddProduct(m_factorToVariableMessages[e]))));
+          else
+          {
+            mit->second.first *= m_variableToFactorMessages[e];
+            mit->second.second *= m_factorToVariableMessages[e];
+          }
+        }
+      newFactors.push_back(classFactors[c]);
+      newSupports.push_back(classFactors[c].support());
+      newPendingFactors.push_back(1);
+      for (auto & mergedMessage: mergedMessages)
+      {
+        mergedEdges.push_back(static_cast<int>(edgeVariables.size()));
+        mergedVariableToFactor.push_back(std::move(mergedMessage.second.first));
+        mergedFactorToVariable.push_back(std::move(mergedMessage.second.second));
+        edgeVariables.push_back(mergedMessage.first);
+        edgeOrigins.push_back(-1);
+        m_pendingVariables[mergedMessage.first] = 1;
+      }
+      factorOffsets.push_back(static_cast<int>(edgeVariables.size()));
+    }
+
+    m_factors.swap(newFactors);
+    m_factorSupports.swap(newSupports);
+    m_pendingFactors.swap(newPendingFactors);
+    compact(std::move(factorOffsets), std::move(edgeVariables), edgeOrigins);
+    for (size_t i = 0; i < mergedEdges.size(); ++i)
+    {
+      m_variableToFactorMessages[mergedEdges[i]] = mergedVariableToFactor[i].evaluate();
+      m_factorToVariableMessages[mergedEdges[i]] = mergedFactorToVariable[i].evaluate();
+    }
+    return result;
+  }
+
+
+
+
+  void CsrFactorGraph::groupVariables(const BddWrapper & variableCube)
+  {
+    groupVariables(std::vector<BddWrapper>(1, variableCube));
+  }
+
+
+
+
+  void CsrFactorGraph::groupVariables(const std::vector<BddWrapper> & variableCubes)
+  {
+    // index the variables by the bdd variables they hold
+    std::map<int, int> idOfVariable;
+    for (int v = 0; v < numVariables(); ++v)
+    {
+      BddWrapper cube = m_variables[v];
+      while (!cube.isOne())
+      {
+        auto x = cube.varWithLowestIndex();
+        idOfVariable[x.getIndex()] = v;
+        cube = cube.cubeDiff(x);
+      }
+    }
+    std::vector<std::vector<int> > groups;
+    for (BddWrapper cube: variableCubes)
+    {
+      groups.emplace_back();
+      while (!cube.isOne())
+      {
+        auto x = cube.varWithLowestIndex();
+        auto vit = idOfVariable.find(x.getIndex());
+        if (vit != idOfVariable.end())
+          groups.back().push_back(vit->second);
+        cube = cube.cubeDiff(x);
+      }
+    }
+
+    // the variables left alone keep their order,
+    //   and the merged ones follow in order of their class
+    std::vector<int> classOfVariable(numVariables(), -1);
+    std::vector<BddWrapper> mergedCubes;
+    for (const auto & variableClass: parakram::joinGroups(numVariables(), groups))
+    {
+      if (variableClass.size() < 2)
+        continue;
+      BddWrapper mergedCube = m_variables[variableClass.front()];
+      for (int v: variableClass)
+      {
+        mergedCube = mergedCube.cubeUnion(m_variables[v]);
+        classOfVariable[v] = static_cast<int>(mergedCubes.size());
+      }
+      mergedCubes.push_back(mergedCube);
+    }
+    if (mergedCubes.empty())
+      return; // nothing to group
+    std::vector<BddWrapper> newVariables;
+    for (int v = 0; v < numVariables(); ++v)
+      if (classOfVariable[v] < 0)
+        newVariables.push_back(m_variables[v]);
+    int const firstMergedId = static_cast<int>(newVariables.size());
+    std::vector<int> newIds(numVariables());
+    for (int v = 0, next = 0; v < numVariables(); ++v)
+      newIds[v] = classOfVariable[v] < 0 ? next++ : firstMergedId + classOfVariable[v];
+    newVariables.insert(newVariables.end(), mergedCubes.cbegin(), mergedCubes.cend());
+    std::vector<char> newPendingVariables(newVariables.size(), 0);
+    for (int v = 0; v < static_cast<int>(newIds.size()); ++v)
+      newPendingVariables[newIds[v]] |= m_pendingVariables[v];
+    std::fill(newPendingVariables.begin() + firstMergedId, newPendingVariables.end(), 1);
+
+    // each factor keeps its edges to the other variables,
+    //   and gets one fresh edge to each merged variable in place of
+    //   all its edges to the variables grouped into it,
+    //   starting at the conjunction of their messages
+    // merged variables have the largest ids, so the fresh edges go last
+    std::vector<int> factorOffsets(1, 0), edgeVariables, edgeOrigins;
+    std::vector<int> mergedEdges;
+    std::vector<dd::BddProduct> mergedVariableToFactor, mergedFactorToVariable;
+    for (int f = 0; f < numFactors(); ++f)
+    {
+      std::map<int, std::pair<dd::BddProduct, dd::BddProduct> > mergedMessages;
+      for (int e = m_factorOffsets[f]; e < m_factorOffsets[f + 1]; ++e)
+      {
+        int v = newIds[m_edgeVariables[e]];
+        if (v < firstMergedId)
+        {
+          edgeVariables.push_back(v);
+          edgeOrigins.push_back(e);
+          continue;
+        }
+        auto mit = mergedMessages.find(v);
+        if (mit == mergedMessages.end())
+          mergedMessages.insert(std::make_pair(v, std::make_pair(dd::BddProduct(m_variableToFactorMessages[e]),
+                                                                 dd::BddProduct(m_factorToVariableMessages[e]))));
+        else
+        {
+          mit->second.first *= m_variableToFactorMessages[e];
+          mit->second.second *= m_factorToVariableMessages[e];
+        }
+      }
+      for (auto & mergedMessage: mergedMessages)
+      {
+        mergedEdges.push_back(static_cast<int>(edgeVariables.size()));
+        mergedVariableToFactor.push_back(std::move(mergedMessage.second.first));
+        mergedFactorToVariable.push_back(std::move(mergedMessage.second.second));
+        edgeVariables.push_back(mergedMessage.first);
+        edgeOrigins.push_back(-1);
+        m_pendingFactors[f] = 1;
+      }
+      factorOffsets.push_back(static_cast<int>(edgeVariables.size()));
+    }
+
+    m_variables.swap(newVariables);
+    m_pendingVariables.swap(newPendingVariables);
+    compact(std::move(factorOffsets), std::move(edgeVariables), edgeOrigins);
+    for (size_t i = 0; i < mergedEdges.size(); ++i)
+    {
+      m_variableToFactorMessages[mergedEdges[i]] = mergedVariableToFactor[i].evaluate();
+      m_factorToVariableMessages[mergedEdges[i]] = mergedFactorToVariable[i].evaluate();
+    }
+  }
+
+
+
+
+  // a copy of f in the destination manager
+  dd::BddWrapper transfer(const dd::BddWrapper & f, DdManager * destination)
+  {
+    bdd_ptr result = Cudd_bddTransfer(f.getManager(), destination, f.getUncountedBdd());
+    if (NULL == result)
+      throw std::runtime_error("Cudd_bddTransfer failed while converging a factor graph in parallel");
+    Cudd_Ref(result);
+    return dd::BddWrapper(result, destination);
+  }
+
+
+
+  // ***** Barrier *****
+  // ******** class ********
+  // Blocks numThreads threads until all of them have arrived,
+  //   and runs the completion on the last one to arrive,
+  //   while the others are still blocked.
+  class Barrier
+  {
+    public:
+      Barrier(int numThreads, std::function<void()> completion):
+        m_numThreads(numThreads),
+        m_numArrived(0),
+        m_generation(0),
+        m_completion(std::move(completion))
+      { }
+
+      void arriveAndWait()
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        long long const generation = m_generation;
+        if (++m_numArrived < m_numThreads)
+        {
+          m_condition.wait(lock, [&]() { return generation != m_generation; });
+          return;
+        }
+        m_completion();
+        m_numArrived = 0;
+        ++m_generation;
+        m_condition.notify_all();
+      }
+
+    private:
+      int const m_numThreads;
+      int m_numArrived;
+      long long m_generation;
+      std::function<void()> m_completion;
+      std::mutex m_mutex;
+      std::condition_variable m_condition;
+  };
+
+
+
+  // ***** CsrFactorGraph::Partition *****
+  // The part of the graph converged by one worker, in a manager of its own.
+  // Local factors are the partition's factors, in increasing order of id,
+  //   followed by one boundary factor per shared variable.
+  // Local variables are those of the partition's factors,
+  //   in increasing order of id, so local edges follow the order of the
+  //   edges of the whole graph.
+  struct CsrFactorGraph::Partition
+  {
+    DdManager * manager = NULL;
+    std::unique_ptr<CsrFactorGraph> graph;
+    std::vector<int> factors;         // the id in the whole graph of each local factor
+    std::vector<int> variables;       // the id in the whole graph of each local variable
+    std::vector<int> sharedIndex;     // the index among the shared variables, -1 if not shared
+    std::vector<int> sharedVariables; // the local id of each shared variable
+    std::vector<int> boundaryFactors; // the boundary factor of each shared variable
+    std::vector<BddWrapper> partials; // the conjunction of the local messages to each shared variable
+    std::vector<int> pending;         // the local nodes to fire in the next superstep
+
+    Partition() = default;
+    Partition(Partition const &) = delete;
+    Partition & operator = (Partition const &) = delete;
+
+    ~Partition()
+    {
+      partials.clear();
+      graph.reset();
+      if (NULL == manager)
+        return;
+      parakram::MultiComputedTable::quit(manager);
+    }
+  };
+
+
+
+
+  std::vector<int> CsrFactorGraph::partitionFactors(int numPartitions) const
+  {
+    // walk each connected component breadth first from its lowest factor,
+    //   and cut the walk into chunks of about 1 / numPartitions
+    //   of the weight of the graph, a factor weighing one plus its degree
+    int const target = std::max(1, (numEdges() + numFactors() + numPartitions - 1) / numPartitions);
+    std::vector<std::vector<int> > chunks;
+    std::vector<int> chunkWeights;
+    std::vector<char> factorVisited(numFactors(), 0), variableVisited(numVariables(), 0);
+    std::vector<int> walk;
+    for (int root = 0; root < numFactors(); ++root)
+    {
+      if (factorVisited[root])
+        continue;
+      walk.assign(1, root);
+      factorVisited[root] = 1;
+      for (size_t head = 0; head < walk.size(); ++head)
+      {
+        int f = walk[head];
+        for (int e = m_factorOffsets[f]; e < m_factorOffsets[f + 1]; ++e)
+        {
+          int v = m_edgeVariables[e];
+          if (variableVisited[v])
+            continue;
+          variableVisited[v] = 1;
+          for (int i = m_variableOffsets[v]; i < m_variableOffsets[v + 1]; ++i)
+          {
+            int g = m_edgeFactors[m_variableEdges[i]];
+            if (!factorVisited[g])
+            {
+              factorVisited[g] = 1;
+              walk.push_back(g);
+            }
+          }
+        }
+      }
+
+      chunks.emplace_back();
+      chunkWeights.push_back(0);
+      for (int f: walk)
+      {
+        int weight = 1 + m_factorOffsets[f + 1] - m_factorOffsets[f];
+        if (!chunks.back().empty() && chunkWeights.back() + weight > target)
+        {
+          chunks.emplace_back();
+          chunkWeights.push_back(0);
+        }
+        chunks.back().push_back(f);
+        chunkWeights.back() += weight;
+      }
+    }
+
+    // heaviest chunk first, to the lightest partition
+    std::vector<int> order(chunks.size());
+    for (size_t c = 0; c < chunks.size(); ++c)
+      order[c] = static_cast<int>(c);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return chunkWeights[a] > chunkWeights[b]; });
+    std::vector<long long> loads(numPartitions, 0);
+    std::vector<int> result(numFactors(), 0);
+    for (int c: order)
+    {
+      int p = static_cast<int>(std::min_element(loads.cbegin(), loads.cend()) - loads.cbegin());
+      loads[p] += chunkWeights[c];
+      for (int f: chunks[c])
+        result[f] = p;
+    }
+    return result;
+  }
+
+
+
+
+  int CsrFactorGraph::convergeParallel(int numThreads)
+  {
+    if (numThreads <= 0)
+      numThreads = std::max(1u, std::thread::hardware_concurrency());
+    numThreads = std::min(numThreads, numFactors());
+    if (numThreads <= 1)
+      return converge();
+
+    // reset all messages
+    m_stats = ConvergenceStats();
+    m_nodeFirings.assign(m_timeNodes ? numFactors() + numVariables() : 0, 0);
+    m_nodeWallTimes.assign(m_nodeFirings.size(), 0);
+    DdManager * manager = m_factors.front().getManager();
+    BddWrapper one = m_factors.front().one();
+    std::fill(m_variableToFactorMessages.begin(), m_variableToFactorMessages.end(), one);
+    std::fill(m_factorToVariableMessages.begin(), m_factorToVariableMessages.end(), one);
+
+    // split the factors, dropping partitions that got none
+    std::vector<int> factorPartitions = partitionFactors(numThreads);
+    std::vector<std::unique_ptr<Partition> > partitions;
+    for (int p = 0; p < numThreads; ++p)
+      partitions.emplace_back(new Partition());
+    for (int f = 0; f < numFactors(); ++f)
+      partitions[factorPartitions[f]]->factors.push_back(f);
+    partitions.erase(std::remove_if(partitions.begin(), partitions.end(),
+                                    [](const std::unique_ptr<Partition> & p) { return p->factors.empty(); }),
+                     partitions.end());
+    int const numPartitions = static_cast<int>(partitions.size());
+
+    // the partitions holding each variable, with its local id in each
+    std::vector<std::vector<std::pair<int, int> > > holders(numVariables());
+    for (int p = 0; p < numPartitions; ++p)
+    {
+      auto & variables = partitions[p]->variables;
+      for (int f: partitions[p]->factors)
+        variables.insert(variables.end(),
+                         m_edgeVariables.cbegin() + m_factorOffsets[f],
+                         m_edgeVariables.cbegin() + m_factorOffsets[f + 1]);
+      std::sort(variables.begin(), variables.end());
+      variables.erase(std::unique(variables.begin(), variables.end()), variables.end());
+      for (size_t lv = 0; lv < variables.size(); ++lv)
+        holders[variables[lv]].push_back(std::make_pair(p, static_cast<int>(lv)));
+    }
+
+    // copy each partition into a manager of its own, with the same variable order
+    std::vector<int> order(Cudd_ReadSize(manager));
+    for (int level = 0; level < static_cast<int>(order.size()); ++level)
+      order[level] = Cudd_ReadInvPerm(manager, level);
+    for (auto & partition: partitions)
+    {
+      Partition & P = *partition;
+      P.manager = Cudd_Init(static_cast<unsigned int>(order.size()), 0, CUDD_UNIQUE_SLOTS, CUDD_CACHE_SLOTS, 0);
+      if (NULL == P.manager
+          || (!order.empty() && !Cudd_ShuffleHeap(P.manager, &order.front())))
+        throw std::runtime_error("FactorGraph::convergeParallel could not set up a worker manager");
+
+      std::vector<BddWrapper> factors, variables;
+      std::vector<int> factorOffsets(1, 0), edgeVariables;
+      for (int v: P.variables)
+        variables.push_back(transfer(m_variables[v], P.manager));
+      for (int f: P.factors)
+      {
+        factors.push_back(transfer(m_factors[f], P.manager));
+        for (int e = m_factorOffsets[f]; e < m_factorOffsets[f + 1]; ++e)
+          edgeVariables.push_back(static_cast<int>(
+            std::lower_bound(P.variables.cbegin(), P.variables.cend(), m_edgeVariables[e]) - P.variables.cbegin()));
+        factorOffsets.push_back(static_cast<int>(edgeVariables.size()));
+      }
+      BddWrapper localOne(bdd_one(P.manager), P.manager);
+      P.sharedIndex.assign(P.variables.size(), -1);
+      for (size_t lv = 0; lv < P.variables.size(); ++lv)
+      {
+        if (holders[P.variables[lv]].size() < 2)
+          continue;
+        P.sharedIndex[lv] = static_cast<int>(P.sharedVariables.size());
+        P.sharedVariables.push_back(static_cast<int>(lv));
+        P.boundaryFactors.push_back(static_cast<int>(factors.size()));
+        factors.push_back(localOne);
+        edgeVariables.push_back(static_cast<int>(lv));
+        factorOffsets.push_back(static_cast<int>(edgeVariables.size()));
+      }
+      P.partials.assign(P.sharedVariables.size(), localOne);
+      P.graph.reset(new CsrFactorGraph(std::move(factors), std::move(variables),
+                                       std::move(factorOffsets), std::move(edgeVariables)));
+      P.graph->m_partialProductDegree = m_partialProductDegree;
+      P.graph->m_timeNodes = m_timeNodes;
+      P.graph->m_nodeFirings.assign(m_timeNodes ? P.graph->numFactors() + P.graph->numVariables() : 0, 0);
+      P.graph->m_nodeWallTimes.assign(P.graph->m_nodeFirings.size(), 0);
+      for (int f = 0; f < P.graph->numFactors(); ++f)
+        P.pending.push_back(f);
+    }
+
+    // in each superstep, every worker converges its partition,
+    //   and then the last one to finish hands each boundary factor
+    //   the conjunction of the partials of the other partitions
+    //   (all the managers are idle at that point, so this is serial)
+    // the supersteps stop when no boundary factor changes
+    // the observer is told about each superstep, with the counters
+    //   of all the workers, before the exchange
+    std::atomic<bool> failed(false);
+    bool done = false;
+    int numSupersteps = 0;
+    std::vector<DdManager *> workerManagers;
+    for (const auto & partition: partitions)
+      workerManagers.push_back(partition->manager);
+    ConvergenceStats before;
+    RoundClock clock(workerManagers);
+    auto exchange = [&]()
+    {
+      ++numSupersteps;
+      done = true;
+      if (failed)
+        return;
+      try {
+        if (m_observer)
+        {
+          RoundStats stats;
+          clock.finish(stats);
+          ConvergenceStats total;
+          for (const auto & partition: partitions)
+          {
+            CsrFactorGraph const & G = *partition->graph;
+            total.numFirings += G.m_stats.numFirings;
+            total.numMessagesChanged += G.m_stats.numMessagesChanged;
+            for (int e = 0; e < G.numEdges(); ++e)
+            {
+              measureMessage(G.m_variableToFactorMessages[e], stats);
+              measureMessage(G.m_factorToVariableMessages[e], stats);
+            }
+          }
+          stats.round = numSupersteps;
+          stats.numFirings = total.numFirings - before.numFirings;
+          stats.numMessagesChanged = total.numMessagesChanged - before.numMessagesChanged;
+          m_observer->onRound(stats);
+          before = total;
+        }
+        for (int q = 0; q < numPartitions; ++q)
+        {
+          Partition & Q = *partitions[q];
+          for (size_t s = 0; s < Q.sharedVariables.size(); ++s)
+          {
+            dd::BddProduct external(BddWrapper(bdd_one(Q.manager), Q.manager));
+            for (const auto & holder: holders[Q.variables[Q.sharedVariables[s]]])
+            {
+              if (holder.first == q)
+                continue;
+              Partition const & H = *partitions[holder.first];
+              external *= transfer(H.partials[H.sharedIndex[holder.second]], Q.manager);
+            }
+            BddWrapper boundary = external.evaluate();
+            int b = Q.boundaryFactors[s];
+            if (Q.graph->m_factors[b] == boundary)
+              continue;
+            Q.graph->m_factorSupports[b] = boundary.support();
+            Q.graph->m_factors[b] = std::move(boundary);
+            Q.graph->quantifyEdges(b);
+            Q.pending.push_back(b);
+            done = false;
+          }
+        }
+        clock = RoundClock(workerManagers);
+      }
+      catch (std::exception const &)
+      {
+        failed = true;
+        done = true;
+      }
+    };
+    Barrier barrier(numPartitions, exchange);
+    auto work = [&](Partition & P)
+    {
+      while (true)
+      {
+        if (!failed)
+        {
+          try {
+            P.graph->flood(std::move(P.pending));
+            P.pending.clear();
+            CsrFactorGraph const & G = *P.graph;
+            for (size_t s = 0; s < P.sharedVariables.size(); ++s)
+            {
+              int lv = P.sharedVariables[s];
+              dd::BddProduct partial(G.m_variables[lv].one());
+              for (int i = G.m_variableOffsets[lv]; i < G.m_variableOffsets[lv + 1]; ++i)
+                if (G.m_edgeFactors[G.m_variableEdges[i]] != P.boundaryFactors[s])
+                  partial *= G.m_factorToVariableMessages[G.m_variableEdges[i]];
+              P.partials[s] = partial.evaluate();
+            }
+          }
+          catch (std::exception const &)
+          {
+            failed = true;
+          }
+        }
+        barrier.arriveAndWait();
+        if (done)
+          break;
+      }
+    };
+    std::vector<std::thread> threads;
+    for (auto & partition: partitions)
+      threads.emplace_back(work, std::ref(*partition));
+    for (auto & thread: threads)
+      thread.join();
+    if (failed)
+      throw std::runtime_error("FactorGraph::convergeParallel failed in a worker");
+
+    // move the messages back, the local edges of each factor
+    //   being in the same order as its edges in the whole graph
+    for (const auto & partition: partitions)
+    {
+      Partition const & P = *partition;
+      for (size_t lf = 0; lf < P.factors.size(); ++lf)
+      {
+        int const f = P.factors[lf];
+        int const localFirst = P.graph->m_factorOffsets[lf];
+        for (int e = m_factorOffsets[f]; e < m_factorOffsets[f + 1]; ++e)
+        {
+          int le = localFirst + e - m_factorOffsets[f];
+          m_factorToVariableMessages[e] = transfer(P.graph->m_factorToVariableMessages[le], manager);
+          m_variableToFactorMessages[e] = transfer(P.graph->m_variableToFactorMessages[le], manager);
+        }
+      }
+      m_stats.numFirings += P.graph->m_stats.numFirings;
+      m_stats.numMessagesChanged += P.graph->m_stats.numMessagesChanged;
+
+      // and the times of the nodes, each variable adding up its copies
+      for (int node = 0; node < static_cast<int>(P.graph->m_nodeFirings.size()); ++node)
+      {
+        int const numLocalFactors = P.graph->numFactors();
+        int wholeNode;
+        if (node < static_cast<int>(P.factors.size()))
+          wholeNode = P.factors[node];
+        else if (node < numLocalFactors)
+          continue; // a boundary factor
+        else
+          wholeNode = numFactors() + P.variables[node - numLocalFactors];
+        m_nodeFirings[wholeNode] += P.graph->m_nodeFirings[node];
+        m_nodeWallTimes[wholeNode] += P.graph->m_nodeWallTimes[node];
+      }
+    }
+    m_pendingFactors.assign(numFactors(), 0);
+    m_pendingVariables.assign(numVariables(), 0);
+    m_stats.numIterations = numSupersteps;
+    if (m_observer)
+      reportConverged();
+    return numSupersteps;
+  }
+
+} // end anonymous namespace
+
+
+
+
+
+
+
+
+
+
+
+
+namespace fgpp
+{
+
+  FactorGraph::Ptr FactorGraph::createCsrFactorGraph(const std::vector<BddWrapper> & factors)
+  {
+    return std::make_shared<CsrFactorGraph>(factors);
+  }
+
+
+  void FactorGraph::testCsrFactorGraphImpl(DdManager * manager)
+  {
+    CsrFactorGraph::test(manager);
+  }
+
+} // end namespace fgpp
+
+
+
+
+
+
+
+
+
+//-----------------------------------------------
+// Tests
+//-----------------------------------------------
+namespace {
+
+  using namespace dd;
+
+  void CsrFactorGraph::test(DdManager * manager)
+  {
+    // the same graph as in the tests of FactorGraphImpl:
+    // f0 -- v1 -- f1 -- v2 -- f2 -- v4
+    // |     |     |
+    // v0    f4    v3
+    // |     |
+    // f3    v5 -- f5 -- v6 -- f6 -- v10
+    // |           |           |
+    // + -- v7     v9 -- f7 -- v11
+    // |
+    // + -- v8
+    std::vector<BddWrapper> V;
+    for (int i = 1; i <= 12; ++i)
+      V.emplace_back(bdd_new_var_with_index(manager, i), manager);
+    std::vector<BddWrapper> F{
+      V[0] * -V[1],
+      (-V[1] * V[3]) + (V[1] * V[2]),
+      -V[2] * V[4],
+      -V[0] + (V[7] * V[8]),
+      V[1] + V[5],
+      (V[5] * V[6]) + (-V[5] + V[9]),
+      (V[6] * V[11]) + (-V[6] * -V[10]),
+      -V[11] + V[9] };
+
+    // check the structural invariants of the arrays
+    auto checkInvariants = [](const CsrFactorGraph & fg)
+    {
+      assert(fg.m_factorOffsets.size() == fg.m_factors.size() + 1);
+      assert(fg.m_factorOffsets.back() == fg.numEdges());
+      assert(fg.m_variableOffsets.size() == fg.m_variables.size() + 1);
+      assert(fg.m_variableOffsets.back() == fg.numEdges());
+      assert(fg.m_variableToFactorMessages.size() == fg.m_edgeVariables.size());
+      assert(fg.m_factorToVariableMessages.size() == fg.m_edgeVariables.size());
+      for (int f = 0; f < fg.numFactors(); ++f)
+        for (int e = fg.m_factorOffsets[f]; e < fg.m_factorOffsets[f + 1]; ++e)
+        {
+          assert(fg.m_edgeFactors[e] == f);
+          assert(e == fg.m_factorOffsets[f] || fg.m_edgeVariables[e - 1] < fg.m_edgeVariables[e]);
+        }
+      for (int v = 0; v < fg.numVariables(); ++v)
+        for (int i = fg.m_variableOffsets[v]; i < fg.m_variableOffsets[v + 1]; ++i)
+          assert(fg.m_edgeVariables[fg.m_variableEdges[i]] == v);
+    };
+
+    // compare the incoming messages of every variable with FactorGraphImpl
+    auto sameMessages = [](const fgpp::FactorGraph & fg1,
+                           const fgpp::FactorGraph & fg2,
+                           const std::vector<BddWrapper> & variables)
+    {
+      for (const auto & v: variables)
+      {
+        auto m1 = fg1.getIncomingMessages(v), m2 = fg2.getIncomingMessages(v);
+        if (std::multiset<BddWrapper>(m1.cbegin(), m1.cend()) != std::multiset<BddWrapper>(m2.cbegin(), m2.cend()))
+          return false;
+      }
+      return true;
+    };
+
+    // creation
+    CsrFactorGraph fg(F);
+    checkInvariants(fg);
+    assert(fg.numFactors() == 8);
+    assert(fg.numVariables() == 12);
+    assert(fg.numEdges() == 20);
+    assert(fg.m_factorOffsets[6] - fg.m_factorOffsets[5] == 3); // f5 -- v5, v6, v9
+
+    // convergence reaches the same fixpoint as FactorGraphImpl,
+    //   and is reproducible
+    auto reference = fgpp::FactorGraph::createFactorGraph(F);
+    reference->converge();
+    int numIterations = fg.converge();
+    assert(numIterations > 0);
+    assert(sameMessages(fg, *reference, V));
+    auto messages = fg.getIncomingMessages(V[1]);
+    assert(fg.converge() == numIterations);
+    assert(fg.getIncomingMessages(V[1]) == messages);
+    auto floodingStats = fg.getConvergenceStats();
+    assert(floodingStats.numIterations == numIterations);
+    assert(floodingStats.numFirings >= numIterations);
+
+    // so does the residual schedule, counting firings
+    int numFirings = fg.converge(Schedule::Residual);
+    assert(numFirings == fg.getConvergenceStats().numFirings);
+    assert(numFirings >= fg.numFactors());
+    assert(sameMessages(fg, *reference, V));
+    reference->converge(Schedule::Residual);
+    assert(sameMessages(fg, *reference, V));
+
+    // so does the parallel engine, whatever the number of partitions
+    for (int numThreads = 2; numThreads <= 4; ++numThreads)
+    {
+      auto partitions = fg.partitionFactors(numThreads);
+      assert(*std::max_element(partitions.cbegin(), partitions.cend()) < numThreads);
+      int numSupersteps = fg.convergeParallel(numThreads);
+      assert(numSupersteps >= 1);
+      assert(fg.getConvergenceStats().numIterations == numSupersteps);
+      assert(sameMessages(fg, *reference, V));
+    }
+    fg.converge();
+    auto v9Messages = fg.getIncomingMessages(V[9]);
+
+    // grouping, as in the tests of FactorGraphImpl
+    auto v_0_1_2 = V[0] * V[1] * V[2];
+    for (auto * g: {static_cast<fgpp::FactorGraph *>(&fg), reference.get()})
+    {
+      g->groupFactors({F[0], F[1], F[2]});
+      g->groupVariables(v_0_1_2);
+      g->groupFactors({F[0] * F[1] * F[2], F[3]});
+      g->groupVariables(v_0_1_2 * V[3]);
+    }
+    checkInvariants(fg);
+    assert(fg.numFactors() == 5);
+    assert(fg.numVariables() == 9);
+    assert(fg.numEdges() == 14);
+    assert(fg.m_factors.back() == F[0] * F[1] * F[2] * F[3]);
+    assert(fg.m_variables.back() == v_0_1_2 * V[3]);
+
+    // untouched edges keep their messages, until the next convergence
+    assert(fg.getIncomingMessages(V[9]) == v9Messages);
+    reference->converge();
+    fg.converge();
+    std::vector<BddWrapper> groupedVars{v_0_1_2 * V[3], V[4], V[5], V[6], V[7], V[8], V[9], V[10], V[11]};
+    assert(sameMessages(fg, *reference, groupedVars));
+    fg.converge(Schedule::Residual);
+    assert(sameMessages(fg, *reference, groupedVars));
+    fg.convergeParallel(3);
+    assert(sameMessages(fg, *reference, groupedVars));
+
+    // grouping nothing changes nothing
+    fg.groupVariables(V[0].one());
+    assert(fg.numVariables() == 9);
+    assert(fg.groupFactors({V[0]}) == V[0].one());
+    assert(fg.numFactors() == 5);
+    checkInvariants(fg);
+
+    // a warm start after each grouping reaches the fixpoint of a cold start,
+    //   firing only around the grouped nodes
+    {
+      CsrFactorGraph warm(F), cold(F);
+      warm.converge(Start::Warm);
+      auto step = [&](const std::vector<BddWrapper> & factors, const BddWrapper & variables,
+                      const std::vector<BddWrapper> & groupedVariables, Schedule schedule)
+      {
+        for (auto * g: {&warm, &cold})
+        {
+          g->groupFactors(factors);
+          g->groupVariables(variables);
+        }
+        checkInvariants(warm);
+        warm.converge(schedule, Start::Warm);
+        cold.converge(schedule, Start::Cold);
+        assert(sameMessages(warm, cold, groupedVariables));
+        assert(warm.getConvergenceStats().numFirings <= cold.getConvergenceStats().numFirings);
+        assert(std::count(warm.m_pendingFactors.cbegin(), warm.m_pendingFactors.cend(), 1) == 0);
+        assert(std::count(warm.m_pendingVariables.cbegin(), warm.m_pendingVariables.cend(), 1) == 0);
+      };
+      step({F[0], F[1], F[2]}, v_0_1_2, {v_0_1_2, V[3], V[4], V[5], V[6], V[7], V[8], V[9], V[10], V[11]}, Schedule::Flooding);
+      step({F[5], F[7]}, V[9] * V[11], {v_0_1_2, V[3], V[4], V[5], V[6], V[7], V[8], V[9] * V[11], V[10]}, Schedule::Residual);
+      warm.convergeParallel(2);
+      step({F[0] * F[1] * F[2], F[3]}, v_0_1_2 * V[3], {v_0_1_2 * V[3], V[4], V[5], V[6], V[7], V[8], V[9] * V[11], V[10]}, Schedule::Flooding);
+    }
+
+    // trees of partial conjunctions at every node give the same fixpoint,
+    //   in every engine
+    {
+      CsrFactorGraph trees(F);
+      trees.setPartialProductDegree(1);
+      trees.converge();
+      auto reference = fgpp::FactorGraph::createFactorGraph(F);
+      reference->converge();
+      assert(sameMessages(trees, *reference, V));
+      for (int f = 0; f < trees.numFactors(); ++f)
+        assert(trees.m_factorPartials[f]
+               && trees.m_factorPartials[f]->size() == trees.m_factorOffsets[f + 1] - trees.m_factorOffsets[f] + 1);
+      CsrFactorGraph plain(F);
+      plain.setPartialProductDegree(0);
+      for (auto * g: {&trees, &plain})
+      {
+        g->groupFactors({F[0], F[1], F[2]});
+        g->groupVariables(v_0_1_2);
+      }
+      checkInvariants(trees);
+      plain.converge();
+      std::vector<BddWrapper> groupedVariables{v_0_1_2, V[3], V[4], V[5], V[6], V[7], V[8], V[9], V[10], V[11]};
+      trees.converge(Start::Warm);
+      assert(sameMessages(trees, plain, groupedVariables));
+      trees.converge(Schedule::Residual);
+      assert(sameMessages(trees, plain, groupedVariables));
+      trees.convergeParallel(2);
+      assert(sameMessages(trees, plain, groupedVariables));
+    }
+
+    // grouping in bulk gives the graph of grouping one at a time,
+    //   including a factor with edges to several merged variables
+    {
+      CsrFactorGraph bulk(F), sequential(F);
+      auto reference = fgpp::FactorGraph::createFactorGraph(F);
+      for (fgpp::FactorGraph * g: std::vector<fgpp::FactorGraph *>{&bulk, &sequential, reference.get()})
+        g->converge();
+      auto merged = bulk.groupFactors({{F[5], F[7]}, {F[2], F[3]}, {F[4]}});
+      assert(merged == std::vector<BddWrapper>({F[5] * F[7], F[2] * F[3], F[4]}));
+      assert(reference->groupFactors({{F[5], F[7]}, {F[2], F[3]}, {F[4]}}) == merged);
+      bulk.groupVariables({V[0] * V[1], V[2], V[3] * V[2], V[9] * V[11]});
+      reference->groupVariables({V[0] * V[1], V[2], V[3] * V[2], V[9] * V[11]});
+      sequential.groupFactors({F[5], F[7]});
+      sequential.groupFactors({F[2], F[3]});
+      sequential.groupVariables(V[0] * V[1]);
+      sequential.groupVariables(V[2] * V[3]);
+      sequential.groupVariables(V[9] * V[11]);
+      checkInvariants(bulk);
+      assert(bulk.numFactors() == 6);
+      assert(bulk.numVariables() == 9);
+      assert(bulk.numEdges() == sequential.numEdges());
+      assert(std::multiset<BddWrapper>(bulk.m_factors.cbegin(), bulk.m_factors.cend())
+             == std::multiset<BddWrapper>(sequential.m_factors.cbegin(), sequential.m_factors.cend()));
+      assert(std::multiset<BddWrapper>(bulk.m_variables.cbegin(), bulk.m_variables.cend())
+             == std::multiset<BddWrapper>(sequential.m_variables.cbegin(), sequential.m_variables.cend()));
+      std::vector<BddWrapper> groupedVariables{V[0] * V[1], V[2] * V[3], V[4], V[5], V[6], V[7], V[8], V[9] * V[11], V[10]};
+      bulk.converge(Start::Warm);
+      sequential.converge(Start::Cold);
+      reference->converge(Start::Warm);
+      assert(sameMessages(bulk, sequential, groupedVariables));
+      assert(sameMessages(bulk, *reference, groupedVariables));
+    }
+
+    // the rounds reported to an observer add up to the convergence stats,
+    //   one round per iteration when flooding, and per superstep in parallel
+    {
+      struct Recorder: public ConvergenceObserver {
+        std::vector<RoundStats> rounds;
+        std::vector<NodeTime> nodeTimes;
+        void onRound(const RoundStats & stats) override { rounds.push_back(stats); }
+        void onConverged(const ConvergenceStats &, const std::vector<NodeTime> & times) override { nodeTimes = times; }
+      };
+      for (int numThreads: {0, 1, 3})
+      {
+        CsrFactorGraph fg(F);
+        auto recorder = std::make_shared<Recorder>();
+        fg.setConvergenceObserver(recorder, true);
+        int numIterations = numThreads ? fg.convergeParallel(numThreads) : fg.converge(Schedule::Flooding);
+        auto stats = fg.getConvergenceStats();
+        assert(static_cast<int>(recorder->rounds.size()) == numIterations);
+        long long numFirings = 0, numMessagesChanged = 0;
+        for (const auto & round: recorder->rounds)
+        {
+          assert(round.totalMessageSize >= round.maxMessageSize);
+          numFirings += round.numFirings;
+          numMessagesChanged += round.numMessagesChanged;
+        }
+        assert(numFirings == stats.numFirings);
+        assert(numMessagesChanged == stats.numMessagesChanged);
+        assert(!recorder->nodeTimes.empty());
+        for (size_t i = 1; i < recorder->nodeTimes.size(); ++i)
+          assert(recorder->nodeTimes[i - 1].wallTime >= recorder->nodeTimes[i].wallTime);
+      }
+    }
+  }
+
+} // end anonymous namespace
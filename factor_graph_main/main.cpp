@@ -58,56 +58,41 @@ void remove_comments(FILE *f)
   ungetc(c, f);
 }
 
+/** The node with the given id among the num_nodes nodes, or NULL if none
+ */
+fgnode * find_node(fgnode **nodes, int num_nodes, int id)
+{
+  int i;
+  for(i = 0; i < num_nodes; i++)
+    if(nodes[i]->id == id)
+      return nodes[i];
+  return NULL;
+}
+
 void merge_heur3(factor_graph *fg)
 {
-  int i, j;
+  int i, j, k;
   do
   {
     i = 0;//no change
-    fgnode_list *fl;
-    fgedge_list *el;
     fgnode *v1, *v2, *fn;
-    fl = fg->fl;
-    do
+    for(k = 0; k < fg->num_funcs && !i; k++)
     {
-      if(fl->died <= fg->time || fl->n->num_neigh != 2)
-      {
-        fl = fl->next;
+      fn = fg->funcs[k];
+      if(fn->num_neigh != 2)
         continue;
-      }
-      fn = fl->n;
-      el = fn->neigh;
-      v1 = NULL;
-      v2 = NULL;
-      do
-      {
-        if(el->died <= fg->time) {el = el->next; continue;}
-        if(v1 == NULL)
-          v1 = el->e->vn;
-        else
-        {
-          assert(v2 == NULL);
-          v2 = el->e->vn;
-          //break;
-        }
-        el = el->next;
-      } while(el != fn->neigh);
-      
-      el = v1->neigh;
-      do
+      v1 = fn->neigh[0]->vn;
+      v2 = fn->neigh[1]->vn;
+
+      for(j = 0; j < v1->num_neigh && !i; j++)
       {
-        if(el->died <= fg->time || el->e->fn == fn || !factor_graph_is_connected(fg->m, el->e->fn, v2))
-        {
-          el = el->next;
+        fgnode *other = v1->neigh[j]->fn;
+        if(other == fn || !factor_graph_is_connected(fg->m, other, v2))
           continue;
-        }
-        actually_merge(fg, el->e->fn, fn);
+        actually_merge(fg, other, fn);
         i = 1;
-      } while(el != v1->neigh && !i);
-      
-      
-      fl = fl->next;
-    } while(fl != fg->fl && !i);
+      }
+    }
     
   } while(i);
 }
@@ -308,42 +293,24 @@ int main2(int argc, char ** argv)
       
       printf("grouping vars...\n");
       fg->time++;
-      fgnode_list *vl = fg->vl;
       bdd_ptr vargrp = bdd_one(fg->m);
-      do{
-        if(vl->died <= fg->time)
-        {
-          vl = vl->next;
-          continue;
-        }
+      for(j = 0; j < fg->num_vars; j++)
         if(random() % fg->num_vars < i)
-          bdd_and_accumulate(fg->m, &vargrp, vl->n->ss[0]);
-        vl = vl->next;
-      }while(vl != fg->vl);
+          bdd_and_accumulate(fg->m, &vargrp, fg->vars[j]->ss[0]);
       assert(factor_graph_group_vars(fg, vargrp) == 0);
       bdd_free(fg->m, vargrp);
       
-      i = fg->max_vid;
-      do{
-        if(vl->died <= fg->time)
-        {
-          vl = vl->prev;
-          continue;
-        }
-        if(vl->n->id == i)
-          break;
-        vl = vl->prev;
-      }while(vl != fg->vl);
-      assert(vl->n->id == i);
+      fgnode *vn = find_node(fg->vars, fg->num_vars, fg->max_vid);
+      assert(vn != NULL);
       
       printf("computing best possible lambda...\n");
-      int lam = best_lambda(fg, vl->n);
+      int lam = best_lambda(fg, vn);
       //int lam = 85;
       printf("lam = %d\n", lam);
       
       printf("computing fg answer...\n");
       tt1 = time(NULL);
-      //bdd_ptr res1 = fgtest4(fg, vl->n, lam);
+      //bdd_ptr res1 = fgtest4(fg, vn, lam);
       bdd_ptr res1 = bdd_one(fg->m);
       tt1 = time(NULL) - tt1;
       printf("computed in %g seconds.\n", (double)tt1);
@@ -353,21 +320,14 @@ int main2(int argc, char ** argv)
       tt2 = time(NULL);
       bdd_ptr fand, block, res2;
       fand = bdd_one(fg->m);
-      fgnode_list* fl = fg->fl;
-      do
+      for(j = 0; j < fg->num_funcs; j++)
       {
-        if(fl->died <= fg->time)
-        {
-          fl = fl->next;
-          continue;
-        }
         int fi;
-        for(fi = 0; fi < fl->n->fs; fi++)
-          bdd_and_accumulate(fg->m, &fand, fl->n->f[fi]);
-        fl = fl->next;
-      } while(fl != fg->fl);
+        for(fi = 0; fi < fg->funcs[j]->fs; fi++)
+          bdd_and_accumulate(fg->m, &fand, fg->funcs[j]->f[fi]);
+      }
       res2 = bdd_support(fg->m, fand);
-      block = bdd_cube_diff(fg->m, res2, vl->n->ss[0]);
+      block = bdd_cube_diff(fg->m, res2, vn->ss[0]);
       bdd_free(fg->m, res2);
       res2 = bdd_forsome(fg->m, fand, block);
       bdd_free(fg->m, fand);
@@ -394,18 +354,10 @@ int main2(int argc, char ** argv)
     {
       printf("Enter number of vars -> ");
       (void)!scanf("%d", &i);
-      fgnode_list *vl = fg->vl;
       bdd_ptr vargrp = bdd_one(fg->m);
-      do{
-        if(vl->died <= fg->time)
-        {
-          vl = vl->next;
-          continue;
-        }
+      for(j = 0; j < fg->num_vars; j++)
         if(random() % fg->num_vars < i)
-          bdd_and_accumulate(fg->m, &vargrp, vl->n->ss[0]);
-        vl = vl->next;
-      }while(vl != fg->vl);
+          bdd_and_accumulate(fg->m, &vargrp, fg->vars[j]->ss[0]);
       assert(factor_graph_group_vars(fg, vargrp) == 0);
       bdd_free(fg->m, vargrp);
       factor_graph_rollback(fg);
@@ -416,21 +368,11 @@ int main2(int argc, char ** argv)
       (void)!scanf("%d", &i);
       printf("enter id of the variable node -> ");
       (void)!scanf("%d", &j);
-      fgnode_list* vl = fg->vl;
-      do
-      {
-        if(vl->died <= fg->time)
-        {
-          vl = vl->next;
-          continue;
-        }
-        if(vl->n->id == j)
-          break;
-        vl = vl->next;
-      } while(vl != fg->vl);
-      if(vl->n->id != j)
+      fgnode *vn = find_node(fg->vars, fg->num_vars, j);
+      if(vn == NULL)
         printf("invalid node id\n");
-      fgtest3(fg, vl->n, i);
+      else
+        fgtest3(fg, vn, i);
     }
     else if(!strcmp(command, "mergeheur3"))
     {
@@ -438,22 +380,11 @@ int main2(int argc, char ** argv)
     }
     else if(!strcmp(command, "mergevar"))
     {
-      fgnode_list *vl1, *vl2;
+      fgnode *vn1, *vn2;
       printf("enter first var id -> ");
       (void)!scanf("%d", &i);
-      vl1 = fg->vl;
-      do
-      {
-        if(vl1->died <= fg->time)
-        {
-          vl1 = vl1->next;
-          continue;
-        }
-        if(vl1->n->id == i)
-          break;
-        vl1 = vl1->next;
-      } while(vl1 != fg->vl);
-      if(vl1->n->id != i)
+      vn1 = find_node(fg->vars, fg->num_vars, i);
+      if(vn1 == NULL)
       {
         printf("no such variable\n");
         continue;
@@ -461,45 +392,23 @@ int main2(int argc, char ** argv)
       
       printf("enter second var id -> ");
       (void)!scanf("%d", &i);
-      vl2 = fg->vl;
-      do
-      {
-        if(vl2->died <= fg->time)
-        {
-          vl2 = vl2->next;
-          continue;
-        }
-        if(vl2->n->id == i)
-          break;
-        vl2 = vl2->next;
-      } while(vl2 != fg->vl);
-      if(vl2->n->id != i)
+      vn2 = find_node(fg->vars, fg->num_vars, i);
+      if(vn2 == NULL)
       {
         printf("no such variable\n");
         continue;
       }
       
-      actually_merge(fg, vl1->n, vl2->n);
+      actually_merge(fg, vn1, vn2);
       printf("merge successful.\n");
     }
     else if(!strcmp(command, "mergefunc"))
     {
-      fgnode_list *fl1, *fl2;
+      fgnode *fn1, *fn2;
       printf("enter first func id -> ");
       (void)!scanf("%d", &i);
-      fl1 = fg->fl;
-      do
-      {
-        if(fl1->died <= fg->time)
-        {
-          fl1 = fl1->next;
-          continue;
-        }
-        if(fl1->n->id == i)
-          break;
-        fl1 = fl1->next;
-      } while(fl1 != fg->fl);
-      if(fl1->n->id != i)
+      fn1 = find_node(fg->funcs, fg->num_funcs, i);
+      if(fn1 == NULL)
       {
         printf("no such function\n");
         continue;
@@ -507,33 +416,20 @@ int main2(int argc, char ** argv)
       
       printf("enter second func id -> ");
       (void)!scanf("%d", &i);
-      fl2 = fg->fl;
-      do
-      {
-        if(fl2->died <= fg->time)
-        {
-          fl2 = fl2->next;
-          continue;
-        }
-        if(fl2->n->id == i)
-          break;
-        fl2 = fl2->next;
-      } while(fl2 != fg->fl);
-      if(fl2->n->id != i)
+      fn2 = find_node(fg->funcs, fg->num_funcs, i);
+      if(fn2 == NULL)
       {
         printf("no such function\n");
         continue;
       }
       
       fg->time++;
-      actually_merge(fg, fl1->n, fl2->n);
+      actually_merge(fg, fn1, fn2);
       printf("merge successful.\n");
     }
     else if(!strcmp(command, "assertmsg"))
     {
-      fgnode_list *vl;
-      fgnode_list *fl;
-      fgedge_list *el;
+      fgnode *vn;
       bdd_ptr msgans, actans;
       bdd_ptr varcube, vbar;
       
@@ -542,19 +438,8 @@ int main2(int argc, char ** argv)
       
       printf("computing the message from message passing...\n");
       factor_graph_converge(fg);
-      vl = fg->vl;
-      if(vl != NULL) do
-      {
-        if(vl->died <= fg->time)
-        {
-          vl = vl->next;
-          continue;
-        }
-        if(vl->n->id == i)
-          break;
-        vl = vl->next;
-      }while(vl != fg->vl);
-      if(vl->n->id != i)
+      vn = find_node(fg->vars, fg->num_vars, i);
+      if(vn == NULL)
       {
         printf("var node id incorrect\n");
         continue;
@@ -562,7 +447,7 @@ int main2(int argc, char ** argv)
       msgans = bdd_one(fg->m);
       int ressize;
       bdd_ptr* res;
-      res = factor_graph_incoming_messages(fg, vl->n, &ressize);
+      res = factor_graph_incoming_messages(fg, vn, &ressize);
       for(j = 0; j < ressize; j++)
       {
         bdd_and_accumulate(fg->m, &msgans, res[j]);
@@ -574,22 +459,16 @@ int main2(int argc, char ** argv)
       printf("computing the actual answer...\n");
       actans = bdd_one(fg->m);
       varcube = bdd_one(fg->m);
-      fl = fg->fl;
-      do
+      for (i = 0; i < fg->num_funcs; i++)
       {
-        if (fl->died <= fg->time)
-        {
-          fl = fl->next;
-          continue;
-        }
-        for (j = 0; j < fl->n->fs; j++)
+        fgnode *fn = fg->funcs[i];
+        for (j = 0; j < fn->fs; j++)
         {
-          bdd_and_accumulate(fg->m, &actans, fl->n->f[j]);
-          bdd_and_accumulate(fg->m, &varcube, fl->n->ss[j]);
+          bdd_and_accumulate(fg->m, &actans, fn->f[j]);
+          bdd_and_accumulate(fg->m, &varcube, fn->ss[j]);
         }
-        fl = fl->next;
-      } while(fl != fg->fl);
-      vbar = bdd_cube_diff(fg->m, varcube, vl->n->ss[0]);
+      }
+      vbar = bdd_cube_diff(fg->m, varcube, vn->ss[0]);
       bdd_free(fg->m, varcube);
       if(!bdd_is_one(fg->m, vbar))
         varcube = bdd_forsome(fg->m, actans, vbar);
@@ -687,21 +566,13 @@ int main2(int argc, char ** argv)
       (void)!scanf("%d", &i);
       printf("enter starting variable node id -> ");
       (void)!scanf("%d", &j);
-      fgnode_list *vl = fg->vl;
-      if(vl != NULL) do
-      {
-        if(vl->died <= fg->time)
-          continue;
-        if(vl->n->id == j)
-          break;
-        vl = vl->next;
-      }while(vl != fg->vl);
-      if(vl->n->id != j)
+      fgnode *vn = find_node(fg->vars, fg->num_vars, j);
+      if(vn == NULL)
       {
         printf("Invalid node id\n");
         continue;
       }
-      nextv = factor_graph_make_acyclic(fg, vl->n, i);
+      nextv = factor_graph_make_acyclic(fg, vn, i);
       if(nextv == NULL)
         printf("Successfully made acyclic\n");
       else
@@ -772,7 +643,7 @@ int main1(int argc, char ** argv)
   
   //factor_graph_print(fg, "fg1.dot", "temp.txt");
   //fg->time++;
-  //factor_graph_make_acyclic(fg, fg->vl->n, fg->num_vars);
+  //factor_graph_make_acyclic(fg, fg->vars[0], fg->num_vars);
   //factor_graph_rollback(fg);
   //factor_graph_print(fg, "fg2.dot", "temp.txt");
   
@@ -782,7 +653,7 @@ int main1(int argc, char ** argv)
   fgdm("deleting fg", 0);
   factor_graph_delete(fg);
   fgdm("done", 0);
-  Cudd_Quit(ddm);
+  bdd_quit(ddm);
   return 0;
 }
 
@@ -823,9 +694,7 @@ void fgtest2(factor_graph *fg)
     fg->time++;
     j = -1;
     do {
-      while(fg->vl->died <= fg->time)
-        fg->vl = fg->vl->next;
-      nextv = factor_graph_make_acyclic(fg, fg->vl->n, i);
+      nextv = factor_graph_make_acyclic(fg, fg->vars[0], i);
       fgdm("made acyclic", 0);
       j++;
       if(nextv == NULL)
@@ -854,7 +723,7 @@ void fgtest1(factor_graph *fg)
   
   fg->time++;
   /* Try to make the factor graph acyclic*/
-  if(factor_graph_make_acyclic(fg, fg->vl->n, LAMBDA) != NULL)
+  if(factor_graph_make_acyclic(fg, fg->vars[0], LAMBDA) != NULL)
   {
     printf("make_acyclic failed :(\n");
   }
@@ -535,10 +535,12 @@ void May22MucCallback::processMuc(const std::vector<std::vector<int> >& muc)
     mergeAllPairs(varNodes, m_mergeHints, m_mucMergeWeight);
     auto mergeResults = blif_solve::merge(m_ddManager, *m_factors, *m_variables, m_largestSupportSet, m_mergeHints, m_quantifiedVariables);
     auto factorGraph = createFactorGraph(m_ddManager, dd::BddVectorWrapper(*mergeResults.factors, m_ddManager));
+    std::vector<dd::BddWrapper> variableGroups;
     for (const auto & varsToMerge: *mergeResults.variables)
     {
-      factorGraph->groupVariables(dd::BddWrapper(bdd_dup(varsToMerge), m_ddManager));
+      variableGroups.emplace_back(bdd_dup(varsToMerge), m_ddManager);
     }
+    factorGraph->groupVariables(variableGroups);
     blif_solve_log(INFO, "merged " << funcNodes.size() << " func nodes.");
     factorGraph->converge();
     m_factorGraphResult = getFactorGraphResult(m_ddManager, *factorGraph, *m_qdimacsToBdd);
@@ -570,11 +572,7 @@ dd::BddWrapper getFactorGraphResult(DdManager* ddm, const fgpp::FactorGraph& fg,
     allVars = allVars.cubeUnion(nextVar);
   }
   auto nonQVars = allVars.cubeDiff(qvars);
-  auto resultVec = fg.getIncomingMessages(nonQVars);
-  dd::BddWrapper result(bdd_one(ddm), ddm);
-  for (const auto & message: resultVec)
-    result = result * message;
-  return result;
+  return fg.getIncomingConjunction(nonQVars);
 }
 
 
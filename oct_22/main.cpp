@@ -49,6 +49,7 @@ struct CommandLineOptions {
   std::string inputFile;
   bool computeExactUsingBdd;
   std::optional<std::string> outputFile;
+  bool residualSchedule;
 };
 
 struct Oct22MucCallback: public MucCallback
@@ -151,9 +152,12 @@ int main(int argc, char const * const * const argv)
   auto fg = createFactorGraph(ddm.get(), *bdds, clo.largestSupportSet); // merge factors and create factor graph
 
   start = blif_solve::now();
-  auto numIterations = fg->converge();                                  // converge factor graph
+  auto numIterations = fg->converge(clo.residualSchedule                // converge factor graph
+                                    ? fgpp::FactorGraph::Schedule::Residual
+                                    : fgpp::FactorGraph::Schedule::Flooding);
   blif_solve_log(INFO, "Factor graph converged after " 
-      << numIterations << " iterations in "
+      << numIterations << " iterations and "
+      << fg->getConvergenceStats().numFirings << " node firings in "
       << blif_solve::duration(start) << " secs");
 
   start = blif_solve::now();                                            // factor graph result to CNF
@@ -234,8 +238,10 @@ fgpp::FactorGraph::Ptr createFactorGraph(DdManager* ddm, const dd::QdimacsToBdd&
   auto fg = fgpp::FactorGraph::createFactorGraph(mergedFactorVec);
 
   // group the variables in the factor graph
+  std::vector<dd::BddWrapper> mergedVariableVec;
   for (auto mergedVariables: *mergeResults.variables)
-      fg->groupVariables(dd::BddWrapper(mergedVariables, ddm));
+      mergedVariableVec.emplace_back(mergedVariables, ddm);
+  fg->groupVariables(mergedVariableVec);
   blif_solve_log(INFO, "Created factor graph in " << blif_solve::duration(start) << " sec");
 
   return fg;
@@ -280,10 +286,17 @@ CommandLineOptions parseClo(int argc, char const * const * const argv)
         false,
         std::optional<std::string>()
     );
+  auto residualSchedule =
+    std::make_shared<CommandLineOption<bool> >(
+        "--residualSchedule",
+        "Converge the factor graph firing the node with the largest residual first, instead of flooding (default false)",
+        false,
+        false
+    );
   
   // parse the command line
   blif_solve::parse(
-      {  largestSupportSet, inputFile, verbosity, computeExactUsingBdd, outputFile },
+      {  largestSupportSet, inputFile, verbosity, computeExactUsingBdd, outputFile, residualSchedule },
       argc,
       argv);
 
@@ -296,7 +309,8 @@ CommandLineOptions parseClo(int argc, char const * const * const argv)
     *(largestSupportSet->value),
     *(inputFile->value),
     *(computeExactUsingBdd->value),
-    outputFile->value
+    outputFile->value,
+    *(residualSchedule->value)
   };
 }
 
@@ -581,7 +595,7 @@ std::vector<dd::BddWrapper> getFactorGraphResults(DdManager* ddm, const fgpp::Fa
     allVars = allVars.cubeUnion(nextVar);
   }
   auto nonQVars = allVars.cubeDiff(qvars);
-  return fg.getIncomingMessages(nonQVars);
+  return fg.getDistinctIncomingMessages(nonQVars);
 }
 
 
@@ -158,7 +158,7 @@ int main(int argc, char const * const * const argv)
 
 
   blif_solve_log(INFO, "computing clipped result");
-  result = bdd_clipping_and_exists_multi(manager, factors, varsToQuantify, clippingDepth, clippingDirection);
+  result = bdd_clipping_and_exists_multi(manager, factors, varsToQuantify, clippingDepth, clippingDirection, 100*1000);
   blif_solve_log_bdd(DEBUG, "clipped result is ", manager, result);
   std::cout << "Clipped number of solutions = " << bdd_count_minterm(manager, result, numVars - numVarsToQuantify) << std::endl;
   bdd_free(manager, result);
@@ -0,0 +1,231 @@
+/*
+
+Copyright 2021 Parakram Majumdar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+
+// Benchmark of the compressed-sparse-row fgpp::FactorGraph
+//   against the node-based one, on random 2-clause factor graphs
+//   with a few unit clauses to start the propagation.
+// Reports the heap memory held by each graph (counted by replacing
+//   the global operator new, so the bdd nodes themselves, which CUDD
+//   allocates with malloc, are not included), the converge time,
+//   and the node firings of the flooding and residual schedules,
+//   and of the parallel engine, checking that it reaches the same fixpoint.
+// Also times the legacy C factor graph converging on the same factors.
+// Then times grouping the variables into random groups,
+//   one groupVariables call per group against a single bulk call.
+// With --telemetry, each convergence also writes its rounds and
+//   its slowest nodes to stderr, as lines of JSON.
+
+
+// std includes
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <vector>
+
+
+// factor_graph includes
+#include <factor_graph/factor_graph.h>
+#include <factor_graph/fgpp.h>
+
+
+// blif_solve_lib includes
+#include <blif_solve_lib/command_line_options.h>
+#include <blif_solve_lib/log.h>
+
+
+
+namespace {
+
+  // bytes currently allocated through operator new
+  long long g_heapBytes = 0;
+
+} // end anonymous namespace
+
+
+void * operator new(std::size_t size)
+{
+  // keep the size in front of the block, aligned for any type
+  std::size_t * block = static_cast<std::size_t *>(std::malloc(size + alignof(std::max_align_t)));
+  if (!block)
+    throw std::bad_alloc();
+  *block = size;
+  g_heapBytes += size;
+  return reinterpret_cast<char *>(block) + alignof(std::max_align_t);
+}
+
+void operator delete(void * ptr) noexcept
+{
+  if (!ptr)
+    return;
+  std::size_t * block = reinterpret_cast<std::size_t *>(static_cast<char *>(ptr) - alignof(std::max_align_t));
+  g_heapBytes -= *block;
+  std::free(block);
+}
+
+void operator delete(void * ptr, std::size_t) noexcept
+{
+  operator delete(ptr);
+}
+
+
+
+int main(int argc, char const * const * const argv)
+{
+  using blif_solve::CommandLineOptionValue;
+  using dd::BddWrapper;
+
+  auto numFactorsClo = CommandLineOptionValue<int>::create("--num_factors", "Number of 2-variable clauses (default 20000)", 20000);
+  auto numVarsClo = CommandLineOptionValue<int>::create("--num_vars", "Number of variables (default 10000)", 10000);
+  auto numUnitsClo = CommandLineOptionValue<int>::create("--num_units", "Number of unit clauses (default 50)", 50);
+  auto numThreadsClo = CommandLineOptionValue<int>::create("--num_threads", "Threads of the parallel engine (default 4)", 4);
+  auto partialProductDegreeClo = CommandLineOptionValue<int>::create("--partial_product_degree",
+                                                                      "Smallest degree of a node with a tree of partial conjunctions (0 for none)",
+                                                                      fgpp::FactorGraph::DefaultPartialProductDegree);
+  auto groupSizeClo = CommandLineOptionValue<int>::create("--group_size", "Variables per group in the grouping benchmark (default 4)", 4);
+  auto telemetryClo = CommandLineOptionValue<int>::create("--telemetry", "Write convergence telemetry to stderr as JSON lines (1) or not (0, default)", 0);
+  auto seedClo = CommandLineOptionValue<int>::create("--seed", "Seed for randomization", 20200123);
+  std::vector<std::shared_ptr<blif_solve::ICommandLineOption> > options{ numFactorsClo, numVarsClo, numUnitsClo, numThreadsClo,
+                                                                         partialProductDegreeClo, groupSizeClo, telemetryClo, seedClo };
+  blif_solve::parseCommandLineOptions(argc - 1, argv + 1, options);
+
+  int const numFactors = numFactorsClo->getValue();
+  int const numVars = numVarsClo->getValue();
+  int const numUnits = numUnitsClo->getValue();
+  std::mt19937 gen(seedClo->getValue());
+  std::uniform_int_distribution<int> varDist(0, numVars - 1), signDist(0, 1);
+
+  DdManager * manager = Cudd_Init(0, 0, 256, 262144, 0);
+  {
+    std::vector<BddWrapper> vars;
+    for (int i = 0; i < numVars; ++i)
+      vars.emplace_back(bdd_new_var_with_index(manager, i), manager);
+    auto literal = [&]() { auto const & v = vars[varDist(gen)]; return signDist(gen) ? v : -v; };
+    std::vector<BddWrapper> factors;
+    for (int i = 0; i < numFactors; ++i)
+      factors.push_back(literal() + literal());
+    for (int i = 0; i < numUnits; ++i)
+      factors.push_back(literal());
+
+    typedef fgpp::FactorGraph::Schedule Schedule;
+    typedef fgpp::FactorGraph::Ptr (*Create)(const std::vector<BddWrapper> &);
+    auto run = [&](char const * name, Create create, std::function<void(fgpp::FactorGraph &)> converge)
+    {
+      long long before = g_heapBytes;
+      auto start = blif_solve::now();
+      auto fg = create(factors);
+      fg->setPartialProductDegree(partialProductDegreeClo->getValue());
+      if (telemetryClo->getValue())
+        fg->setConvergenceObserver(std::make_shared<fgpp::FactorGraph::JsonLinesWriter>(std::cerr), true);
+      double createTime = blif_solve::duration(start);
+      long long graphBytes = g_heapBytes - before;
+
+      // wall clock, since blif_solve::now counts the cpu time of all threads
+      auto wallStart = std::chrono::steady_clock::now();
+      converge(*fg);
+      double convergeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+      auto stats = fg->getConvergenceStats();
+
+      std::cout << name << ": " << graphBytes / 1024 << " KiB, created in " << createTime
+                << " s, converged in " << stats.numIterations << " iterations, "
+                << stats.numFirings << " firings, " << convergeTime << " s" << std::endl;
+      return fg;
+    };
+    auto flooding = [](fgpp::FactorGraph & fg) { fg.converge(Schedule::Flooding); };
+    auto residual = [](fgpp::FactorGraph & fg) { fg.converge(Schedule::Residual); };
+    auto parallel = [&](fgpp::FactorGraph & fg) { fg.convergeParallel(numThreadsClo->getValue()); };
+    run("node-based           ", &fgpp::FactorGraph::createFactorGraph, flooding);
+    auto sequential = run("csr                  ", &fgpp::FactorGraph::createCsrFactorGraph, flooding);
+    run("node-based, residual ", &fgpp::FactorGraph::createFactorGraph, residual);
+    run("csr, residual        ", &fgpp::FactorGraph::createCsrFactorGraph, residual);
+    auto threaded = run("csr, parallel        ", &fgpp::FactorGraph::createCsrFactorGraph, parallel);
+
+    // one cube of all the variables, so each graph is queried only once
+    BddWrapper allVars(bdd_one(manager), manager);
+    for (const auto & v: vars)
+      allVars = allVars * v;
+    bool same = sequential->getIncomingMessages(allVars) == threaded->getIncomingMessages(allVars);
+    std::cout << "parallel fixpoint " << (same ? "matches" : "DIFFERS FROM") << " the sequential one" << std::endl;
+
+    // the legacy factor graph
+    {
+      std::vector<bdd_ptr> funcs;
+      for (const auto & f: factors)
+        funcs.push_back(f.getUncountedBdd());
+      auto start = blif_solve::now();
+      factor_graph * fg = factor_graph_new(manager, &funcs.front(), static_cast<int>(funcs.size()));
+      double createTime = blif_solve::duration(start);
+      if (telemetryClo->getValue())
+        factor_graph_set_round_callback(fg, factor_graph_write_round_json, stderr, 0);
+      auto wallStart = std::chrono::steady_clock::now();
+      int numIterations = factor_graph_converge(fg);
+      double convergeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+      std::cout << "legacy               : created in " << createTime
+                << " s, converged in " << numIterations << " iterations, " << convergeTime << " s" << std::endl;
+      factor_graph_delete(fg);
+    }
+
+    // random groups of variables
+    std::vector<BddWrapper> shuffled(vars);
+    std::shuffle(shuffled.begin(), shuffled.end(), gen);
+    std::vector<BddWrapper> groups;
+    int const groupSize = std::max(groupSizeClo->getValue(), 1);
+    for (int i = 0; i < numVars; i += groupSize)
+    {
+      BddWrapper group(bdd_one(manager), manager);
+      for (int j = i; j < std::min(i + groupSize, numVars); ++j)
+        group = group * shuffled[j];
+      groups.push_back(group);
+    }
+    auto group = [&](char const * name, Create create, bool bulk)
+    {
+      auto fg = create(factors);
+      auto wallStart = std::chrono::steady_clock::now();
+      if (bulk)
+        fg->groupVariables(groups);
+      else
+        for (const auto & g: groups)
+          fg->groupVariables(g);
+      double groupTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+      std::cout << name << ": " << groups.size() << " groups in " << groupTime << " s" << std::endl;
+      return fg;
+    };
+    group("node-based, one by one", &fgpp::FactorGraph::createFactorGraph, false);
+    group("node-based, bulk      ", &fgpp::FactorGraph::createFactorGraph, true);
+    auto oneByOne = group("csr, one by one       ", &fgpp::FactorGraph::createCsrFactorGraph, false);
+    auto bulk = group("csr, bulk             ", &fgpp::FactorGraph::createCsrFactorGraph, true);
+    oneByOne->converge();
+    bulk->converge();
+    same = oneByOne->getIncomingMessages(allVars) == bulk->getIncomingMessages(allVars);
+    std::cout << "bulk grouping " << (same ? "matches" : "DIFFERS FROM") << " grouping one by one" << std::endl;
+  }
+  bdd_quit(manager);
+  return 0;
+}
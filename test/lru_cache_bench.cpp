@@ -0,0 +1,215 @@
+/*
+
+Copyright 2019 Parakram Majumdar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+
+// Microbenchmark of parakram::LruCache against the implementation it replaced
+//   (five hash maps and a std::list), on the access pattern of the
+//   multi-operand kernels: keys are sorted sets of DdNode pointers,
+//   and most probes are lookups, followed by an insert on a miss.
+// The new cache is also probed with spans, without building a set.
+
+
+// std includes
+#include <iostream>
+#include <list>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+// dd includes
+#include <dd/dd.h>
+#include <dd/const_span.h>
+#include <dd/lru_cache.h>
+#include <dd/optional.h>
+
+
+// blif_solve_lib includes
+#include <blif_solve_lib/command_line_options.h>
+#include <blif_solve_lib/log.h>
+
+
+namespace {
+
+  typedef std::set<DdNode *> NodeSet;
+
+  struct NodeSetHash
+  {
+    std::size_t operator()(NodeSet const & s) const { return parakram::LruRangeHash()(s); }
+  };
+
+  // ***** LegacyLruCache *****
+  // ******** class ********
+  // The previous LruCache, kept verbatim as the baseline
+  template<typename TKey, typename TValue, typename THash>
+  class LegacyLruCache
+  {
+    public:
+
+      LegacyLruCache(int capacity) : m_capacity(capacity), m_largestKey(0) { }
+
+      bool insert(const TKey & key, const TValue & value)
+      {
+        if (m_keyStore.find(key) != m_keyStore.end())
+          return false;
+        KeyId keyId = ++m_largestKey;
+        m_keyStore[key] = keyId;
+        m_keyStoreMap[keyId] = m_keyStore.find(key);
+        m_valueMap[keyId] = value;
+        m_priorityQueue.push_front(keyId);
+        m_priorityMap[keyId] = m_priorityQueue.begin();
+        while (m_keyStore.size() > static_cast<size_t>(m_capacity) && !m_keyStore.empty())
+        {
+          KeyId lruId = m_priorityQueue.back();
+          m_priorityMap.erase(lruId);
+          m_priorityQueue.pop_back();
+          m_valueMap.erase(lruId);
+          auto ksmit = m_keyStoreMap.find(lruId);
+          auto ksit = ksmit->second;
+          m_keyStoreMap.erase(ksmit);
+          m_keyStore.erase(ksit);
+        }
+        return true;
+      }
+
+      parakram::Optional<TValue> tryGet(const TKey & key)
+      {
+        auto keyIdIter = m_keyStore.find(key);
+        if (m_keyStore.end() == keyIdIter)
+          return parakram::Optional<TValue>();
+        KeyId keyId = keyIdIter->second;
+        auto pqiter = m_priorityMap.find(keyId);
+        m_priorityQueue.erase(pqiter->second);
+        m_priorityQueue.push_front(keyId);
+        pqiter->second = m_priorityQueue.begin();
+        return m_valueMap[keyId];
+      }
+
+    private:
+      typedef unsigned long long KeyId;
+      typedef std::list<KeyId>::const_iterator PriorityQueueIterator;
+      typedef std::unordered_map<TKey, KeyId, THash> KeyStore;
+      typedef typename KeyStore::const_iterator KeyStoreIterator;
+      int m_capacity;
+      KeyId m_largestKey;
+      KeyStore m_keyStore;
+      std::unordered_map<KeyId, KeyStoreIterator> m_keyStoreMap;
+      std::unordered_map<KeyId, TValue> m_valueMap;
+      std::list<KeyId> m_priorityQueue;
+      std::unordered_map<KeyId, PriorityQueueIterator> m_priorityMap;
+  };
+
+  // ***** Function *****
+  // makeProbes
+  // a skewed sequence of sorted operand vectors over a pool of distinct keys
+  std::vector<std::vector<DdNode *> > makeProbes(int numKeys, int numOps, int keySize, int seed)
+  {
+    std::mt19937 gen(seed);
+    std::vector<std::vector<DdNode *> > keys(numKeys);
+    for (auto & key: keys)
+    {
+      NodeSet s;
+      while (static_cast<int>(s.size()) < keySize)
+        s.insert(reinterpret_cast<DdNode *>(static_cast<std::size_t>(gen() % (1 << 20) + 1) * 64));
+      key.assign(s.begin(), s.end());
+    }
+    // the product of two uniforms favours the small indices
+    std::uniform_real_distribution<double> u(0, 1);
+    std::vector<std::vector<DdNode *> > probes;
+    probes.reserve(numOps);
+    for (int i = 0; i < numOps; ++i)
+      probes.push_back(keys[static_cast<int>(u(gen) * u(gen) * numKeys)]);
+    return probes;
+  }
+
+} // end anonymous namespace
+
+
+int main(int argc, char const * const * const argv)
+{
+  using blif_solve::CommandLineOptionValue;
+
+  auto capacityClo = CommandLineOptionValue<int>::create("--capacity", "Cache capacity (default 4096)", 4096);
+  auto numKeysClo = CommandLineOptionValue<int>::create("--num_keys", "Number of distinct keys (default 16384)", 16384);
+  auto numOpsClo = CommandLineOptionValue<int>::create("--num_ops", "Number of probes (default 1000000)", 1000000);
+  auto keySizeClo = CommandLineOptionValue<int>::create("--key_size", "Number of nodes per key (default 6)", 6);
+  auto seedClo = CommandLineOptionValue<int>::create("--seed", "Seed for randomization", 20200123);
+  std::vector<std::shared_ptr<blif_solve::ICommandLineOption> > options{ capacityClo, numKeysClo, numOpsClo, keySizeClo, seedClo };
+  blif_solve::parseCommandLineOptions(argc - 1, argv + 1, options);
+
+  int capacity = capacityClo->getValue();
+  auto probes = makeProbes(numKeysClo->getValue(), numOpsClo->getValue(), keySizeClo->getValue(), seedClo->getValue());
+  DdNode * value = reinterpret_cast<DdNode *>(0x40);
+
+  // legacy cache, keyed on sets
+  {
+    LegacyLruCache<NodeSet, DdNode *, NodeSetHash> cache(capacity);
+    long long hits = 0;
+    auto start = blif_solve::now();
+    for (auto const & probe: probes)
+    {
+      NodeSet key(probe.begin(), probe.end());
+      if (cache.tryGet(key).isPresent())
+        ++hits;
+      else
+        cache.insert(key, value);
+    }
+    std::cout << "legacy LruCache, set probes: " << blif_solve::duration(start) << " sec, "
+              << hits << " hits" << std::endl;
+  }
+
+  // new cache, keyed on sets
+  {
+    parakram::LruCache<NodeSet, DdNode *, NodeSetHash> cache(capacity);
+    auto start = blif_solve::now();
+    for (auto const & probe: probes)
+    {
+      NodeSet key(probe.begin(), probe.end());
+      if (NULL == cache.lookup(key))
+        cache.insert(std::move(key), std::move(value));
+    }
+    std::cout << "flat LruCache, set probes: " << blif_solve::duration(start) << " sec, "
+              << cache.stats().hits << " hits, " << cache.stats().evictions << " evictions" << std::endl;
+  }
+
+  // new cache, probed with spans, building a set only to insert
+  {
+    parakram::LruCache<NodeSet, DdNode *, parakram::LruRangeHash, parakram::LruRangeEqual> cache(capacity);
+    auto start = blif_solve::now();
+    for (auto const & probe: probes)
+    {
+      parakram::ConstSpan<DdNode *> span(probe);
+      if (NULL == cache.lookup(span))
+        cache.insert(NodeSet(probe.begin(), probe.end()), std::move(value));
+    }
+    std::cout << "flat LruCache, span probes: " << blif_solve::duration(start) << " sec, "
+              << cache.stats().hits << " hits, " << cache.stats().evictions << " evictions" << std::endl;
+  }
+
+  return 0;
+}
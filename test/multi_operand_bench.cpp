@@ -0,0 +1,96 @@
+/*
+
+Copyright 2019 Parakram Majumdar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+
+
+// Microbenchmark of the span overloads of the multi-operand functions
+//   against the bdd_ptr_set ones, on factor sets of 10^3 to 10^5 operands.
+// The factors are projection functions, one of them also complemented,
+//   so the kernel finds the conjunction to be zero as soon as
+//   the operands are normalized: what is timed is the cost
+//   of handing the operands over, which every call pays.
+
+
+// std includes
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+
+// dd includes
+#include <dd/dd.h>
+
+
+// blif_solve_lib includes
+#include <blif_solve_lib/command_line_options.h>
+#include <blif_solve_lib/log.h>
+
+
+int main(int argc, char const * const * const argv)
+{
+  using blif_solve::CommandLineOptionValue;
+
+  auto maxOperandsClo = CommandLineOptionValue<int>::create("--max_operands", "Largest number of operands (default 100000)", 100000);
+  auto numCallsClo = CommandLineOptionValue<int>::create("--num_calls", "Number of calls per size (default 100)", 100);
+  auto seedClo = CommandLineOptionValue<int>::create("--seed", "Seed for randomization", 20200123);
+  std::vector<std::shared_ptr<blif_solve::ICommandLineOption> > options{ maxOperandsClo, numCallsClo, seedClo };
+  blif_solve::parseCommandLineOptions(argc - 1, argv + 1, options);
+
+  int const maxOperands = maxOperandsClo->getValue();
+  int const numCalls = numCallsClo->getValue();
+  std::mt19937 gen(seedClo->getValue());
+
+  DdManager * manager = Cudd_Init(0, 0, 256, 262144, 0);
+  for (int numOperands = 1000; numOperands <= maxOperands; numOperands *= 10)
+  {
+    std::vector<bdd_ptr> funcs;
+    for (int i = 0; i < numOperands; ++i)
+      funcs.push_back(bdd_new_var_with_index(manager, i));
+    funcs.push_back(bdd_not(funcs[numOperands / 2]));
+    std::shuffle(funcs.begin(), funcs.end(), gen);
+
+    auto start = blif_solve::now();
+    for (int call = 0; call < numCalls; ++call)
+    {
+      bdd_ptr_set funcSet(funcs.cbegin(), funcs.cend());
+      bdd_free(manager, bdd_and_multi(manager, funcSet, 1000));
+    }
+    double setTime = blif_solve::duration(start);
+
+    start = blif_solve::now();
+    for (int call = 0; call < numCalls; ++call)
+      bdd_free(manager, bdd_and_multi(manager, funcs, 1000));
+    double spanTime = blif_solve::duration(start);
+
+    std::cout << numOperands << " operands: bdd_ptr_set " << setTime / numCalls * 1e6
+              << " us/call, span " << spanTime / numCalls * 1e6 << " us/call" << std::endl;
+
+    for (auto f: funcs)
+      bdd_free(manager, f);
+  }
+  bdd_quit(manager);
+  return 0;
+}
@@ -28,6 +28,12 @@ SOFTWARE.
 #include <blif_solve_lib/cnf_dump.h>
 #include <dd/optional.h>
 #include <dd/lru_cache.h>
+#include <dd/sharded_cache.h>
+#include <dd/const_span.h>
+#include <dd/bdd_operand_set.h>
+#include <dd/conjunction_tree.h>
+#include <dd/cuddAndAbsMulti.h>
+#include <dd/multi_computed_table.h>
 #include <dd/max_heap.h>
 #include <blif_solve_lib/clo.hpp>
 #include <dd/dotty.h>
@@ -37,22 +43,47 @@ SOFTWARE.
 #include <dd/qdimacs.h>
 #include <dd/qdimacs_to_bdd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <list>
 #include <memory>
+#include <set>
 #include <vector>
 #include <cstdlib>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 
 #include "testApproxMerge.h"
 #include "testVarScoreQuantification.h"
 
 void testCuddBddAndAbstractMulti(DdManager * manager);
+void testCuddBddClippingAndAbstractMultiDeepening(DdManager * manager);
+void testCuddBddAndAbstractMultiParallel(DdManager * manager);
+void testCuddBddAndAbstractMultiBudgeted(DdManager * manager);
+void testMultiStackStats(DdManager * manager);
 void testCnfDump(DdManager * manager);
 void testIsConnectedComponent(DdManager * manager);
 void testCuddBddCountMintermsMulti(DdManager * manager);
+void testCuddBddCountMintermsMultiExact(DdManager * manager);
+void testMultiOperandSpanOverloads(DdManager * manager);
+void testBigCount();
 void testOptional();
 void testLruCache();
+void testShardedCache();
+void testBddWrapperMoveAndProduct(DdManager * manager);
+void testConjunctionTree(DdManager * manager);
+void testLegacyFactorGraphRounds(DdManager * manager);
+void testLegacyFactorGraphRollback(DdManager * manager);
+void testLegacyFactorGraphSnapshots(DdManager * manager);
+void testLegacyFactorGraphAcyclicMessages(DdManager * manager);
+void testLegacyFactorGraphAllMessages(DdManager * manager);
+void testLegacyFactorGraphWorklist(DdManager * manager);
+void testBddOperandSet(DdManager * manager);
+void testMultiComputedTable(DdManager * manager);
 void testDisjointSet(DdManager * manager);
 void testMaxHeap();
 void testClo();
@@ -63,6 +94,10 @@ void testFactorGraphImpl(DdManager * manager);
 void testQdimacsParser(DdManager* manager);
 
 DdNode * makeFunc(DdManager * manager, int const numVars, int const funcAsIntger);
+std::vector<dd::BddWrapper> makeVars(DdManager * manager, int numVars);
+std::vector<dd::BddWrapper> makeHubClauses(std::vector<dd::BddWrapper> const & v);
+dd::BddWrapper conjunctionOf(DdManager * manager, std::vector<dd::BddWrapper> const & funcs);
+std::vector<dd::BddWrapper> incomingMessages(factor_graph * fg, std::vector<dd::BddWrapper> const & vars);
 
 int main()
 {
@@ -72,11 +107,29 @@ int main()
 
     
     testCuddBddCountMintermsMulti(manager);
+    testCuddBddCountMintermsMultiExact(manager);
+    testMultiOperandSpanOverloads(manager);
+    testBigCount();
     testCuddBddAndAbstractMulti(manager);
+    testCuddBddClippingAndAbstractMultiDeepening(manager);
+    testCuddBddAndAbstractMultiParallel(manager);
+    testCuddBddAndAbstractMultiBudgeted(manager);
+    testMultiStackStats(manager);
     testCnfDump(manager);
     testIsConnectedComponent(manager);
     testOptional();
     testLruCache();
+    testShardedCache();
+    testBddWrapperMoveAndProduct(manager);
+    testConjunctionTree(manager);
+    testLegacyFactorGraphRounds(manager);
+    testLegacyFactorGraphRollback(manager);
+    testLegacyFactorGraphSnapshots(manager);
+    testLegacyFactorGraphAcyclicMessages(manager);
+    testLegacyFactorGraphAllMessages(manager);
+    testLegacyFactorGraphWorklist(manager);
+    testBddOperandSet(manager);
+    testMultiComputedTable(manager);
     testDisjointSet(manager);
     testMaxHeap();
     testApproxMerge(manager);
@@ -166,6 +219,7 @@ void testQdimacsParser(DdManager* manager)
 void testFactorGraphImpl(DdManager * manager)
 {
   fgpp::FactorGraph::testFactorGraphImpl(manager);
+  fgpp::FactorGraph::testCsrFactorGraphImpl(manager);
 }
 
 
@@ -471,6 +525,685 @@ void testLruCache()
     if (i > 0) assert(lc.tryGet(i).get() == ctos('a' + i - 1));
     assert(lc.tryGet(i + 1).get() == ctos('a' + i));
   }
+
+  // hits, misses and evictions
+  lc.resetStats();
+  assert(lc.size() == 3);
+  assert(!lc.tryGet(1).isPresent());
+  assert(lc.tryGet(26).get() == "z");
+  assert(!lc.insert(26, "zz"));
+  assert(lc.insert(27, "?"));
+  assert(lc.stats().hits == 1);
+  assert(lc.stats().misses == 1);
+  assert(lc.stats().insertions == 1);
+  assert(lc.stats().evictions == 1);
+  assert(lc.tryGet(26).get() == "z");
+  lc.clear();
+  assert(lc.size() == 0);
+  assert(!lc.tryGet(26).isPresent());
+
+  // probe a cache keyed on sets with spans and vectors
+  LruCache<std::set<int>, int, LruRangeHash, LruRangeEqual> sc(2);
+  sc.insert(std::set<int>{3, 1, 2}, 6);
+  sc.insert(std::set<int>{4, 5}, 9);
+  std::vector<int> v123{1, 2, 3};
+  int a45[] = {4, 5};
+  assert(sc.tryGet(v123).get() == 6);
+  assert(*sc.lookup(ConstSpan<int>(a45, 2)) == 9);
+  assert(NULL == sc.lookup(ConstSpan<int>(a45, 1)));
+  sc.insert(std::set<int>{7}, 7);
+  assert(!sc.tryGet(v123).isPresent());
+
+  // compare against a reference list of keys, most recent first
+  LruCache<int, int> rc(16);
+  std::list<int> ref;
+  for (int step = 0; step < 20000; ++step)
+  {
+    int k = rand() % 40;
+    auto rit = std::find(ref.begin(), ref.end(), k);
+    if (rand() % 2)
+    {
+      bool isNew = rc.insert(k, 3 * k);
+      assert(isNew == (ref.end() == rit));
+      if (isNew)
+      {
+        ref.push_front(k);
+        if (ref.size() > 16)
+          ref.pop_back();
+      }
+    }
+    else
+    {
+      int * value = rc.lookup(k);
+      assert((NULL == value) == (ref.end() == rit));
+      if (NULL != value)
+      {
+        assert(*value == 3 * k);
+        ref.splice(ref.begin(), ref, rit);
+      }
+    }
+    assert(rc.size() == static_cast<int>(ref.size()));
+  }
+}
+
+void testShardedCache()
+{
+  using namespace parakram;
+  ShardedCache<int, int> sc(64, 4);
+  assert(sc.numShards() == 4);
+  assert(sc.insert(1, 10));
+  assert(!sc.insert(1, 11));
+  assert(sc.tryGet(1).get() == 10);
+  assert(!sc.tryGet(2).isPresent());
+  for (int i = 2; i < 10; ++i)
+    sc.insert(i, 10 * i);
+  assert(sc.size() == 9);
+  assert(sc.eraseIf([](int k, int) { return k % 2 == 0; }) == 4);
+  assert(!sc.tryGet(4).isPresent());
+  assert(sc.tryGet(5).get() == 50);
+  assert(sc.stats().insertions == 9);
+
+  // several threads filling and probing overlapping ranges of keys
+  ShardedCache<int, int> big(1 << 14);
+  std::vector<std::thread> threads;
+  std::atomic<int> numWrong(0);
+  for (int t = 0; t < 4; ++t)
+    threads.emplace_back([&big, &numWrong, t]() {
+      for (int i = 0; i < 4000; ++i)
+      {
+        int k = (t * 1000 + i) % 5000;
+        big.insert(k, 3 * k);
+        auto v = big.tryGet((k * 7) % 5000);
+        if (v.isPresent() && v.get() != 3 * ((k * 7) % 5000))
+          ++numWrong;
+      }
+    });
+  for (auto & thread: threads)
+    thread.join();
+  assert(0 == numWrong);
+  assert(big.size() == 5000);
+  for (int k = 0; k < 5000; ++k)
+    assert(big.tryGet(k).get() == 3 * k);
+
+  // managers and operand spans as keys
+  DdShardedCache<int> dc(256);
+  DdNode * nodes[] = {reinterpret_cast<DdNode *>(0x40), reinterpret_cast<DdNode *>(0x80)};
+  DdManager * m1 = reinterpret_cast<DdManager *>(0x1000);
+  DdManager * m2 = reinterpret_cast<DdManager *>(0x2000);
+  dc.insert(DdCacheKey{m1, 1, 0, std::vector<DdNode *>(nodes, nodes + 2)}, 12);
+  assert(dc.tryGet(DdCacheProbe{m1, 1, 0, ConstSpan<DdNode *>(nodes, 2)}).get() == 12);
+  assert(!dc.tryGet(DdCacheProbe{m2, 1, 0, ConstSpan<DdNode *>(nodes, 2)}).isPresent());
+  assert(!dc.tryGet(DdCacheProbe{m1, 1, 1, ConstSpan<DdNode *>(nodes, 2)}).isPresent());
+  assert(!dc.tryGet(DdCacheProbe{m1, 1, 0, ConstSpan<DdNode *>(nodes, 1)}).isPresent());
+}
+
+void testBddWrapperMoveAndProduct(DdManager * manager)
+{
+  using dd::BddWrapper;
+  using dd::BddProduct;
+  std::vector<BddWrapper> v;
+  for (int i = 0; i < 6; ++i)
+    v.emplace_back(bdd_new_var_with_index(manager, i), manager);
+  auto refs = [](BddWrapper const & f) { return Cudd_Regular(f.getUncountedBdd())->ref; };
+
+  // moves transfer the reference instead of taking a new one
+  BddWrapper a = v[0] + v[1];
+  auto aRefs = refs(a);
+  BddWrapper b(std::move(a));
+  assert(refs(b) == aRefs);
+  a = std::move(b);
+  assert(refs(a) == aRefs);
+  a = a;
+  assert(refs(a) == aRefs);
+  {
+    BddWrapper c = a;
+    assert(refs(a) == aRefs + 1);
+  }
+  assert(refs(a) == aRefs);
+
+  // a chain of products is evaluated once, and agrees with pairwise conjunction
+  bdd_ptr expected = bdd_one(manager);
+  for (auto const & x: v)
+  {
+    bdd_ptr next = bdd_and(manager, expected, x.getUncountedBdd());
+    bdd_free(manager, expected);
+    expected = next;
+  }
+  auto product = dd::product(v[0], v[1], v[2], dd::product(v[3], v[4]), v[5]);
+  assert(product.numFactors() == 6);
+  BddWrapper conjoined = product;
+  assert(conjoined.getUncountedBdd() == expected);
+  assert(BddWrapper(dd::product(v[0], v[1])) == v[0] * v[1]);
+
+  // the conjunction operator still gives a wrapper at once
+  static_assert(std::is_same<decltype(v[0] * v[1]), BddWrapper>::value,
+                "the conjunction of wrappers must be a wrapper");
+  bdd_free(manager, expected);
+
+  // products hold their factors, and release them when done
+  auto v0Refs = refs(v[0]);
+  {
+    BddProduct p(v[0]);
+    p *= v[0] + v[2];
+    assert(refs(v[0]) == v0Refs + 1);
+    BddProduct q = p;
+    assert(refs(v[0]) == v0Refs + 2);
+    BddProduct r = std::move(q);
+    assert(refs(v[0]) == v0Refs + 2);
+  }
+  assert(refs(v[0]) == v0Refs);
+
+  // fused conjunction and projection
+  BddWrapper cube = v[1] * v[2] * v[3];
+  auto disjoint = dd::product(v[0] + v[1], -v[1] + v[2], v[2] + v[3]);
+  BddWrapper fused = disjoint.existentialQuantification(cube);
+  BddWrapper unfused = BddWrapper(disjoint).existentialQuantification(cube);
+  assert(fused == unfused);
+  assert(dd::product(v[0] + v[1], v[2]).existentialQuantification(cube) == v[0].one());
+  assert(dd::product(v[0], -v[1]).existentialQuantification(v[1]) == v[0]);
+}
+
+void testConjunctionTree(DdManager * manager)
+{
+  using dd::BddWrapper;
+  std::vector<BddWrapper> v = makeVars(manager, 8);
+  auto conjunction = [&](std::vector<BddWrapper> const & leaves) { return conjunctionOf(manager, leaves); };
+  auto update = [&](parakram::ConjunctionTree & tree, std::vector<BddWrapper> const & leaves) {
+    std::vector<bdd_ptr> ptrs;
+    for (auto const & leaf: leaves)
+      ptrs.push_back(leaf.getUncountedBdd());
+    return BddWrapper(bdd_dup(tree.update(ptrs.data(), static_cast<int>(ptrs.size()))), manager);
+  };
+
+  // the root follows the leaves as they change, one or several at a time,
+  //   and as their number changes
+  {
+    parakram::ConjunctionTree tree(manager);
+    std::vector<BddWrapper> leaves;
+    for (int i = 0; i < 7; ++i)
+      leaves.push_back(v[i] + v[i + 1]);
+    assert(update(tree, leaves) == conjunction(leaves));
+    assert(tree.size() == 7);
+    leaves[3] = -v[3] + v[0];
+    assert(update(tree, leaves) == conjunction(leaves));
+    leaves[0] = v[0] * v[5];
+    leaves[6] = v[0].one();
+    assert(update(tree, leaves) == conjunction(leaves));
+    leaves[2] = -v[2] * -v[3];
+    assert(update(tree, leaves) == conjunction(leaves));
+    leaves[5] = -v[0];
+    assert(update(tree, leaves).isZero());
+    leaves.erase(leaves.begin() + 2, leaves.end());
+    assert(update(tree, leaves) == conjunction(leaves));
+    leaves.pop_back();
+    assert(update(tree, leaves) == leaves[0]);
+    leaves[0] = v[7];
+    assert(update(tree, leaves) == v[7]);
+    leaves.clear();
+    assert(update(tree, leaves).isOne());
+  }
+
+  // the children of the root conjoin to the root, which is rebuilt
+  //   on demand after updates that left it out
+  {
+    parakram::ConjunctionTree tree(manager);
+    auto updateChildren = [&](std::vector<BddWrapper> const & leaves) {
+      std::vector<bdd_ptr> ptrs;
+      for (auto const & leaf: leaves)
+        ptrs.push_back(leaf.getUncountedBdd());
+      auto children = tree.updateChildren(ptrs.data(), static_cast<int>(ptrs.size()));
+      BddWrapper result(bdd_dup(children.first), manager);
+      if (NULL != children.second)
+        result = result * BddWrapper(bdd_dup(children.second), manager);
+      return result;
+    };
+    std::vector<BddWrapper> leaves;
+    for (int i = 0; i < 5; ++i)
+      leaves.push_back(v[i] + -v[i + 1]);
+    assert(updateChildren(leaves) == conjunction(leaves));
+    leaves[4] = v[6];
+    assert(updateChildren(leaves) == conjunction(leaves));
+    assert(update(tree, leaves) == conjunction(leaves));
+    leaves[1] = -v[7];
+    assert(updateChildren(leaves) == conjunction(leaves));
+    assert(update(tree, leaves) == conjunction(leaves));
+    leaves.erase(leaves.begin() + 1, leaves.end());
+    assert(updateChildren(leaves) == leaves[0]);
+  }
+
+  // the tree releases its references
+  auto refs = Cudd_Regular(v[1].getUncountedBdd())->ref;
+  {
+    parakram::ConjunctionTree tree(manager);
+    update(tree, {v[1], v[2], v[1]});
+    assert(Cudd_Regular(v[1].getUncountedBdd())->ref > refs);
+  }
+  assert(Cudd_Regular(v[1].getUncountedBdd())->ref == refs);
+
+  // the legacy factor graph reaches the same messages with and without the trees,
+  //   here around a hub variable and after grouping variables
+  std::vector<BddWrapper> clauses = makeHubClauses(v);
+  std::vector<bdd_ptr> funcs;
+  for (auto const & c: clauses)
+    funcs.push_back(c.getUncountedBdd());
+  auto messages = [&](int degree, bool group) {
+    factor_graph * fg = factor_graph_new(manager, &funcs.front(), static_cast<int>(funcs.size()));
+    fg->partial_product_degree = degree;
+    BddWrapper grouped = v[4] * v[5];
+    if (group)
+      factor_graph_group_vars(fg, grouped.getUncountedBdd());
+    factor_graph_converge(fg);
+    auto result = incomingMessages(fg, group ? std::vector<BddWrapper>{v[0], v[1], grouped} : v);
+    factor_graph_delete(fg);
+    return result;
+  };
+  assert(messages(0, false) == messages(1, false));
+  assert(messages(0, true) == messages(1, true));
+  assert(messages(0, false) == messages(3, false));
+}
+
+void testLegacyFactorGraphRounds(DdManager * manager)
+{
+  // the round callback sees every round, and every firing, of the legacy converge
+  std::vector<dd::BddWrapper> clauses = makeHubClauses(makeVars(manager, 8));
+  std::vector<bdd_ptr> funcs;
+  for (auto const & c: clauses)
+    funcs.push_back(c.getUncountedBdd());
+  factor_graph * fg = factor_graph_new(manager, &funcs.front(), static_cast<int>(funcs.size()));
+  std::vector<factor_graph_round_stats> rounds;
+  factor_graph_set_round_callback(fg,
+                                  [](factor_graph *, const factor_graph_round_stats * stats, void * data) {
+                                    static_cast<std::vector<factor_graph_round_stats> *>(data)->push_back(*stats);
+                                  },
+                                  &rounds, 1);
+  int numIterations = factor_graph_converge(fg);
+  assert(numIterations == static_cast<int>(rounds.size()));
+  long numFirings = 0, numNodeFirings = 0;
+  for (int i = 0; i < numIterations; ++i)
+  {
+    assert(rounds[i].round == i + 1);
+    assert(rounds[i].num_firings > 0);
+    assert(rounds[i].max_message_size > 0);
+    assert(rounds[i].total_message_size >= rounds[i].max_message_size);
+    numFirings += rounds[i].num_firings;
+  }
+  for (int i = 0; i < fg->num_funcs; ++i)
+    numNodeFirings += fg->funcs[i]->num_firings;
+  for (int i = 0; i < fg->num_vars; ++i)
+    numNodeFirings += fg->vars[i]->num_firings;
+  assert(numFirings == numNodeFirings);
+  factor_graph_delete(fg);
+} // end testLegacyFactorGraphRounds
+
+void testLegacyFactorGraphRollback(DdManager * manager)
+{
+  // rollback undoes assignments and groupings exactly, back to the same nodes and edges in the same order
+  using dd::BddWrapper;
+  std::vector<BddWrapper> v = makeVars(manager, 8);
+  std::vector<BddWrapper> clauses = makeHubClauses(v);
+  std::vector<bdd_ptr> funcs;
+  for (auto const & c: clauses)
+    funcs.push_back(c.getUncountedBdd());
+  factor_graph * fg = factor_graph_new(manager, &funcs.front(), static_cast<int>(funcs.size()));
+  typedef std::tuple<std::vector<fgnode *>, std::vector<fgnode *>, std::vector<fgedge *> > Snapshot;
+  auto snapshot = [&]() {
+    return Snapshot(std::vector<fgnode *>(fg->funcs, fg->funcs + fg->num_funcs),
+                    std::vector<fgnode *>(fg->vars, fg->vars + fg->num_vars),
+                    std::vector<fgedge *>(fg->edges, fg->edges + fg->num_edges));
+  };
+  auto const initial = snapshot();
+  factor_graph * converged = factor_graph_new(manager, &funcs.front(), static_cast<int>(funcs.size()));
+  factor_graph_converge(converged);
+  auto const initialMessages = incomingMessages(converged, v);
+  factor_graph_delete(converged);
+  fg->time++;
+  assert(factor_graph_assign_var(fg, v[0].getUncountedBdd()) == 0);
+  assert(factor_graph_verify(fg) > 0);
+  assert(factor_graph_get_varnode(fg, v[0].getUncountedBdd()) == NULL);
+  auto const assigned = snapshot();
+  fg->time++;
+  assert(factor_graph_assign_var(fg, (-v[1]).getUncountedBdd()) == 0);
+  BddWrapper grouped = v[4] * v[5];
+  assert(factor_graph_group_vars(fg, grouped.getUncountedBdd()) == 0);
+  assert(factor_graph_verify(fg) > 0);
+  assert(factor_graph_get_varnode(fg, v[4].getUncountedBdd()) == factor_graph_get_varnode(fg, v[5].getUncountedBdd()));
+  factor_graph_rollback(fg);
+  assert(snapshot() == assigned);
+  factor_graph_rollback(fg);
+  assert(snapshot() == initial);
+  assert(factor_graph_verify(fg) > 0);
+  factor_graph_converge(fg);
+  assert(incomingMessages(fg, v) == initialMessages);
+  factor_graph_delete(fg);
+} // end testLegacyFactorGraphRollback
+
+void testLegacyFactorGraphSnapshots(DdManager * manager)
+{
+  // snapshots explore assignments on worker threads, starting from the converged messages:
+  //   each result lies between the exact projection and the one of a cold converge
+  using dd::BddWrapper;
+  std::vector<BddWrapper> v = makeVars(manager, 8);
+  std::vector<BddWrapper> clauses = makeHubClauses(v);
+  std::vector<bdd_ptr> funcs;
+  for (auto const & c: clauses)
+    funcs.push_back(c.getUncountedBdd());
+  factor_graph * fg = factor_graph_new(manager, &funcs.front(), static_cast<int>(funcs.size()));
+  factor_graph_converge(fg);
+  factor_graph * copy = factor_graph_copy(fg, manager);
+  assert(factor_graph_verify(copy) > 0);
+  for (int i = 0; i < fg->num_edges; ++i)
+    assert(copy->edges[i]->id == fg->edges[i]->id && copy->edges[i]->msg_fv == fg->edges[i]->msg_fv);
+  factor_graph_delete(copy);
+
+  struct Jobs { std::vector<bdd_ptr> assignments; bdd_ptr query; };
+  Jobs jobs;
+  std::vector<BddWrapper> assignments;
+  for (int j = 0; j < 4; ++j)
+  {
+    assignments.push_back(BddWrapper((j & 1 ? v[1] : -v[1]) * (j & 2 ? v[2] : -v[2])));
+    jobs.assignments.push_back(assignments.back().getUncountedBdd());
+  }
+  jobs.query = v[3].getUncountedBdd();
+  std::vector<bdd_ptr> results(4, NULL);
+  int status = factor_graph_run_snapshots(fg, 4, 2,
+                                          [](factor_graph_snapshot * s, int job, void * data) -> bdd_ptr {
+                                            Jobs * jobs = static_cast<Jobs *>(data);
+                                            if (factor_graph_snapshot_assign(s, jobs->assignments[job]) != 0)
+                                              return NULL;
+                                            return factor_graph_snapshot_message(s, jobs->query);
+                                          },
+                                          &jobs, &results.front());
+  assert(status == 0);
+
+  BddWrapper all = conjunctionOf(manager, clauses);
+  BddWrapper others = v[0] * v[1] * v[2] * v[4] * v[5] * v[6] * v[7];
+  for (int j = 0; j < 4; ++j)
+  {
+    BddWrapper warm(results[j], manager);
+    fg->time++;
+    for (auto literal: {j & 1 ? v[1] : -v[1], j & 2 ? v[2] : -v[2]})
+      assert(factor_graph_assign_var(fg, literal.getUncountedBdd()) == 0);
+    factor_graph_converge(fg);
+    int size = 0;
+    bdd_ptr * incoming = factor_graph_incoming_messages(fg, factor_graph_get_varnode(fg, jobs.query), &size);
+    BddWrapper cold = v[0].one();
+    for (int i = 0; i < size; ++i)
+      cold = cold * BddWrapper(incoming[i], manager);
+    free(incoming);
+    factor_graph_rollback(fg);
+    BddWrapper exact = BddWrapper(all * assignments[j]).existentialQuantification(others);
+    assert(BddWrapper(exact * -warm).isZero());
+    assert(BddWrapper(warm * -cold).isZero());
+  }
+  assert(factor_graph_verify(fg) > 0);
+  factor_graph_delete(fg);
+} // end testLegacyFactorGraphSnapshots
+
+void testLegacyFactorGraphAcyclicMessages(DdManager * manager)
+{
+  // acyclic messages reach the root on a forest, and the end of a tree without the root
+  using dd::BddWrapper;
+  std::vector<BddWrapper> v = makeVars(manager, 8);
+  std::vector<BddWrapper> forest{v[0] + v[1], -v[1], v[5] + v[6], -v[6] + v[7]};
+  std::vector<bdd_ptr> forestFuncs;
+  for (auto const & f: forest)
+    forestFuncs.push_back(f.getUncountedBdd());
+  factor_graph * fg = factor_graph_new(manager, &forestFuncs.front(), static_cast<int>(forestFuncs.size()));
+  fgnode * root = factor_graph_get_varnode(fg, v[0].getUncountedBdd());
+  assert(factor_graph_acyclic_messages(fg, root) == 1);
+  assert(root->num_neigh == 1 && BddWrapper(bdd_dup(root->neigh[0]->msg_fv), manager) == v[0]);
+  int numEnds = 0;
+  for (int i = 0; i < fg->num_funcs + fg->num_vars; ++i)
+  {
+    fgnode * n = (i < fg->num_funcs ? fg->funcs[i] : fg->vars[i - fg->num_funcs]);
+    if (n != root && n->num_messages == n->num_neigh)
+      ++numEnds;
+  }
+  assert(numEnds == 1);
+  factor_graph_delete(fg);
+} // end testLegacyFactorGraphAcyclicMessages
+
+void testLegacyFactorGraphAllMessages(DdManager * manager)
+{
+  // two sweeps over each tree give every var node of a forest its exact incoming messages,
+  //   the same on one thread as on several, and cycles are refused
+  using dd::BddWrapper;
+  std::vector<BddWrapper> v = makeVars(manager, 8);
+  std::vector<BddWrapper> clauses = makeHubClauses(v);
+  std::vector<bdd_ptr> funcs;
+  for (auto const & c: clauses)
+    funcs.push_back(c.getUncountedBdd());
+  std::vector<BddWrapper> forest{v[0] + v[1], -v[1] + v[2], v[1] + -v[3], -v[0] * -v[7] + v[4],
+                                 v[5] + v[6], -v[6]};
+  std::vector<bdd_ptr> forestFuncs;
+  for (auto const & f: forest)
+    forestFuncs.push_back(f.getUncountedBdd());
+  BddWrapper all = conjunctionOf(manager, forest);
+  auto messages = [&](int numThreads) {
+    factor_graph * fg = factor_graph_new(manager, &forestFuncs.front(), static_cast<int>(forestFuncs.size()));
+    assert(factor_graph_acyclic_all_messages(fg, numThreads) == 1);
+    std::vector<BddWrapper> result;
+    for (int i = 0; i < fg->num_edges; ++i)
+    {
+      result.emplace_back(bdd_dup(fg->edges[i]->msg_fv), manager);
+      result.emplace_back(bdd_dup(fg->edges[i]->msg_vf), manager);
+    }
+    for (int i = 0; i < fg->num_vars; ++i)
+    {
+      BddWrapper incoming = v[0].one(), vars(bdd_dup(fg->vars[i]->ss[0]), manager);
+      for (int j = 0; j < fg->vars[i]->num_neigh; ++j)
+        incoming = incoming * BddWrapper(bdd_dup(fg->vars[i]->neigh[j]->msg_fv), manager);
+      BddWrapper others = conjunctionOf(manager, v).cubeDiff(vars);
+      assert(incoming == all.existentialQuantification(others));
+    }
+    factor_graph_delete(fg);
+    return result;
+  };
+  assert(messages(1) == messages(3));
+
+  factor_graph * fg = factor_graph_new(manager, &funcs.front(), static_cast<int>(funcs.size()));
+  assert(factor_graph_acyclic_all_messages(fg, 1) == -1);
+  factor_graph_delete(fg);
+} // end testLegacyFactorGraphAllMessages
+
+void testLegacyFactorGraphWorklist(DdManager * manager)
+{
+  // the nodes that groupings and assignments make after a converge are queued by the next one,
+  //   past the end of the queued bitmap of the first: a reconverge keeps the graph consistent
+  //   and within the messages of a cold converge, and a converge reaches them exactly
+  using dd::BddWrapper;
+  std::vector<BddWrapper> v = makeVars(manager, 60);
+  std::vector<BddWrapper> clauses = makeHubClauses(v);
+  for (int i = 8; i + 1 < 60; ++i)
+    clauses.push_back((i % 2 ? v[i] : -v[i]) + v[i + 1] + v[(i * 5) % 8]);
+  std::vector<bdd_ptr> funcs;
+  for (auto const & c: clauses)
+    funcs.push_back(c.getUncountedBdd());
+  std::vector<BddWrapper> groups{v[4] * v[5], v[10] * v[11] * v[12], v[20] * v[30]};
+  // each step makes new nodes, by grouping variables or by assigning one
+  auto step = [&](factor_graph * fg, int i) {
+    fg->time++;
+    if (i % 2 == 0)
+      assert(factor_graph_group_vars(fg, groups[i / 2].getUncountedBdd()) == 0);
+    else
+      assert(factor_graph_assign_var(fg, (i % 4 == 1 ? v[9 + 4 * i] : -v[9 + 4 * i]).getUncountedBdd()) == 0);
+  };
+  std::vector<BddWrapper> queries{v[0], v[2], v[3], v[4], v[7], v[11], v[20], v[38]};
+  factor_graph * fg = factor_graph_new(manager, &funcs.front(), static_cast<int>(funcs.size()));
+  assert(factor_graph_converge(fg) > 0);
+  for (int i = 0; i < 6; ++i)
+  {
+    step(fg, i);
+    assert(factor_graph_reconverge(fg) >= 0);
+    assert(factor_graph_verify(fg) > 0);
+    auto const warm = incomingMessages(fg, queries);
+
+    factor_graph * cold = factor_graph_new(manager, &funcs.front(), static_cast<int>(funcs.size()));
+    for (int j = 0; j <= i; ++j)
+      step(cold, j);
+    assert(factor_graph_converge(cold) > 0);
+    auto const coldMessages = incomingMessages(cold, queries);
+    factor_graph_delete(cold);
+
+    assert(warm.size() == coldMessages.size());
+    for (size_t j = 0; j < warm.size(); ++j)
+      assert(BddWrapper(warm[j] * -coldMessages[j]).isZero());
+    assert(factor_graph_converge(fg) > 0);
+    assert(factor_graph_verify(fg) > 0);
+    assert(incomingMessages(fg, queries) == coldMessages);
+  }
+  factor_graph_delete(fg);
+} // end testLegacyFactorGraphWorklist
+
+void testBddOperandSet(DdManager * manager)
+{
+  using parakram::BddOperandSet;
+  using dd::BddWrapper;
+  std::vector<BddWrapper> v;
+  for (int i = 0; i < 12; ++i)
+    v.emplace_back(bdd_new_var_with_index(manager, i), manager);
+  auto one = v[0].one();
+  auto f = v[0] * v[1], g = v[1] + v[2], h = -v[2] * v[3];
+
+  // operands are sorted by level, ones and duplicates are dropped
+  std::vector<bdd_ptr> ops1{ h.getUncountedBdd(), one.getUncountedBdd(), f.getUncountedBdd(),
+                             g.getUncountedBdd(), h.getUncountedBdd() };
+  std::vector<bdd_ptr> ops2{ g.getUncountedBdd(), f.getUncountedBdd(), h.getUncountedBdd() };
+  auto s1 = BddOperandSet<2>::fromRange(manager, ops1.cbegin(), ops1.cend());
+  auto s2 = BddOperandSet<2>::fromRange(manager, ops2.cbegin(), ops2.cend());
+  assert(s1.size() == 3);
+  assert(!s1.isZero());
+  assert(s1.isSpilled());
+  assert(s1[0] == f.getUncountedBdd());
+  assert(s1[2] == h.getUncountedBdd());
+  assert(s1.topLevel(manager) == Cudd_ReadPerm(manager, 0));
+  assert(s1 == s2);
+  assert(s1.hash() == s2.hash());
+  assert(std::hash<BddOperandSet<2> >()(s1) == s2.hash());
+
+  // lookup and removal keep the hash up to date
+  assert(s1.contains(manager, g.getUncountedBdd()));
+  assert(!s1.contains(manager, one.getUncountedBdd()));
+  assert(s1.erase(manager, g.getUncountedBdd()));
+  assert(!s1.erase(manager, g.getUncountedBdd()));
+  assert(s1.size() == 2);
+  assert(s1 != s2);
+  std::vector<bdd_ptr> ops3{ h.getUncountedBdd(), f.getUncountedBdd() };
+  assert(s1 == BddOperandSet<2>::fromRange(manager, ops3.cbegin(), ops3.cend()));
+
+  // zero and complementary pairs make the whole set zero
+  std::vector<bdd_ptr> ops4{ f.getUncountedBdd(), (-f).getUncountedBdd(), g.getUncountedBdd() };
+  assert(BddOperandSet<4>::fromRange(manager, ops4.cbegin(), ops4.cend()).isZero());
+  std::vector<bdd_ptr> ops5{ f.getUncountedBdd(), one.zero().getUncountedBdd() };
+  assert(BddOperandSet<4>::fromRange(manager, ops5.cbegin(), ops5.cend()).isZero());
+  std::vector<bdd_ptr> ops6{ one.getUncountedBdd() };
+  assert(BddOperandSet<4>::fromRange(manager, ops6.cbegin(), ops6.cend()).empty());
+
+  // splitting on the top variable gives normalized cofactors
+  auto s3 = BddOperandSet<4>::fromRange(manager, ops2.cbegin(), ops2.cend());
+  BddOperandSet<4> t3, e3;
+  int index = s3.splitOnTop(manager, t3, e3);
+  assert(index == 0);
+  assert(e3.isZero()); // f = v0 * v1 has a zero else child
+  assert(t3.size() == 3);
+  assert(t3.contains(manager, v[1].getUncountedBdd()));
+
+  // large sets spill, and survive copies and moves
+  std::vector<bdd_ptr> ops7;
+  for (const auto & var: v)
+    ops7.push_back(var.getUncountedBdd());
+  auto s7 = BddOperandSet<8>::fromRange(manager, ops7.crbegin(), ops7.crend());
+  assert(s7.size() == 12);
+  assert(s7.isSpilled());
+  for (int i = 0; i < 12; ++i)
+    assert(s7[i] == v[i].getUncountedBdd());
+  auto s8 = s7;
+  assert(s8 == s7);
+  auto s9 = std::move(s8);
+  assert(s9 == s7);
+  assert(s8.empty());
+}
+
+void testMultiComputedTable(DdManager * manager)
+{
+  using parakram::BddOperandSet;
+  using parakram::MultiComputedTable;
+  using dd::BddWrapper;
+  std::vector<BddWrapper> v;
+  for (int i = 0; i < 6; ++i)
+    v.emplace_back(bdd_new_var_with_index(manager, i), manager);
+  auto & table = MultiComputedTable::forManager(manager, 1024);
+  assert(&table == &MultiComputedTable::forManager(manager, 16));
+  assert(table.capacity() >= 1024);
+  table.clear();
+  table.resetStats();
+
+  bdd_ptr_set funcs;
+  {
+    auto f = v[0] + v[1], g = -v[1] + v[2], h = v[2] + v[3] + -v[4], k = v[4] * -v[5] + v[0];
+    for (auto const & x: { f, g, h, k })
+      funcs.insert(bdd_dup(x.getUncountedBdd()));
+  }
+  BddWrapper product(bdd_one(manager), manager);
+  for (auto x: funcs)
+    product = product * BddWrapper(bdd_dup(x), manager);
+  auto cube1 = v[1].cubeUnion(v[2]).cubeUnion(v[4]);
+  auto cube2 = v[0].cubeUnion(v[3]);
+
+  // results are correct, and persist across calls
+  BddWrapper r1(bdd_and_exists_multi(manager, funcs, cube1.getUncountedBdd(), 16), manager);
+  assert(r1 == product.existentialQuantification(cube1));
+  assert(table.stats().insertions > 0);
+  assert(table.size() > 0);
+  auto hitsBefore = table.stats().hits;
+  BddWrapper r2(bdd_and_exists_multi(manager, funcs, cube1.getUncountedBdd(), 16), manager);
+  assert(r2 == r1);
+  assert(table.stats().hits > hitsBefore);
+
+  // the cube is part of the key
+  BddWrapper r3(bdd_and_exists_multi(manager, funcs, cube2.getUncountedBdd(), 16), manager);
+  assert(r3 == product.existentialQuantification(cube2));
+  BddWrapper r4(bdd_and_multi(manager, funcs, 16), manager);
+  assert(r4 == product);
+
+  // so is the number of variables of a minterm count
+  auto count6 = bdd_count_minterm_multi(manager, funcs, 6, 16);
+  auto count7 = bdd_count_minterm_multi(manager, funcs, 7, 16);
+  assert(count6 == Cudd_CountMinterm(manager, product.getUncountedBdd(), 6));
+  assert(count7 == 2 * count6);
+  assert(table.stats().hitRate() > 0);
+
+  // entries that refer to dead nodes are purged
+  auto fSet = BddOperandSet<4>::fromRange(manager, funcs.cbegin(), funcs.cend());
+  DdNode * cached;
+  assert(table.lookup(MultiComputedTable::And, fSet, NULL, 0, cached));
+  auto sizeBefore = table.size();
+  for (auto x: funcs)
+    bdd_free(manager, x);
+  table.purgeDeadEntries();
+  assert(table.stats().purges > 0);
+  assert(table.size() < sizeBefore);
+  assert(!table.lookup(MultiComputedTable::And, fSet, NULL, 0, cached));
+
+  // a manager at the address of one destroyed with a bare Cudd_Quit
+  // does not inherit its table (the allocator usually reuses the address)
+  for (int i = 0; i < 4; ++i)
+  {
+    DdManager * other = Cudd_Init(0, 0, 256, 262144, 0);
+    auto & otherTable = MultiComputedTable::forManager(other, 16);
+    assert(otherTable.size() == 0);
+    bdd_ptr_set xyz;
+    for (int vi = 0; vi < 3; ++vi)
+      xyz.insert(bdd_new_var_with_index(other, vi));
+    bdd_free(other, bdd_and_multi(other, xyz, 16));
+    assert(otherTable.size() > 0);
+    for (auto x: xyz)
+      bdd_free(other, x);
+    if (i < 3)
+      Cudd_Quit(other);
+    else
+      bdd_quit(other);
+  }
 }
 
 void testOptional() {
@@ -641,10 +1374,10 @@ void testCuddBddAndAbstractMulti(DdManager * manager)
 
     auto autoConjunction = bdd_and_multi(manager, funcs, 100*1000);
     auto autoResult = bdd_and_exists_multi(manager, funcs, cube, 100*1000);
-    auto conjunctionClipUp = bdd_clipping_and_multi(manager, funcs, maxDepth, dd_constants::Clip_Up);
-    auto conjunctionClipDown = bdd_clipping_and_multi(manager, funcs, maxDepth, dd_constants::Clip_Down);
-    auto resultClipUp = bdd_clipping_and_exists_multi(manager, funcs, cube, maxDepth, dd_constants::Clip_Up);
-    auto resultClipDown = bdd_clipping_and_exists_multi(manager, funcs, cube, maxDepth, dd_constants::Clip_Down);
+    auto conjunctionClipUp = bdd_clipping_and_multi(manager, funcs, maxDepth, dd_constants::Clip_Up, 100*1000);
+    auto conjunctionClipDown = bdd_clipping_and_multi(manager, funcs, maxDepth, dd_constants::Clip_Down, 100*1000);
+    auto resultClipUp = bdd_clipping_and_exists_multi(manager, funcs, cube, maxDepth, dd_constants::Clip_Up, 100*1000);
+    auto resultClipDown = bdd_clipping_and_exists_multi(manager, funcs, cube, maxDepth, dd_constants::Clip_Down, 100*1000);
 
 
     if (manualResult != autoResult)
@@ -676,6 +1409,272 @@ void testCuddBddAndAbstractMulti(DdManager * manager)
   return;
 } // end testCuddBddAndAbstractMulti
 
+void testCuddBddClippingAndAbstractMultiDeepening(DdManager * manager)
+{
+  // without a budget, the deepening runs until a round clips nothing,
+  //   which is exact, in either direction
+  int const numVars = 3;
+  int const totalFuncs = 1 << (1 << numVars);
+  for (int itest = 0; itest < 500; ++itest)
+  {
+    std::set<DdNode *> funcs;
+    for (int ifunc = 0; ifunc < 3; ++ifunc)
+      funcs.insert(makeFunc(manager, numVars, rand() % totalFuncs));
+    DdNode * cube = bdd_new_var_with_index(manager, itest % numVars);
+    auto exact = bdd_and_exists_multi(manager, funcs, cube, 100*1000);
+    for (int direction: {dd_constants::Clip_Up, dd_constants::Clip_Down})
+    {
+      int reachedDepth = 0;
+      auto deep = bdd_clipping_and_exists_multi_deepening(
+          manager, funcs, cube, direction, 1, 0, 0, 100*1000, &reachedDepth);
+      if (deep != exact || reachedDepth < 1)
+        throw std::runtime_error("bdd_clipping_and_exists_multi_deepening did not give expected result");
+      bdd_free(manager, deep);
+    }
+    for (auto f: funcs)
+      bdd_free(manager, f);
+    bdd_free(manager, cube);
+    bdd_free(manager, exact);
+  }
+
+  // a chain of clauses, with every other variable quantified
+  int const chainLength = 12;
+  std::set<DdNode *> funcs;
+  DdNode * cube = bdd_one(manager);
+  for (int i = 0; i < chainLength; ++i)
+  {
+    auto x = bdd_new_var_with_index(manager, i);
+    auto y = bdd_new_var_with_index(manager, (i + 1) % chainLength);
+    auto notX = bdd_not(x);
+    funcs.insert(bdd_or(manager, i % 3 ? x : notX, y));
+    if (i % 2)
+    {
+      auto temp = cube;
+      cube = bdd_cube_union(manager, cube, x);
+      bdd_free(manager, temp);
+    }
+    bdd_free(manager, x);
+    bdd_free(manager, notX);
+    bdd_free(manager, y);
+  }
+  auto exact = bdd_and_exists_multi(manager, funcs, cube, 100*1000);
+
+  // the deepening goes as deep as it must, and no deeper than with a node budget
+  //   (from an empty table each time, since exact results are reused at any depth)
+  auto & table = parakram::MultiComputedTable::forManager(manager);
+  int fullDepth = 0, budgetedDepth = 0;
+  table.clear();
+  auto full = bdd_clipping_and_exists_multi_deepening(
+      manager, funcs, cube, dd_constants::Clip_Up, 1, 0, 0, 100*1000, &fullDepth);
+  table.clear();
+  auto budgeted = bdd_clipping_and_exists_multi_deepening(
+      manager, funcs, cube, dd_constants::Clip_Up, 1, 1, 0, 100*1000, &budgetedDepth);
+  if (full != exact || fullDepth < 2)
+    throw std::runtime_error("bdd_clipping_and_exists_multi_deepening did not reach the exact result");
+  if (budgetedDepth < 1 || budgetedDepth >= fullDepth || !Cudd_bddLeq(manager, exact, budgeted))
+    throw std::runtime_error("bdd_clipping_and_exists_multi_deepening did not stop at the node budget");
+  bdd_free(manager, full);
+  bdd_free(manager, budgeted);
+
+  // a repeated clipping call is found in the table,
+  //   while the remaining distance and the direction are part of the key
+  table.clear();
+  auto clip = [&](int depth, int direction) {
+    auto before = table.stats();
+    bdd_free(manager, bdd_clipping_and_exists_multi(manager, funcs, cube, depth, direction, 100*1000));
+    auto after = table.stats();
+    return std::make_pair(after.hits - before.hits, after.misses - before.misses);
+  };
+  clip(2, dd_constants::Clip_Up);
+  auto repeated = clip(2, dd_constants::Clip_Up);
+  if (repeated.first == 0 || repeated.second != 0)
+    throw std::runtime_error("a repeated clipping call missed the computed table");
+  if (clip(3, dd_constants::Clip_Up).second == 0 || clip(2, dd_constants::Clip_Down).second == 0)
+    throw std::runtime_error("a clipping call at another depth or direction hit the computed table");
+
+  for (auto f: funcs)
+    bdd_free(manager, f);
+  bdd_free(manager, cube);
+  bdd_free(manager, exact);
+} // end testCuddBddClippingAndAbstractMultiDeepening
+
+void testCuddBddAndAbstractMultiParallel(DdManager * manager)
+{
+  int const numVars = 4;
+  int const numTests = 50;
+  int const numFuncsPerTest = 4;
+  int const totalFuncs = 1 << (1 << numVars);
+  for (int itest = 0; itest < numTests; ++itest)
+  {
+    std::set<DdNode *> funcs;
+    for (int ifunc = 0; ifunc < numFuncsPerTest; ++ifunc)
+      funcs.insert(makeFunc(manager, numVars, rand() % totalFuncs));
+
+    // quantify every other variable,
+    // so that the split variables are both quantified and not
+    DdNode * cube = bdd_one(manager);
+    for (int vi = itest % 2; vi < numVars; vi += 2)
+    {
+      auto var = bdd_new_var_with_index(manager, vi);
+      auto temp = cube;
+      cube = bdd_cube_union(manager, cube, var);
+      bdd_free(manager, temp);
+      bdd_free(manager, var);
+    }
+
+    // with as many threads as jobs, and fewer, so that some subtrees
+    // of the combination span several workers and others do not
+    auto expected = bdd_and_exists_multi(manager, funcs, cube, 100*1000);
+    for (auto splitAndThreads: {std::make_pair(2, 2), std::make_pair(3, 3), std::make_pair(4, 3), std::make_pair(1, 4)})
+    {
+      auto result = bdd_and_exists_multi_parallel(manager, funcs, cube, 100*1000,
+                                                   splitAndThreads.first, splitAndThreads.second);
+      if (result != expected)
+        throw std::runtime_error("bdd_and_exists_multi_parallel did not give expected result");
+      bdd_free(manager, result);
+    }
+
+    for (auto f: funcs)
+      bdd_free(manager, f);
+    bdd_free(manager, cube);
+    bdd_free(manager, expected);
+  }
+} // end testCuddBddAndAbstractMultiParallel
+
+
+
+void testCuddBddAndAbstractMultiBudgeted(DdManager * manager)
+{
+  // random 3-clauses over more variables than the other tests use,
+  // so that solving them makes new nodes
+  int const numVars = 12;
+  int const numTests = 200;
+  int const numFuncsPerTest = 8;
+  for (int itest = 0; itest < numTests; ++itest)
+  {
+    std::set<DdNode *> funcs;
+    for (int ifunc = 0; ifunc < numFuncsPerTest; ++ifunc)
+    {
+      auto clause = bdd_zero(manager);
+      for (int ilit = 0; ilit < 3; ++ilit)
+      {
+        auto var = bdd_new_var_with_index(manager, rand() % numVars);
+        auto lit = (rand() % 2) ? bdd_dup(var) : bdd_not(var);
+        bdd_or_accumulate(manager, &clause, lit);
+        bdd_free(manager, lit);
+        bdd_free(manager, var);
+      }
+      if (!funcs.insert(clause).second)
+        bdd_free(manager, clause);
+    }
+    DdNode * cube = bdd_one(manager);
+    for (int vi = itest % 2; vi < numVars; vi += 2)
+    {
+      auto var = bdd_new_var_with_index(manager, vi);
+      auto temp = cube;
+      cube = bdd_cube_union(manager, cube, var);
+      bdd_free(manager, temp);
+      bdd_free(manager, var);
+    }
+
+    // with a budget that runs out part of the way,
+    // the result is an approximation in the requested direction,
+    // and agrees with the exact result wherever it claims to be exact
+    // (the budget is a few nodes over the current count,
+    // and none of the exact result has been computed yet)
+    std::vector<bdd_ptr> results, exactParts;
+    int const directions[] = {dd_constants::Clip_Up, dd_constants::Clip_Down};
+    bdd_ptr exactPart = NULL;
+    for (int direction: directions)
+    {
+      int const budget = Cudd_ReadKeys(manager) - Cudd_ReadDead(manager) + rand() % 8;
+      results.push_back(bdd_and_exists_multi_budgeted(
+          manager, funcs, cube, direction, budget, 0, 1, 100*1000, &exactPart));
+      exactParts.push_back(exactPart);
+    }
+    auto expected = bdd_and_exists_multi(manager, funcs, cube, 100*1000);
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+      bool const isApprox = directions[i] == dd_constants::Clip_Up
+                              ? Cudd_bddLeq(manager, expected, results[i])
+                              : Cudd_bddLeq(manager, results[i], expected);
+      if (!isApprox)
+        throw std::runtime_error("bdd_and_exists_multi_budgeted did not give an approximation");
+      auto exactResult = bdd_and(manager, results[i], exactParts[i]);
+      auto exactExpected = bdd_and(manager, expected, exactParts[i]);
+      if (exactResult != exactExpected)
+        throw std::runtime_error("bdd_and_exists_multi_budgeted is not exact in its exact part");
+      bdd_free(manager, exactResult);
+      bdd_free(manager, exactExpected);
+      bdd_free(manager, exactParts[i]);
+      bdd_free(manager, results[i]);
+    }
+
+    // without a budget, the result is exact
+    auto unlimited = bdd_and_exists_multi_budgeted(
+        manager, funcs, cube, dd_constants::Clip_Up, 0, 0, 1, 100*1000, &exactPart);
+    if (unlimited != expected || exactPart != Cudd_ReadOne(manager))
+      throw std::runtime_error("bdd_and_exists_multi_budgeted did not give exact result");
+    bdd_free(manager, unlimited);
+    bdd_free(manager, exactPart);
+
+    for (auto f: funcs)
+      bdd_free(manager, f);
+    bdd_free(manager, cube);
+    bdd_free(manager, expected);
+  }
+} // end testCuddBddAndAbstractMultiBudgeted
+
+
+
+void testMultiStackStats(DdManager * manager)
+{
+  int const numVars = 6;
+  std::set<DdNode *> funcs;
+  DdNode * cube = bdd_one(manager);
+  for (int vi = 0; vi < numVars; ++vi)
+  {
+    // a chain of implications x_i -> x_{i+1}
+    auto x = bdd_new_var_with_index(manager, vi);
+    auto y = bdd_new_var_with_index(manager, (vi + 1) % numVars);
+    auto notX = bdd_not(x);
+    funcs.insert(bdd_or(manager, notX, y));
+    bdd_free(manager, notX);
+    if (vi % 2 == 0)
+    {
+      auto temp = cube;
+      cube = bdd_cube_union(manager, cube, x);
+      bdd_free(manager, temp);
+    }
+    bdd_free(manager, x);
+    bdd_free(manager, y);
+  }
+
+  Cudd_ResetMultiStackPeak();
+  int peakDepth = 0, numFrames = 0;
+  Cudd_ReadMultiStackStats(&peakDepth, &numFrames);
+  if (peakDepth != 0)
+    throw std::runtime_error("Cudd_ResetMultiStackPeak did not reset the peak depth");
+
+  auto result = bdd_and_exists_multi(manager, funcs, cube, 100*1000);
+  Cudd_ReadMultiStackStats(&peakDepth, &numFrames);
+  if (peakDepth <= 0 || numFrames < peakDepth)
+    throw std::runtime_error("Cudd_ReadMultiStackStats did not record the stack usage");
+
+  // the stack is unwound and its frames reused by the next call
+  int const framesBefore = numFrames;
+  auto again = bdd_and_exists_multi(manager, funcs, cube, 100*1000);
+  Cudd_ReadMultiStackStats(&peakDepth, &numFrames);
+  if (again != result || numFrames != framesBefore)
+    throw std::runtime_error("multi-operand kernels did not reuse their stack frames");
+
+  for (auto f: funcs)
+    bdd_free(manager, f);
+  bdd_free(manager, cube);
+  bdd_free(manager, result);
+  bdd_free(manager, again);
+} // end testMultiStackStats
+
 void testCuddBddCountMintermsMulti(DdManager * manager)
 {
   const int numVars = 3;
@@ -727,6 +1726,158 @@ void testCuddBddCountMintermsMulti(DdManager * manager)
  
 }
 
+
+
+void testCuddBddCountMintermsMultiExact(DdManager * manager)
+{
+  // (x_i or y_i) for 100 disjoint pairs, over 210 variables,
+  // has 3^100 * 2^10 solutions, far more than a long double holds exactly
+  int const numPairs = 100;
+  int const numVars = 2 * numPairs + 10;
+  std::string const expected = "527746581229579602981336196879996183246958102529024";
+  std::set<DdNode *> funcs;
+  for (int i = 0; i < numPairs; ++i)
+  {
+    auto x = bdd_new_var_with_index(manager, 2 * i);
+    auto y = bdd_new_var_with_index(manager, 2 * i + 1);
+    funcs.insert(bdd_or(manager, x, y));
+    bdd_free(manager, x);
+    bdd_free(manager, y);
+  }
+
+  auto whole = bdd_count_minterm_multi_exact(manager, funcs, numVars, 100*1000);
+  if (whole.toString() != expected)
+    throw std::runtime_error("bdd_count_minterm_multi_exact gave " + whole.toString()
+                             + " instead of " + expected);
+  // the second call finds every pair in the shared tiers
+  auto & shared = parakram::MultiComputedTable::sharedCounts();
+  auto & shapes = parakram::MultiComputedTable::sharedShapes();
+  shared.resetStats();
+  shapes.resetStats();
+  for (int numThreads: {1, 3})
+  {
+    auto product = bdd_count_minterm_multi_partitioned(manager, funcs, numVars, 100*1000, numThreads);
+    if (product != whole)
+      throw std::runtime_error("bdd_count_minterm_multi_partitioned gave " + product.toString()
+                               + " instead of " + expected);
+  }
+  if (shared.stats().hits < static_cast<unsigned long long>(numPairs))
+    throw std::runtime_error("bdd_count_minterm_multi_partitioned did not reuse the shared counts");
+  if (shapes.stats().hits < static_cast<unsigned long long>(numPairs))
+    throw std::runtime_error("bdd_count_minterm_multi_partitioned did not reuse the shared shapes");
+
+  for (auto f: funcs)
+    bdd_free(manager, f);
+
+  // on random operands over three variables, both counts match the count of the conjunction
+  int const numSmallVars = 3;
+  int const totalFuncs = 1 << (1 << numSmallVars);
+  for (int itest = 0; itest < 1000; ++itest)
+  {
+    std::set<DdNode *> smallFuncs;
+    for (int ifunc = 0; ifunc < 3; ++ifunc)
+      smallFuncs.insert(makeFunc(manager, numSmallVars, rand() % totalFuncs));
+    const auto exactAnswer = bdd_count_minterm_multi_exact(manager, smallFuncs, numSmallVars, 100*1000);
+    const auto partitionedAnswer = bdd_count_minterm_multi_partitioned(manager, smallFuncs, numSmallVars, 100*1000, 1);
+    bdd_ptr conj = bdd_and_multi(manager, smallFuncs, 100*1000);
+    const auto expectedAnswer = bdd_count_minterm(manager, conj, numSmallVars);
+    bdd_free(manager, conj);
+    for (auto f: smallFuncs)
+      bdd_free(manager, f);
+    if (exactAnswer.toLongDouble() != expectedAnswer || partitionedAnswer != exactAnswer)
+      throw std::runtime_error("bdd_count_minterm_multi_exact did not give expected result");
+  }
+} // end testCuddBddCountMintermsMultiExact
+
+
+void testMultiOperandSpanOverloads(DdManager * manager)
+{
+  // the span overloads take the operands unsorted, with a duplicate and a constant one,
+  //   and agree with the set overloads
+  int const numVars = 3;
+  int const numTests = 1000;
+  int const numFuncsPerTest = 3;
+  int const maxDepth = 2;
+  int const totalMinTerms = 1 << numVars;
+  int const totalFuncs = 1 << totalMinTerms;
+  for (int itest = 0; itest < numTests; ++itest)
+  {
+    std::set<DdNode *> funcs;
+    for (int ifunc = 0; ifunc < numFuncsPerTest; ++ifunc)
+      funcs.insert(makeFunc(manager, numVars, rand() % totalFuncs));
+    DdNode * cube = bdd_new_var_with_index(manager, rand() % numVars);
+    std::vector<DdNode *> funcVec(funcs.crbegin(), funcs.crend());
+    funcVec.push_back(*funcs.cbegin());
+    funcVec.push_back(Cudd_ReadOne(manager));
+
+    std::vector<std::pair<DdNode *, DdNode *> > results;
+    results.emplace_back(bdd_and_multi(manager, funcs, 100*1000),
+                         bdd_and_multi(manager, funcVec, 100*1000));
+    results.emplace_back(bdd_and_exists_multi(manager, funcs, cube, 100*1000),
+                         bdd_and_exists_multi(manager, funcVec, cube, 100*1000));
+    for (int direction: {dd_constants::Clip_Up, dd_constants::Clip_Down})
+    {
+      results.emplace_back(bdd_clipping_and_multi(manager, funcs, maxDepth, direction, 100*1000),
+                           bdd_clipping_and_multi(manager, funcVec, maxDepth, direction, 100*1000));
+      results.emplace_back(bdd_clipping_and_exists_multi(manager, funcs, cube, maxDepth, direction, 100*1000),
+                           bdd_clipping_and_exists_multi(manager, funcVec, cube, maxDepth, direction, 100*1000));
+    }
+    for (auto const & r: results)
+    {
+      if (r.first != r.second)
+        throw std::runtime_error("the span overloads of the multi-operand conjunctions did not agree with the set overloads");
+      bdd_free(manager, r.first);
+      bdd_free(manager, r.second);
+    }
+
+    // a duplicate must not be counted twice
+    auto const whole = bdd_count_minterm_multi_exact(manager, funcs, numVars, 100*1000);
+    if (bdd_count_minterm_multi(manager, funcVec, numVars, 100*1000) != bdd_count_minterm_multi(manager, funcs, numVars, 100*1000)
+        || bdd_count_minterm_multi_exact(manager, funcVec, numVars, 100*1000) != whole
+        || bdd_count_minterm_multi_partitioned(manager, funcVec, numVars, 100*1000, 2) != whole)
+      throw std::runtime_error("the span overloads of the minterm count did not agree with the set overloads");
+
+    for (auto f: funcs)
+      bdd_free(manager, f);
+    bdd_free(manager, cube);
+  }
+} // end testMultiOperandSpanOverloads
+
+
+
+void testBigCount()
+{
+  using parakram::BigCount;
+  if (BigCount().toString() != "0" || BigCount(1234567890123ULL).toString() != "1234567890123")
+    throw std::runtime_error("BigCount::toString failed on small values");
+  auto p100 = BigCount::powerOfTwo(100);
+  if (p100.toString() != "1267650600228229401496703205376" || p100.numBits() != 101)
+    throw std::runtime_error("BigCount::powerOfTwo failed");
+
+  // (2^64 + 5) * (2^70 + 3)
+  auto a = BigCount::powerOfTwo(64);
+  a += BigCount(5);
+  auto b = BigCount::powerOfTwo(70);
+  b += BigCount(3);
+  a *= b;
+  if (a.toString() != "21778071482940061667614273211441350705167")
+    throw std::runtime_error("BigCount multiplication failed");
+
+  // shifts undo each other, carries ripple across limbs
+  auto c = a;
+  c.shiftLeft(45).shiftRight(45);
+  if (c != a)
+    throw std::runtime_error("BigCount shifts failed");
+  auto d = BigCount(0xffffffffULL);
+  d += BigCount(1);
+  if (d != BigCount::powerOfTwo(32))
+    throw std::runtime_error("BigCount addition failed to carry");
+  if (BigCount::powerOfTwo(70).toLongDouble() != std::ldexp(1.0L, 70))
+    throw std::runtime_error("BigCount::toLongDouble failed");
+  if (!(BigCount(7) *= BigCount()).isZero())
+    throw std::runtime_error("BigCount multiplication by zero failed");
+} // end testBigCount
+
 DdNode * makeFunc(DdManager * manager, int const numVars, int const funcAsInteger)
 {
   int const totalMinTerms = 1 << numVars;
@@ -758,4 +1909,48 @@ DdNode * makeFunc(DdManager * manager, int const numVars, int const funcAsIntege
   return func;
 }
 
+std::vector<dd::BddWrapper> makeVars(DdManager * manager, int numVars)
+{
+  std::vector<dd::BddWrapper> result;
+  for (int i = 0; i < numVars; ++i)
+    result.emplace_back(bdd_new_var_with_index(manager, i), manager);
+  return result;
+}
+
+// over at least eight variables: v[0] is a hub, in clauses with each of v[1..7]
+std::vector<dd::BddWrapper> makeHubClauses(std::vector<dd::BddWrapper> const & v)
+{
+  std::vector<dd::BddWrapper> clauses;
+  for (int i = 1; i < 8; ++i)
+  {
+    clauses.push_back(v[0] + (i % 2 ? v[i] : -v[i]));
+    clauses.push_back(-v[0] + v[i] + v[(i % 7) + 1]);
+  }
+  clauses.push_back(-v[3]);
+  return clauses;
+}
+
+dd::BddWrapper conjunctionOf(DdManager * manager, std::vector<dd::BddWrapper> const & funcs)
+{
+  dd::BddWrapper result(bdd_one(manager), manager);
+  for (auto const & f: funcs)
+    result = result * f;
+  return result;
+}
+
+// the incoming messages of the var nodes of the given vars, in their order
+std::vector<dd::BddWrapper> incomingMessages(factor_graph * fg, std::vector<dd::BddWrapper> const & vars)
+{
+  std::vector<dd::BddWrapper> result;
+  for (auto const & var: vars)
+  {
+    int size = 0;
+    bdd_ptr * incoming = factor_graph_incoming_messages(fg, factor_graph_get_varnode(fg, var.getUncountedBdd()), &size);
+    for (int i = 0; i < size; ++i)
+      result.emplace_back(incoming[i], fg->m);
+    free(incoming);
+  }
+  return result;
+}
+
 
@@ -375,10 +375,11 @@ namespace {
 
         auto fg = fgpp::FactorGraph::createFactorGraph(mergedFactors);
         auto varsToBeProjectedOn = fgm.getVarsToBeProjectedOn();
+        std::vector<BddWrapper> variableGroups;
         for (auto vtbg: *varsToBeProjectedOn)
-          fg->groupVariables(BddWrapper(bdd_dup(vtbg), manager));
-        for (auto const & vtbg: mergedVariables)
-          fg->groupVariables(vtbg);
+          variableGroups.emplace_back(bdd_dup(vtbg), manager);
+        variableGroups.insert(variableGroups.end(), mergedVariables.cbegin(), mergedVariables.cend());
+        fg->groupVariables(variableGroups);
         blif_solve_log(INFO, "var_score/FactorGraphImpl: factor graph created in " 
                              << blif_solve::duration(start) 
                              << " sec");
@@ -417,7 +418,7 @@ namespace {
         for (auto vtbg: *varsToBeProjectedOn)
         {
           int numMessages;
-          auto messages = fg->getIncomingMessages(BddWrapper(bdd_dup(vtbg), manager));
+          auto messages = fg->getDistinctIncomingMessages(BddWrapper(bdd_dup(vtbg), manager));
 #ifdef DEBUG_VAR_SCORE
           blif_solve_log(INFO, messages.size() << " messages for " << vtbg);
 #endif